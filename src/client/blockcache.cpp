@@ -0,0 +1,179 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "blockcache.h"
+#include <algorithm>
+#include <ctime>
+#include "database/database-sqlite3.h"
+#include "exceptions.h"
+#include "filesys.h"
+#include "log.h"
+#include "network/networkprotocol.h"
+#include "util/numeric.h"
+
+// Blocks dropped from the database at once when it is too large
+#define BLOCK_CACHE_DELETE_BATCH 256
+
+ClientBlockCache::ClientBlockCache(const std::string &dir, u64 max_size):
+	m_dir(dir),
+	m_max_size(max_size)
+{
+	fs::CreateAllDirs(dir);
+	m_db = new BlockCacheDatabaseSQLite3(dir);
+	m_db->beginSave();
+}
+
+ClientBlockCache::~ClientBlockCache()
+{
+	if (m_list_thread.joinable())
+		m_list_thread.join();
+	m_db->endSave();
+	delete m_db;
+}
+
+u64 ClientBlockCache::hashData(const std::string &data)
+{
+	return murmur_hash_64_ua(data.c_str(), data.size(), BLOCK_CACHE_HASH_SEED);
+}
+
+void ClientBlockCache::store(v3s16 pos, const std::string &data)
+{
+	u64 old_size = m_db->saveBlock(pos, hashData(data), data, time(NULL));
+	m_size_change += (s64)data.size() - (s64)old_size;
+	if (!m_list_taken)
+		m_stored_before_list.insert(pos);
+}
+
+bool ClientBlockCache::load(v3s16 pos, std::string *data)
+{
+	if (!m_db->loadBlock(pos, data))
+		return false;
+	m_db->touchBlock(pos, time(NULL));
+	return true;
+}
+
+void ClientBlockCache::startListNear(v3s16 center, s16 radius, u32 max_count)
+{
+	if (m_list_thread.joinable())
+		return;
+	m_list_thread = std::thread(&ClientBlockCache::listNear, this,
+		center, radius, max_count);
+}
+
+void ClientBlockCache::listNear(v3s16 center, s16 radius, u32 max_count)
+{
+	std::vector<std::pair<v3s16, u64>> all;
+	u64 size = 0;
+	try {
+		// A connection of its own, the one of the main thread is not
+		// thread safe
+		BlockCacheDatabaseSQLite3 db(m_dir);
+		db.listBlocks(all);
+		size = db.getTotalSize();
+	} catch (BaseException &e) {
+		errorstream << "ClientBlockCache: failed to list blocks: "
+			<< e.what() << std::endl;
+		all.clear();
+	}
+
+	std::vector<std::pair<s32, size_t>> near;
+	for (size_t i = 0; i < all.size(); i++) {
+		v3s16 d = all[i].first - center;
+		s32 dist_sq = (s32)d.X * d.X + (s32)d.Y * d.Y + (s32)d.Z * d.Z;
+		if (dist_sq <= (s32)radius * radius)
+			near.emplace_back(dist_sq, i);
+	}
+	std::sort(near.begin(), near.end());
+	if (near.size() > max_count)
+		near.resize(max_count);
+
+	std::vector<std::pair<v3s16, u64>> list;
+	list.reserve(near.size());
+	for (const auto &it : near)
+		list.push_back(all[it.second]);
+
+	std::lock_guard<std::mutex> lock(m_list_mutex);
+	m_list = std::move(list);
+	m_list_size = size;
+	m_list_done = true;
+}
+
+bool ClientBlockCache::isListDone()
+{
+	if (!m_list_thread.joinable())
+		return false;
+	{
+		std::lock_guard<std::mutex> lock(m_list_mutex);
+		if (!m_list_done)
+			return false;
+	}
+	m_list_thread.join();
+	return true;
+}
+
+bool ClientBlockCache::getNearList(std::vector<std::pair<v3s16, u64>> *dst)
+{
+	if (!m_size_known && !isListDone())
+		return false;
+
+	// m_list is only written by the thread, which is done
+	if (!m_size_known) {
+		m_size = m_list_size;
+		m_size_known = true;
+	}
+	dst->clear();
+	for (const auto &it : m_list) {
+		if (m_stored_before_list.count(it.first) == 0)
+			dst->push_back(it);
+	}
+	m_list.clear();
+	m_list_taken = true;
+	m_stored_before_list.clear();
+	return true;
+}
+
+void ClientBlockCache::save()
+{
+	if (!m_size_known) {
+		// Committing now would change the size the list thread reads
+		if (!isListDone())
+			return;
+		m_size = m_list_size;
+		m_size_known = true;
+	}
+
+	m_size = (u64)MYMAX((s64)m_size + m_size_change, 0);
+	m_size_change = 0;
+
+	if (m_size > m_max_size) {
+		// Leave some room so that this does not happen on every save
+		u64 target = m_max_size / 10 * 9;
+		while (m_size > target) {
+			u64 size = m_db->deleteLeastRecentlyUsed(BLOCK_CACHE_DELETE_BATCH);
+			if (size == 0)
+				break;
+			m_size -= MYMIN(size, m_size);
+		}
+		infostream << "ClientBlockCache: dropped least recently used blocks, "
+			<< m_size / 1024 << " KiB left" << std::endl;
+	}
+
+	m_db->endSave();
+	m_db->beginSave();
+}
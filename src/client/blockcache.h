@@ -0,0 +1,96 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "irrlichttypes_bloated.h"
+
+class BlockCacheDatabaseSQLite3;
+
+/*
+	Persistent per-server cache of TOCLIENT_BLOCKDATA payloads.
+
+	Each entry holds the payload as received together with its hash, so
+	that the client can announce the blocks it has with
+	TOSERVER_CACHED_BLOCKS and the server can skip unchanged ones.
+
+	The cache is kept below a size limit by dropping the least recently
+	used blocks when it is saved.
+*/
+class ClientBlockCache
+{
+public:
+	/*
+		'dir' is the directory of the cache database, one per server.
+		'max_size' is the size limit of the cached payloads in bytes.
+	*/
+	ClientBlockCache(const std::string &dir, u64 max_size);
+	~ClientBlockCache();
+
+	static u64 hashData(const std::string &data);
+
+	// Stores the payload that followed the position in TOCLIENT_BLOCKDATA
+	void store(v3s16 pos, const std::string &data);
+	// Returns false if the block is not cached
+	bool load(v3s16 pos, std::string *data);
+
+	/*
+		Starts listing the cached blocks within 'radius' blocks of
+		'center', nearest first, at most 'max_count' of them. This reads
+		the whole database, so it is done by a thread of its own.
+	*/
+	void startListNear(v3s16 center, s16 radius, u32 max_count);
+	// Takes the list started by startListNear(), without the blocks that
+	// were stored since. Returns false while the list is not done.
+	bool getNearList(std::vector<std::pair<v3s16, u64>> *dst);
+
+	// Commits pending writes and drops blocks above the size limit
+	void save();
+
+private:
+	void listNear(v3s16 center, s16 radius, u32 max_count);
+	bool isListDone();
+
+	const std::string m_dir;
+	const u64 m_max_size;
+	BlockCacheDatabaseSQLite3 *m_db = nullptr;
+
+	// Total size of the cached payloads is the size read by the list
+	// thread plus the change since the database was opened. Nothing is
+	// committed before the list thread is done, so it reads the size at
+	// the time of opening.
+	s64 m_size_change = 0;
+	u64 m_size = 0;
+	bool m_size_known = false;
+
+	std::thread m_list_thread;
+	std::mutex m_list_mutex;
+	bool m_list_done = false;
+	bool m_list_taken = false;
+	// Blocks stored before the list was taken, their listed hash is old
+	std::unordered_set<v3s16> m_stored_before_list;
+	u64 m_list_size = 0;
+	std::vector<std::pair<v3s16, u64>> m_list;
+};
@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/connection.h"
 #include "network/networkpacket.h"
 #include "threading/mutex_auto_lock.h"
+#include "client/blockcache.h"
 #include "client/clientevent.h"
 #include "client/gameui.h"
 #include "client/renderingengine.h"
@@ -57,6 +58,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "game.h"
 #include "chatmessage.h"
 #include "translation.h"
+#include "frametrace.h"
 
 extern gui::IGUIEnvironment* guienv;
 
@@ -84,7 +86,7 @@ Client::Client(
 	m_nodedef(nodedef),
 	m_sound(sound),
 	m_event(event),
-	m_mesh_update_thread(this),
+	m_mesh_update_manager(this),
 	m_env(
 		new ClientMap(this, control, 666),
 		tsrc, this
@@ -247,7 +249,7 @@ void Client::Stop()
 	if (m_modding_enabled)
 		m_script->on_shutdown();
 	//request all client managed threads to stop
-	m_mesh_update_thread.stop();
+	m_mesh_update_manager.stop();
 	// Save local server map
 	if (m_localdb) {
 		infostream << "Local map saving ended." << std::endl;
@@ -260,7 +262,7 @@ void Client::Stop()
 
 bool Client::isShutdown()
 {
-	return m_shutdown || !m_mesh_update_thread.isRunning();
+	return m_shutdown || !m_mesh_update_manager.isRunning();
 }
 
 Client::~Client()
@@ -270,10 +272,10 @@ Client::~Client()
 
 	deleteAuthData();
 
-	m_mesh_update_thread.stop();
-	m_mesh_update_thread.wait();
-	while (!m_mesh_update_thread.m_queue_out.empty()) {
-		MeshUpdateResult r = m_mesh_update_thread.m_queue_out.pop_frontNoEx();
+	m_mesh_update_manager.stop();
+	m_mesh_update_manager.wait();
+	while (!m_mesh_update_manager.m_queue_out.empty()) {
+		MeshUpdateResult r = m_mesh_update_manager.m_queue_out.pop_frontNoEx();
 		delete r.mesh;
 	}
 
@@ -295,10 +297,12 @@ Client::~Client()
 
 	delete m_minimap;
 	delete m_media_downloader;
+	delete m_block_cache;
 }
 
 void Client::connect(Address address, bool is_local_server)
 {
+	m_is_local_server = is_local_server;
 	initLocalMapSaving(address, m_address_name, is_local_server);
 
 	m_con->SetTimeoutMs(0);
@@ -307,6 +311,8 @@ void Client::connect(Address address, bool is_local_server)
 
 void Client::step(float dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "Client::step");
+
 	// Limit a bit
 	if (dtime > 2.0)
 		dtime = 2.0;
@@ -377,6 +383,7 @@ void Client::step(float dtime)
 			g_settings->getFloat("client_unload_unused_data_timeout"),
 			g_settings->getS32("client_mapblock_limit"),
 			&deleted_blocks);
+		m_env.getClientMap().onBlocksDeleted(deleted_blocks);
 
 		/*
 			Send info to server
@@ -475,19 +482,32 @@ void Client::step(float dtime)
 		}
 	}
 
+	/*
+		Announce the cached blocks once they are listed
+	*/
+	if (m_state == LC_Ready)
+		sendCachedBlocks();
+
 	/*
 		Replace updated meshes
 	*/
 	{
+		FrameTraceScope ft(g_frame_tracer, "Client: replace meshes");
+
+		// Build the meshes nearest to the player first
+		LocalPlayer *player = m_env.getLocalPlayer();
+		m_mesh_update_manager.setCameraPos(
+				getNodeBlockPos(floatToInt(player->getPosition(), BS)));
+
 		int num_processed_meshes = 0;
-		while (!m_mesh_update_thread.m_queue_out.empty())
+		while (!m_mesh_update_manager.m_queue_out.empty())
 		{
 			num_processed_meshes++;
 
 			MinimapMapblock *minimap_mapblock = NULL;
 			bool do_mapper_update = true;
 
-			MeshUpdateResult r = m_mesh_update_thread.m_queue_out.pop_frontNoEx();
+			MeshUpdateResult r = m_mesh_update_manager.m_queue_out.pop_frontNoEx();
 			MapBlock *block = m_env.getMap().getBlockNoCreateNoEx(r.p);
 			if (block) {
 				// Delete the old mesh
@@ -510,6 +530,7 @@ void Client::step(float dtime)
 						// Replace with the new mesh
 						block->mesh = r.mesh;
 				}
+				m_env.getClientMap().onBlockMeshChanged(r.p, r.urgent);
 			} else {
 				delete r.mesh;
 			}
@@ -616,11 +637,15 @@ void Client::step(float dtime)
 		}
 	}
 
-	// Write server map
-	if (m_localdb && m_localdb_save_interval.step(dtime,
+	// Write server map and block cache
+	if ((m_localdb || m_block_cache) && m_localdb_save_interval.step(dtime,
 			m_cache_save_interval)) {
-		m_localdb->endSave();
-		m_localdb->beginSave();
+		if (m_localdb) {
+			m_localdb->endSave();
+			m_localdb->beginSave();
+		}
+		if (m_block_cache)
+			m_block_cache->save();
 	}
 }
 
@@ -779,8 +804,33 @@ void Client::initLocalMapSaving(const Address &address,
 	actionstream << "Local map saving started, map will be saved at '" << world_path << "'" << std::endl;
 }
 
+void Client::initBlockCache()
+{
+	if (!g_settings->getBool("enable_block_cache") || m_is_local_server ||
+			m_proto_ver < 38 || m_block_cache)
+		return;
+
+	// The seed keeps caches of different worlds behind one address apart
+	const std::string cache_path = porting::path_cache
+		+ DIR_DELIM + "blocks"
+		+ DIR_DELIM + m_address_name + "_"
+		+ std::to_string(getServerAddress().getPort()) + "_"
+		+ std::to_string(m_map_seed);
+
+	u64 max_size = (u64)g_settings->getU32("block_cache_max_size") * 1024 * 1024;
+	m_block_cache = new ClientBlockCache(cache_path, max_size);
+	infostream << "Client: using block cache at '" << cache_path << "'" << std::endl;
+
+	// The list is read while the media is being received
+	LocalPlayer *player = m_env.getLocalPlayer();
+	v3s16 center = getNodeBlockPos(floatToInt(player->getPosition(), BS));
+	s16 radius = g_settings->getS16("viewing_range") / MAP_BLOCKSIZE + 1;
+	m_block_cache->startListNear(center, radius, BLOCK_CACHE_MAX_ANNOUNCED);
+}
+
 void Client::ReceiveAll()
 {
+	FrameTraceScope ft(g_frame_tracer, "Client::ReceiveAll");
 	u64 start_ms = porting::getTimeMs();
 	for(;;)
 	{
@@ -1074,6 +1124,31 @@ void Client::sendDeletedBlocks(std::vector<v3s16> &blocks)
 	Send(&pkt);
 }
 
+void Client::sendCachedBlocks()
+{
+	if (!m_block_cache || m_cached_blocks_sent)
+		return;
+
+	std::vector<std::pair<v3s16, u64>> blocks;
+	if (!m_block_cache->getNearList(&blocks))
+		return;
+	m_cached_blocks_sent = true;
+
+	// Keep the packets reasonably small
+	const size_t per_packet = 1000;
+	for (size_t start = 0; start < blocks.size(); start += per_packet) {
+		size_t count = MYMIN(per_packet, blocks.size() - start);
+		NetworkPacket pkt(TOSERVER_CACHED_BLOCKS, 2 + count * (6 + 8));
+		pkt << (u16) count;
+		for (size_t i = start; i < start + count; i++)
+			pkt << blocks[i].first << blocks[i].second;
+		Send(&pkt);
+	}
+
+	infostream << "Client: announced " << blocks.size()
+			<< " cached blocks to the server" << std::endl;
+}
+
 void Client::sendGotBlocks(v3s16 block)
 {
 	NetworkPacket pkt(TOSERVER_GOTBLOCKS, 1 + 6);
@@ -1526,7 +1601,7 @@ void Client::addUpdateMeshTask(v3s16 p, bool ack_to_server, bool urgent)
 	if (b == NULL)
 		return;
 
-	m_mesh_update_thread.updateBlock(&m_env.getMap(), p, ack_to_server, urgent);
+	m_mesh_update_manager.updateBlock(&m_env.getMap(), p, ack_to_server, urgent);
 }
 
 void Client::addUpdateMeshTaskWithEdge(v3s16 blockpos, bool ack_to_server, bool urgent)
@@ -1696,14 +1771,18 @@ void Client::afterContentReceived()
 	tu_args.last_percent = 0;
 	tu_args.text_base =  wgettext("Initializing nodes");
 	tu_args.tsrc = m_tsrc;
+	if (g_settings->getBool("enable_texture_cache"))
+		m_tsrc->setImageCache(porting::path_cache + DIR_DELIM + "textures",
+			m_media_hash);
 	m_nodedef->updateTextures(this, texture_update_progress, &tu_args);
 	delete[] tu_args.text_base;
 
 	// Start mesh update thread after setting up content definitions
 	infostream<<"- Starting mesh update thread"<<std::endl;
-	m_mesh_update_thread.start();
+	m_mesh_update_manager.start();
 
 	m_state = LC_Ready;
+	sendCachedBlocks();
 	sendReady();
 
 	if (g_settings->getBool("enable_client_modding")) {
@@ -57,6 +57,7 @@ class ModChannelMgr;
 class MtEventManager;
 struct PointedThing;
 class MapDatabase;
+class ClientBlockCache;
 class Minimap;
 struct MinimapMapblock;
 class Camera;
@@ -226,6 +227,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void handleCommand_ModChannelSignal(NetworkPacket *pkt);
 	void handleCommand_SrpBytesSandB(NetworkPacket *pkt);
 	void handleCommand_FormspecPrepend(NetworkPacket *pkt);
+	void handleCommand_BlockDataCached(NetworkPacket *pkt);
 	void handleCommand_CSMRestrictionFlags(NetworkPacket *pkt);
 
 	void ProcessData(NetworkPacket *pkt);
@@ -315,7 +317,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void addUpdateMeshTaskForNode(v3s16 nodepos, bool ack_to_server=false, bool urgent=false);
 
 	void updateCameraOffset(v3s16 camera_offset)
-	{ m_mesh_update_thread.m_camera_offset = camera_offset; }
+	{ m_mesh_update_manager.m_camera_offset = camera_offset; }
 
 	bool hasClientEvents() const { return !m_client_event_queue.empty(); }
 	// Get event from queue. If queue is empty, it triggers an assertion failure.
@@ -449,6 +451,9 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	void initLocalMapSaving(const Address &address,
 			const std::string &hostname,
 			bool is_local_server);
+	void initBlockCache();
+	void sendCachedBlocks();
+	void deSerializeBlock(v3s16 p, const std::string &datastring);
 
 	void ReceiveAll();
 	void Receive();
@@ -488,7 +493,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	MtEventManager *m_event;
 
 
-	MeshUpdateThread m_mesh_update_thread;
+	MeshUpdateManager m_mesh_update_manager;
 	ClientEnvironment m_env;
 	ParticleManager m_particle_manager;
 	std::unique_ptr<con::Connection> m_con;
@@ -547,6 +552,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	bool m_nodedef_received = false;
 	bool m_mods_loaded = false;
 	ClientMediaDownloader *m_media_downloader;
+	// SHA1 of the names and hashes of all announced media
+	std::string m_media_hash;
 
 	// time_of_day speed approximation for old protocol
 	bool m_time_of_day_set = false;
@@ -593,6 +600,11 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	IntervalLimiter m_localdb_save_interval;
 	u16 m_cache_save_interval;
 
+	// Blocks received from this server in earlier sessions
+	ClientBlockCache *m_block_cache = nullptr;
+	bool m_cached_blocks_sent = false;
+	bool m_is_local_server = false;
+
 	ClientScripting *m_script = nullptr;
 	bool m_modding_enabled;
 	std::unordered_map<std::string, ModMetadata *> m_mod_storages;
@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "scripting_client.h"
 #include "mapblock_mesh.h"
 #include "event.h"
+#include "frametrace.h"
 #include "collision.h"
 #include "nodedef.h"
 #include "profiler.h"
@@ -88,6 +89,8 @@ void ClientEnvironment::setLocalPlayer(LocalPlayer *player)
 
 void ClientEnvironment::step(float dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "ClientEnvironment::step");
+
 	/* Step time of day */
 	stepTimeOfDay(dtime);
 
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <matrix4.h>
 #include "mapsector.h"
 #include "mapblock.h"
+#include "frametrace.h"
 #include "profiler.h"
 #include "settings.h"
 #include "camera.h"               // CameraModes
@@ -113,147 +114,281 @@ void ClientMap::getBlocksInViewRange(v3s16 cam_pos_nodes,
 			p_nodes_max.Z / MAP_BLOCKSIZE + 1);
 }
 
-void ClientMap::updateDrawList()
-{
-	ScopeProfiler sp(g_profiler, "CM::updateDrawList()", SPT_AVG);
-	g_profiler->add("CM::updateDrawList() count", 1);
-
-	for (auto &i : m_drawlist) {
-		MapBlock *block = i.second;
-		block->refDrop();
-	}
-	m_drawlist.clear();
-
-	v3f camera_position = m_camera_position;
-	v3f camera_direction = m_camera_direction;
-	f32 camera_fov = m_camera_fov;
-
-	// Use a higher fov to accomodate faster camera movements.
-	// Blocks are cropped better when they are drawn.
-	// Or maybe they aren't? Well whatever.
-	camera_fov *= 1.2;
+// Edge length in blocks of the regions in ClientMap::m_mesh_regions
+static const s16 DRAWLIST_REGION_SIZE = 8;
 
-	v3s16 cam_pos_nodes = floatToInt(camera_position, BS);
-	v3s16 p_blocks_min;
-	v3s16 p_blocks_max;
-	getBlocksInViewRange(cam_pos_nodes, &p_blocks_min, &p_blocks_max);
+/*
+	Parameters and statistics of one draw list update
+*/
+struct DrawListUpdate
+{
+	v3f camera_position;
+	v3f camera_direction;
+	f32 camera_fov;
+	f32 range;
+	v3s16 cam_pos_nodes;
+	bool occlusion_culling_enabled;
 
 	// Number of blocks in rendering range
 	u32 blocks_in_range = 0;
 	// Number of blocks occlusion culled
 	u32 blocks_occlusion_culled = 0;
-	// Number of blocks in rendering range but don't have a mesh
-	u32 blocks_in_range_without_mesh = 0;
-	// Blocks that had mesh that would have been drawn according to
-	// rendering range (if max blocks limit didn't kick in)
-	u32 blocks_would_have_drawn = 0;
-	// Blocks that were drawn and had a mesh
-	u32 blocks_drawn = 0;
-	// Blocks which had a corresponding meshbuffer for this pass
-	//u32 blocks_had_pass_meshbuf = 0;
-	// Blocks from which stuff was actually drawn
-	//u32 blocks_without_stuff = 0;
+	// Number of regions culled without looking at their blocks
+	u32 regions_culled = 0;
 	// Distance to farthest drawn block
 	float farthest_drawn = 0;
+};
+
+void ClientMap::updateDrawList()
+{
+	ScopeProfiler sp(g_profiler, "CM::updateDrawList()", SPT_AVG);
+	FrameTraceScope ft(g_frame_tracer, "ClientMap::updateDrawList");
+	g_profiler->add("CM::updateDrawList() count", 1);
+
+	DrawListUpdate u;
+	u.camera_position = m_camera_position;
+	u.camera_direction = m_camera_direction;
+	// Use a higher fov to accomodate faster camera movements.
+	// Blocks are cropped better when they are drawn.
+	// Or maybe they aren't? Well whatever.
+	u.camera_fov = m_camera_fov * 1.2;
+	u.range = m_control.range_all ? 100000 * BS : m_control.wanted_range * BS;
+	u.cam_pos_nodes = floatToInt(u.camera_position, BS);
 
 	// No occlusion culling when free_move is on and camera is
 	// inside ground
-	bool occlusion_culling_enabled = true;
+	u.occlusion_culling_enabled = true;
 	if (g_settings->getBool("free_move")) {
-		MapNode n = getNodeNoEx(cam_pos_nodes);
+		MapNode n = getNodeNoEx(u.cam_pos_nodes);
 		if (n.getContent() == CONTENT_IGNORE ||
 				m_nodedef->get(n).solidness == 2)
-			occlusion_culling_enabled = false;
+			u.occlusion_culling_enabled = false;
 	}
 
-	for (const auto &sector_it : m_sectors) {
-		MapSector *sector = sector_it.second;
-		v2s16 sp = sector->getPos();
+	v3s16 cam_block = getNodeBlockPos(u.cam_pos_nodes);
+	if (cam_block != m_occlusion_camera_block) {
+		m_occlusion_camera_block = cam_block;
+		m_blocks_occluded.clear();
+		m_blocks_not_occluded.clear();
+	}
 
-		if (!m_control.range_all) {
-			if (sp.X < p_blocks_min.X || sp.X > p_blocks_max.X ||
-					sp.Y < p_blocks_min.Z || sp.Y > p_blocks_max.Z)
-				continue;
+	// The camera may turn a little within the extra fov
+	bool camera_changed = m_drawlist_outdated ||
+		cam_block != m_drawlist_camera_block ||
+		u.camera_direction.getDistanceFrom(m_drawlist_camera_dir) > 0.05f ||
+		u.camera_fov != m_drawlist_camera_fov ||
+		u.range != m_drawlist_range ||
+		m_camera_offset != m_drawlist_camera_offset;
+
+	if (!camera_changed) {
+		// Only check the blocks that got a mesh since the last update
+		for (const v3s16 &p : m_new_meshes) {
+			MapBlock *block = getBlockNoCreateNoEx(p);
+			if (block && block->mesh)
+				addToDrawList(block, u);
 		}
+		m_new_meshes.clear();
 
-		MapBlockVect sectorblocks;
-		sector->getBlocks(sectorblocks);
+		for (auto &i : m_drawlist)
+			i.second->resetUsageTimer();
 
-		/*
-			Loop through blocks in sector
-		*/
+		g_profiler->avg("CM: blocks drawn", m_drawlist.size());
+		return;
+	}
 
-		u32 sector_blocks_drawn = 0;
+	m_drawlist_outdated = false;
+	m_drawlist_camera_block = cam_block;
+	m_drawlist_camera_dir = u.camera_direction;
+	m_drawlist_camera_fov = u.camera_fov;
+	m_drawlist_range = u.range;
+	m_drawlist_camera_offset = m_camera_offset;
+	m_new_meshes.clear();
 
-		for (auto block : sectorblocks) {
-			/*
-			Compare block position to camera position, skip
-			if not seen on display
-		*/
+	for (auto &i : m_drawlist) {
+		MapBlock *block = i.second;
+		block->refDrop();
+	}
+	m_drawlist.clear();
 
-			if (block->mesh)
-				block->mesh->updateCameraOffset(m_camera_offset);
+	v3s16 p_blocks_min;
+	v3s16 p_blocks_max;
+	getBlocksInViewRange(u.cam_pos_nodes, &p_blocks_min, &p_blocks_max);
 
-			float range = 100000 * BS;
-			if (!m_control.range_all)
-				range = m_control.wanted_range * BS;
+	// Radius of the sphere around a region
+	static const f32 region_radius =
+		0.866025403784f * DRAWLIST_REGION_SIZE * MAP_BLOCKSIZE * BS;
+	static const f32 region_size_nodes = DRAWLIST_REGION_SIZE * MAP_BLOCKSIZE;
 
-			float d = 0.0;
-			if (!isBlockInSight(block->getPos(), camera_position,
-					camera_direction, camera_fov, range, &d))
-				continue;
+	for (auto region_it = m_mesh_regions.begin();
+			region_it != m_mesh_regions.end();) {
+		v3s16 region_min = region_it->first * DRAWLIST_REGION_SIZE;
+		v3s16 region_max = region_min +
+			v3s16(1, 1, 1) * (DRAWLIST_REGION_SIZE - 1);
 
-			blocks_in_range++;
+		if (!m_control.range_all) {
+			if (region_max.X < p_blocks_min.X || region_min.X > p_blocks_max.X ||
+					region_max.Y < p_blocks_min.Y || region_min.Y > p_blocks_max.Y ||
+					region_max.Z < p_blocks_min.Z || region_min.Z > p_blocks_max.Z) {
+				++region_it;
+				continue;
+			}
 
-			/*
-				Ignore if mesh doesn't exist
-			*/
-			if (!block->mesh) {
-				blocks_in_range_without_mesh++;
+			v3f center = (v3f(region_it->first.X, region_it->first.Y,
+				region_it->first.Z) + v3f(0.5f, 0.5f, 0.5f)) *
+				region_size_nodes * BS;
+			if (!isSphereInSight(center, region_radius, u.camera_position,
+					u.camera_direction, u.camera_fov, u.range)) {
+				u.regions_culled++;
+				++region_it;
 				continue;
 			}
+		}
 
-			/*
-				Occlusion culling
-			*/
-			if (occlusion_culling_enabled && isBlockOccluded(block, cam_pos_nodes)) {
-				blocks_occlusion_culled++;
+		std::vector<v3s16> &blocks = region_it->second;
+		for (size_t i = 0; i < blocks.size();) {
+			MapBlock *block = getBlockNoCreateNoEx(blocks[i]);
+			if (!block || !block->mesh) {
+				// Missed by onBlockMeshChanged() or onBlocksDeleted()
+				blocks[i] = blocks.back();
+				blocks.pop_back();
 				continue;
 			}
+			addToDrawList(block, u);
+			i++;
+		}
 
-			// This block is in range. Reset usage timer.
-			block->resetUsageTimer();
+		if (blocks.empty())
+			region_it = m_mesh_regions.erase(region_it);
+		else
+			++region_it;
+	}
 
-			// Limit block count in case of a sudden increase
-			blocks_would_have_drawn++;
-			if (blocks_drawn >= m_control.wanted_max_blocks &&
-					!m_control.range_all &&
-					d > m_control.wanted_range * BS)
-				continue;
+	g_profiler->avg("CM: blocks in range", u.blocks_in_range);
+	g_profiler->avg("CM: blocks occlusion culled", u.blocks_occlusion_culled);
+	g_profiler->avg("CM: regions culled", u.regions_culled);
+	g_profiler->avg("CM: blocks drawn", m_drawlist.size());
+	g_profiler->avg("CM: farthest drawn", u.farthest_drawn);
+	g_profiler->avg("CM: wanted max blocks", m_control.wanted_max_blocks);
+}
+
+void ClientMap::addToDrawList(MapBlock *block, DrawListUpdate &u)
+{
+	/*
+		Compare block position to camera position, skip
+		if not seen on display
+	*/
 
-			// Add to set
-			block->refGrab();
-			m_drawlist[block->getPos()] = block;
+	block->mesh->updateCameraOffset(m_camera_offset);
 
-			sector_blocks_drawn++;
-			blocks_drawn++;
-			if (d / BS > farthest_drawn)
-				farthest_drawn = d / BS;
+	float d = 0.0;
+	if (!isBlockInSight(block->getPos(), u.camera_position,
+			u.camera_direction, u.camera_fov, u.range, &d))
+		return;
 
-		} // foreach sectorblocks
+	u.blocks_in_range++;
 
-		if (sector_blocks_drawn != 0)
-			m_last_drawn_sectors.insert(sp);
+	/*
+		Occlusion culling
+	*/
+	if (u.occlusion_culling_enabled &&
+			isBlockOccludedCached(block, u.cam_pos_nodes)) {
+		u.blocks_occlusion_culled++;
+		return;
 	}
 
-	g_profiler->avg("CM: blocks in range", blocks_in_range);
-	g_profiler->avg("CM: blocks occlusion culled", blocks_occlusion_culled);
-	if (blocks_in_range != 0)
-		g_profiler->avg("CM: blocks in range without mesh (frac)",
-				(float)blocks_in_range_without_mesh / blocks_in_range);
-	g_profiler->avg("CM: blocks drawn", blocks_drawn);
-	g_profiler->avg("CM: farthest drawn", farthest_drawn);
-	g_profiler->avg("CM: wanted max blocks", m_control.wanted_max_blocks);
+	// This block is in range. Reset usage timer.
+	block->resetUsageTimer();
+
+	// Limit block count in case of a sudden increase
+	if (m_drawlist.size() >= m_control.wanted_max_blocks &&
+			!m_control.range_all &&
+			d > m_control.wanted_range * BS)
+		return;
+
+	// Add to set
+	if (m_drawlist.emplace(block->getPos(), block).second)
+		block->refGrab();
+
+	v3s16 p = block->getPos();
+	m_last_drawn_sectors.insert(v2s16(p.X, p.Z));
+	if (d / BS > u.farthest_drawn)
+		u.farthest_drawn = d / BS;
+}
+
+bool ClientMap::isBlockOccludedCached(MapBlock *block, v3s16 cam_pos_nodes)
+{
+	v3s16 p = block->getPos();
+	if (m_blocks_occluded.contains(p))
+		return true;
+	if (m_blocks_not_occluded.contains(p))
+		return false;
+
+	if (isBlockOccluded(block, cam_pos_nodes)) {
+		m_blocks_occluded.insert(p);
+		return true;
+	}
+	m_blocks_not_occluded.insert(p);
+	return false;
+}
+
+void ClientMap::onBlockMeshChanged(v3s16 p, bool nodes_changed)
+{
+	v3s16 region_pos = getContainerPos(p, DRAWLIST_REGION_SIZE);
+	MapBlock *block = getBlockNoCreateNoEx(p);
+	// Whether the block had a mesh before
+	bool had_mesh = false;
+
+	if (block && block->mesh) {
+		std::vector<v3s16> &region = m_mesh_regions[region_pos];
+		if (std::find(region.begin(), region.end(), p) == region.end())
+			region.push_back(p);
+		else
+			had_mesh = true;
+		m_new_meshes.push_back(p);
+	} else {
+		// Stays in the draw list until the next full update,
+		// renderMap() skips blocks without a mesh
+		auto region_it = m_mesh_regions.find(region_pos);
+		if (region_it != m_mesh_regions.end()) {
+			std::vector<v3s16> &region = region_it->second;
+			auto it = std::find(region.begin(), region.end(), p);
+			if (it != region.end()) {
+				*it = region.back();
+				region.pop_back();
+				had_mesh = true;
+			}
+			if (region.empty())
+				m_mesh_regions.erase(region_it);
+		}
+	}
+
+	// Replacing or removing the mesh of a block may come from changed
+	// nodes, whether the player or the server changed them. These can
+	// uncover or hide other blocks.
+	if (nodes_changed || had_mesh) {
+		m_blocks_occluded.clear();
+		m_blocks_not_occluded.clear();
+		m_drawlist_outdated = true;
+	}
+}
+
+void ClientMap::onBlocksDeleted(const std::vector<v3s16> &blocks)
+{
+	for (const v3s16 &p : blocks) {
+		auto region_it = m_mesh_regions.find(
+			getContainerPos(p, DRAWLIST_REGION_SIZE));
+		if (region_it == m_mesh_regions.end())
+			continue;
+
+		std::vector<v3s16> &region = region_it->second;
+		auto it = std::find(region.begin(), region.end(), p);
+		if (it != region.end()) {
+			*it = region.back();
+			region.pop_back();
+		}
+		if (region.empty())
+			m_mesh_regions.erase(region_it);
+	}
 }
 
 struct MeshBufList
@@ -303,6 +438,8 @@ struct MeshBufListList
 void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 {
 	bool is_transparent_pass = pass == scene::ESNRP_TRANSPARENT;
+	FrameTraceScope ft(g_frame_tracer, is_transparent_pass ?
+		"ClientMap::renderMap transparent" : "ClientMap::renderMap solid");
 
 	std::string prefix;
 	if (pass == scene::ESNRP_SOLID)
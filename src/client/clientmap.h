@@ -22,8 +22,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irrlichttypes_extrabloated.h"
 #include "map.h"
 #include "camera.h"
+#include "util/blockbitset.h"
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 struct MapDrawControl
 {
@@ -39,6 +42,7 @@ struct MapDrawControl
 
 class Client;
 class ITextureSource;
+struct DrawListUpdate;
 
 /*
 	ClientMap
@@ -103,6 +107,18 @@ class ClientMap : public Map, public scene::ISceneNode
 	void getBlocksInViewRange(v3s16 cam_pos_nodes,
 		v3s16 *p_blocks_min, v3s16 *p_blocks_max);
 	void updateDrawList();
+
+	/*
+		Keep the index of blocks with meshes up to date. Must be called
+		after the mesh of a block was replaced or removed, and after
+		blocks were deleted.
+		Cached occlusion results are dropped when the block already had a
+		mesh, or when 'nodes_changed' is set because the player changed
+		nodes of the block.
+	*/
+	void onBlockMeshChanged(v3s16 p, bool nodes_changed);
+	void onBlocksDeleted(const std::vector<v3s16> &blocks);
+
 	void renderMap(video::IVideoDriver* driver, s32 pass);
 
 	int getBackgroundBrightness(float max_d, u32 daylight_factor,
@@ -128,8 +144,32 @@ class ClientMap : public Map, public scene::ISceneNode
 	f32 m_camera_fov = M_PI;
 	v3s16 m_camera_offset;
 
+	void addToDrawList(MapBlock *block, DrawListUpdate &u);
+	bool isBlockOccludedCached(MapBlock *block, v3s16 cam_pos_nodes);
+
 	std::map<v3s16, MapBlock*> m_drawlist;
 
+	// Blocks that have a mesh, grouped by regions of blocks so that
+	// whole regions can be culled at once
+	std::unordered_map<v3s16, std::vector<v3s16>> m_mesh_regions;
+	// Blocks that got a mesh since the last draw list update
+	std::vector<v3s16> m_new_meshes;
+
+	// Camera the draw list was built for. As long as it does not change
+	// only blocks with new meshes are added.
+	bool m_drawlist_outdated = true;
+	v3s16 m_drawlist_camera_block;
+	v3f m_drawlist_camera_dir;
+	f32 m_drawlist_camera_fov = 0.0f;
+	f32 m_drawlist_range = 0.0f;
+	v3s16 m_drawlist_camera_offset;
+
+	// Occlusion culling results, kept while the camera stays in
+	// m_occlusion_camera_block
+	v3s16 m_occlusion_camera_block;
+	BlockBitSet m_blocks_occluded;
+	BlockBitSet m_blocks_not_occluded;
+
 	std::set<v2s16> m_last_drawn_sectors;
 
 	bool m_cache_trilinear_filter;
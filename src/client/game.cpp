@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <iomanip>
 #include <cmath>
+#include <ctime>
 #include "client/renderingengine.h"
 #include "camera.h"
 #include "client.h"
@@ -36,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "content_cao.h"
 #include "client/event_manager.h"
 #include "fontengine.h"
+#include "frametrace.h"
 #include "itemdef.h"
 #include "log.h"
 #include "filesys.h"
@@ -689,6 +691,7 @@ class Game {
 	bool handleCallbacks();
 	void processQueues();
 	void updateProfilers(const RunStats &stats, const FpsControl &draw_times, f32 dtime);
+	void writeFrameTrace();
 	void addProfilerGraphs(const RunStats &stats, const FpsControl &draw_times, f32 dtime);
 	void updateStats(RunStats *stats, const FpsControl &draw_times, f32 dtime);
 
@@ -895,6 +898,11 @@ class Game {
 
 	bool m_does_lost_focus_pause_game = false;
 
+	// Frame trace, see the frame_trace setting
+	bool m_frame_trace = false;
+	u64 m_frame_trace_hitch_us = 0;
+	u64 m_frame_trace_written_us = 0;
+
 #ifdef __ANDROID__
 	bool m_cache_hold_aux1;
 	bool m_android_chat_open;
@@ -1072,6 +1080,14 @@ void Game::run()
 	irr::core::dimension2d<u32> previous_screen_size(g_settings->getU16("screen_w"),
 		g_settings->getU16("screen_h"));
 
+	m_frame_trace = g_settings->getBool("frame_trace");
+	if (m_frame_trace) {
+		m_frame_trace_hitch_us = MYMAX(g_settings->getS32(
+			"frame_trace_hitch_threshold"), 0) * 1000;
+		g_frame_tracer->clear();
+		g_frame_tracer->start();
+	}
+
 	while (RenderingEngine::run()
 			&& !(*kill || g_gamecallback->shutdown_requested
 			|| (server && server->isShutdownRequested()))) {
@@ -1093,6 +1109,8 @@ void Game::run()
 		 * uses device->getTimer()->getTime()
 		 */
 		limitFps(&draw_times, &dtime);
+		// The time spent waiting in limitFps() is not part of the frame
+		g_frame_tracer->beginFrame();
 
 		updateStats(&stats, draw_times, dtime);
 		updateInteractTimers(dtime);
@@ -1131,6 +1149,18 @@ void Game::run()
 		if (m_does_lost_focus_pause_game && !device->isWindowFocused() && !isMenuActive()) {
 			showPauseMenu();
 		}
+
+		if (m_frame_trace) {
+			u64 frame_us = g_frame_tracer->endFrame();
+			if (m_frame_trace_hitch_us > 0 && frame_us > m_frame_trace_hitch_us &&
+					porting::getTimeUs() > m_frame_trace_written_us + 10000000)
+				writeFrameTrace();
+		}
+	}
+
+	if (m_frame_trace) {
+		g_frame_tracer->stop();
+		writeFrameTrace();
 	}
 }
 
@@ -1830,6 +1860,8 @@ void Game::updateStats(RunStats *stats, const FpsControl &draw_times,
 
 void Game::processUserInput(f32 dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::processUserInput");
+
 	// Reset input if window not active or some menu is active
 	if (!device->isWindowActive() || isMenuActive() || guienv->hasFocus(gui_chat_console)) {
 		input->clear();
@@ -2488,6 +2520,8 @@ void Game::updatePlayerControl(const CameraOrientation &cam)
 
 inline void Game::step(f32 *dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::step");
+
 	bool can_be_and_is_paused =
 			(simple_singleplayer_mode && g_menumgr.pausesGame());
 
@@ -2791,6 +2825,8 @@ void Game::handleClientEvent_CloudParams(ClientEvent *event, CameraOrientation *
 
 void Game::processClientEvents(CameraOrientation *cam)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::processClientEvents");
+
 	while (client->hasClientEvents()) {
 		std::unique_ptr<ClientEvent> event(client->getClientEvent());
 		FATAL_ERROR_IF(event->type >= CLIENTEVENT_MAX, "Invalid clientevent type");
@@ -2830,6 +2866,8 @@ void Game::updateChat(f32 dtime, const v2u32 &screensize)
 
 void Game::updateCamera(u32 busy_time, f32 dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::updateCamera");
+
 	LocalPlayer *player = client->getEnv().getLocalPlayer();
 
 	/*
@@ -2940,6 +2978,8 @@ void Game::updateSound(f32 dtime)
 
 void Game::processPlayerInteraction(f32 dtime, bool show_hud, bool show_debug)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::processPlayerInteraction");
+
 	LocalPlayer *player = client->getEnv().getLocalPlayer();
 
 	ItemStack playeritem;
@@ -3650,6 +3690,8 @@ void Game::handleDigging(const PointedThing &pointed, const v3s16 &nodepos,
 void Game::updateFrame(ProfilerGraph *graph, RunStats *stats, f32 dtime,
 		const CameraOrientation &cam)
 {
+	FrameTraceScope ft(g_frame_tracer, "Game::updateFrame");
+
 	LocalPlayer *player = client->getEnv().getLocalPlayer();
 
 	/*
@@ -3900,12 +3942,26 @@ void Game::updateFrame(ProfilerGraph *graph, RunStats *stats, f32 dtime,
 	/*
 		End scene
 	*/
-	driver->endScene();
+	{
+		FrameTraceScope ft(g_frame_tracer, "IVideoDriver::endScene");
+		driver->endScene();
+	}
 
 	stats->drawtime = tt_draw.stop(true);
 	g_profiler->graphAdd("mainloop_draw", stats->drawtime / 1000.0f);
 }
 
+void Game::writeFrameTrace()
+{
+	std::string path = porting::path_user + DIR_DELIM + "frametrace-" +
+		std::to_string(std::time(nullptr)) + ".json";
+	if (g_frame_tracer->writeChromeTrace(path))
+		actionstream << "Wrote frame trace to " << path << std::endl;
+	else
+		errorstream << "Failed to write frame trace to " << path << std::endl;
+	m_frame_trace_written_us = porting::getTimeUs();
+}
+
 /* Log times and stuff for visualization */
 inline void Game::updateProfilerGraphs(ProfilerGraph *graph)
 {
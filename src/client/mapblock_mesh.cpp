@@ -37,7 +37,16 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 MeshMakeData::MeshMakeData(Client *client, bool use_shaders,
 		bool use_tangent_vertices):
-	m_client(client),
+	MeshMakeData(client->ndef(), client->getTextureSource(),
+		client->getShaderSource(), use_shaders, use_tangent_vertices)
+{}
+
+MeshMakeData::MeshMakeData(const NodeDefManager *nodedef,
+		ITextureSource *tsrc, IShaderSource *shdrsrc, bool use_shaders,
+		bool use_tangent_vertices):
+	m_nodedef(nodedef),
+	m_tsrc(tsrc),
+	m_shdrsrc(shdrsrc),
 	m_use_shaders(use_shaders),
 	m_use_tangent_vertices(use_tangent_vertices)
 {}
@@ -190,7 +199,7 @@ u16 getFaceLight(MapNode n, MapNode n2, const v3s16 &face_dir,
 static u16 getSmoothLightCombined(const v3s16 &p,
 	const std::array<v3s16,8> &dirs, MeshMakeData *data)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 
 	u16 ambient_occlusion = 0;
 	u16 light_count = 0;
@@ -604,10 +613,9 @@ static void makeFastFace(const TileSpec &tile, u16 li0, u16 li1, u16 li2, u16 li
 		vpos += pos;
 	}
 
-	f32 abs_scale = 1.0f;
-	if      (scale.X < 0.999f || scale.X > 1.001f) abs_scale = scale.X;
-	else if (scale.Y < 0.999f || scale.Y > 1.001f) abs_scale = scale.Y;
-	else if (scale.Z < 0.999f || scale.Z > 1.001f) abs_scale = scale.Z;
+	// Texture repetitions along the u and v axes of a merged face
+	f32 u_scale = dir.X != 0 ? scale.Z : scale.X;
+	f32 v_scale = dir.Y != 0 ? scale.Z : scale.Y;
 
 	v3f normal(dir.X, dir.Y, dir.Z);
 
@@ -624,10 +632,10 @@ static void makeFastFace(const TileSpec &tile, u16 li0, u16 li1, u16 li2, u16 li
 			< abs(day[1] - day[3]) + abs(night[1] - night[3]);
 
 	v2f32 f[4] = {
-		core::vector2d<f32>(x0 + w * abs_scale, y0 + h),
-		core::vector2d<f32>(x0, y0 + h),
+		core::vector2d<f32>(x0 + w * u_scale, y0 + h * v_scale),
+		core::vector2d<f32>(x0, y0 + h * v_scale),
 		core::vector2d<f32>(x0, y0),
-		core::vector2d<f32>(x0 + w * abs_scale, y0) };
+		core::vector2d<f32>(x0 + w * u_scale, y0) };
 
 	// equivalent to dest.push_back(FastFace()) but faster
 	dest.emplace_back();
@@ -706,7 +714,7 @@ static u8 face_contents(content_t m1, content_t m2, bool *equivalent,
 */
 void getNodeTileN(MapNode mn, const v3s16 &p, u8 tileindex, MeshMakeData *data, TileSpec &tile)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 	const ContentFeatures &f = ndef->get(mn);
 	tile = f.tiles[tileindex];
 	bool has_crack = p == data->m_crack_pos_relative;
@@ -726,7 +734,7 @@ void getNodeTileN(MapNode mn, const v3s16 &p, u8 tileindex, MeshMakeData *data,
 */
 void getNodeTile(MapNode mn, const v3s16 &p, const v3s16 &dir, MeshMakeData *data, TileSpec &tile)
 {
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 
 	// Direction must be (1,0,0), (-1,0,0), (0,1,0), (0,-1,0),
 	// (0,0,1), (0,0,-1) or (0,0,0)
@@ -799,7 +807,7 @@ static void getTileInfo(
 	)
 {
 	VoxelManipulator &vmanip = data->m_vmanip;
-	const NodeDefManager *ndef = data->m_client->ndef();
+	const NodeDefManager *ndef = data->m_nodedef;
 	v3s16 blockpos_nodes = data->m_blockpos * MAP_BLOCKSIZE;
 
 	const MapNode &n0 = vmanip.getNodeRefUnsafe(blockpos_nodes + p);
@@ -863,142 +871,148 @@ static void getTileInfo(
 	}
 }
 
+struct FaceSliceCell
+{
+	bool makes_face = false;
+	bool used = false;
+	v3s16 p_corrected;
+	v3s16 face_dir_corrected;
+	u16 lights[4] = {0, 0, 0, 0};
+	TileSpec tile;
+};
+
+/*
+	Whether 'b', located 'offset' nodes from 'a' within the slice, can be
+	drawn as part of the same face as 'a'.
+*/
+static bool isFaceMergeable(const FaceSliceCell &a, const FaceSliceCell &b,
+		const v3s16 &offset)
+{
+	return b.makes_face && !b.used
+		&& b.p_corrected == a.p_corrected + offset
+		&& b.face_dir_corrected == a.face_dir_corrected
+		&& memcmp(b.lights, a.lights, sizeof(a.lights)) == 0
+		&& b.tile.isTileable(a.tile);
+}
+
 /*
-	startpos:
-	translate_dir: unit vector with only one of x, y or z
+	Makes the faces between one MAP_BLOCKSIZE^2 slice of nodes and the
+	nodes next to it in face_dir, merging equal faces into rectangles.
+
+	origin: first node of the slice
+	u_dir, v_dir: slice axes, match the texture u and v axes of the faces
 	face_dir: unit vector with only one of x, y or z
+	cells: scratch space of MAP_BLOCKSIZE^2 cells
 */
-static void updateFastFaceRow(
+static void updateFastFaceSlice(
 		MeshMakeData *data,
-		const v3s16 &&startpos,
-		v3s16 translate_dir,
-		const v3f &&translate_dir_f,
-		const v3s16 &&face_dir,
+		const v3s16 &origin,
+		const v3s16 &u_dir,
+		const v3s16 &v_dir,
+		const v3s16 &face_dir,
+		std::vector<FaceSliceCell> &cells,
 		std::vector<FastFace> &dest)
 {
-	v3s16 p = startpos;
+	for (s16 v = 0; v < MAP_BLOCKSIZE; v++)
+	for (s16 u = 0; u < MAP_BLOCKSIZE; u++) {
+		FaceSliceCell &cell = cells[v * MAP_BLOCKSIZE + u];
+		cell.used = false;
+		getTileInfo(data, origin + u_dir * u + v_dir * v, face_dir,
+				cell.makes_face, cell.p_corrected, cell.face_dir_corrected,
+				cell.lights, cell.tile);
+	}
 
-	u16 continuous_tiles_count = 1;
+	v3f u_dir_f(u_dir.X, u_dir.Y, u_dir.Z);
+	v3f v_dir_f(v_dir.X, v_dir.Y, v_dir.Z);
 
-	bool makes_face = false;
-	v3s16 p_corrected;
-	v3s16 face_dir_corrected;
-	u16 lights[4] = {0, 0, 0, 0};
-	TileSpec tile;
-	getTileInfo(data, p, face_dir,
-			makes_face, p_corrected, face_dir_corrected,
-			lights, tile);
-
-	// Unroll this variable which has a significant build cost
-	TileSpec next_tile;
-	for (u16 j = 0; j < MAP_BLOCKSIZE; j++) {
-		// If tiling can be done, this is set to false in the next step
-		bool next_is_different = true;
-
-		v3s16 p_next;
-
-		bool next_makes_face = false;
-		v3s16 next_p_corrected;
-		v3s16 next_face_dir_corrected;
-		u16 next_lights[4] = {0, 0, 0, 0};
-
-		// If at last position, there is nothing to compare to and
-		// the face must be drawn anyway
-		if (j != MAP_BLOCKSIZE - 1) {
-			p_next = p + translate_dir;
-
-			getTileInfo(data, p_next, face_dir,
-					next_makes_face, next_p_corrected,
-					next_face_dir_corrected, next_lights,
-					next_tile);
-
-			if (next_makes_face == makes_face
-					&& next_p_corrected == p_corrected + translate_dir
-					&& next_face_dir_corrected == face_dir_corrected
-					&& memcmp(next_lights, lights, ARRLEN(lights) * sizeof(u16)) == 0
-					&& next_tile.isTileable(tile)) {
-				next_is_different = false;
-				continuous_tiles_count++;
-			}
-		}
-		if (next_is_different) {
-			/*
-				Create a face if there should be one
-			*/
-			if (makes_face) {
-				// Floating point conversion of the position vector
-				v3f pf(p_corrected.X, p_corrected.Y, p_corrected.Z);
-				// Center point of face (kind of)
-				v3f sp = pf - ((f32)continuous_tiles_count * 0.5f - 0.5f)
-					* translate_dir_f;
-				v3f scale(1, 1, 1);
-
-				if (translate_dir.X != 0)
-					scale.X = continuous_tiles_count;
-				if (translate_dir.Y != 0)
-					scale.Y = continuous_tiles_count;
-				if (translate_dir.Z != 0)
-					scale.Z = continuous_tiles_count;
-
-				makeFastFace(tile, lights[0], lights[1], lights[2], lights[3],
-						pf, sp, face_dir_corrected, scale, dest);
-
-				g_profiler->avg("Meshgen: faces drawn by tiling", 0);
-				for (int i = 1; i < continuous_tiles_count; i++)
-					g_profiler->avg("Meshgen: faces drawn by tiling", 1);
-			}
+	for (s16 v = 0; v < MAP_BLOCKSIZE; v++)
+	for (s16 u = 0; u < MAP_BLOCKSIZE; u++) {
+		FaceSliceCell &cell = cells[v * MAP_BLOCKSIZE + u];
+		if (!cell.makes_face || cell.used)
+			continue;
 
-			continuous_tiles_count = 1;
+		// Grow along u first, like the rows of the old row mesher
+		s16 w = 1;
+		while (u + w < MAP_BLOCKSIZE && isFaceMergeable(cell,
+				cells[v * MAP_BLOCKSIZE + u + w], u_dir * w))
+			w++;
+
+		// Then along v while the whole next row matches. World aligned
+		// textures are only merged along u, their coordinates depend on
+		// the face position.
+		s16 h = 1;
+		if (data->m_greedy_meshing && !cell.tile.world_aligned) {
+			for (; v + h < MAP_BLOCKSIZE; h++) {
+				bool row_matches = true;
+				for (s16 i = 0; i < w && row_matches; i++)
+					row_matches = isFaceMergeable(cell,
+							cells[(v + h) * MAP_BLOCKSIZE + u + i],
+							u_dir * i + v_dir * h);
+				if (!row_matches)
+					break;
+			}
 		}
 
-		makes_face = next_makes_face;
-		p_corrected = next_p_corrected;
-		face_dir_corrected = next_face_dir_corrected;
-		std::memcpy(lights, next_lights, ARRLEN(lights) * sizeof(u16));
-		if (next_is_different)
-			tile = next_tile;
-		p = p_next;
+		for (s16 j = 0; j < h; j++)
+		for (s16 i = 0; i < w; i++)
+			cells[(v + j) * MAP_BLOCKSIZE + u + i].used = true;
+
+		// Floating point conversion of the last node's position
+		v3s16 p_last = cell.p_corrected + u_dir * (w - 1) + v_dir * (h - 1);
+		v3f pf(p_last.X, p_last.Y, p_last.Z);
+		// Center point of face (kind of)
+		v3f sp = pf - ((f32)w * 0.5f - 0.5f) * u_dir_f
+			- ((f32)h * 0.5f - 0.5f) * v_dir_f;
+		v3f scale(1, 1, 1);
+		scale += u_dir_f * (w - 1) + v_dir_f * (h - 1);
+
+		makeFastFace(cell.tile, cell.lights[0], cell.lights[1],
+				cell.lights[2], cell.lights[3],
+				pf, sp, cell.face_dir_corrected, scale, dest);
+
+		g_profiler->avg("Meshgen: faces drawn by tiling", 0);
+		for (int i = 1; i < w * h; i++)
+			g_profiler->avg("Meshgen: faces drawn by tiling", 1);
 	}
 }
 
 static void updateAllFastFaceRows(MeshMakeData *data,
 		std::vector<FastFace> &dest)
 {
+	std::vector<FaceSliceCell> cells(MAP_BLOCKSIZE * MAP_BLOCKSIZE);
+
 	/*
-		Go through every y,z and get top(y+) faces in rows of x+
+		Go through every y and get top(y+) faces in x,z slices
 	*/
 	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
-	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
-		updateFastFaceRow(data,
-				v3s16(0, y, z),
-				v3s16(1, 0, 0), //dir
-				v3f  (1, 0, 0),
-				v3s16(0, 1, 0), //face dir
-				dest);
+		updateFastFaceSlice(data,
+				v3s16(0, y, 0),
+				v3s16(1, 0, 0), // u
+				v3s16(0, 0, 1), // v
+				v3s16(0, 1, 0), // face dir
+				cells, dest);
 
 	/*
-		Go through every x,y and get right(x+) faces in rows of z+
+		Go through every x and get right(x+) faces in z,y slices
 	*/
 	for (s16 x = 0; x < MAP_BLOCKSIZE; x++)
-	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
-		updateFastFaceRow(data,
-				v3s16(x, y, 0),
-				v3s16(0, 0, 1), //dir
-				v3f  (0, 0, 1),
-				v3s16(1, 0, 0), //face dir
-				dest);
+		updateFastFaceSlice(data,
+				v3s16(x, 0, 0),
+				v3s16(0, 0, 1), // u
+				v3s16(0, 1, 0), // v
+				v3s16(1, 0, 0), // face dir
+				cells, dest);
 
 	/*
-		Go through every y,z and get back(z+) faces in rows of x+
+		Go through every z and get back(z+) faces in x,y slices
 	*/
 	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
-	for (s16 y = 0; y < MAP_BLOCKSIZE; y++)
-		updateFastFaceRow(data,
-				v3s16(0, y, z),
-				v3s16(1, 0, 0), //dir
-				v3f  (1, 0, 0),
-				v3s16(0, 0, 1), //face dir
-				dest);
+		updateFastFaceSlice(data,
+				v3s16(0, 0, z),
+				v3s16(1, 0, 0), // u
+				v3s16(0, 1, 0), // v
+				v3s16(0, 0, 1), // face dir
+				cells, dest);
 }
 
 static void applyTileColor(PreMeshBuffer &pmb)
@@ -1021,8 +1035,8 @@ static void applyTileColor(PreMeshBuffer &pmb)
 
 MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	m_minimap_mapblock(NULL),
-	m_tsrc(data->m_client->getTextureSource()),
-	m_shdrsrc(data->m_client->getShaderSource()),
+	m_tsrc(data->m_tsrc),
+	m_shdrsrc(data->m_shdrsrc),
 	m_animation_force_timer(0), // force initial animation
 	m_last_crack(-1),
 	m_last_daynight_ratio((u32) -1)
@@ -1148,6 +1162,7 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 				// Dummy sunlight to handle non-sunlit areas
 				video::SColorf sunlight;
 				get_sunlight_color(&sunlight, 0);
+				std::vector<std::pair<u16, video::SColor>> daynight_diff;
 				u32 vertex_count = p.vertices.size();
 				for (u32 j = 0; j < vertex_count; j++) {
 					video::SColor *vc = &p.vertices[j].Color;
@@ -1155,12 +1170,17 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 					if (vc->getAlpha() == 0) // No sunlight - no need to animate
 						final_color_blend(vc, copy, sunlight); // Finalize color
 					else // Record color to animate
-						m_daynight_diffs[std::pair<u8, u32>(layer, i)][j] = copy;
+						daynight_diff.emplace_back(j, copy);
 
 					// The sunlight ratio has been stored,
 					// delete alpha (for the final rendering).
 					vc->setAlpha(255);
 				}
+				if (!daynight_diff.empty()) {
+					daynight_diff.shrink_to_fit();
+					m_daynight_diffs[std::pair<u8, u32>(layer, i)] =
+						std::move(daynight_diff);
+				}
 			}
 
 			// Create material
@@ -1184,8 +1204,14 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 
 			scene::SMesh *mesh = (scene::SMesh *)m_mesh[layer];
 
+			// Tangents take 24 bytes per vertex and are only read by the
+			// shaders of layers with a normal map, unless normal maps
+			// are generated for every texture
+			bool use_tangents = m_use_tangent_vertices &&
+				(p.layer.normal_texture || data->m_generate_normalmaps);
+
 			// Create meshbuffer, add to mesh
-			if (m_use_tangent_vertices) {
+			if (use_tangents) {
 				scene::SMeshBufferTangents *buf =
 						new scene::SMeshBufferTangents();
 				buf->Material = material;
@@ -1215,6 +1241,7 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 		translateMesh(m_mesh[layer],
 			intToFloat(data->m_blockpos * MAP_BLOCKSIZE - camera_offset, BS));
 
+		// Only changes the buffers with tangent vertices
 		if (m_use_tangent_vertices) {
 			scene::IMeshManipulator* meshmanip =
 				RenderingEngine::get_scene_manager()->getMeshManipulator();
@@ -24,9 +24,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "voxel.h"
 #include <array>
 #include <map>
+#include <vector>
 
 class Client;
 class IShaderSource;
+class NodeDefManager;
 
 /*
 	Mesh making stuff
@@ -42,13 +44,23 @@ struct MeshMakeData
 	v3s16 m_blockpos = v3s16(-1337,-1337,-1337);
 	v3s16 m_crack_pos_relative = v3s16(-1337,-1337,-1337);
 	bool m_smooth_lighting = false;
+	// Merge cube faces into rectangles instead of rows only
+	bool m_greedy_meshing = true;
+	// Shaders generate normal maps, so every layer needs tangents
+	bool m_generate_normalmaps = false;
 
-	Client *m_client;
+	const NodeDefManager *m_nodedef;
+	ITextureSource *m_tsrc;
+	IShaderSource *m_shdrsrc;
 	bool m_use_shaders;
 	bool m_use_tangent_vertices;
 
 	MeshMakeData(Client *client, bool use_shaders,
 			bool use_tangent_vertices = false);
+	// For building meshes without a client, e.g. in benchmarks
+	MeshMakeData(const NodeDefManager *nodedef, ITextureSource *tsrc,
+			IShaderSource *shdrsrc, bool use_shaders,
+			bool use_tangent_vertices = false);
 
 	/*
 		Copy block data manually (to allow optimizations by the caller)
@@ -166,8 +178,10 @@ class MapBlockMesh
 	u32 m_last_daynight_ratio;
 	// For each mesh and mesh buffer, stores pre-baked colors
 	// of sunlit vertices
-	// Keys are pairs of (mesh index, buffer index in the mesh)
-	std::map<std::pair<u8, u32>, std::map<u32, video::SColor > > m_daynight_diffs;
+	// Keys are pairs of (mesh index, buffer index in the mesh),
+	// values are (vertex index, color) pairs sorted by vertex index
+	std::map<std::pair<u8, u32>, std::vector<std::pair<u16, video::SColor>>>
+		m_daynight_diffs;
 
 	// Camera offset info -> do we have to translate the mesh?
 	v3s16 m_camera_offset;
@@ -55,6 +55,8 @@ MeshUpdateQueue::MeshUpdateQueue(Client *client):
 	m_cache_use_tangent_vertices = m_cache_enable_shaders && (
 		g_settings->getBool("enable_bumpmapping") ||
 		g_settings->getBool("enable_parallax_occlusion"));
+	m_cache_generate_normalmaps = m_cache_use_tangent_vertices &&
+		g_settings->getBool("generate_normalmaps");
 	m_cache_smooth_lighting = g_settings->getBool("smooth_lighting");
 	m_meshgen_block_cache_size = g_settings->getS32("meshgen_block_cache_size");
 }
@@ -67,8 +69,8 @@ MeshUpdateQueue::~MeshUpdateQueue()
 		delete i.second;
 	}
 
-	for (QueuedMeshUpdate *q : m_queue) {
-		delete q;
+	for (auto &i : m_queue) {
+		delete i.second;
 	}
 }
 
@@ -101,26 +103,26 @@ void MeshUpdateQueue::addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool
 	g_profiler->avg("MeshUpdateQueue MapBlock cache hit %",
 			100.0f * cache_hit_counter / cached_blocks.size());
 
-	/*
-		Mark the block as urgent if requested
-	*/
-	if (urgent)
-		m_urgents.insert(p);
-
 	/*
 		Find if block is already in queue.
 		If it is, update the data and quit.
 	*/
-	for (QueuedMeshUpdate *q : m_queue) {
-		if (q->p == p) {
-			// NOTE: We are not adding a new position to the queue, thus
-			//       refcount_from_queue stays the same.
-			if(ack_block_to_server)
-				q->ack_block_to_server = true;
-			q->crack_level = m_client->getCrackLevel();
-			q->crack_pos = m_client->getCrackPos();
-			return;
+	auto it = m_queue.find(p);
+	if (it != m_queue.end()) {
+		// NOTE: We are not adding a new position to the queue, thus
+		//       refcount_from_queue stays the same.
+		QueuedMeshUpdate *q = it->second;
+		if(ack_block_to_server)
+			q->ack_block_to_server = true;
+		q->crack_level = m_client->getCrackLevel();
+		q->crack_pos = m_client->getCrackPos();
+		if (urgent && !q->urgent) {
+			m_order.erase(std::make_pair(q->priority, p));
+			q->urgent = true;
+			q->priority = getPriority(q);
+			m_order.emplace(q->priority, p);
 		}
+		return;
 	}
 
 	/*
@@ -129,9 +131,12 @@ void MeshUpdateQueue::addBlock(Map *map, v3s16 p, bool ack_block_to_server, bool
 	QueuedMeshUpdate *q = new QueuedMeshUpdate;
 	q->p = p;
 	q->ack_block_to_server = ack_block_to_server;
+	q->urgent = urgent;
 	q->crack_level = m_client->getCrackLevel();
 	q->crack_pos = m_client->getCrackPos();
-	m_queue.push_back(q);
+	q->priority = getPriority(q);
+	m_queue[p] = q;
+	m_order.emplace(q->priority, p);
 
 	// This queue entry is a new reference to the cached blocks
 	for (CachedMapBlockData *cached_block : cached_blocks) {
@@ -145,20 +150,52 @@ QueuedMeshUpdate *MeshUpdateQueue::pop()
 {
 	MutexAutoLock lock(m_mutex);
 
-	bool must_be_urgent = !m_urgents.empty();
-	for (std::vector<QueuedMeshUpdate*>::iterator i = m_queue.begin();
-			i != m_queue.end(); ++i) {
-		QueuedMeshUpdate *q = *i;
-		if(must_be_urgent && m_urgents.count(q->p) == 0)
+	for (auto i = m_order.begin(); i != m_order.end(); ++i) {
+		// Another worker is still busy with this block
+		if (m_inflight.count(i->second))
 			continue;
-		m_queue.erase(i);
-		m_urgents.erase(q->p);
+
+		auto it = m_queue.find(i->second);
+		QueuedMeshUpdate *q = it->second;
+		m_queue.erase(it);
+		m_order.erase(i);
+		m_inflight.insert(q->p);
 		fillDataFromMapBlockCache(q);
 		return q;
 	}
 	return NULL;
 }
 
+void MeshUpdateQueue::done(v3s16 p)
+{
+	MutexAutoLock lock(m_mutex);
+	m_inflight.erase(p);
+}
+
+void MeshUpdateQueue::setCameraPos(v3s16 camera_pos)
+{
+	MutexAutoLock lock(m_mutex);
+	if (camera_pos == m_camera_pos)
+		return;
+
+	m_camera_pos = camera_pos;
+	m_order.clear();
+	for (auto &i : m_queue) {
+		QueuedMeshUpdate *q = i.second;
+		q->priority = getPriority(q);
+		m_order.emplace(q->priority, q->p);
+	}
+}
+
+s32 MeshUpdateQueue::getPriority(const QueuedMeshUpdate *q) const
+{
+	if (q->urgent)
+		return 0;
+
+	v3s16 d = q->p - m_camera_pos;
+	return 1 + d.X * d.X + d.Y * d.Y + d.Z * d.Z;
+}
+
 CachedMapBlockData* MeshUpdateQueue::cacheBlock(Map *map, v3s16 p, UpdateMode mode,
 			size_t *cache_hit_counter)
 {
@@ -235,6 +272,7 @@ void MeshUpdateQueue::fillDataFromMapBlockCache(QueuedMeshUpdate *q)
 
 	data->setCrack(q->crack_level, q->crack_pos);
 	data->setSmoothLighting(m_cache_smooth_lighting);
+	data->m_generate_normalmaps = m_cache_generate_normalmaps;
 }
 
 void MeshUpdateQueue::cleanupCache()
@@ -267,42 +305,100 @@ void MeshUpdateQueue::cleanupCache()
 }
 
 /*
-	MeshUpdateThread
+	MeshUpdateWorkerThread
 */
 
-MeshUpdateThread::MeshUpdateThread(Client *client):
+MeshUpdateWorkerThread::MeshUpdateWorkerThread(MeshUpdateQueue *queue_in,
+		MeshUpdateManager *manager, v3s16 *camera_offset):
 	UpdateThread("Mesh"),
-	m_queue_in(client)
+	m_queue_in(queue_in),
+	m_manager(manager),
+	m_camera_offset(camera_offset)
 {
 	m_generation_interval = g_settings->getU16("mesh_generation_interval");
 	m_generation_interval = rangelim(m_generation_interval, 0, 50);
 }
 
-void MeshUpdateThread::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
-		bool urgent)
-{
-	// Allow the MeshUpdateQueue to do whatever it wants
-	m_queue_in.addBlock(map, p, ack_block_to_server, urgent);
-	deferUpdate();
-}
-
-void MeshUpdateThread::doUpdate()
+void MeshUpdateWorkerThread::doUpdate()
 {
 	QueuedMeshUpdate *q;
-	while ((q = m_queue_in.pop())) {
+	while ((q = m_queue_in->pop())) {
 		if (m_generation_interval)
 			sleep_ms(m_generation_interval);
 		ScopeProfiler sp(g_profiler, "Client: Mesh making");
 
-		MapBlockMesh *mesh_new = new MapBlockMesh(q->data, m_camera_offset);
+		MapBlockMesh *mesh_new = new MapBlockMesh(q->data, *m_camera_offset);
 
 		MeshUpdateResult r;
 		r.p = q->p;
 		r.mesh = mesh_new;
 		r.ack_block_to_server = q->ack_block_to_server;
+		r.urgent = q->urgent;
 
-		m_queue_out.push_back(r);
+		m_manager->putResult(r);
+		m_queue_in->done(q->p);
 
 		delete q;
 	}
 }
+
+/*
+	MeshUpdateManager
+*/
+
+MeshUpdateManager::MeshUpdateManager(Client *client):
+	m_queue_in(client)
+{
+	int number_of_threads = g_settings->getU16("mesh_generation_threads");
+	if (number_of_threads == 0)
+		number_of_threads = (int)Thread::getNumberOfProcessors() - 2;
+	number_of_threads = rangelim(number_of_threads, 1, 8);
+
+	infostream << "MeshUpdateManager: using " << number_of_threads
+			<< " mesh generation threads" << std::endl;
+
+	for (int i = 0; i < number_of_threads; i++)
+		m_workers.emplace_back(new MeshUpdateWorkerThread(&m_queue_in, this,
+				&m_camera_offset));
+}
+
+MeshUpdateManager::~MeshUpdateManager()
+{
+	stop();
+	wait();
+}
+
+void MeshUpdateManager::updateBlock(Map *map, v3s16 p, bool ack_block_to_server,
+		bool urgent)
+{
+	// Allow the MeshUpdateQueue to do whatever it wants
+	m_queue_in.addBlock(map, p, ack_block_to_server, urgent);
+	for (auto &worker : m_workers)
+		worker->deferUpdate();
+}
+
+void MeshUpdateManager::start()
+{
+	for (auto &worker : m_workers)
+		worker->start();
+}
+
+void MeshUpdateManager::stop()
+{
+	for (auto &worker : m_workers)
+		worker->stop();
+}
+
+void MeshUpdateManager::wait()
+{
+	for (auto &worker : m_workers)
+		worker->wait();
+}
+
+bool MeshUpdateManager::isRunning()
+{
+	for (auto &worker : m_workers)
+		if (worker->isRunning())
+			return true;
+	return false;
+}
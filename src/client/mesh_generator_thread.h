@@ -20,7 +20,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <ctime>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include "mapblock_mesh.h"
 #include "threading/mutex_auto_lock.h"
 #include "util/thread.h"
@@ -43,6 +46,8 @@ struct QueuedMeshUpdate
 	bool urgent = false;
 	int crack_level = -1;
 	v3s16 crack_pos;
+	// Position in the queue order, lower is popped first
+	s32 priority = 0;
 	MeshMakeData *data = nullptr; // This is generated in MeshUpdateQueue::pop()
 
 	QueuedMeshUpdate() = default;
@@ -50,7 +55,11 @@ struct QueuedMeshUpdate
 };
 
 /*
-	A thread-safe queue of mesh update tasks and a cache of MapBlock data
+	A thread-safe queue of mesh update tasks and a cache of MapBlock data.
+
+	Urgent updates (node edits) are popped first, the others by distance
+	to the camera. A block is never handed to two workers at once, so
+	results for one position arrive in order.
 */
 class MeshUpdateQueue
 {
@@ -73,6 +82,12 @@ class MeshUpdateQueue
 	// Returns NULL if queue is empty
 	QueuedMeshUpdate *pop();
 
+	// Must be called by the worker when the update returned by pop() is done
+	void done(v3s16 p);
+
+	// Changes the queue order, the argument is in blocks
+	void setCameraPos(v3s16 camera_pos);
+
 	u32 size()
 	{
 		MutexAutoLock lock(m_mutex);
@@ -81,17 +96,21 @@ class MeshUpdateQueue
 
 private:
 	Client *m_client;
-	std::vector<QueuedMeshUpdate *> m_queue;
-	std::set<v3s16> m_urgents;
+	std::unordered_map<v3s16, QueuedMeshUpdate *> m_queue;
+	std::set<std::pair<s32, v3s16>> m_order;
+	std::unordered_set<v3s16> m_inflight;
 	std::map<v3s16, CachedMapBlockData *> m_cache;
+	v3s16 m_camera_pos;
 	std::mutex m_mutex;
 
 	// TODO: Add callback to update these when g_settings changes
 	bool m_cache_enable_shaders;
 	bool m_cache_use_tangent_vertices;
+	bool m_cache_generate_normalmaps;
 	bool m_cache_smooth_lighting;
 	int m_meshgen_block_cache_size;
 
+	s32 getPriority(const QueuedMeshUpdate *q) const;
 	CachedMapBlockData *cacheBlock(Map *map, v3s16 p, UpdateMode mode,
 			size_t *cache_hit_counter = NULL);
 	CachedMapBlockData *getCachedBlock(const v3s16 &p);
@@ -104,28 +123,57 @@ struct MeshUpdateResult
 	v3s16 p = v3s16(-1338, -1338, -1338);
 	MapBlockMesh *mesh = nullptr;
 	bool ack_block_to_server = false;
+	// Requested after nodes were changed, e.g. by digging
+	bool urgent = false;
 
 	MeshUpdateResult() = default;
 };
 
-class MeshUpdateThread : public UpdateThread
+class MeshUpdateManager;
+
+class MeshUpdateWorkerThread : public UpdateThread
+{
+public:
+	MeshUpdateWorkerThread(MeshUpdateQueue *queue_in,
+			MeshUpdateManager *manager, v3s16 *camera_offset);
+
+private:
+	MeshUpdateQueue *m_queue_in;
+	MeshUpdateManager *m_manager;
+	v3s16 *m_camera_offset;
+
+	// TODO: Add callback to update these when g_settings changes
+	int m_generation_interval;
+
+protected:
+	virtual void doUpdate();
+};
+
+/*
+	Owns the mesh update queue and the worker threads building meshes
+	from it. The number of workers is set by mesh_generation_threads.
+*/
+class MeshUpdateManager
 {
 public:
-	MeshUpdateThread(Client *client);
+	MeshUpdateManager(Client *client);
+	~MeshUpdateManager();
 
 	// Caches the block at p and its neighbors (if needed) and queues a mesh
 	// update for the block at p
 	void updateBlock(Map *map, v3s16 p, bool ack_block_to_server, bool urgent);
+	void setCameraPos(v3s16 camera_pos) { m_queue_in.setCameraPos(camera_pos); }
+	void putResult(const MeshUpdateResult &r) { m_queue_out.push_back(r); }
+
+	void start();
+	void stop();
+	void wait();
+	bool isRunning();
 
 	v3s16 m_camera_offset;
 	MutexedQueue<MeshUpdateResult> m_queue_out;
 
 private:
 	MeshUpdateQueue m_queue_in;
-
-	// TODO: Add callback to update these when g_settings changes
-	int m_generation_interval;
-
-protected:
-	virtual void doUpdate();
+	std::vector<std::unique_ptr<MeshUpdateWorkerThread>> m_workers;
 };
@@ -0,0 +1,328 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "meshgen_benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include "client/mapblock_mesh.h"
+#include "client/renderingengine.h"
+#include "client/shader.h"
+#include "client/tile.h"
+#include "content/mods.h"
+#include "database/database.h"
+#include "threading/thread.h"
+#include "util/directiontables.h"
+#include "util/numeric.h"
+#include "gamedef.h"
+#include "gameparams.h"
+#include "itemdef.h"
+#include "log.h"
+#include "map.h"
+#include "mapblock.h"
+#include "nodedef.h"
+#include "porting.h"
+#include "serialization.h"
+#include "settings.h"
+
+typedef std::unordered_map<v3s16, MapBlock *> BenchmarkBlocks;
+
+/*
+	Just enough of a game definition to deserialize blocks from disk.
+*/
+class BenchmarkGameDef : public IGameDef
+{
+public:
+	BenchmarkGameDef(NodeDefManager *nodedef):
+		m_itemdef(createItemDefManager()),
+		m_nodedef(nodedef)
+	{}
+
+	~BenchmarkGameDef()
+	{
+		delete m_itemdef;
+	}
+
+	IItemDefManager *getItemDefManager() { return m_itemdef; }
+	const NodeDefManager *getNodeDefManager() { return m_nodedef; }
+	ICraftDefManager *getCraftDefManager() { return nullptr; }
+
+	// Names that are not in the node definitions are drawn as unknown nodes
+	u16 allocateUnknownNodeId(const std::string &name) { return CONTENT_UNKNOWN; }
+
+	const std::vector<ModSpec> &getMods() const { return m_mods; }
+	const ModSpec *getModSpec(const std::string &modname) const { return nullptr; }
+	std::string getModStoragePath() const { return ""; }
+	bool registerModStorage(ModMetadata *storage) { return false; }
+	void unregisterModStorage(const std::string &name) {}
+
+	bool joinModChannel(const std::string &channel) { return false; }
+	bool leaveModChannel(const std::string &channel) { return false; }
+	bool sendModChannelMessage(const std::string &channel,
+		const std::string &message) { return false; }
+	ModChannel *getModChannel(const std::string &channel) { return nullptr; }
+
+private:
+	IWritableItemDefManager *m_itemdef;
+	NodeDefManager *m_nodedef;
+	std::vector<ModSpec> m_mods;
+};
+
+struct MeshgenStats
+{
+	u32 blocks = 0;
+	u64 vertices = 0;
+	u64 indices = 0;
+	u64 bytes = 0;
+};
+
+static bool load_node_definitions(const std::string &path, NodeDefManager *nodedef)
+{
+	std::ifstream is(path, std::ios::binary);
+	if (!is.good()) {
+		errorstream << "Cannot open node definitions " << path << std::endl;
+		return false;
+	}
+
+	try {
+		std::ostringstream os(std::ios::binary);
+		decompressZlib(is, os);
+		std::istringstream is2(os.str(), std::ios::binary);
+		nodedef->deSerialize(is2);
+	} catch (SerializationError &e) {
+		errorstream << "Invalid node definitions in " << path << ": "
+			<< e.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool load_blocks(const GameParams &game_params, s16 radius,
+		IGameDef *gamedef, BenchmarkBlocks *blocks)
+{
+	Settings world_mt;
+	std::string world_mt_path = game_params.world_path + DIR_DELIM + "world.mt";
+	if (!world_mt.readConfigFile(world_mt_path.c_str())) {
+		errorstream << "Cannot read world.mt!" << std::endl;
+		return false;
+	}
+
+	std::string backend = "sqlite3";
+	if (world_mt.exists("backend"))
+		backend = world_mt.get("backend");
+
+	MapDatabase *db = ServerMap::createDatabase(backend,
+		game_params.world_path, world_mt);
+
+	std::vector<v3s16> all;
+	db->listAllLoadableBlocks(all);
+
+	std::string data;
+	for (const v3s16 &pos : all) {
+		if (std::abs(pos.X) > radius || std::abs(pos.Y) > radius ||
+				std::abs(pos.Z) > radius)
+			continue;
+
+		data.clear();
+		db->loadBlock(pos, &data);
+		if (data.empty())
+			continue;
+
+		MapBlock *block = new MapBlock(nullptr, pos, gamedef);
+		try {
+			std::istringstream is(data, std::ios_base::binary);
+			u8 version = SER_FMT_VER_INVALID;
+			is.read((char *)&version, 1);
+			block->deSerialize(is, version, true);
+		} catch (SerializationError &e) {
+			errorstream << "Invalid block data in database at "
+				<< PP(pos) << ": " << e.what() << std::endl;
+			delete block;
+			continue;
+		}
+		(*blocks)[pos] = block;
+	}
+
+	delete db;
+	return true;
+}
+
+static MapBlockMesh *make_mesh(MeshMakeData *data, v3s16 pos,
+		const BenchmarkBlocks &blocks)
+{
+	// Same as MeshMakeData::fill(), without a Map
+	data->fillBlockDataBegin(pos);
+	data->fillBlockData(v3s16(0, 0, 0), blocks.at(pos)->getData());
+	for (const v3s16 &dir : g_26dirs) {
+		auto it = blocks.find(pos + dir);
+		if (it != blocks.end())
+			data->fillBlockData(dir, it->second->getData());
+	}
+
+	return new MapBlockMesh(data, v3s16(0, 0, 0));
+}
+
+static void count_mesh(MapBlockMesh *mesh, MeshgenStats *stats)
+{
+	for (u8 layer = 0; layer < MAX_TILE_LAYERS; layer++) {
+		scene::IMesh *m = mesh->getMesh(layer);
+		if (!m)
+			continue;
+		for (u32 i = 0; i < m->getMeshBufferCount(); i++) {
+			scene::IMeshBuffer *buf = m->getMeshBuffer(i);
+			u32 index_size = buf->getIndexType() == video::EIT_16BIT ? 2 : 4;
+			stats->vertices += buf->getVertexCount();
+			stats->indices += buf->getIndexCount();
+			stats->bytes += buf->getVertexCount() *
+					video::getVertexPitchFromType(buf->getVertexType()) +
+				buf->getIndexCount() * index_size;
+		}
+	}
+}
+
+static void print_run(bool greedy, bool tangents, u32 threads, u64 time_us,
+		const MeshgenStats &stats)
+{
+	u32 n = MYMAX(stats.blocks, 1);
+	dstream << "meshgen: greedy=" << greedy
+		<< " tangents=" << tangents
+		<< " threads=" << threads
+		<< " blocks=" << stats.blocks
+		<< " time_ms=" << time_us / 1000
+		<< " blocks_per_s=" << stats.blocks * 1000000.0 / MYMAX(time_us, 1)
+		<< " vertices_per_block=" << (float)stats.vertices / n
+		<< " indices_per_block=" << (float)stats.indices / n
+		<< " bytes_per_block=" << (float)stats.bytes / n
+		<< std::endl;
+}
+
+static void run_benchmark(NodeDefManager *nodedef,
+		IWritableTextureSource *tsrc, IWritableShaderSource *shdsrc,
+		const BenchmarkBlocks &blocks)
+{
+	std::vector<v3s16> positions;
+	positions.reserve(blocks.size());
+	for (const auto &it : blocks)
+		positions.push_back(it.first);
+
+	bool smooth_lighting = g_settings->getBool("smooth_lighting");
+	// Same as MeshUpdateQueue, shaders are not needed to build the buffers
+	bool use_tangent_vertices = g_settings->getBool("enable_bumpmapping") ||
+		g_settings->getBool("enable_parallax_occlusion");
+	bool generate_normalmaps = use_tangent_vertices &&
+		g_settings->getBool("generate_normalmaps");
+	u32 num_threads = g_settings->getU16("mesh_generation_threads");
+	if (num_threads == 0)
+		num_threads = std::max(Thread::getNumberOfProcessors(), 1U);
+
+	for (bool greedy : {false, true}) {
+		// Single threaded run, also counts the geometry
+		MeshgenStats stats;
+		u64 t0 = porting::getTimeUs();
+		for (const v3s16 &pos : positions) {
+			MeshMakeData data(nodedef, tsrc, shdsrc, false,
+					use_tangent_vertices);
+			data.m_greedy_meshing = greedy;
+			data.m_generate_normalmaps = generate_normalmaps;
+			data.setSmoothLighting(smooth_lighting);
+			MapBlockMesh *mesh = make_mesh(&data, pos, blocks);
+			count_mesh(mesh, &stats);
+			stats.blocks++;
+			delete mesh;
+		}
+		print_run(greedy, use_tangent_vertices, 1,
+			porting::getTimeUs() - t0, stats);
+
+		// Multi threaded run. Textures requested by the workers are
+		// created on this thread, like the main loop of the client does.
+		std::atomic<size_t> next(0);
+		std::atomic<u32> done(0);
+		std::vector<std::thread> workers;
+		t0 = porting::getTimeUs();
+		for (u32 i = 0; i < num_threads; i++) {
+			workers.emplace_back([&] () {
+				size_t j;
+				while ((j = next++) < positions.size()) {
+					MeshMakeData data(nodedef, tsrc, shdsrc, false,
+							use_tangent_vertices);
+					data.m_greedy_meshing = greedy;
+					data.m_generate_normalmaps = generate_normalmaps;
+					data.setSmoothLighting(smooth_lighting);
+					delete make_mesh(&data, positions[j], blocks);
+				}
+				done++;
+			});
+		}
+		while (done < num_threads) {
+			tsrc->processQueue();
+			shdsrc->processQueue();
+			sleep_ms(1);
+		}
+		for (std::thread &worker : workers)
+			worker.join();
+		print_run(greedy, use_tangent_vertices, num_threads,
+			porting::getTimeUs() - t0, stats);
+	}
+}
+
+bool run_meshgen_benchmark(const GameParams &game_params, const Settings &cmd_args)
+{
+	std::string nodedefs_path = game_params.world_path + DIR_DELIM + "nodedefs.bin";
+	if (cmd_args.exists("nodedefs"))
+		nodedefs_path = cmd_args.get("nodedefs");
+	s16 radius = 4;
+	if (cmd_args.exists("meshgen-radius"))
+		radius = cmd_args.getS16("meshgen-radius");
+
+	// Headless; the null driver still creates textures in memory.
+	// Settings are not saved after the benchmark.
+	g_settings->set("video_driver", "null");
+	g_settings->setBool("enable_shaders", false);
+	new RenderingEngine(nullptr);
+
+	IWritableTextureSource *tsrc = createTextureSource();
+	IWritableShaderSource *shdsrc = createShaderSource();
+	NodeDefManager *nodedef = createNodeDefManager();
+	BenchmarkGameDef gamedef(nodedef);
+	BenchmarkBlocks blocks;
+
+	bool ok = load_node_definitions(nodedefs_path, nodedef) &&
+		load_blocks(game_params, radius, &gamedef, &blocks);
+	if (ok && blocks.empty()) {
+		errorstream << "No blocks within " << radius
+			<< " blocks of the origin" << std::endl;
+		ok = false;
+	}
+
+	if (ok) {
+		nodedef->updateTextures(tsrc, shdsrc, nullptr, nullptr, nullptr);
+		run_benchmark(nodedef, tsrc, shdsrc, blocks);
+	}
+
+	for (auto &it : blocks)
+		delete it.second;
+	delete nodedef;
+	delete shdsrc;
+	delete tsrc;
+	delete RenderingEngine::get_instance();
+	return ok;
+}
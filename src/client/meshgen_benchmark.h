@@ -0,0 +1,39 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+struct GameParams;
+class Settings;
+
+/*
+	Headless mesh generation benchmark (--meshgen-benchmark).
+
+	Loads the blocks around the origin of a world from its map database,
+	together with node definitions written by --dump-nodedefs, and builds
+	a MapBlockMesh for each of them using the null video driver. Meshes
+	are built on one thread and on mesh_generation_threads threads, with
+	and without greedy meshing. Tangent vertices are used when bumpmapping
+	or parallax occlusion is enabled, like in the client.
+
+	Prints one line per run with blocks per second and the number of
+	vertices, indices and bytes of mesh data per block, so that the
+	output can be compared between builds.
+*/
+bool run_meshgen_benchmark(const GameParams &game_params, const Settings &cmd_args);
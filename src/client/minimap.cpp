@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "minimap.h"
 #include <cmath>
+#include <cstring>
 #include "client.h"
 #include "clientmap.h"
 #include "settings.h"
@@ -31,6 +32,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //// MinimapUpdateThread
 ////
 
+MinimapUpdateThread::MinimapUpdateThread() :
+	UpdateThread("Minimap"),
+	m_tiles(MINIMAP_TILES * MINIMAP_TILES)
+{
+}
+
 MinimapUpdateThread::~MinimapUpdateThread()
 {
 	for (auto &it : m_blocks_cache) {
@@ -95,79 +102,139 @@ void MinimapUpdateThread::doUpdate()
 			std::pair<std::map<v3s16, MinimapMapblock*>::iterator, bool>
 			    result = m_blocks_cache.insert(std::make_pair(update.pos, update.data));
 			if (!result.second) {
+				// Most mesh updates leave the surface as it was
+				if (memcmp(result.first->second->data, update.data->data,
+						sizeof(update.data->data)) == 0) {
+					delete update.data;
+					continue;
+				}
 				delete result.first->second;
 				result.first->second = update.data;
 			}
 		} else {
 			std::map<v3s16, MinimapMapblock *>::iterator it;
 			it = m_blocks_cache.find(update.pos);
-			if (it != m_blocks_cache.end()) {
-				delete it->second;
-				m_blocks_cache.erase(it);
-			}
+			if (it == m_blocks_cache.end())
+				continue;
+			delete it->second;
+			m_blocks_cache.erase(it);
 		}
+		invalidateTile(update.pos);
 	}
 
 	if (data->map_invalidated && data->mode != MINIMAP_MODE_OFF) {
-		getMap(data->pos, data->map_size, data->scan_height);
-		data->map_invalidated = false;
+		// The texture also depends on these
+		bool texture_changed = data->is_radar != m_scan_is_radar ||
+			data->minimap_shape_round != m_scan_shape_round;
+		m_scan_is_radar = data->is_radar;
+		m_scan_shape_round = data->minimap_shape_round;
+
+		if (getMap(data->pos, data->map_size, data->scan_height) ||
+				texture_changed)
+			data->map_invalidated = false;
 	}
 }
 
-void MinimapUpdateThread::getMap(v3s16 pos, s16 size, s16 height)
+void MinimapUpdateThread::invalidateTile(v3s16 blockpos)
 {
-	v3s16 pos_min(pos.X - size / 2, pos.Y - height / 2, pos.Z - size / 2);
-	v3s16 pos_max(pos_min.X + size - 1, pos.Y + height / 2, pos_min.Z + size - 1);
-	v3s16 blockpos_min = getNodeBlockPos(pos_min);
-	v3s16 blockpos_max = getNodeBlockPos(pos_max);
+	MinimapTile &tile = getTile(v2s16(blockpos.X, blockpos.Z));
+	if (tile.pos == v2s16(blockpos.X, blockpos.Z))
+		tile.valid = false;
+}
 
-// clear the map
-	for (int z = 0; z < size; z++)
-	for (int x = 0; x < size; x++) {
-		MinimapPixel &mmpixel = data->minimap_scan[x + z * size];
-		mmpixel.air_count = 0;
-		mmpixel.height = 0;
-		mmpixel.n = MapNode(CONTENT_AIR);
+void MinimapUpdateThread::composeTile(MinimapTile *tile, v2s16 pos,
+	s16 block_y_min, s16 block_y_max)
+{
+	tile->pos = pos;
+	tile->block_y_min = block_y_min;
+	tile->block_y_max = block_y_max;
+	tile->valid = true;
+
+	for (MinimapTile::Pixel &pixel : tile->data) {
+		pixel.n = MapNode(CONTENT_AIR);
+		pixel.surface_y = 0;
+		pixel.air_count = 0;
 	}
 
-// draw the map
-	v3s16 blockpos;
-	for (blockpos.Z = blockpos_min.Z; blockpos.Z <= blockpos_max.Z; ++blockpos.Z)
-	for (blockpos.Y = blockpos_min.Y; blockpos.Y <= blockpos_max.Y; ++blockpos.Y)
-	for (blockpos.X = blockpos_min.X; blockpos.X <= blockpos_max.X; ++blockpos.X) {
+	// From the top down, the topmost surface is shown
+	for (s16 y = block_y_max; y >= block_y_min; y--) {
 		std::map<v3s16, MinimapMapblock *>::const_iterator pblock =
-			m_blocks_cache.find(blockpos);
+			m_blocks_cache.find(v3s16(pos.X, y, pos.Y));
 		if (pblock == m_blocks_cache.end())
 			continue;
 		const MinimapMapblock &block = *pblock->second;
 
-		v3s16 block_node_min(blockpos * MAP_BLOCKSIZE);
-		v3s16 block_node_max(block_node_min + MAP_BLOCKSIZE - 1);
-		// clip
-		v3s16 range_min = componentwise_max(block_node_min, pos_min);
-		v3s16 range_max = componentwise_min(block_node_max, pos_max);
-
-		v3s16 pos;
-		pos.Y = range_min.Y;
-		for (pos.Z = range_min.Z; pos.Z <= range_max.Z; ++pos.Z)
-		for (pos.X = range_min.X; pos.X <= range_max.X; ++pos.X) {
-			v3s16 inblock_pos = pos - block_node_min;
-			const MinimapPixel &in_pixel =
-				block.data[inblock_pos.Z * MAP_BLOCKSIZE + inblock_pos.X];
-
-			v3s16 inmap_pos = pos - pos_min;
-			MinimapPixel &out_pixel =
-				data->minimap_scan[inmap_pos.X + inmap_pos.Z * size];
+		for (u32 i = 0; i < MAP_BLOCKSIZE * MAP_BLOCKSIZE; i++) {
+			const MinimapPixel &in_pixel = block.data[i];
+			MinimapTile::Pixel &out_pixel = tile->data[i];
 
 			out_pixel.air_count += in_pixel.air_count;
-			if (in_pixel.n.param0 != CONTENT_AIR) {
+			if (in_pixel.n.param0 != CONTENT_AIR &&
+					out_pixel.n.param0 == CONTENT_AIR) {
 				out_pixel.n = in_pixel.n;
-				out_pixel.height = inmap_pos.Y + in_pixel.height;
+				out_pixel.surface_y = y * MAP_BLOCKSIZE + in_pixel.height;
 			}
 		}
 	}
 }
 
+bool MinimapUpdateThread::getMap(v3s16 pos, s16 size, s16 height)
+{
+	v3s16 pos_min(pos.X - size / 2, pos.Y - height / 2, pos.Z - size / 2);
+	v3s16 pos_max(pos_min.X + size - 1, pos.Y + height / 2, pos_min.Z + size - 1);
+	v3s16 blockpos_min = getNodeBlockPos(pos_min);
+	v3s16 blockpos_max = getNodeBlockPos(pos_max);
+
+	bool changed = !m_scan_valid || pos != m_scan_pos ||
+		size != m_scan_size || height != m_scan_height;
+
+	// Compose the tiles that are new or out of date
+	v2s16 tilepos;
+	for (tilepos.Y = blockpos_min.Z; tilepos.Y <= blockpos_max.Z; ++tilepos.Y)
+	for (tilepos.X = blockpos_min.X; tilepos.X <= blockpos_max.X; ++tilepos.X) {
+		MinimapTile &tile = getTile(tilepos);
+		if (tile.valid && tile.pos == tilepos &&
+				tile.block_y_min == blockpos_min.Y &&
+				tile.block_y_max == blockpos_max.Y)
+			continue;
+		composeTile(&tile, tilepos, blockpos_min.Y, blockpos_max.Y);
+		changed = true;
+	}
+
+	if (!changed)
+		return false;
+
+	m_scan_valid = true;
+	m_scan_pos = pos;
+	m_scan_size = size;
+	m_scan_height = height;
+
+	// Copy the visible part of the tiles to the scan
+	for (s16 z = 0; z < size; z++)
+	for (s16 x = 0; x < size; x++) {
+		v2s16 p(pos_min.X + x, pos_min.Z + z);
+		v2s16 tilepos = getContainerPos(p, MAP_BLOCKSIZE);
+		v2s16 inblock_pos = p - tilepos * MAP_BLOCKSIZE;
+		const MinimapTile::Pixel &in_pixel = getTile(tilepos).data[
+			inblock_pos.Y * MAP_BLOCKSIZE + inblock_pos.X];
+		MinimapPixel &out_pixel = data->minimap_scan[x + z * size];
+
+		out_pixel.n = in_pixel.n;
+		out_pixel.air_count = in_pixel.air_count;
+		out_pixel.height = 0;
+		if (in_pixel.n.param0 != CONTENT_AIR) {
+			// Heights in a block that starts below the scan are
+			// counted from the bottom of the scan
+			s16 block_min_y = getContainerPos(in_pixel.surface_y,
+				MAP_BLOCKSIZE) * MAP_BLOCKSIZE;
+			out_pixel.height = MYMAX(block_min_y, pos_min.Y) - pos_min.Y +
+				in_pixel.surface_y - block_min_y;
+		}
+	}
+
+	return true;
+}
+
 ////
 //// Mapper
 ////
@@ -616,8 +683,10 @@ void MinimapMapblock::getMinimapNodes(VoxelManipulator *vmanip, const v3s16 &pos
 			}
 		}
 
-		if (!surface_found)
+		if (!surface_found) {
+			mmpixel->height = 0;
 			mmpixel->n = MapNode(CONTENT_AIR);
+		}
 
 		mmpixel->air_count = air_count;
 	}
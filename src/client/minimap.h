@@ -32,6 +32,9 @@ class IShaderSource;
 
 #define MINIMAP_MAX_SX 512
 #define MINIMAP_MAX_SY 512
+// Tiles per axis of the scrolling tile buffer, must be a power of two
+// and at least the block columns covered by the largest map size
+#define MINIMAP_TILES 32
 
 enum MinimapMode {
 	MINIMAP_MODE_OFF,
@@ -68,6 +71,27 @@ struct MinimapMapblock {
 	MinimapPixel data[MAP_BLOCKSIZE * MAP_BLOCKSIZE];
 };
 
+/*
+	The minimap pixels of one column of blocks, composed over a range of
+	block Ys. Tiles are kept while the player moves and are composed again
+	only when one of their blocks changes or the range of Ys does.
+*/
+struct MinimapTile {
+	struct Pixel {
+		//! The topmost node in the column, CONTENT_AIR if there is none.
+		MapNode n;
+		//! Node Y of the topmost node.
+		s16 surface_y;
+		u16 air_count;
+	};
+
+	v2s16 pos;
+	s16 block_y_min;
+	s16 block_y_max;
+	bool valid = false;
+	Pixel data[MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+};
+
 struct MinimapData {
 	bool is_radar;
 	MinimapMode mode;
@@ -95,10 +119,11 @@ struct QueuedMinimapUpdate {
 
 class MinimapUpdateThread : public UpdateThread {
 public:
-	MinimapUpdateThread() : UpdateThread("Minimap") {}
+	MinimapUpdateThread();
 	virtual ~MinimapUpdateThread();
 
-	void getMap(v3s16 pos, s16 size, s16 height);
+	// Returns false if the scan did not change since the last call
+	bool getMap(v3s16 pos, s16 size, s16 height);
 	void enqueueBlock(v3s16 pos, MinimapMapblock *data);
 	bool pushBlockUpdate(v3s16 pos, MinimapMapblock *data);
 	bool popBlockUpdate(QueuedMinimapUpdate *update);
@@ -109,9 +134,29 @@ class MinimapUpdateThread : public UpdateThread {
 	virtual void doUpdate();
 
 private:
+	MinimapTile &getTile(v2s16 pos)
+	{
+		return m_tiles[(pos.Y & (MINIMAP_TILES - 1)) * MINIMAP_TILES +
+			(pos.X & (MINIMAP_TILES - 1))];
+	}
+	void invalidateTile(v3s16 blockpos);
+	void composeTile(MinimapTile *tile, v2s16 pos,
+		s16 block_y_min, s16 block_y_max);
+
 	std::mutex m_queue_mutex;
 	std::deque<QueuedMinimapUpdate> m_update_queue;
 	std::map<v3s16, MinimapMapblock *> m_blocks_cache;
+
+	// Scrolling buffer, indexed by block column modulo MINIMAP_TILES
+	std::vector<MinimapTile> m_tiles;
+
+	// Parameters of the last scan and of the texture made from it
+	bool m_scan_valid = false;
+	v3s16 m_scan_pos;
+	s16 m_scan_size = 0;
+	s16 m_scan_height = 0;
+	bool m_scan_is_radar = false;
+	bool m_scan_shape_round = false;
 };
 
 class Minimap {
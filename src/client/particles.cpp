@@ -18,7 +18,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "particles.h"
+#include <algorithm>
 #include <cmath>
+#include <tuple>
 #include "client.h"
 #include "collision.h"
 #include "client/clientevent.h"
@@ -26,7 +28,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "light.h"
 #include "environment.h"
+#include "frametrace.h"
 #include "clientmap.h"
+#include "mapblock.h"
 #include "mapnode.h"
 #include "nodedef.h"
 #include "client.h"
@@ -43,204 +47,355 @@ v3f random_v3f(v3f min, v3f max)
 			rand()/(float)RAND_MAX*(max.Z-min.Z)+min.Z);
 }
 
-Particle::Particle(
-	IGameDef *gamedef,
-	LocalPlayer *player,
-	ClientEnvironment *env,
-	v3f pos,
-	v3f velocity,
-	v3f acceleration,
-	float expirationtime,
-	float size,
-	bool collisiondetection,
-	bool collision_removal,
-	bool object_collision,
-	bool vertical,
-	video::ITexture *texture,
-	v2f texpos,
-	v2f texsize,
-	const struct TileAnimationParams &anim,
-	u8 glow,
-	video::SColor color
-):
-	scene::ISceneNode(RenderingEngine::get_scene_manager()->getRootSceneNode(),
-		RenderingEngine::get_scene_manager())
+/*
+	ParticleLightCache
+*/
+
+ParticleLightCache::ParticleLightCache(Map *map, u32 daynight_ratio,
+		const NodeDefManager *ndef):
+	m_map(map),
+	m_daynight_ratio(daynight_ratio),
+	m_ndef(ndef)
 {
-	// Misc
-	m_gamedef = gamedef;
-	m_env = env;
+}
 
-	// Texture
+u8 ParticleLightCache::getLight(v3f pos)
+{
+	v3s16 p(
+		floor(pos.X + 0.5f),
+		floor(pos.Y + 0.5f),
+		floor(pos.Z + 0.5f)
+	);
+	v3s16 blockpos, offset;
+	getNodeBlockPosWithOffset(p, blockpos, offset);
+
+	MapBlock *block;
+	auto it = m_blocks.find(blockpos);
+	if (it != m_blocks.end()) {
+		block = it->second;
+	} else {
+		block = m_map->getBlockNoCreateNoEx(blockpos);
+		m_blocks[blockpos] = block;
+	}
+
+	bool pos_ok = false;
+	MapNode n;
+	if (block)
+		n = block->getNodeNoCheck(offset, &pos_ok);
+	if (pos_ok)
+		return n.getLightBlend(m_daynight_ratio, m_ndef);
+	return blend_light(m_daynight_ratio, LIGHT_SUN, 0);
+}
+
+/*
+	ParticlePool
+*/
+
+// Four vertices per particle must be addressable with 16-bit indices
+#define MAX_PARTICLES_PER_DRAW 16383
+
+ParticlePool::ParticlePool(video::ITexture *texture, bool collisiondetection):
+	m_collisiondetection(collisiondetection)
+{
 	m_material.setFlag(video::EMF_LIGHTING, false);
 	m_material.setFlag(video::EMF_BACK_FACE_CULLING, false);
 	m_material.setFlag(video::EMF_BILINEAR_FILTER, false);
 	m_material.setFlag(video::EMF_FOG_ENABLE, true);
 	m_material.MaterialType = video::EMT_TRANSPARENT_ALPHA_CHANNEL;
 	m_material.setTexture(0, texture);
-	m_texpos = texpos;
-	m_texsize = texsize;
-	m_animation = anim;
-
-	// Color
-	m_base_color = color;
-	m_color = color;
-
-	// Particle related
-	m_pos = pos;
-	m_velocity = velocity;
-	m_acceleration = acceleration;
-	m_expiration = expirationtime;
-	m_player = player;
-	m_size = size;
-	m_collisiondetection = collisiondetection;
-	m_collision_removal = collision_removal;
-	m_object_collision = object_collision;
-	m_vertical = vertical;
-	m_glow = glow;
-
-	// Irrlicht stuff
-	m_collisionbox = aabb3f
-			(-size/2,-size/2,-size/2,size/2,size/2,size/2);
-	this->setAutomaticCulling(scene::EAC_OFF);
-
-	// Init lighting
-	updateLight();
-
-	// Init model
-	updateVertices();
 }
 
-void Particle::OnRegisterSceneNode()
+void ParticlePool::add(const ParticleParameters &p)
 {
-	if (IsVisible)
-		SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
-
-	ISceneNode::OnRegisterSceneNode();
+	m_pos_x.push_back(p.pos.X);
+	m_pos_y.push_back(p.pos.Y);
+	m_pos_z.push_back(p.pos.Z);
+	m_vel_x.push_back(p.vel.X);
+	m_vel_y.push_back(p.vel.Y);
+	m_vel_z.push_back(p.vel.Z);
+	m_acc_x.push_back(p.acc.X);
+	m_acc_y.push_back(p.acc.Y);
+	m_acc_z.push_back(p.acc.Z);
+	m_time.push_back(0.0f);
+	m_expiration.push_back(p.expirationtime);
+	m_light.push_back(0);
+
+	Attributes a;
+	a.size = p.size;
+	a.texpos = p.texpos;
+	a.texsize = p.texsize;
+	a.base_color = p.color;
+	a.glow = p.glow;
+	a.collision_removal = p.collision_removal;
+	a.object_collision = p.object_collision;
+	a.vertical = p.vertical;
+	a.animation = p.animation;
+	a.animation_time = 0.0f;
+	a.animation_frame = 0;
+	m_attributes.push_back(a);
 }
 
-void Particle::render()
+void ParticlePool::remove(size_t i)
 {
-	video::IVideoDriver* driver = SceneManager->getVideoDriver();
-	driver->setMaterial(m_material);
-	driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
-
-	u16 indices[] = {0,1,2, 2,3,0};
-	driver->drawVertexPrimitiveList(m_vertices, 4,
-			indices, 2, video::EVT_STANDARD,
-			scene::EPT_TRIANGLES, video::EIT_16BIT);
+	// Move the last particle into the gap
+	size_t last = size() - 1;
+	m_pos_x[i] = m_pos_x[last];
+	m_pos_y[i] = m_pos_y[last];
+	m_pos_z[i] = m_pos_z[last];
+	m_vel_x[i] = m_vel_x[last];
+	m_vel_y[i] = m_vel_y[last];
+	m_vel_z[i] = m_vel_z[last];
+	m_acc_x[i] = m_acc_x[last];
+	m_acc_y[i] = m_acc_y[last];
+	m_acc_z[i] = m_acc_z[last];
+	m_time[i] = m_time[last];
+	m_expiration[i] = m_expiration[last];
+	m_light[i] = m_light[last];
+	m_attributes[i] = m_attributes[last];
+
+	m_pos_x.pop_back();
+	m_pos_y.pop_back();
+	m_pos_z.pop_back();
+	m_vel_x.pop_back();
+	m_vel_y.pop_back();
+	m_vel_z.pop_back();
+	m_acc_x.pop_back();
+	m_acc_y.pop_back();
+	m_acc_z.pop_back();
+	m_time.pop_back();
+	m_expiration.pop_back();
+	m_light.pop_back();
+	m_attributes.pop_back();
 }
 
-void Particle::step(float dtime)
+void ParticlePool::step(float dtime, Environment *env, IGameDef *gamedef)
 {
-	m_time += dtime;
-	if (m_collisiondetection) {
-		aabb3f box = m_collisionbox;
-		v3f p_pos = m_pos * BS;
-		v3f p_velocity = m_velocity * BS;
-		collisionMoveResult r = collisionMoveSimple(m_env, m_gamedef, BS * 0.5f,
-			box, 0.0f, dtime, &p_pos, &p_velocity, m_acceleration * BS, nullptr,
-			m_object_collision);
-		if (m_collision_removal && r.collides) {
-			// force expiration of the particle
-			m_expiration = -1.0;
-		} else {
-			m_pos = p_pos / BS;
-			m_velocity = p_velocity / BS;
+	for (size_t i = 0; i < size();) {
+		if (m_expiration[i] < m_time[i])
+			remove(i);
+		else
+			i++;
+	}
+
+	const size_t n = size();
+	float *time = m_time.data();
+	for (size_t i = 0; i < n; i++)
+		time[i] += dtime;
+
+	if (!m_collisiondetection) {
+		float *pos_x = m_pos_x.data(), *pos_y = m_pos_y.data(), *pos_z = m_pos_z.data();
+		float *vel_x = m_vel_x.data(), *vel_y = m_vel_y.data(), *vel_z = m_vel_z.data();
+		const float *acc_x = m_acc_x.data(), *acc_y = m_acc_y.data(),
+			*acc_z = m_acc_z.data();
+		for (size_t i = 0; i < n; i++) {
+			vel_x[i] += acc_x[i] * dtime;
+			vel_y[i] += acc_y[i] * dtime;
+			vel_z[i] += acc_z[i] * dtime;
+		}
+		for (size_t i = 0; i < n; i++) {
+			pos_x[i] += vel_x[i] * dtime;
+			pos_y[i] += vel_y[i] * dtime;
+			pos_z[i] += vel_z[i] * dtime;
 		}
 	} else {
-		m_velocity += m_acceleration * dtime;
-		m_pos += m_velocity * dtime;
+		for (size_t i = 0; i < n; i++) {
+			const Attributes &a = m_attributes[i];
+			aabb3f box(-a.size / 2, -a.size / 2, -a.size / 2,
+				a.size / 2, a.size / 2, a.size / 2);
+			v3f p_pos = v3f(m_pos_x[i], m_pos_y[i], m_pos_z[i]) * BS;
+			v3f p_velocity = v3f(m_vel_x[i], m_vel_y[i], m_vel_z[i]) * BS;
+			v3f p_acceleration = v3f(m_acc_x[i], m_acc_y[i], m_acc_z[i]) * BS;
+			collisionMoveResult r = collisionMoveSimple(env, gamedef, BS * 0.5f,
+				box, 0.0f, dtime, &p_pos, &p_velocity, p_acceleration, nullptr,
+				a.object_collision);
+			if (a.collision_removal && r.collides) {
+				// force expiration of the particle
+				m_expiration[i] = -1.0f;
+				continue;
+			}
+			p_pos /= BS;
+			p_velocity /= BS;
+			m_pos_x[i] = p_pos.X;
+			m_pos_y[i] = p_pos.Y;
+			m_pos_z[i] = p_pos.Z;
+			m_vel_x[i] = p_velocity.X;
+			m_vel_y[i] = p_velocity.Y;
+			m_vel_z[i] = p_velocity.Z;
+		}
 	}
-	if (m_animation.type != TAT_NONE) {
-		m_animation_time += dtime;
+
+	video::ITexture *texture = m_material.getTexture(0);
+	if (!texture)
+		return;
+	for (Attributes &a : m_attributes) {
+		if (a.animation.type == TAT_NONE)
+			continue;
+		a.animation_time += dtime;
 		int frame_length_i, frame_count;
-		m_animation.determineParams(
-				m_material.getTexture(0)->getSize(),
+		a.animation.determineParams(texture->getSize(),
 				&frame_count, &frame_length_i, NULL);
 		float frame_length = frame_length_i / 1000.0;
-		while (m_animation_time > frame_length) {
-			m_animation_frame++;
-			m_animation_time -= frame_length;
+		while (a.animation_time > frame_length) {
+			a.animation_frame++;
+			a.animation_time -= frame_length;
 		}
 	}
+}
 
-	// Update lighting
-	updateLight();
-
-	// Update model
-	updateVertices();
+void ParticlePool::updateLight(ParticleLightCache *cache)
+{
+	for (size_t i = 0; i < size(); i++) {
+		u8 light = cache->getLight(v3f(m_pos_x[i], m_pos_y[i], m_pos_z[i]));
+		m_light[i] = decode_light(light + m_attributes[i].glow);
+	}
 }
 
-void Particle::updateLight()
+void ParticlePool::updateVertices(const ParticleCamera &camera)
 {
-	u8 light = 0;
-	bool pos_ok;
+	const size_t n = size();
+	m_vertices.resize(n * 4);
+
+	// Corners of a particle of size 1 facing the camera,
+	// the same for all particles that are not vertical
+	v3f corners[4] = {
+		v3f(-0.5f, -0.5f, 0.0f),
+		v3f(0.5f, -0.5f, 0.0f),
+		v3f(0.5f, 0.5f, 0.0f),
+		v3f(-0.5f, 0.5f, 0.0f),
+	};
+	for (v3f &corner : corners) {
+		corner.rotateYZBy(camera.pitch);
+		corner.rotateXZBy(camera.yaw);
+	}
 
-	v3s16 p = v3s16(
-		floor(m_pos.X+0.5),
-		floor(m_pos.Y+0.5),
-		floor(m_pos.Z+0.5)
-	);
-	MapNode n = m_env->getClientMap().getNodeNoEx(p, &pos_ok);
-	if (pos_ok)
-		light = n.getLightBlend(m_env->getDayNightRatio(), m_gamedef->ndef());
-	else
-		light = blend_light(m_env->getDayNightRatio(), LIGHT_SUN, 0);
+	video::ITexture *texture = m_material.getTexture(0);
+	for (size_t i = 0; i < n; i++) {
+		const Attributes &a = m_attributes[i];
+
+		f32 tx0, tx1, ty0, ty1;
+		if (a.animation.type != TAT_NONE && texture) {
+			const v2u32 texsize = texture->getSize();
+			v2f texcoord, framesize_f;
+			v2u32 framesize;
+			texcoord = a.animation.getTextureCoords(texsize, a.animation_frame);
+			a.animation.determineParams(texsize, NULL, NULL, &framesize);
+			framesize_f = v2f(framesize.X / (float) texsize.X, framesize.Y / (float) texsize.Y);
+
+			tx0 = a.texpos.X + texcoord.X;
+			tx1 = a.texpos.X + texcoord.X + framesize_f.X * a.texsize.X;
+			ty0 = a.texpos.Y + texcoord.Y;
+			ty1 = a.texpos.Y + texcoord.Y + framesize_f.Y * a.texsize.Y;
+		} else {
+			tx0 = a.texpos.X;
+			tx1 = a.texpos.X + a.texsize.X;
+			ty0 = a.texpos.Y;
+			ty1 = a.texpos.Y + a.texsize.Y;
+		}
 
-	u8 m_light = decode_light(light + m_glow);
-	m_color.set(255,
-		m_light * m_base_color.getRed() / 255,
-		m_light * m_base_color.getGreen() / 255,
-		m_light * m_base_color.getBlue() / 255);
+		u8 light = m_light[i];
+		video::SColor color(255,
+			light * a.base_color.getRed() / 255,
+			light * a.base_color.getGreen() / 255,
+			light * a.base_color.getBlue() / 255);
+
+		v3f pos(m_pos_x[i], m_pos_y[i], m_pos_z[i]);
+		v3f center = pos * BS - camera.camera_offset;
+
+		video::S3DVertex *v = &m_vertices[i * 4];
+		if (a.vertical) {
+			// Turned around the Y axis towards the player; the same as
+			// rotateXZBy(atan2(dz, dx) / DEGTORAD + 90) without the trigonometry
+			f32 dx = camera.player_pos.X - pos.X;
+			f32 dz = camera.player_pos.Z - pos.Z;
+			f32 len = std::sqrt(dx * dx + dz * dz);
+			f32 cs = len > 0.0f ? -dz / len : 0.0f;
+			f32 sn = len > 0.0f ? dx / len : 1.0f;
+			for (u32 k = 0; k < 4; k++) {
+				f32 x = (k == 0 || k == 3 ? -0.5f : 0.5f) * a.size;
+				f32 y = (k < 2 ? -0.5f : 0.5f) * a.size;
+				v[k].Pos = center + v3f(x * cs, y, x * sn);
+			}
+		} else {
+			for (u32 k = 0; k < 4; k++)
+				v[k].Pos = center + corners[k] * a.size;
+		}
+
+		v[0].TCoords = v2f(tx0, ty1);
+		v[1].TCoords = v2f(tx1, ty1);
+		v[2].TCoords = v2f(tx1, ty0);
+		v[3].TCoords = v2f(tx0, ty0);
+		for (u32 k = 0; k < 4; k++) {
+			v[k].Normal = v3f(0.0f, 0.0f, 0.0f);
+			v[k].Color = color;
+		}
+	}
 }
 
-void Particle::updateVertices()
+void ParticlePool::render(video::IVideoDriver *driver)
 {
-	f32 tx0, tx1, ty0, ty1;
-
-	if (m_animation.type != TAT_NONE) {
-		const v2u32 texsize = m_material.getTexture(0)->getSize();
-		v2f texcoord, framesize_f;
-		v2u32 framesize;
-		texcoord = m_animation.getTextureCoords(texsize, m_animation_frame);
-		m_animation.determineParams(texsize, NULL, NULL, &framesize);
-		framesize_f = v2f(framesize.X / (float) texsize.X, framesize.Y / (float) texsize.Y);
-
-		tx0 = m_texpos.X + texcoord.X;
-		tx1 = m_texpos.X + texcoord.X + framesize_f.X * m_texsize.X;
-		ty0 = m_texpos.Y + texcoord.Y;
-		ty1 = m_texpos.Y + texcoord.Y + framesize_f.Y * m_texsize.Y;
-	} else {
-		tx0 = m_texpos.X;
-		tx1 = m_texpos.X + m_texsize.X;
-		ty0 = m_texpos.Y;
-		ty1 = m_texpos.Y + m_texsize.Y;
+	const size_t n = m_vertices.size() / 4;
+	if (n == 0)
+		return;
+
+	// The same indices are used for every chunk
+	size_t num_indexed = m_indices.size() / 6;
+	size_t chunk_size = std::min<size_t>(n, MAX_PARTICLES_PER_DRAW);
+	for (size_t i = num_indexed; i < chunk_size; i++) {
+		u16 base = i * 4;
+		u16 quad[] = {0, 1, 2, 2, 3, 0};
+		for (u16 index : quad)
+			m_indices.push_back(base + index);
 	}
 
-	m_vertices[0] = video::S3DVertex(-m_size / 2, -m_size / 2,
-		0, 0, 0, 0, m_color, tx0, ty1);
-	m_vertices[1] = video::S3DVertex(m_size / 2, -m_size / 2,
-		0, 0, 0, 0, m_color, tx1, ty1);
-	m_vertices[2] = video::S3DVertex(m_size / 2, m_size / 2,
-		0, 0, 0, 0, m_color, tx1, ty0);
-	m_vertices[3] = video::S3DVertex(-m_size / 2, m_size / 2,
-		0, 0, 0, 0, m_color, tx0, ty0);
-
-	v3s16 camera_offset = m_env->getCameraOffset();
-	for (video::S3DVertex &vertex : m_vertices) {
-		if (m_vertical) {
-			v3f ppos = m_player->getPosition()/BS;
-			vertex.Pos.rotateXZBy(std::atan2(ppos.Z - m_pos.Z, ppos.X - m_pos.X) /
-				core::DEGTORAD + 90);
-		} else {
-			vertex.Pos.rotateYZBy(m_player->getPitch());
-			vertex.Pos.rotateXZBy(m_player->getYaw());
-		}
-		m_box.addInternalPoint(vertex.Pos);
-		vertex.Pos += m_pos*BS - intToFloat(camera_offset, BS);
+	driver->setMaterial(m_material);
+	for (size_t first = 0; first < n; first += MAX_PARTICLES_PER_DRAW) {
+		u32 count = std::min<size_t>(n - first, MAX_PARTICLES_PER_DRAW);
+		driver->drawVertexPrimitiveList(&m_vertices[first * 4], count * 4,
+				m_indices.data(), count * 2, video::EVT_STANDARD,
+				scene::EPT_TRIANGLES, video::EIT_16BIT);
 	}
 }
 
+/*
+	ParticleRenderer: the scene node that draws all particles
+*/
+
+class ParticleRenderer : public scene::ISceneNode
+{
+public:
+	ParticleRenderer(ParticleManager *manager):
+		scene::ISceneNode(RenderingEngine::get_scene_manager()->getRootSceneNode(),
+			RenderingEngine::get_scene_manager()),
+		m_manager(manager)
+	{
+		setAutomaticCulling(scene::EAC_OFF);
+	}
+
+	virtual const aabb3f &getBoundingBox() const
+	{
+		return m_box;
+	}
+
+	virtual void OnRegisterSceneNode()
+	{
+		if (IsVisible)
+			SceneManager->registerNodeForRendering(this, scene::ESNRP_TRANSPARENT_EFFECT);
+
+		ISceneNode::OnRegisterSceneNode();
+	}
+
+	virtual void render()
+	{
+		video::IVideoDriver *driver = SceneManager->getVideoDriver();
+		driver->setTransform(video::ETS_WORLD, AbsoluteTransformation);
+		m_manager->render(driver);
+	}
+
+private:
+	ParticleManager *m_manager;
+	aabb3f m_box = aabb3f(0, 0, 0, 0, 0, 0);
+};
+
 /*
 	ParticleSpawner
 */
@@ -331,25 +486,19 @@ void ParticleSpawner::spawnParticle(ClientEnvironment *env, float radius,
 			* (m_maxsize - m_minsize)
 			+ m_minsize;
 
-	m_particlemanager->addParticle(new Particle(
-		m_gamedef,
-		m_player,
-		env,
-		pos,
-		vel,
-		acc,
-		exptime,
-		size,
-		m_collisiondetection,
-		m_collision_removal,
-		m_object_collision,
-		m_vertical,
-		m_texture,
-		v2f(0.0, 0.0),
-		v2f(1.0, 1.0),
-		m_animation,
-		m_glow
-	));
+	ParticleParameters p;
+	p.pos = pos;
+	p.vel = vel;
+	p.acc = acc;
+	p.expirationtime = exptime;
+	p.size = size;
+	p.collisiondetection = m_collisiondetection;
+	p.collision_removal = m_collision_removal;
+	p.object_collision = m_object_collision;
+	p.vertical = m_vertical;
+	p.animation = m_animation;
+	p.glow = m_glow;
+	m_particlemanager->addParticle(m_texture, p);
 }
 
 void ParticleSpawner::step(float dtime, ClientEnvironment* env)
@@ -406,16 +555,20 @@ void ParticleSpawner::step(float dtime, ClientEnvironment* env)
 
 
 ParticleManager::ParticleManager(ClientEnvironment* env) :
-	m_env(env)
+	m_env(env),
+	m_renderer(new ParticleRenderer(this))
 {}
 
 ParticleManager::~ParticleManager()
 {
 	clearAll();
+	m_renderer->remove();
+	m_renderer->drop();
 }
 
 void ParticleManager::step(float dtime)
 {
+	FrameTraceScope ft(g_frame_tracer, "ParticleManager::step");
 	stepParticles (dtime);
 	stepSpawners (dtime);
 }
@@ -443,23 +596,40 @@ void ParticleManager::stepSpawners (float dtime)
 void ParticleManager::stepParticles (float dtime)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	for(std::vector<Particle*>::iterator i = m_particles.begin();
-			i != m_particles.end();)
-	{
-		if ((*i)->get_expired())
-		{
-			(*i)->remove();
-			delete *i;
-			i = m_particles.erase(i);
-		}
-		else
-		{
-			(*i)->step(dtime);
-			++i;
+	LocalPlayer *player = m_env->getLocalPlayer();
+	if (!player)
+		return;
+
+	ParticleCamera camera;
+	camera.player_pos = player->getPosition() / BS;
+	camera.pitch = player->getPitch();
+	camera.yaw = player->getYaw();
+	camera.camera_offset = intToFloat(m_env->getCameraOffset(), BS);
+
+	IGameDef *gamedef = m_env->getGameDef();
+	ParticleLightCache light_cache(&m_env->getClientMap(),
+		m_env->getDayNightRatio(), gamedef->ndef());
+
+	for (auto i = m_pools.begin(); i != m_pools.end();) {
+		ParticlePool &pool = i->second;
+		pool.step(dtime, m_env, gamedef);
+		if (pool.size() == 0) {
+			i = m_pools.erase(i);
+			continue;
 		}
+		pool.updateLight(&light_cache);
+		pool.updateVertices(camera);
+		++i;
 	}
 }
 
+void ParticleManager::render(video::IVideoDriver *driver)
+{
+	MutexAutoLock lock(m_particle_list_lock);
+	for (auto &i : m_pools)
+		i.second.render(driver);
+}
+
 void ParticleManager::clearAll ()
 {
 	MutexAutoLock lock(m_spawner_list_lock);
@@ -472,14 +642,7 @@ void ParticleManager::clearAll ()
 		m_particle_spawners.erase(i++);
 	}
 
-	for(std::vector<Particle*>::iterator i =
-			m_particles.begin();
-			i != m_particles.end();)
-	{
-		(*i)->remove();
-		delete *i;
-		i = m_particles.erase(i);
-	}
+	m_pools.clear();
 }
 
 void ParticleManager::handleParticleEvent(ClientEvent *event, Client *client,
@@ -555,23 +718,20 @@ void ParticleManager::handleParticleEvent(ClientEvent *event, Client *client,
 			video::ITexture *texture =
 				client->tsrc()->getTextureForMesh(*(event->spawn_particle.texture));
 
-			Particle *toadd = new Particle(client, player, m_env,
-					*event->spawn_particle.pos,
-					*event->spawn_particle.vel,
-					*event->spawn_particle.acc,
-					event->spawn_particle.expirationtime,
-					event->spawn_particle.size,
-					event->spawn_particle.collisiondetection,
-					event->spawn_particle.collision_removal,
-					event->spawn_particle.object_collision,
-					event->spawn_particle.vertical,
-					texture,
-					v2f(0.0, 0.0),
-					v2f(1.0, 1.0),
-					event->spawn_particle.animation,
-					event->spawn_particle.glow);
-
-			addParticle(toadd);
+			ParticleParameters p;
+			p.pos = *event->spawn_particle.pos;
+			p.vel = *event->spawn_particle.vel;
+			p.acc = *event->spawn_particle.acc;
+			p.expirationtime = event->spawn_particle.expirationtime;
+			p.size = event->spawn_particle.size;
+			p.collisiondetection = event->spawn_particle.collisiondetection;
+			p.collision_removal = event->spawn_particle.collision_removal;
+			p.object_collision = event->spawn_particle.object_collision;
+			p.vertical = event->spawn_particle.vertical;
+			p.animation = event->spawn_particle.animation;
+			p.glow = event->spawn_particle.glow;
+
+			addParticle(texture, p);
 
 			delete event->spawn_particle.pos;
 			delete event->spawn_particle.vel;
@@ -613,8 +773,6 @@ void ParticleManager::addNodeParticle(IGameDef* gamedef,
 	u8 texid = myrand_range(0, 5);
 	const TileLayer &tile = f.tiles[texid].layers[0];
 	video::ITexture *texture;
-	struct TileAnimationParams anim;
-	anim.type = TAT_NONE;
 
 	// Only use first frame of animated texture
 	if (tile.material_flags & MATERIAL_FLAG_ANIMATION)
@@ -654,31 +812,29 @@ void ParticleManager::addNodeParticle(IGameDef* gamedef,
 	else
 		n.getColor(f, &color);
 
-	Particle* toadd = new Particle(
-		gamedef,
-		player,
-		m_env,
-		particlepos,
-		velocity,
-		acceleration,
-		(rand() % 100) / 100.0f, // expiration time
-		visual_size,
-		true,
-		false,
-		false,
-		false,
-		texture,
-		texpos,
-		texsize,
-		anim,
-		0,
-		color);
-
-	addParticle(toadd);
+	ParticleParameters p;
+	p.pos = particlepos;
+	p.vel = velocity;
+	p.acc = acceleration;
+	p.expirationtime = (rand() % 100) / 100.0f;
+	p.size = visual_size;
+	p.collisiondetection = true;
+	p.texpos = texpos;
+	p.texsize = texsize;
+	p.color = color;
+
+	addParticle(texture, p);
 }
 
-void ParticleManager::addParticle(Particle* toadd)
+void ParticleManager::addParticle(video::ITexture *texture,
+		const ParticleParameters &p)
 {
 	MutexAutoLock lock(m_particle_list_lock);
-	m_particles.push_back(toadd);
+	auto key = std::make_pair(texture, p.collisiondetection);
+	auto it = m_pools.find(key);
+	if (it == m_pools.end()) {
+		it = m_pools.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+			std::forward_as_tuple(texture, p.collisiondetection)).first;
+	}
+	it->second.add(p);
 }
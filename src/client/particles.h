@@ -20,6 +20,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
 #include "irrlichttypes_extrabloated.h"
 #include "client/tile.h"
 #include "localplayer.h"
@@ -27,91 +30,128 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 struct ClientEvent;
 class ParticleManager;
+class ParticleRenderer;
 class ClientEnvironment;
+class Environment;
+class Map;
+class MapBlock;
+class NodeDefManager;
 struct MapNode;
 struct ContentFeatures;
 
-class Particle : public scene::ISceneNode
+/*
+	Everything needed to spawn one particle
+*/
+struct ParticleParameters
 {
-	public:
-	Particle(
-		IGameDef* gamedef,
-		LocalPlayer *player,
-		ClientEnvironment *env,
-		v3f pos,
-		v3f velocity,
-		v3f acceleration,
-		float expirationtime,
-		float size,
-		bool collisiondetection,
-		bool collision_removal,
-		bool object_collision,
-		bool vertical,
-		video::ITexture *texture,
-		v2f texpos,
-		v2f texsize,
-		const struct TileAnimationParams &anim,
-		u8 glow,
-		video::SColor color = video::SColor(0xFFFFFFFF)
-	);
-	~Particle() = default;
-
-	virtual const aabb3f &getBoundingBox() const
-	{
-		return m_box;
-	}
+	ParticleParameters() { animation.type = TAT_NONE; }
+
+	v3f pos;
+	v3f vel;
+	v3f acc;
+	float expirationtime = 1.0f;
+	float size = 1.0f;
+	bool collisiondetection = false;
+	bool collision_removal = false;
+	bool object_collision = false;
+	bool vertical = false;
+	v2f texpos = v2f(0.0f, 0.0f);
+	v2f texsize = v2f(1.0f, 1.0f);
+	struct TileAnimationParams animation;
+	u8 glow = 0;
+	video::SColor color = video::SColor(0xFFFFFFFF);
+};
 
-	virtual u32 getMaterialCount() const
-	{
-		return 1;
-	}
+/*
+	Looks up the light of the nodes particles are in. Particles tend to be
+	in a few blocks, so the blocks are looked up only once per step.
+*/
+class ParticleLightCache
+{
+public:
+	ParticleLightCache(Map *map, u32 daynight_ratio, const NodeDefManager *ndef);
 
-	virtual video::SMaterial& getMaterial(u32 i)
-	{
-		return m_material;
-	}
+	// Light of the node at 'pos' (in nodes), blended for the time of day
+	u8 getLight(v3f pos);
+
+private:
+	Map *m_map;
+	u32 m_daynight_ratio;
+	const NodeDefManager *m_ndef;
+	// NULL for blocks that are not loaded
+	std::unordered_map<v3s16, MapBlock *> m_blocks;
+};
+
+/*
+	How particles are turned towards the camera
+*/
+struct ParticleCamera
+{
+	v3f player_pos; // in nodes
+	f32 pitch = 0.0f;
+	f32 yaw = 0.0f;
+	v3f camera_offset; // in BS units
+};
 
-	virtual void OnRegisterSceneNode();
-	virtual void render();
+/*
+	Particles drawn with the same texture that either all collide with the
+	map or all do not, stored as structure of arrays. Stepping them is a
+	few loops over the arrays and they are drawn with one vertex buffer.
+*/
+class ParticlePool
+{
+public:
+	ParticlePool(video::ITexture *texture, bool collisiondetection);
 
-	void step(float dtime);
+	void add(const ParticleParameters &p);
+	size_t size() const { return m_time.size(); }
 
-	bool get_expired ()
-	{ return m_expiration < m_time; }
+	// Removes expired particles and moves the others.
+	// env and gamedef are only used for collision detection.
+	void step(float dtime, Environment *env, IGameDef *gamedef);
+	void updateLight(ParticleLightCache *cache);
+	void updateVertices(const ParticleCamera &camera);
 
-private:
-	void updateLight();
-	void updateVertices();
+	void render(video::IVideoDriver *driver);
 
-	video::S3DVertex m_vertices[4];
-	float m_time = 0.0f;
-	float m_expiration;
+	const std::vector<video::S3DVertex> &getVertices() const { return m_vertices; }
+
+private:
+	void remove(size_t i);
 
-	ClientEnvironment *m_env;
-	IGameDef *m_gamedef;
-	aabb3f m_box;
-	aabb3f m_collisionbox;
 	video::SMaterial m_material;
-	v2f m_texpos;
-	v2f m_texsize;
-	v3f m_pos;
-	v3f m_velocity;
-	v3f m_acceleration;
-	LocalPlayer *m_player;
-	float m_size;
-	//! Color without lighting
-	video::SColor m_base_color;
-	//! Final rendered color
-	video::SColor m_color;
 	bool m_collisiondetection;
-	bool m_collision_removal;
-	bool m_object_collision;
-	bool m_vertical;
-	v3s16 m_camera_offset;
-	struct TileAnimationParams m_animation;
-	float m_animation_time = 0.0f;
-	int m_animation_frame = 0;
-	u8 m_glow;
+
+	// Used by every step
+	std::vector<float> m_pos_x, m_pos_y, m_pos_z;
+	std::vector<float> m_vel_x, m_vel_y, m_vel_z;
+	std::vector<float> m_acc_x, m_acc_y, m_acc_z;
+	std::vector<float> m_time;
+	std::vector<float> m_expiration;
+	//! Brightness including glow
+	std::vector<u8> m_light;
+
+	struct Attributes
+	{
+		float size;
+		v2f texpos;
+		v2f texsize;
+		//! Color without lighting
+		video::SColor base_color;
+		u8 glow;
+		bool collision_removal;
+		bool object_collision;
+		bool vertical;
+		struct TileAnimationParams animation;
+		float animation_time;
+		int animation_frame;
+	};
+	std::vector<Attributes> m_attributes;
+
+	// Four vertices per particle, drawn in chunks of at most
+	// MAX_PARTICLES_PER_DRAW particles with m_indices
+	std::vector<video::S3DVertex> m_vertices;
+	std::vector<u16> m_indices;
 };
 
 class ParticleSpawner
@@ -204,8 +244,11 @@ friend class ParticleSpawner;
 	 	}
 	}
 
+	// Draws all particles, called by the scene node of the particles
+	void render(video::IVideoDriver *driver);
+
 protected:
-	void addParticle(Particle* toadd);
+	void addParticle(video::ITexture *texture, const ParticleParameters &p);
 
 private:
 
@@ -214,10 +257,12 @@ friend class ParticleSpawner;
 
 	void clearAll ();
 
-	std::vector<Particle*> m_particles;
+	// Keyed by texture and collision detection
+	std::map<std::pair<video::ITexture *, bool>, ParticlePool> m_pools;
 	std::map<u32, ParticleSpawner*> m_particle_spawners;
 
 	ClientEnvironment* m_env;
+	ParticleRenderer *m_renderer;
 	std::mutex m_particle_list_lock;
 	std::mutex m_spawner_list_lock;
 };
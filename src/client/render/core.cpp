@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/clientmap.h"
 #include "client/hud.h"
 #include "client/minimap.h"
+#include "frametrace.h"
 
 RenderingCore::RenderingCore(IrrlichtDevice *_device, Client *_client, Hud *_hud)
 	: device(_device), driver(device->getVideoDriver()), smgr(device->getSceneManager()),
@@ -72,6 +73,7 @@ void RenderingCore::draw(video::SColor _skycolor, bool _show_hud, bool _show_min
 
 void RenderingCore::draw3D()
 {
+	FrameTraceScope ft(g_frame_tracer, "RenderingCore::draw3D");
 	smgr->drawAll();
 	driver->setTransform(video::ETS_WORLD, core::IdentityMatrix);
 	if (!show_hud)
@@ -84,6 +86,7 @@ void RenderingCore::draw3D()
 void RenderingCore::drawHUD()
 {
 	if (show_hud) {
+		FrameTraceScope ft(g_frame_tracer, "RenderingCore::drawHUD");
 		if (draw_crosshair)
 			hud->drawCrosshair();
 		hud->drawHotbar(client->getPlayerItem());
@@ -92,6 +95,8 @@ void RenderingCore::drawHUD()
 		if (mapper && show_minimap)
 			mapper->drawMinimap();
 	}
+	// Formspecs, chat and other GUI elements
+	FrameTraceScope ft(g_frame_tracer, "IGUIEnvironment::drawAll");
 	guienv->drawAll();
 }
 
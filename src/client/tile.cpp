@@ -20,18 +20,28 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "tile.h"
 
 #include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
 #include <ICameraSceneNode.h>
+#include "threading/thread.h"
+#include "util/hex.h"
+#include "util/sha1.h"
 #include "util/string.h"
 #include "util/container.h"
 #include "util/thread.h"
 #include "filesys.h"
 #include "settings.h"
 #include "mesh.h"
+#include "porting.h"
 #include "gamedef.h"
 #include "util/strfnd.h"
 #include "imagefilters.h"
 #include "guiscalingfilter.h"
 #include "renderingengine.h"
+#include "version.h"
 
 
 #ifdef __ANDROID__
@@ -162,6 +172,17 @@ void clearTextureNameCache()
 	g_texturename_to_path_cache.clear();
 }
 
+/*
+	Returns a new image with the same format and content as img.
+*/
+static video::IImage *copy_image(video::IImage *img)
+{
+	video::IImage *copy = RenderingEngine::get_video_driver()->
+		createImage(img->getColorFormat(), img->getDimension());
+	img->copyTo(copy);
+	return copy;
+}
+
 /*
 	Stores internal information about a texture.
 */
@@ -363,6 +384,13 @@ class TextureSource : public IWritableTextureSource
 	// Shall be called from the main thread.
 	void rebuildImagesAndTextures();
 
+	// Creates the textures of the given names, composing the images
+	// on several threads.
+	// Shall be called from the main thread.
+	void prepareTextures(const std::vector<std::string> &names);
+
+	void setImageCache(const std::string &dir, const std::string &media_hash);
+
 	video::ITexture* getNormalTexture(const std::string &name);
 	video::SColor getTextureAverageColor(const std::string &name);
 	video::ITexture *getShaderFlagsTexture(bool normamap_present);
@@ -373,12 +401,27 @@ class TextureSource : public IWritableTextureSource
 	std::thread::id m_main_thread;
 
 	// Cache of source images
-	// This should be only accessed from the main thread
+	// Accessed through getSourceImage() only
 	SourceImageCache m_sourcecache;
+	// Also serializes file access, Irrlicht's file system is not thread-safe
+	std::mutex m_sourcecache_mutex;
+
+	// Returns a source image from the cache or the file system, to be
+	// dropped by the caller. Other threads get a private copy.
+	video::IImage *getSourceImage(const std::string &name);
 
 	// Generate a texture
 	u32 generateTexture(const std::string &name);
 
+	// Creates a texture from img, drops img and adds the texture
+	// to the caches.
+	// Shall be called from the main thread.
+	u32 addTexture(const std::string &name, video::IImage *img);
+
+	// Reads a composed image from the image cache directory, or composes
+	// it and stores it there
+	video::IImage *loadOrGenerateImage(const std::string &name);
+
 	// Generate image based on a string like "stone.png" or "[crack:1:0".
 	// if baseimg is NULL, it is created. Otherwise stuff is made on it.
 	bool generateImagePart(std::string part_of_name, video::IImage *& baseimg);
@@ -389,6 +432,17 @@ class TextureSource : public IWritableTextureSource
 	 * The returned Image should be dropped.
 	 */
 	video::IImage* generateImage(const std::string &name);
+	video::IImage* composeImage(const std::string &name);
+
+	// While prepareTextures() runs, images generated by one thread are
+	// kept here for the others, e.g. "default_dirt.png^default_grass_side.png"
+	// which is the base of many other textures. Holds copies.
+	bool m_image_memo_enabled = false;
+	std::unordered_map<std::string, video::IImage *> m_image_memo;
+	std::mutex m_image_memo_mutex;
+
+	// Directory of composed images, empty if disabled
+	std::string m_image_cache_dir;
 
 	// Thread-safe cache of what source images are known (true = known)
 	MutexedMap<std::string, bool> m_source_image_existence;
@@ -586,11 +640,14 @@ u32 TextureSource::generateTexture(const std::string &name)
 		return 0;
 	}
 
+	return addTexture(name, generateImage(name));
+}
+
+u32 TextureSource::addTexture(const std::string &name, video::IImage *img)
+{
 	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
 	sanity_check(driver);
 
-	video::IImage *img = generateImage(name);
-
 	video::ITexture *tex = NULL;
 
 	if (img != NULL) {
@@ -737,10 +794,25 @@ void TextureSource::insertSourceImage(const std::string &name, video::IImage *im
 
 	sanity_check(std::this_thread::get_id() == m_main_thread);
 
+	MutexAutoLock lock(m_sourcecache_mutex);
 	m_sourcecache.insert(name, img, true);
 	m_source_image_existence.set(name, true);
 }
 
+video::IImage *TextureSource::getSourceImage(const std::string &name)
+{
+	MutexAutoLock lock(m_sourcecache_mutex);
+	video::IImage *img = m_sourcecache.getOrLoad(name);
+	if (!img || std::this_thread::get_id() == m_main_thread)
+		return img;
+
+	// Reference counting of images is not atomic, so the shared image
+	// must only be grabbed and dropped while holding the lock
+	video::IImage *copy = copy_image(img);
+	img->drop();
+	return copy;
+}
+
 void TextureSource::rebuildImagesAndTextures()
 {
 	MutexAutoLock lock(m_textureinfo_cache_mutex);
@@ -770,6 +842,167 @@ void TextureSource::rebuildImagesAndTextures()
 	}
 }
 
+void TextureSource::prepareTextures(const std::vector<std::string> &names)
+{
+	sanity_check(std::this_thread::get_id() == m_main_thread);
+
+#ifdef __ANDROID__
+	// Align2Npot2() needs the GL context of the main thread; the
+	// textures are generated on demand instead
+	return;
+#endif
+
+	std::vector<std::string> todo;
+	{
+		MutexAutoLock lock(m_textureinfo_cache_mutex);
+		std::unordered_set<std::string> seen;
+		for (const std::string &name : names) {
+			if (!name.empty() && m_name_to_id.find(name) == m_name_to_id.end() &&
+					seen.insert(name).second)
+				todo.push_back(name);
+		}
+	}
+	if (todo.empty())
+		return;
+
+	u32 num_threads = std::max(Thread::getNumberOfProcessors(), 1U);
+	num_threads = std::min<size_t>(num_threads, todo.size());
+
+	u64 t0 = porting::getTimeMs();
+	std::vector<video::IImage *> images(todo.size(), NULL);
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+
+	m_image_memo_enabled = true;
+	for (u32 i = 0; i < num_threads; i++) {
+		workers.emplace_back([&] () {
+			size_t j;
+			while ((j = next++) < todo.size())
+				images[j] = loadOrGenerateImage(todo[j]);
+		});
+	}
+	for (std::thread &worker : workers)
+		worker.join();
+	m_image_memo_enabled = false;
+
+	for (auto &it : m_image_memo) {
+		if (it.second)
+			it.second->drop();
+	}
+	m_image_memo.clear();
+
+	// Textures can only be created by the main thread
+	for (size_t i = 0; i < todo.size(); i++)
+		addTexture(todo[i], images[i]);
+
+	infostream << "TextureSource: prepared " << todo.size() << " textures on "
+		<< num_threads << " threads in " << porting::getTimeMs() - t0
+		<< "ms" << std::endl;
+}
+
+// Number of image cache directories that are kept, one for every server,
+// version of its media and set of texture settings
+#define IMAGE_CACHE_MAX_DIRS 5
+
+// Deletes the least recently used image cache directories in dir other
+// than 'keep', so that at most IMAGE_CACHE_MAX_DIRS are left
+static void prune_image_cache(const std::string &dir, const std::string &keep)
+{
+	std::vector<std::pair<s64, std::string>> dirs;
+	for (const fs::DirListNode &node : fs::GetDirListing(dir)) {
+		// Only directories named after a SHA1 digest belong to the cache
+		if (!node.dir || node.name.size() != 40 || node.name == keep)
+			continue;
+
+		// Directories without a time are the oldest
+		std::string path = dir + DIR_DELIM + node.name;
+		std::ifstream is(path + DIR_DELIM + "last_used");
+		s64 last_used = 0;
+		is >> last_used;
+		dirs.emplace_back(last_used, path);
+	}
+	if (dirs.size() < IMAGE_CACHE_MAX_DIRS)
+		return;
+
+	std::sort(dirs.begin(), dirs.end());
+	for (size_t i = 0; i <= dirs.size() - IMAGE_CACHE_MAX_DIRS; i++) {
+		infostream << "TextureSource: deleting old image cache \""
+			<< dirs[i].second << "\"" << std::endl;
+		if (!fs::RecursiveDelete(dirs[i].second))
+			warningstream << "TextureSource: cannot delete \""
+				<< dirs[i].second << "\"" << std::endl;
+	}
+}
+
+void TextureSource::setImageCache(const std::string &dir,
+		const std::string &media_hash)
+{
+	// Everything else that changes the result of composing an image
+	// goes into the name of the directory as well
+	std::ostringstream os(std::ios::binary);
+	os << media_hash << '\0'
+		<< g_version_hash << '\0'
+		<< g_settings->get("texture_path") << '\0'
+		<< g_settings->getBool("texture_clean_transparent") << '\0'
+		<< g_settings->getS32("texture_min_size") << '\0'
+		<< m_setting_trilinear_filter << m_setting_bilinear_filter;
+	std::string key = os.str();
+
+	SHA1 sha1;
+	sha1.addBytes(key.c_str(), key.size());
+	unsigned char *digest = sha1.getDigest();
+	std::string digest_hex = hex_encode((char *)digest, 20);
+	free(digest);
+
+	m_image_cache_dir = dir + DIR_DELIM + digest_hex;
+	if (!fs::CreateAllDirs(m_image_cache_dir)) {
+		errorstream << "TextureSource: cannot create image cache directory \""
+			<< m_image_cache_dir << "\"" << std::endl;
+		m_image_cache_dir.clear();
+		return;
+	}
+	infostream << "TextureSource: using image cache at \""
+		<< m_image_cache_dir << "\"" << std::endl;
+
+	fs::safeWriteToFile(m_image_cache_dir + DIR_DELIM + "last_used",
+		std::to_string((s64)time(NULL)));
+	prune_image_cache(dir, digest_hex);
+}
+
+video::IImage *TextureSource::loadOrGenerateImage(const std::string &name)
+{
+	// Source images are cached by the media cache already
+	if (m_image_cache_dir.empty() ||
+			(name[0] != '[' && name.find('^') == std::string::npos))
+		return generateImage(name);
+
+	SHA1 sha1;
+	sha1.addBytes(name.c_str(), name.size());
+	unsigned char *digest = sha1.getDigest();
+	std::string path = m_image_cache_dir + DIR_DELIM +
+		hex_encode((char *)digest, 20) + ".png";
+	free(digest);
+
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	{
+		MutexAutoLock lock(m_sourcecache_mutex);
+		if (fs::PathExists(path)) {
+			video::IImage *img = driver->createImageFromFile(path.c_str());
+			if (img)
+				return img;
+		}
+	}
+
+	video::IImage *img = generateImage(name);
+	if (img) {
+		MutexAutoLock lock(m_sourcecache_mutex);
+		if (!driver->writeImageToFile(img, path.c_str()))
+			warningstream << "TextureSource: cannot write \"" << path
+				<< "\"" << std::endl;
+	}
+	return img;
+}
+
 inline static void applyShadeFactor(video::SColor &color, u32 factor)
 {
 	u32 f = core::clamp<u32>(factor, 0, 256);
@@ -888,6 +1121,26 @@ static video::IImage *createInventoryCubeImage(
 }
 
 video::IImage* TextureSource::generateImage(const std::string &name)
+{
+	if (!m_image_memo_enabled)
+		return composeImage(name);
+
+	{
+		MutexAutoLock lock(m_image_memo_mutex);
+		auto it = m_image_memo.find(name);
+		if (it != m_image_memo.end())
+			return it->second ? copy_image(it->second) : NULL;
+	}
+
+	video::IImage *img = composeImage(name);
+
+	MutexAutoLock lock(m_image_memo_mutex);
+	if (m_image_memo.find(name) == m_image_memo.end())
+		m_image_memo[name] = img ? copy_image(img) : NULL;
+	return img;
+}
+
+video::IImage* TextureSource::composeImage(const std::string &name)
 {
 	// Get the base image
 
@@ -1076,7 +1329,7 @@ bool TextureSource::generateImagePart(std::string part_of_name,
 
 	// Stuff starting with [ are special commands
 	if (part_of_name.empty() || part_of_name[0] != '[') {
-		video::IImage *image = m_sourcecache.getOrLoad(part_of_name);
+		video::IImage *image = getSourceImage(part_of_name);
 #ifdef __ANDROID__
 		image = Align2Npot2(image, driver);
 #endif
@@ -1217,8 +1470,7 @@ bool TextureSource::generateImagePart(std::string part_of_name,
 					It is an image with a number of cracking stages
 					horizontally tiled.
 				*/
-				video::IImage *img_crack = m_sourcecache.getOrLoad(
-					"crack_anylength.png");
+				video::IImage *img_crack = getSourceImage("crack_anylength.png");
 
 				if (img_crack) {
 					draw_crack(img_crack, baseimg,
@@ -107,6 +107,12 @@ class ITextureSource : public ISimpleTextureSource
 	virtual video::ITexture* getNormalTexture(const std::string &name)=0;
 	virtual video::SColor getTextureAverageColor(const std::string &name)=0;
 	virtual video::ITexture *getShaderFlagsTexture(bool normalmap_present)=0;
+	/*!
+	 * Creates the textures of all the given names that do not exist yet,
+	 * composing their images on several threads.
+	 * Shall be called from the main thread.
+	 */
+	virtual void prepareTextures(const std::vector<std::string> &names)=0;
 };
 
 class IWritableTextureSource : public ITextureSource
@@ -126,6 +132,13 @@ class IWritableTextureSource : public ITextureSource
 	virtual void processQueue()=0;
 	virtual void insertSourceImage(const std::string &name, video::IImage *img)=0;
 	virtual void rebuildImagesAndTextures()=0;
+	/*!
+	 * Stores composed images as files below 'dir' and reads them from
+	 * there instead of composing them again. 'media_hash' must change
+	 * whenever any of the source images does.
+	 */
+	virtual void setImageCache(const std::string &dir,
+			const std::string &media_hash)=0;
 	virtual video::ITexture* getNormalTexture(const std::string &name)=0;
 	virtual video::SColor getTextureAverageColor(const std::string &name)=0;
 	virtual video::ITexture *getShaderFlagsTexture(bool normalmap_present)=0;
@@ -31,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "util/srp.h"
 #include "face_position_cache.h"
+#include "util/numeric.h"
 
 const char *ClientInterface::statenames[] = {
 	"Invalid",
@@ -122,7 +123,8 @@ void RemoteClient::GetNextBlocks (
 	LuaEntitySAO *lsao = getAttachedObject(sao, env);
 	const v3f &playerspeed = lsao? lsao->getVelocity() : player->getSpeed();
 	v3f playerspeeddir(0,0,0);
-	if (playerspeed.getLength() > 1.0f * BS)
+	const bool player_moving = playerspeed.getLength() > 1.0f * BS;
+	if (player_moving)
 		playerspeeddir = playerspeed / playerspeed.getLength();
 	// Predict to next block
 	v3f playerpos_predicted = playerpos + playerspeeddir * (MAP_BLOCKSIZE * BS);
@@ -234,6 +236,10 @@ void RemoteClient::GetNextBlocks (
 	//bool queue_is_full = false;
 
 	const v3s16 cam_pos_nodes = floatToInt(camera_pos, BS);
+	if (cam_pos_nodes != m_occlusion_cam_pos) {
+		m_blocks_occluded.clear();
+		m_occlusion_cam_pos = cam_pos_nodes;
+	}
 
 	s16 d;
 	for (d = d_start; d <= d_max; d++) {
@@ -241,11 +247,10 @@ void RemoteClient::GetNextBlocks (
 			Get the border/face dot coordinates of a "d-radiused"
 			box
 		*/
-		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
+		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
 
-		std::vector<v3s16>::iterator li;
-		for (li = list.begin(); li != list.end(); ++li) {
-			v3s16 p = *li + center;
+		for (const v3s16 &offset : list) {
+			v3s16 p = offset + center;
 
 			/*
 				Send throttling
@@ -278,6 +283,12 @@ void RemoteClient::GetNextBlocks (
 			if (blockpos_over_max_limit(p))
 				continue;
 
+			/*
+				Don't send already sent blocks
+			*/
+			if (m_blocks_sent.contains(p))
+				continue;
+
 			// If this is true, inexistent block will be made from scratch
 			bool generate = d <= d_max_gen;
 
@@ -292,18 +303,12 @@ void RemoteClient::GetNextBlocks (
 			f32 dist;
 			if (!(isBlockInSight(p, camera_pos, camera_dir, camera_fov,
 						d_blocks_in_sight, &dist) ||
-					(playerspeed.getLength() > 1.0f * BS &&
+					(player_moving &&
 					isBlockInSight(p, camera_pos, playerspeeddir, 0.1f,
 						d_blocks_in_sight)))) {
 				continue;
 			}
 
-			/*
-				Don't send already sent blocks
-			*/
-			if (m_blocks_sent.find(p) != m_blocks_sent.end())
-				continue;
-
 			/*
 				Check if map has this block
 			*/
@@ -336,9 +341,13 @@ void RemoteClient::GetNextBlocks (
 						continue;
 				}
 
-				if (m_occ_cull && !block_is_invalid &&
-						env->getMap().isBlockOccluded(block, cam_pos_nodes)) {
-					continue;
+				if (m_occ_cull && !block_is_invalid) {
+					if (m_blocks_occluded.contains(p))
+						continue;
+					if (env->getMap().isBlockOccluded(block, cam_pos_nodes)) {
+						m_blocks_occluded.insert(p);
+						continue;
+					}
 				}
 			}
 
@@ -436,9 +445,29 @@ void RemoteClient::SetBlockNotSent(v3s16 p)
 
 	if (m_blocks_sending.find(p) != m_blocks_sending.end())
 		m_blocks_sending.erase(p);
-	if (m_blocks_sent.find(p) != m_blocks_sent.end())
-		m_blocks_sent.erase(p);
+	m_blocks_sent.erase(p);
 	m_blocks_modified.insert(p);
+	m_blocks_occluded.clear();
+}
+
+void RemoteClient::SetBlockCached(v3s16 p, u64 hash)
+{
+	if (m_blocks_cached.size() >= BLOCK_CACHE_MAX_ANNOUNCED)
+		return;
+
+	m_blocks_cached[p] = hash;
+}
+
+bool RemoteClient::TakeBlockCached(v3s16 p, const std::string &data)
+{
+	auto it = m_blocks_cached.find(p);
+	if (it == m_blocks_cached.end())
+		return false;
+
+	bool matches = it->second ==
+		murmur_hash_64_ua(data.c_str(), data.size(), BLOCK_CACHE_HASH_SEED);
+	m_blocks_cached.erase(it);
+	return matches;
 }
 
 void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
@@ -452,9 +481,9 @@ void RemoteClient::SetBlocksNotSent(std::map<v3s16, MapBlock*> &blocks)
 
 		if (m_blocks_sending.find(p) != m_blocks_sending.end())
 			m_blocks_sending.erase(p);
-		if (m_blocks_sent.find(p) != m_blocks_sent.end())
-			m_blocks_sent.erase(p);
+		m_blocks_sent.erase(p);
 	}
+	m_blocks_occluded.clear();
 }
 
 void RemoteClient::notifyEvent(ClientStateEvent event)
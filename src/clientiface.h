@@ -26,10 +26,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/networkpacket.h"
 #include "network/networkprotocol.h"
 #include "porting.h"
+#include "util/blockbitset.h"
 
 #include <list>
 #include <vector>
 #include <set>
+#include <string>
+#include <unordered_map>
 #include <mutex>
 
 class MapBlock;
@@ -238,6 +241,8 @@ class RemoteClient
 	bool create_player_on_auth_success = false;
 	AuthMechanism chosen_mech  = AUTH_MECHANISM_NONE;
 	void *auth_data = nullptr;
+	// An SRP step is being computed by the AuthWorkerPool
+	bool auth_job_pending = false;
 	u32 allowed_auth_mechs = 0;
 	u32 allowed_sudo_mechs = 0;
 
@@ -274,9 +279,18 @@ class RemoteClient
 
 	u32 getSendingCount() const { return m_blocks_sending.size(); }
 
+	// Remembers a block the client announced with TOSERVER_CACHED_BLOCKS
+	void SetBlockCached(v3s16 p, u64 hash);
+	/*
+		Returns true if the client has the block cached with exactly
+		this serialized data. The announcement is used up either way,
+		later sends of the block always carry the data.
+	*/
+	bool TakeBlockCached(v3s16 p, const std::string &data);
+
 	bool isBlockSent(v3s16 p) const
 	{
-		return m_blocks_sent.find(p) != m_blocks_sent.end();
+		return m_blocks_sent.contains(p);
 	}
 
 	// Increments timeouts and removes timed-out blocks from list
@@ -303,6 +317,19 @@ class RemoteClient
 	*/
 	std::set<u16> m_known_objects;
 
+	/*
+		Rate limiting of position updates of distant objects.
+		Key = object id
+	*/
+	struct ObjectPositionLod
+	{
+		// Time since the last position update was sent
+		float timer = 0.0f;
+		// Newest update that was held back, empty if none
+		std::string pending;
+	};
+	std::unordered_map<u16, ObjectPositionLod> m_object_position_lod;
+
 	ClientState getState() const { return m_state; }
 
 	std::string getName() const { return m_name; }
@@ -354,7 +381,14 @@ class RemoteClient
 		List of block positions.
 		No MapBlock* is stored here because the blocks can get deleted.
 	*/
-	std::set<v3s16> m_blocks_sent;
+	BlockBitSet m_blocks_sent;
+
+	/*
+		Blocks found to be occluded from m_occlusion_cam_pos. Cleared when
+		the camera moves to another node or blocks get modified.
+	*/
+	BlockBitSet m_blocks_occluded;
+	v3s16 m_occlusion_cam_pos;
 	s16 m_nearest_unsent_d = 0;
 	v3s16 m_last_center;
 	float m_nearest_unsent_reset_timer = 0.0f;
@@ -386,6 +420,12 @@ class RemoteClient
 	*/
 	std::set<v3s16> m_blocks_modified;
 
+	/*
+		Blocks in the client's block cache, with the hash of their
+		TOCLIENT_BLOCKDATA payload.
+	*/
+	std::map<v3s16, u64> m_blocks_cached;
+
 	/*
 		Count of excess GotBlocks().
 		There is an excess amount because the client sometimes
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "collision.h"
 #include <cmath>
+#include <unordered_map>
 #include "mapblock.h"
 #include "map.h"
 #include "nodedef.h"
@@ -211,6 +212,64 @@ static inline void getNeighborConnectingFace(const v3s16 &p,
 		*neighbors |= v;
 }
 
+const BlockCollisionCache *getBlockCollisionCache(MapBlock *block,
+		const NodeDefManager *nodedef)
+{
+	if (block->isDummy())
+		return NULL;
+	if (block->collision_cache && !block->collision_cache_expired)
+		return block->collision_cache;
+
+	if (!block->collision_cache)
+		block->collision_cache = new BlockCollisionCache;
+	block->collision_cache_expired = false;
+	BlockCollisionCache *cache = block->collision_cache;
+	cache->shapes.clear();
+	cache->boxes.clear();
+
+	// Shape of each content and param2, these make up the boxes
+	std::unordered_map<u32, u16> shape_of_node;
+	std::vector<aabb3f> nodeboxes;
+	for (u32 i = 0; i < MapBlock::nodecount; i++) {
+		const MapNode &n = block->getData()[i];
+		if (n.getContent() == CONTENT_IGNORE) {
+			cache->nodes[i] = BlockCollisionCache::NODE_IGNORE;
+			continue;
+		}
+
+		const ContentFeatures &f = nodedef->get(n);
+		if (!f.walkable) {
+			cache->nodes[i] = BlockCollisionCache::NODE_EMPTY;
+			continue;
+		}
+		if (f.drawtype == NDT_NODEBOX &&
+				f.node_box.type == NODEBOX_CONNECTED) {
+			cache->nodes[i] = BlockCollisionCache::NODE_CONNECTED;
+			continue;
+		}
+
+		u32 key = (u32)n.getContent() << 8 | n.getParam2();
+		auto it = shape_of_node.find(key);
+		if (it != shape_of_node.end()) {
+			cache->nodes[i] = it->second;
+			continue;
+		}
+
+		u16 shape = BlockCollisionCache::NODE_SHAPE + cache->shapes.size();
+		shape_of_node[key] = shape;
+		cache->nodes[i] = shape;
+		cache->shapes.push_back(cache->boxes.size());
+		int bouncy = itemgroup_get(f.groups, "bouncy");
+		nodeboxes.clear();
+		n.getCollisionBoxes(nodedef, &nodeboxes);
+		for (const aabb3f &box : nodeboxes)
+			cache->boxes.push_back({box, bouncy});
+	}
+	cache->shapes.push_back(cache->boxes.size());
+
+	return cache;
+}
+
 collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 		f32 pos_max_d, const aabb3f &box_0,
 		f32 stepheight, f32 dtime,
@@ -273,55 +332,95 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 
 	bool any_position_valid = false;
 
+	/*
+		Only the blocks overlapping the movement range are looked up.
+		Node boxes come from their collision caches; positions are still
+		visited in the same order, which decides between collisions that
+		happen at the same time.
+	*/
+	const NodeDefManager *nodedef = gamedef->getNodeDefManager();
+	v3s16 min_block = getNodeBlockPos(min);
+	v3s16 block_count = getNodeBlockPos(max) - min_block + v3s16(1, 1, 1);
+	std::vector<const BlockCollisionCache *> caches;
+	caches.reserve(block_count.X * block_count.Y * block_count.Z);
+	{
+		v3s16 bp;
+		for (bp.Z = 0; bp.Z < block_count.Z; bp.Z++)
+		for (bp.Y = 0; bp.Y < block_count.Y; bp.Y++)
+		for (bp.X = 0; bp.X < block_count.X; bp.X++) {
+			MapBlock *block = map->getBlockNoCreateNoEx(min_block + bp);
+			caches.push_back(block ? getBlockCollisionCache(block, nodedef) : NULL);
+		}
+	}
+
 	v3s16 p;
 	for (p.X = min.X; p.X <= max.X; p.X++)
 	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
 	for (p.Z = min.Z; p.Z <= max.Z; p.Z++) {
-		bool is_position_valid;
-		MapNode n = map->getNodeNoEx(p, &is_position_valid);
+		v3s16 bp, rel;
+		getNodeBlockPosWithOffset(p, bp, rel);
+		bp -= min_block;
+		const BlockCollisionCache *cache = caches[
+			(bp.Z * block_count.Y + bp.Y) * block_count.X + bp.X];
+		u32 i = rel.Z * MapBlock::zstride + rel.Y * MapBlock::ystride + rel.X;
 
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
-			// Object collides into walkable nodes
+		// Unloaded nodes collide like CONTENT_IGNORE
+		u16 kind = cache ? cache->nodes[i] : BlockCollisionCache::NODE_IGNORE;
 
-			any_position_valid = true;
-			const NodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
+		if (kind == BlockCollisionCache::NODE_IGNORE) {
+			// Collide with unloaded nodes (position invalid) and loaded
+			// CONTENT_IGNORE nodes (position valid)
+			aabb3f box = getNodeBox(p, BS);
+			cinfo.emplace_back(true, false, 0, p, box);
+			continue;
+		}
 
-			if (!f.walkable)
-				continue;
+		// Object collides into walkable nodes
+		any_position_valid = true;
 
+		if (kind >= BlockCollisionCache::NODE_SHAPE) {
+			u16 shape = kind - BlockCollisionCache::NODE_SHAPE;
+			v3f posf = intToFloat(p, BS);
+			for (u32 j = cache->shapes[shape]; j < cache->shapes[shape + 1]; j++) {
+				const BlockCollisionCache::Box &b = cache->boxes[j];
+				aabb3f box = b.box;
+				box.MinEdge += posf;
+				box.MaxEdge += posf;
+				cinfo.emplace_back(false, false, b.bouncy, p, box);
+			}
+		} else if (kind == BlockCollisionCache::NODE_CONNECTED) {
+			MapNode n = map->getNodeNoEx(p);
+			const ContentFeatures &f = nodedef->get(n);
 			int n_bouncy_value = itemgroup_get(f.groups, "bouncy");
 
 			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX &&
-				f.node_box.type == NODEBOX_CONNECTED) {
-				v3s16 p2 = p;
+			v3s16 p2 = p;
 
-				p2.Y++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
+			p2.Y++;
+			getNeighborConnectingFace(p2, nodedef, map, n, 1, &neighbors);
 
-				p2 = p;
-				p2.Y--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
+			p2 = p;
+			p2.Y--;
+			getNeighborConnectingFace(p2, nodedef, map, n, 2, &neighbors);
 
-				p2 = p;
-				p2.Z--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
+			p2 = p;
+			p2.Z--;
+			getNeighborConnectingFace(p2, nodedef, map, n, 4, &neighbors);
 
-				p2 = p;
-				p2.X--;
-				getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
+			p2 = p;
+			p2.X--;
+			getNeighborConnectingFace(p2, nodedef, map, n, 8, &neighbors);
 
-				p2 = p;
-				p2.Z++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+			p2 = p;
+			p2.Z++;
+			getNeighborConnectingFace(p2, nodedef, map, n, 16, &neighbors);
+
+			p2 = p;
+			p2.X++;
+			getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
 
-				p2 = p;
-				p2.X++;
-				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
-			}
 			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
+			n.getCollisionBoxes(nodedef, &nodeboxes, neighbors);
 
 			// Calculate float position only once
 			v3f posf = intToFloat(p, BS);
@@ -330,11 +429,6 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 				box.MaxEdge += posf;
 				cinfo.emplace_back(false, false, n_bouncy_value, p, box);
 			}
-		} else {
-			// Collide with unloaded nodes (position invalid) and loaded
-			// CONTENT_IGNORE nodes (position valid)
-			aabb3f box = getNodeBox(p, BS);
-			cinfo.emplace_back(true, false, 0, p, box);
 		}
 	}
 
@@ -21,11 +21,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "irrlichttypes_bloated.h"
 #include <vector>
+#include "constants.h"
 
 class Map;
+class MapBlock;
 class IGameDef;
 class Environment;
 class ActiveObject;
+class NodeDefManager;
 
 enum CollisionType
 {
@@ -44,6 +47,44 @@ struct CollisionInfo
 	int plane = -1;
 };
 
+/*
+	Collision boxes of the nodes of one MapBlock, so that collisionMoveSimple()
+	does not have to look up nodes and their definitions on every move.
+	Kept by the block and rebuilt after its nodes have changed.
+*/
+struct BlockCollisionCache
+{
+	// Values of nodes[] other than a shape
+	enum NodeKind : u16 {
+		// Loaded and not walkable
+		NODE_EMPTY,
+		// CONTENT_IGNORE, collides like an unloaded node
+		NODE_IGNORE,
+		// Connected node box, depends on the neighbors so is not cached
+		NODE_CONNECTED,
+		// Walkable, nodes[i] - NODE_SHAPE is the index of its shape
+		NODE_SHAPE,
+	};
+
+	struct Box
+	{
+		aabb3f box; // relative to the position of the node
+		int bouncy;
+	};
+
+	// Indexed like MapBlock data. Nodes with the same content and param2
+	// share a shape, so a block needs few boxes.
+	u16 nodes[MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE];
+	// The boxes of shape s are boxes[shapes[s]] to boxes[shapes[s + 1] - 1]
+	std::vector<u32> shapes;
+	std::vector<Box> boxes;
+};
+
+// Returns the collision cache of a block, building it if needed.
+// Returns NULL for dummy blocks.
+const BlockCollisionCache *getBlockCollisionCache(MapBlock *block,
+		const NodeDefManager *nodedef);
+
 struct collisionMoveResult
 {
 	collisionMoveResult() = default;
@@ -774,3 +774,154 @@ void AuthDatabaseSQLite3::writePrivileges(const AuthEntry &authEntry)
 		sqlite3_reset(m_stmt_write_privs);
 	}
 }
+
+/*
+ * Client block cache
+ */
+
+BlockCacheDatabaseSQLite3::BlockCacheDatabaseSQLite3(const std::string &savedir):
+	Database_SQLite3(savedir, "blocks")
+{
+}
+
+BlockCacheDatabaseSQLite3::~BlockCacheDatabaseSQLite3()
+{
+	FINALIZE_STATEMENT(m_stmt_read)
+	FINALIZE_STATEMENT(m_stmt_read_size)
+	FINALIZE_STATEMENT(m_stmt_write)
+	FINALIZE_STATEMENT(m_stmt_touch)
+	FINALIZE_STATEMENT(m_stmt_list)
+	FINALIZE_STATEMENT(m_stmt_total_size)
+	FINALIZE_STATEMENT(m_stmt_list_lru)
+	FINALIZE_STATEMENT(m_stmt_delete)
+}
+
+void BlockCacheDatabaseSQLite3::createDatabase()
+{
+	assert(m_database); // Pre-condition
+
+	SQLOK(sqlite3_exec(m_database,
+		"CREATE TABLE IF NOT EXISTS `blocks` (\n"
+			"	`pos` INT PRIMARY KEY,\n"
+			"	`hash` INT NOT NULL,\n"
+			"	`size` INT NOT NULL,\n"
+			"	`last_used` INT NOT NULL,\n"
+			"	`data` BLOB\n"
+			");\n"
+		"CREATE INDEX IF NOT EXISTS `blocks_last_used` ON `blocks` (`last_used`);\n",
+		NULL, NULL, NULL),
+		"Failed to create database table");
+}
+
+void BlockCacheDatabaseSQLite3::initStatements()
+{
+	PREPARE_STATEMENT(read, "SELECT `data` FROM `blocks` WHERE `pos` = ? LIMIT 1");
+	PREPARE_STATEMENT(read_size, "SELECT `size` FROM `blocks` WHERE `pos` = ? LIMIT 1");
+	PREPARE_STATEMENT(write, "REPLACE INTO `blocks` (`pos`, `hash`, `size`, "
+		"`last_used`, `data`) VALUES (?, ?, ?, ?, ?)");
+	PREPARE_STATEMENT(touch, "UPDATE `blocks` SET `last_used` = ? WHERE `pos` = ?");
+	PREPARE_STATEMENT(list, "SELECT `pos`, `hash` FROM `blocks`");
+	PREPARE_STATEMENT(total_size, "SELECT COALESCE(SUM(`size`), 0) FROM `blocks`");
+	PREPARE_STATEMENT(list_lru, "SELECT `pos`, `size` FROM `blocks` "
+		"ORDER BY `last_used` LIMIT ?");
+	PREPARE_STATEMENT(delete, "DELETE FROM `blocks` WHERE `pos` = ?");
+
+	verbosestream << "ClientBlockCache: SQLite3 database opened." << std::endl;
+}
+
+inline void BlockCacheDatabaseSQLite3::bindPos(sqlite3_stmt *stmt,
+	const v3s16 &pos, int index)
+{
+	SQLOK(sqlite3_bind_int64(stmt, index, MapDatabase::getBlockAsInteger(pos)),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+}
+
+u64 BlockCacheDatabaseSQLite3::saveBlock(const v3s16 &pos, u64 hash,
+	const std::string &data, s64 last_used)
+{
+	verifyDatabase();
+
+	u64 old_size = 0;
+	bindPos(m_stmt_read_size, pos);
+	if (sqlite3_step(m_stmt_read_size) == SQLITE_ROW)
+		old_size = sqlite_to_uint64(m_stmt_read_size, 0);
+	sqlite3_reset(m_stmt_read_size);
+
+	bindPos(m_stmt_write, pos);
+	int64_to_sqlite(m_stmt_write, 2, hash);
+	int64_to_sqlite(m_stmt_write, 3, data.size());
+	int64_to_sqlite(m_stmt_write, 4, last_used);
+	SQLOK(sqlite3_bind_blob(m_stmt_write, 5, data.data(), data.size(), NULL),
+		"Internal error: failed to bind query at " __FILE__ ":" TOSTRING(__LINE__));
+	SQLRES(sqlite3_step(m_stmt_write), SQLITE_DONE, "Failed to save block")
+	sqlite3_reset(m_stmt_write);
+
+	return old_size;
+}
+
+bool BlockCacheDatabaseSQLite3::loadBlock(const v3s16 &pos, std::string *data)
+{
+	verifyDatabase();
+	bindPos(m_stmt_read, pos);
+	if (sqlite3_step(m_stmt_read) != SQLITE_ROW) {
+		sqlite3_reset(m_stmt_read);
+		return false;
+	}
+
+	const char *blob = (const char *) sqlite3_column_blob(m_stmt_read, 0);
+	size_t len = sqlite3_column_bytes(m_stmt_read, 0);
+	*data = blob ? std::string(blob, len) : "";
+	sqlite3_reset(m_stmt_read);
+	return true;
+}
+
+void BlockCacheDatabaseSQLite3::touchBlock(const v3s16 &pos, s64 last_used)
+{
+	verifyDatabase();
+	int64_to_sqlite(m_stmt_touch, 1, last_used);
+	bindPos(m_stmt_touch, pos, 2);
+	SQLRES(sqlite3_step(m_stmt_touch), SQLITE_DONE, "Failed to touch block")
+	sqlite3_reset(m_stmt_touch);
+}
+
+void BlockCacheDatabaseSQLite3::listBlocks(std::vector<std::pair<v3s16, u64>> &dst)
+{
+	verifyDatabase();
+	while (sqlite3_step(m_stmt_list) == SQLITE_ROW) {
+		dst.emplace_back(
+			MapDatabase::getIntegerAsBlock(sqlite_to_int64(m_stmt_list, 0)),
+			sqlite_to_uint64(m_stmt_list, 1));
+	}
+	sqlite3_reset(m_stmt_list);
+}
+
+u64 BlockCacheDatabaseSQLite3::getTotalSize()
+{
+	verifyDatabase();
+	u64 size = 0;
+	if (sqlite3_step(m_stmt_total_size) == SQLITE_ROW)
+		size = sqlite_to_uint64(m_stmt_total_size, 0);
+	sqlite3_reset(m_stmt_total_size);
+	return size;
+}
+
+u64 BlockCacheDatabaseSQLite3::deleteLeastRecentlyUsed(u32 count)
+{
+	verifyDatabase();
+
+	std::vector<s64> positions;
+	u64 size = 0;
+	int_to_sqlite(m_stmt_list_lru, 1, count);
+	while (sqlite3_step(m_stmt_list_lru) == SQLITE_ROW) {
+		positions.push_back(sqlite_to_int64(m_stmt_list_lru, 0));
+		size += sqlite_to_uint64(m_stmt_list_lru, 1);
+	}
+	sqlite3_reset(m_stmt_list_lru);
+
+	for (s64 pos : positions) {
+		int64_to_sqlite(m_stmt_delete, 1, pos);
+		SQLRES(sqlite3_step(m_stmt_delete), SQLITE_DONE, "Failed to delete block")
+		sqlite3_reset(m_stmt_delete);
+	}
+	return size;
+}
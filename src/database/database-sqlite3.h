@@ -232,3 +232,42 @@ class AuthDatabaseSQLite3 : private Database_SQLite3, public AuthDatabase
 	sqlite3_stmt *m_stmt_delete_privs = nullptr;
 	sqlite3_stmt *m_stmt_last_insert_rowid = nullptr;
 };
+
+/*
+	Blocks received from a server, kept by the client, see ClientBlockCache
+*/
+class BlockCacheDatabaseSQLite3 : private Database_SQLite3
+{
+public:
+	BlockCacheDatabaseSQLite3(const std::string &savedir);
+	virtual ~BlockCacheDatabaseSQLite3();
+
+	// Returns the size of the data the block had before, or 0
+	u64 saveBlock(const v3s16 &pos, u64 hash, const std::string &data,
+			s64 last_used);
+	bool loadBlock(const v3s16 &pos, std::string *data);
+	void touchBlock(const v3s16 &pos, s64 last_used);
+	// Lists the positions and hashes of all blocks
+	void listBlocks(std::vector<std::pair<v3s16, u64>> &dst);
+	u64 getTotalSize();
+	// Deletes the 'count' least recently used blocks, returns their size
+	u64 deleteLeastRecentlyUsed(u32 count);
+
+	void beginSave() { Database_SQLite3::beginSave(); }
+	void endSave() { Database_SQLite3::endSave(); }
+protected:
+	virtual void createDatabase();
+	virtual void initStatements();
+
+private:
+	void bindPos(sqlite3_stmt *stmt, const v3s16 &pos, int index = 1);
+
+	sqlite3_stmt *m_stmt_read = nullptr;
+	sqlite3_stmt *m_stmt_read_size = nullptr;
+	sqlite3_stmt *m_stmt_write = nullptr;
+	sqlite3_stmt *m_stmt_touch = nullptr;
+	sqlite3_stmt *m_stmt_list = nullptr;
+	sqlite3_stmt *m_stmt_total_size = nullptr;
+	sqlite3_stmt *m_stmt_list_lru = nullptr;
+	sqlite3_stmt *m_stmt_delete = nullptr;
+};
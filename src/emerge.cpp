@@ -23,10 +23,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <iostream>
 #include <queue>
+#include <sstream>
 
 #include "util/container.h"
 #include "util/thread.h"
 #include "threading/event.h"
+#include "threading/task_pool.h"
 
 #include "config.h"
 #include "constants.h"
@@ -81,6 +83,7 @@ class EmergeThread : public Thread {
 		const v3s16 &pos, bool allow_gen, MapBlock **block, BlockMakeData *data);
 	MapBlock *finishGen(v3s16 pos, BlockMakeData *bmdata,
 		std::map<v3s16, MapBlock *> *modified_blocks);
+	void profileMapgenStages();
 
 	friend class EmergeManager;
 };
@@ -153,7 +156,12 @@ EmergeManager::EmergeManager(Server *server)
 	for (s16 i = 0; i < nthreads; i++)
 		m_threads.push_back(new EmergeThread(server, i));
 
-	infostream << "EmergeManager: using " << nthreads << " threads" << std::endl;
+	u16 ntask_threads = g_settings->getU16("num_mapgen_task_threads");
+	if (ntask_threads > 0)
+		m_task_pool = new TaskPool("MapgenTask", ntask_threads);
+
+	infostream << "EmergeManager: using " << nthreads << " threads and "
+		<< ntask_threads << " mapgen task threads" << std::endl;
 }
 
 
@@ -175,6 +183,8 @@ EmergeManager::~EmergeManager()
 			delete m_mapgens[i];
 	}
 
+	delete m_task_pool;
+
 	delete biomemgr;
 	delete oremgr;
 	delete decomgr;
@@ -548,6 +558,26 @@ EmergeAction EmergeThread::getBlockOrStartGen(
 }
 
 
+void EmergeThread::profileMapgenStages()
+{
+	for (int i = 0; i != MGSTAGE_COUNT; i++) {
+		g_profiler->avg(std::string("EmergeThread: mapgen stage ") +
+			Mapgen::getStageName((MapgenStage)i),
+			m_mapgen->stage_times[i] / 1000.0f);
+	}
+
+	if (!enable_mapgen_debug_info)
+		return;
+
+	std::ostringstream os;
+	for (int i = 0; i != MGSTAGE_COUNT; i++) {
+		os << " " << Mapgen::getStageName((MapgenStage)i) << "="
+			<< m_mapgen->stage_times[i] << "us";
+	}
+	infostream << "EmergeThread: makeChunk stages:" << os.str() << std::endl;
+}
+
+
 MapBlock *EmergeThread::finishGen(v3s16 pos, BlockMakeData *bmdata,
 	std::map<v3s16, MapBlock *> *modified_blocks)
 {
@@ -615,6 +645,7 @@ void *EmergeThread::run()
 	m_emerge = m_server->m_emerge;
 	m_mapgen = m_emerge->m_mapgens[id];
 	enable_mapgen_debug_info = m_emerge->enable_mapgen_debug_info;
+	TaskPool::setCurrent(m_emerge->m_task_pool);
 
 	try {
 	while (!stopRequested()) {
@@ -648,6 +679,8 @@ void *EmergeThread::run()
 					t.stop(true); // Hide output
 			}
 
+			profileMapgenStages();
+
 			block = finishGen(pos, &bmdata, &modified_blocks);
 		}
 
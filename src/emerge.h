@@ -44,6 +44,7 @@ class OreManager;
 class DecorationManager;
 class SchematicManager;
 class Server;
+class TaskPool;
 
 // Structure containing inputs/outputs for chunk generation
 struct BlockMakeData {
@@ -152,6 +153,9 @@ class EmergeManager {
 	std::vector<EmergeThread *> m_threads;
 	bool m_threads_active = false;
 
+	// Helper threads for the work inside one chunk, shared by all mapgens
+	TaskPool *m_task_pool = nullptr;
+
 	std::mutex m_queue_mutex;
 	std::map<v3s16, BlockEmergeData> m_blocks_enqueued;
 	std::unordered_map<u16, u16> m_peer_queue_count;
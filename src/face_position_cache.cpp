@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "face_position_cache.h"
+#include <algorithm>
 #include "threading/mutex_auto_lock.h"
 
 
@@ -106,5 +107,12 @@ const std::vector<v3s16> &FacePositionCache::generateFacePosition(u16 d)
 		c.emplace_back(x, -d, z);
 		c.emplace_back(x, d, z);
 	}
+
+	// Nearest first, so the blocks around the player are selected before
+	// the corners of the shell. Keeps the above y ordering for ties.
+	std::stable_sort(c.begin(), c.end(), [] (const v3s16 &a, const v3s16 &b) {
+		return a.X * a.X + a.Y * a.Y + a.Z * a.Z <
+			b.X * b.X + b.Y * b.Y + b.Z * b.Z;
+	});
 	return c;
 }
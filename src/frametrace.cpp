@@ -0,0 +1,99 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "frametrace.h"
+#include <fstream>
+#include "util/serialize.h"
+
+static FrameTracer main_frame_tracer;
+FrameTracer *g_frame_tracer = &main_frame_tracer;
+
+FrameTracer::FrameTracer(size_t capacity) :
+	m_events(capacity)
+{
+}
+
+void FrameTracer::start()
+{
+	m_thread = std::this_thread::get_id();
+	m_recording = true;
+}
+
+void FrameTracer::stop()
+{
+	m_recording = false;
+}
+
+void FrameTracer::clear()
+{
+	m_head = 0;
+	m_count = 0;
+}
+
+void FrameTracer::beginFrame()
+{
+	m_frame_start_us = porting::getTimeUs();
+}
+
+u64 FrameTracer::endFrame()
+{
+	u64 end_us = porting::getTimeUs();
+	if (isRecording())
+		addEvent("frame", m_frame_start_us, end_us);
+	return end_us - m_frame_start_us;
+}
+
+void FrameTracer::addEvent(const char *name, u64 start_us, u64 end_us)
+{
+	if (m_events.empty())
+		return;
+
+	Event &e = m_events[m_head];
+	e.name = name;
+	e.start_us = start_us;
+	e.duration_us = end_us - start_us;
+
+	m_head = (m_head + 1) % m_events.size();
+	if (m_count < m_events.size())
+		m_count++;
+}
+
+void FrameTracer::writeChromeTrace(std::ostream &os) const
+{
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	size_t size = m_events.size();
+	for (size_t i = 0; i < m_count; i++) {
+		const Event &e = m_events[(m_head + size - m_count + i) % size];
+		if (i > 0)
+			os << ",";
+		os << "\n{\"name\":" << serializeJsonString(e.name)
+			<< ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << e.start_us
+			<< ",\"dur\":" << e.duration_us << "}";
+	}
+	os << "\n]}\n";
+}
+
+bool FrameTracer::writeChromeTrace(const std::string &path) const
+{
+	std::ofstream os(path.c_str(), std::ios::binary);
+	if (!os.good())
+		return false;
+	writeChromeTrace(os);
+	return os.good();
+}
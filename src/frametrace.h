@@ -0,0 +1,112 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "porting.h"
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Global frame tracer
+class FrameTracer;
+extern FrameTracer *g_frame_tracer;
+
+/*
+	Records how long the parts of each frame take.
+
+	Events are kept in a ring buffer, so the last frames before a hitch
+	can be written out after it happened. Only the thread that called
+	start() records; scopes on other threads cost one comparison.
+	The output is in the Chrome trace event format, which can be opened
+	in chrome://tracing or other trace viewers.
+*/
+class FrameTracer
+{
+public:
+	FrameTracer(size_t capacity = 65536);
+
+	void start();
+	void stop();
+	void clear();
+
+	bool isRecording() const
+	{
+		return m_recording && std::this_thread::get_id() == m_thread;
+	}
+
+	void beginFrame();
+	// Returns the duration of the frame in microseconds
+	u64 endFrame();
+
+	// 'name' must outlive the tracer, usually it is a string literal
+	void addEvent(const char *name, u64 start_us, u64 end_us);
+
+	size_t getEventCount() const { return m_count; }
+
+	// Writes the recorded events, oldest first
+	void writeChromeTrace(std::ostream &os) const;
+	bool writeChromeTrace(const std::string &path) const;
+
+private:
+	struct Event
+	{
+		const char *name;
+		u64 start_us;
+		u64 duration_us;
+	};
+
+	std::vector<Event> m_events;
+	// Index of the next event to write
+	size_t m_head = 0;
+	size_t m_count = 0;
+
+	bool m_recording = false;
+	std::thread::id m_thread;
+	u64 m_frame_start_us = 0;
+};
+
+/*
+	Records the time until the end of the scope as one event.
+*/
+class FrameTraceScope
+{
+public:
+	FrameTraceScope(FrameTracer *tracer, const char *name) :
+		m_name(name)
+	{
+		if (tracer && tracer->isRecording()) {
+			m_tracer = tracer;
+			m_start_us = porting::getTimeUs();
+		}
+	}
+
+	~FrameTraceScope()
+	{
+		if (m_tracer)
+			m_tracer->addEvent(m_name, m_start_us, porting::getTimeUs());
+	}
+
+private:
+	FrameTracer *m_tracer = nullptr;
+	const char *m_name;
+	u64 m_start_us = 0;
+};
@@ -0,0 +1,656 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "bot.h"
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include "constants.h"
+#include "log.h"
+#include "mapblock.h"
+#include "porting.h"
+#include "serialization.h"
+#include "version.h"
+#include "network/connection.h"
+#include "network/networkpacket.h"
+#include "util/auth.h"
+#include "util/pointedthing.h"
+#include "util/srp.h"
+#include "util/string.h"
+
+/*
+	Channel and reliability used by the real client for each command,
+	see serverCommandFactoryTable in clientopcodes.cpp
+*/
+static void get_send_params(u16 command, u8 *channel, bool *reliable)
+{
+	switch (command) {
+	case TOSERVER_INIT:
+		*channel = 1;
+		*reliable = false;
+		return;
+	case TOSERVER_INIT2:
+	case TOSERVER_REMOVED_SOUNDS:
+	case TOSERVER_REQUEST_MEDIA:
+	case TOSERVER_FIRST_SRP:
+	case TOSERVER_SRP_BYTES_A:
+	case TOSERVER_SRP_BYTES_M:
+		*channel = 1;
+		*reliable = true;
+		return;
+	case TOSERVER_PLAYERPOS:
+		*channel = 0;
+		*reliable = false;
+		return;
+	case TOSERVER_GOTBLOCKS:
+	case TOSERVER_DELETEDBLOCKS:
+		*channel = 2;
+		*reliable = true;
+		return;
+	default:
+		*channel = 0;
+		*reliable = true;
+		return;
+	}
+}
+
+/*
+	Commands which are part of the login sequence or depend on the blocks
+	the original client had. The bot generates these itself when replaying.
+*/
+static bool is_replay_skipped(u16 command)
+{
+	switch (command) {
+	case TOSERVER_INIT:
+	case TOSERVER_INIT2:
+	case TOSERVER_FIRST_SRP:
+	case TOSERVER_SRP_BYTES_A:
+	case TOSERVER_SRP_BYTES_M:
+	case TOSERVER_REQUEST_MEDIA:
+	case TOSERVER_CLIENT_READY:
+	case TOSERVER_GOTBLOCKS:
+	case TOSERVER_DELETEDBLOCKS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void LoadBotStats::add(const LoadBotStats &other)
+{
+	bytes_received += other.bytes_received;
+	packets_received += other.packets_received;
+	blocks_received += other.blocks_received;
+	block_latency_samples += other.block_latency_samples;
+	block_latency_sum += other.block_latency_sum;
+	block_latency_max = MYMAX(block_latency_max, other.block_latency_max);
+}
+
+LoadBot::LoadBot(const std::string &name, const LoadBotParams &params, u32 seed) :
+	m_name(name),
+	m_params(params),
+	m_rand(seed)
+{
+}
+
+LoadBot::~LoadBot()
+{
+	disconnect();
+	deleteAuthData();
+}
+
+void LoadBot::connect(const Address &address)
+{
+	m_con = std::unique_ptr<con::Connection>(new con::Connection(PROTOCOL_ID,
+			512, CONNECTION_TIMEOUT, address.isIPv6(), this));
+	m_con->SetTimeoutMs(0);
+	m_con->Connect(address);
+
+	m_connect_time_ms = porting::getTimeMs();
+	m_state = LOADBOT_CONNECTING;
+	m_init_timer = 0.0f;
+}
+
+void LoadBot::disconnect()
+{
+	if (!m_con)
+		return;
+
+	m_con->Disconnect();
+	m_con.reset();
+	m_state = LOADBOT_DISCONNECTED;
+}
+
+void LoadBot::step(float dtime)
+{
+	if (!m_con || m_state == LOADBOT_DISCONNECTED)
+		return;
+
+	receiveAll();
+
+	if (m_state == LOADBOT_CONNECTING) {
+		// TOSERVER_INIT is unreliable, repeat it like Client::step does
+		m_init_timer -= dtime;
+		if (m_init_timer <= 0.0f) {
+			m_init_timer = 2.0f;
+			sendInit();
+		}
+		return;
+	}
+
+	if (m_state != LOADBOT_ACTIVE)
+		return;
+
+	if (!m_replay.empty()) {
+		stepReplay();
+	} else {
+		stepMovement(dtime);
+		stepInteract(dtime);
+	}
+
+	m_send_timer += dtime;
+	if (m_send_timer >= m_send_interval) {
+		m_send_timer = 0.0f;
+		if (m_replay.empty())
+			sendPlayerPos();
+	}
+
+	sendGotBlocks();
+}
+
+void LoadBot::setReplay(const std::vector<CapturedPacket> &packets)
+{
+	m_replay.clear();
+	for (const CapturedPacket &cp : packets) {
+		if (!is_replay_skipped(cp.command))
+			m_replay.push_back(cp);
+	}
+	m_replay_next = 0;
+}
+
+bool LoadBot::isReplayDone() const
+{
+	return m_replay_next >= m_replay.size();
+}
+
+void LoadBot::requestServerStatus()
+{
+	if (m_state != LOADBOT_ACTIVE)
+		return;
+
+	NetworkPacket pkt(TOSERVER_CHAT_MESSAGE, 0);
+	pkt << std::wstring(L"/status");
+	send(&pkt);
+}
+
+LoadBotStats LoadBot::takeStats()
+{
+	LoadBotStats stats = m_stats;
+	m_stats = LoadBotStats();
+	return stats;
+}
+
+void LoadBot::peerAdded(con::Peer *peer)
+{
+}
+
+void LoadBot::deletingPeer(con::Peer *peer, bool timeout)
+{
+	if (timeout && m_deny_reason.empty())
+		m_deny_reason = "Connection timed out";
+	m_state = LOADBOT_DISCONNECTED;
+}
+
+void LoadBot::receiveAll()
+{
+	u64 start_ms = porting::getTimeMs();
+	for (;;) {
+		// Don't let a single bot starve the others
+		if (porting::getTimeMs() > start_ms + 20)
+			break;
+
+		NetworkPacket pkt;
+		try {
+			m_con->Receive(&pkt);
+		} catch (con::NoIncomingDataException &e) {
+			break;
+		} catch (con::InvalidIncomingDataException &e) {
+			infostream << "LoadBot(" << m_name << "): "
+					<< "InvalidIncomingDataException: what()="
+					<< e.what() << std::endl;
+			continue;
+		}
+
+		try {
+			processPacket(&pkt);
+		} catch (PacketError &e) {
+			infostream << "LoadBot(" << m_name << "): malformed packet "
+					<< pkt.getCommand() << ": " << e.what() << std::endl;
+		}
+
+		if (m_state == LOADBOT_DISCONNECTED)
+			break;
+	}
+}
+
+void LoadBot::processPacket(NetworkPacket *pkt)
+{
+	m_stats.packets_received++;
+	m_stats.bytes_received += 2 + pkt->getSize();
+
+	switch (pkt->getCommand()) {
+	case TOCLIENT_HELLO:
+		handleHello(pkt);
+		break;
+	case TOCLIENT_SRP_BYTES_S_B:
+		handleSrpBytesSandB(pkt);
+		break;
+	case TOCLIENT_AUTH_ACCEPT:
+		handleAuthAccept(pkt);
+		break;
+	case TOCLIENT_ACCESS_DENIED:
+	case TOCLIENT_ACCESS_DENIED_LEGACY:
+		handleAccessDenied(pkt);
+		break;
+	case TOCLIENT_ANNOUNCE_MEDIA:
+		handleAnnounceMedia(pkt);
+		break;
+	case TOCLIENT_BLOCKDATA:
+		handleBlockData(pkt);
+		break;
+	case TOCLIENT_MOVE_PLAYER:
+		handleMovePlayer(pkt);
+		break;
+	case TOCLIENT_CHAT_MESSAGE:
+		handleChatMessage(pkt);
+		break;
+	default:
+		// Everything else is only counted
+		break;
+	}
+}
+
+void LoadBot::send(NetworkPacket *pkt)
+{
+	u8 channel;
+	bool reliable;
+	get_send_params(pkt->getCommand(), &channel, &reliable);
+	m_con->Send(PEER_ID_SERVER, channel, pkt, reliable);
+}
+
+void LoadBot::handleHello(NetworkPacket *pkt)
+{
+	u8 serialization_ver;
+	u16 proto_ver;
+	u16 compression_mode;
+	u32 auth_mechs;
+	std::string username_legacy;
+	*pkt >> serialization_ver >> compression_mode >> proto_ver
+		>> auth_mechs >> username_legacy;
+
+	deleteAuthData();
+	m_state = LOADBOT_AUTHENTICATING;
+
+	if (auth_mechs & AUTH_MECHANISM_SRP) {
+		std::string playername_u = lowercase(m_name);
+		m_auth_data = srp_user_new(SRP_SHA256, SRP_NG_2048,
+			m_name.c_str(), playername_u.c_str(),
+			(const unsigned char *) m_params.password.c_str(),
+			m_params.password.length(), NULL, NULL);
+		char *bytes_A = 0;
+		size_t len_A = 0;
+		SRP_Result res = srp_user_start_authentication(m_auth_data,
+			NULL, NULL, 0, (unsigned char **) &bytes_A, &len_A);
+		if (res != SRP_OK) {
+			m_deny_reason = "Creating local SRP user failed";
+			disconnect();
+			return;
+		}
+
+		NetworkPacket resp_pkt(TOSERVER_SRP_BYTES_A, 0);
+		resp_pkt << std::string(bytes_A, len_A) << (u8) 1;
+		send(&resp_pkt);
+	} else if (auth_mechs & AUTH_MECHANISM_FIRST_SRP) {
+		// New account: register it with the configured password
+		std::string verifier;
+		std::string salt;
+		generate_srp_verifier_and_salt(m_name, m_params.password,
+			&verifier, &salt);
+
+		NetworkPacket resp_pkt(TOSERVER_FIRST_SRP, 0);
+		resp_pkt << salt << verifier
+			<< (u8)(m_params.password.empty() ? 1 : 0);
+		send(&resp_pkt);
+	} else {
+		m_deny_reason = "No supported authentication mechanism";
+		disconnect();
+	}
+}
+
+void LoadBot::handleSrpBytesSandB(NetworkPacket *pkt)
+{
+	if (!m_auth_data)
+		return;
+
+	std::string s;
+	std::string B;
+	*pkt >> s >> B;
+
+	char *bytes_M = 0;
+	size_t len_M = 0;
+	srp_user_process_challenge(m_auth_data,
+		(const unsigned char *) s.c_str(), s.size(),
+		(const unsigned char *) B.c_str(), B.size(),
+		(unsigned char **) &bytes_M, &len_M);
+
+	if (!bytes_M) {
+		m_deny_reason = "SRP-6a S_B safety check violation";
+		disconnect();
+		return;
+	}
+
+	NetworkPacket resp_pkt(TOSERVER_SRP_BYTES_M, 0);
+	resp_pkt << std::string(bytes_M, len_M);
+	send(&resp_pkt);
+}
+
+void LoadBot::handleAuthAccept(NetworkPacket *pkt)
+{
+	deleteAuthData();
+
+	v3f playerpos;
+	u64 map_seed;
+	*pkt >> playerpos >> map_seed >> m_send_interval;
+	m_send_interval = MYMAX(m_send_interval, 0.05f);
+
+	m_position = playerpos - v3f(0, BS / 2, 0);
+	m_spawn_position = m_position;
+	m_yaw = m_rand.range(0, 359);
+
+	NetworkPacket resp_pkt(TOSERVER_INIT2, sizeof(u16));
+	resp_pkt << std::string();
+	send(&resp_pkt);
+
+	m_state = LOADBOT_LOADING;
+}
+
+void LoadBot::handleAccessDenied(NetworkPacket *pkt)
+{
+	m_deny_reason = "Unknown";
+
+	if (pkt->getCommand() == TOCLIENT_ACCESS_DENIED && pkt->getSize() >= 1) {
+		u8 code;
+		*pkt >> code;
+		if (code < SERVER_ACCESSDENIED_MAX)
+			m_deny_reason = accessDeniedStrings[code];
+		if (code == SERVER_ACCESSDENIED_CUSTOM_STRING && pkt->getRemainingBytes() >= 2)
+			*pkt >> m_deny_reason;
+	}
+
+	disconnect();
+}
+
+void LoadBot::handleAnnounceMedia(NetworkPacket *pkt)
+{
+	if (m_state != LOADBOT_LOADING)
+		return;
+
+	// Media is skipped entirely, tell the server we are ready right away
+	const char *hash = g_version_hash;
+	NetworkPacket resp_pkt(TOSERVER_CLIENT_READY,
+			1 + 1 + 1 + 1 + 2 + strlen(hash));
+	resp_pkt << (u8) VERSION_MAJOR << (u8) VERSION_MINOR << (u8) VERSION_PATCH
+		<< (u8) 0 << (u16) strlen(hash);
+	resp_pkt.putRawString(hash, (u16) strlen(hash));
+	send(&resp_pkt);
+
+	m_state = LOADBOT_ACTIVE;
+	m_join_time = (porting::getTimeMs() - m_connect_time_ms) / 1000.0f;
+	m_replay_start_ms = porting::getTimeMs();
+
+	m_current_block = getNodeBlockPos(floatToInt(m_position, BS));
+	m_current_block_since_ms = porting::getTimeMs();
+	m_current_block_received = false;
+}
+
+void LoadBot::handleBlockData(NetworkPacket *pkt)
+{
+	v3s16 p;
+	*pkt >> p;
+
+	m_stats.blocks_received++;
+	m_got_blocks.push_back(p);
+
+	if (!m_current_block_received && p == m_current_block) {
+		float latency = (porting::getTimeMs() - m_current_block_since_ms) / 1000.0f;
+		m_stats.block_latency_samples++;
+		m_stats.block_latency_sum += latency;
+		m_stats.block_latency_max = MYMAX(m_stats.block_latency_max, latency);
+		m_current_block_received = true;
+	}
+}
+
+void LoadBot::handleMovePlayer(NetworkPacket *pkt)
+{
+	// Server rejected our movement (or teleported us)
+	*pkt >> m_position >> m_pitch >> m_yaw;
+	m_spawn_position = m_position;
+	m_position_dirty = true;
+	updateCurrentBlock();
+}
+
+void LoadBot::handleChatMessage(NetworkPacket *pkt)
+{
+	u8 version, message_type;
+	std::wstring sender, message;
+	*pkt >> version >> message_type >> sender >> message;
+
+	// Answer to /status, see Server::getStatusString
+	std::string text = wide_to_utf8(message);
+	size_t pos = text.find("max_lag=");
+	if (pos == std::string::npos)
+		return;
+
+	// Anyone can send a chat message containing "max_lag="
+	const char *start = text.c_str() + pos + 8;
+	char *end;
+	float max_lag = strtof(start, &end);
+	if (end != start)
+		m_server_max_lag = max_lag;
+}
+
+void LoadBot::stepMovement(float dtime)
+{
+	m_move_time += dtime;
+	const float speed = m_params.speed * BS;
+
+	switch (m_params.movement) {
+	case LOADBOT_MOVE_IDLE:
+		m_speed = v3f(0, 0, 0);
+		return;
+	case LOADBOT_MOVE_WALK: {
+		// Pick a new direction every few seconds, stay near the spawn
+		m_turn_timer -= dtime;
+		if (m_turn_timer <= 0.0f) {
+			m_turn_timer = 2.0f + m_rand.range(0, 30) / 10.0f;
+			v3f to_spawn = m_spawn_position - m_position;
+			if (to_spawn.getLength() > 64 * BS)
+				m_yaw = atan2(-to_spawn.X, to_spawn.Z) * core::RADTODEG;
+			else
+				m_yaw = m_rand.range(0, 359);
+		}
+		break;
+	}
+	case LOADBOT_MOVE_CIRCLE: {
+		const float radius = 16 * BS;
+		float angle = m_move_time * speed / radius;
+		v3f target = m_spawn_position +
+			v3f(std::cos(angle) * radius, 0, std::sin(angle) * radius);
+		m_yaw = atan2(-(target.X - m_position.X),
+			target.Z - m_position.Z) * core::RADTODEG;
+		break;
+	}
+	case LOADBOT_MOVE_LINE:
+		break;
+	}
+
+	// Yaw 0 faces +Z, same convention as the client camera
+	float yaw_rad = m_yaw * core::DEGTORAD;
+	m_speed = v3f(-std::sin(yaw_rad), 0, std::cos(yaw_rad)) * speed;
+	m_position += m_speed * dtime;
+	m_position_dirty = true;
+	updateCurrentBlock();
+}
+
+void LoadBot::stepInteract(float dtime)
+{
+	if (m_params.interact_interval <= 0.0f)
+		return;
+
+	m_interact_timer += dtime;
+
+	if (m_digging && m_interact_timer >= 0.5f) {
+		// Finish digging, then put a node back into the hole
+		v3s16 above = m_dig_pos + v3s16(0, 1, 0);
+		sendInteract(2, m_dig_pos, above);
+		sendInteract(3, m_dig_pos + v3s16(0, -1, 0), m_dig_pos);
+		m_digging = false;
+		return;
+	}
+
+	if (m_interact_timer < m_params.interact_interval)
+		return;
+
+	m_interact_timer = 0.0f;
+	// Dig next to the feet, well within the server's reach limit
+	m_dig_pos = floatToInt(m_position, BS) + v3s16(
+			m_rand.range(-2, 2), -1, m_rand.range(-2, 2));
+	sendInteract(0, m_dig_pos, m_dig_pos + v3s16(0, 1, 0));
+	m_digging = true;
+}
+
+void LoadBot::stepReplay()
+{
+	u64 elapsed = porting::getTimeMs() - m_replay_start_ms;
+	u32 base_ms = m_replay.empty() ? 0 : m_replay.front().time_ms;
+
+	while (m_replay_next < m_replay.size()) {
+		const CapturedPacket &cp = m_replay[m_replay_next];
+		if (cp.time_ms - base_ms > elapsed)
+			break;
+
+		NetworkPacket pkt;
+		cp.toNetworkPacket(&pkt, PEER_ID_SERVER);
+
+		if (cp.command == TOSERVER_PLAYERPOS && pkt.getSize() >= 12) {
+			// Keep track of the position for the latency statistics
+			v3s32 ps;
+			pkt >> ps;
+			m_position = v3f(ps.X, ps.Y, ps.Z) / 100.0f;
+			updateCurrentBlock();
+		}
+
+		send(&pkt);
+		m_replay_next++;
+	}
+}
+
+void LoadBot::sendInit()
+{
+	// Same as Client::sendInit
+	NetworkPacket pkt(TOSERVER_INIT, 1 + 2 + 2 + (1 + m_name.size()));
+	pkt << (u8) SER_FMT_VER_HIGHEST_READ << (u16) NETPROTO_COMPRESSION_NONE;
+	pkt << (u16) CLIENT_PROTOCOL_VERSION_MIN << (u16) CLIENT_PROTOCOL_VERSION_MAX;
+	pkt << m_name;
+	send(&pkt);
+}
+
+void LoadBot::sendPlayerPos()
+{
+	if (!m_position_dirty)
+		return;
+	m_position_dirty = false;
+
+	// Same format as writePlayerPos() in client.cpp
+	NetworkPacket pkt(TOSERVER_PLAYERPOS, 12 + 12 + 4 + 4 + 4 + 1 + 1);
+	v3f pf = m_position * 100;
+	v3f sf = m_speed * 100;
+	pkt << v3s32(pf.X, pf.Y, pf.Z) << v3s32(sf.X, sf.Y, sf.Z);
+	pkt << (s32)(m_pitch * 100) << (s32)(m_yaw * 100) << (u32) 0;
+	pkt << (u8)(72.0f * core::DEGTORAD * 80)
+		<< (u8) MYMIN(255, std::ceil(m_params.wanted_range / (float) MAP_BLOCKSIZE));
+	send(&pkt);
+}
+
+void LoadBot::sendInteract(u8 action, v3s16 under, v3s16 above)
+{
+	PointedThing pointed(under, above, under, intToFloat(under, BS),
+		above - under, 0, 0.0f);
+
+	NetworkPacket pkt(TOSERVER_INTERACT, 1 + 2 + 0);
+	pkt << action << (u16) 0;
+
+	std::ostringstream tmp_os(std::ios::binary);
+	pointed.serialize(tmp_os);
+	pkt.putLongString(tmp_os.str());
+
+	v3f pf = m_position * 100;
+	v3f sf = m_speed * 100;
+	pkt << v3s32(pf.X, pf.Y, pf.Z) << v3s32(sf.X, sf.Y, sf.Z);
+	pkt << (s32)(m_pitch * 100) << (s32)(m_yaw * 100) << (u32) 0;
+	pkt << (u8)(72.0f * core::DEGTORAD * 80)
+		<< (u8) MYMIN(255, std::ceil(m_params.wanted_range / (float) MAP_BLOCKSIZE));
+	send(&pkt);
+}
+
+void LoadBot::sendGotBlocks()
+{
+	// Without this the server stops sending once its in-flight limit is hit
+	size_t start = 0;
+	while (start < m_got_blocks.size()) {
+		size_t count = MYMIN(m_got_blocks.size() - start, (size_t) 255);
+		NetworkPacket pkt(TOSERVER_GOTBLOCKS, 1 + 6 * count);
+		pkt << (u8) count;
+		for (size_t i = start; i < start + count; i++)
+			pkt << m_got_blocks[i];
+		send(&pkt);
+		start += count;
+	}
+	m_got_blocks.clear();
+}
+
+void LoadBot::updateCurrentBlock()
+{
+	v3s16 block = getNodeBlockPos(floatToInt(m_position, BS));
+	if (block == m_current_block)
+		return;
+
+	m_current_block = block;
+	m_current_block_since_ms = porting::getTimeMs();
+	m_current_block_received = false;
+}
+
+void LoadBot::deleteAuthData()
+{
+	if (!m_auth_data)
+		return;
+
+	srp_user_delete(m_auth_data);
+	m_auth_data = nullptr;
+}
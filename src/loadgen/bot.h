@@ -0,0 +1,189 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "irrlichttypes_bloated.h"
+#include "network/address.h"
+#include "network/networkprotocol.h"
+#include "network/packetcapture.h"
+#include "network/peerhandler.h"
+#include "noise.h"
+
+class NetworkPacket;
+struct SRPUser;
+
+namespace con {
+class Connection;
+}
+
+enum LoadBotState
+{
+	LOADBOT_CREATED,
+	LOADBOT_CONNECTING,
+	LOADBOT_AUTHENTICATING,
+	LOADBOT_LOADING,
+	LOADBOT_ACTIVE,
+	LOADBOT_DISCONNECTED,
+};
+
+enum LoadBotMovement
+{
+	LOADBOT_MOVE_IDLE,
+	LOADBOT_MOVE_WALK,   // random walk around the spawn point
+	LOADBOT_MOVE_CIRCLE, // circles around the spawn point
+	LOADBOT_MOVE_LINE,   // walks straight away, forces new terrain
+};
+
+struct LoadBotParams
+{
+	std::string password;
+	LoadBotMovement movement = LOADBOT_MOVE_WALK;
+	// Walking speed in nodes per second
+	float speed = 4.0f;
+	// Dig and place a node every interact_interval seconds, 0 = never
+	float interact_interval = 0.0f;
+	// Requested view range in nodes, sent with each position update
+	u16 wanted_range = 100;
+};
+
+struct LoadBotStats
+{
+	u64 bytes_received = 0;
+	u32 packets_received = 0;
+	u32 blocks_received = 0;
+
+	// Delay between entering a mapblock and receiving it from the server
+	u32 block_latency_samples = 0;
+	float block_latency_sum = 0.0f;
+	float block_latency_max = 0.0f;
+
+	void add(const LoadBotStats &other);
+};
+
+/*
+	A headless client that speaks the real network protocol: handshake,
+	SRP authentication, media skipping, movement and node interaction.
+	Packets can also be replayed from a server-side packet capture.
+
+	All methods must be called from the same thread; network I/O runs in
+	the connection threads.
+*/
+class LoadBot : public con::PeerHandler
+{
+public:
+	LoadBot(const std::string &name, const LoadBotParams &params, u32 seed);
+	~LoadBot();
+
+	void connect(const Address &address);
+	void disconnect();
+
+	void step(float dtime);
+
+	// Replays the given post-login packets instead of generating movement
+	void setReplay(const std::vector<CapturedPacket> &packets);
+	bool isReplayDone() const;
+
+	// Sends /status to the server, the answer updates getServerMaxLag()
+	void requestServerStatus();
+
+	LoadBotState getState() const { return m_state; }
+	const std::string &getName() const { return m_name; }
+	const std::string &getDenyReason() const { return m_deny_reason; }
+	// Time between connect() and the server accepting TOSERVER_CLIENT_READY
+	float getJoinTime() const { return m_join_time; }
+	// Last "max_lag" value reported by the server, -1 if unknown
+	float getServerMaxLag() const { return m_server_max_lag; }
+
+	// Returns statistics collected since the last call and resets them
+	LoadBotStats takeStats();
+
+	// con::PeerHandler
+	void peerAdded(con::Peer *peer);
+	void deletingPeer(con::Peer *peer, bool timeout);
+
+private:
+	void receiveAll();
+	void processPacket(NetworkPacket *pkt);
+	void send(NetworkPacket *pkt);
+
+	void handleHello(NetworkPacket *pkt);
+	void handleSrpBytesSandB(NetworkPacket *pkt);
+	void handleAuthAccept(NetworkPacket *pkt);
+	void handleAccessDenied(NetworkPacket *pkt);
+	void handleAnnounceMedia(NetworkPacket *pkt);
+	void handleBlockData(NetworkPacket *pkt);
+	void handleMovePlayer(NetworkPacket *pkt);
+	void handleChatMessage(NetworkPacket *pkt);
+
+	void stepMovement(float dtime);
+	void stepInteract(float dtime);
+	void stepReplay();
+	void sendInit();
+	void sendPlayerPos();
+	void sendInteract(u8 action, v3s16 under, v3s16 above);
+	void sendGotBlocks();
+	void updateCurrentBlock();
+	void deleteAuthData();
+
+	std::string m_name;
+	LoadBotParams m_params;
+	PcgRandom m_rand;
+
+	std::unique_ptr<con::Connection> m_con;
+	LoadBotState m_state = LOADBOT_CREATED;
+	std::string m_deny_reason;
+	SRPUser *m_auth_data = nullptr;
+	u64 m_connect_time_ms = 0;
+	float m_init_timer = 0.0f;
+	float m_join_time = 0.0f;
+
+	// Player state, in the same units as LocalPlayer
+	v3f m_position;
+	v3f m_speed;
+	v3f m_spawn_position;
+	float m_yaw = 0.0f;
+	float m_pitch = 0.0f;
+	float m_move_time = 0.0f;
+	float m_turn_timer = 0.0f;
+	float m_send_interval = 0.1f;
+	float m_send_timer = 0.0f;
+	bool m_position_dirty = true;
+
+	float m_interact_timer = 0.0f;
+	v3s16 m_dig_pos;
+	bool m_digging = false;
+
+	// Block delivery latency tracking
+	v3s16 m_current_block;
+	u64 m_current_block_since_ms = 0;
+	bool m_current_block_received = true;
+	std::vector<v3s16> m_got_blocks;
+
+	// Replay state
+	std::vector<CapturedPacket> m_replay;
+	size_t m_replay_next = 0;
+	u64 m_replay_start_ms = 0;
+
+	float m_server_max_lag = -1.0f;
+	LoadBotStats m_stats;
+};
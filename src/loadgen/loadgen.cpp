@@ -0,0 +1,256 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "loadgen.h"
+#include <iomanip>
+#include <map>
+#include "log.h"
+#include "porting.h"
+#include "settings.h"
+#include "exceptions.h"
+#include "network/socket.h"
+#include "util/numeric.h"
+#include "util/string.h"
+
+LoadGenerator::LoadGenerator(const LoadGeneratorParams &params) :
+	m_params(params)
+{
+}
+
+LoadGenerator::~LoadGenerator()
+{
+	for (auto &bot : m_bots)
+		bot->disconnect();
+}
+
+bool LoadGenerator::loadReplay()
+{
+	std::vector<CapturedPacket> packets;
+	if (!PacketCaptureReader::readAll(m_params.replay_file, &packets))
+		return false;
+
+	std::map<session_t, size_t> peer_index;
+	for (const CapturedPacket &cp : packets) {
+		auto it = peer_index.find(cp.peer_id);
+		if (it == peer_index.end()) {
+			it = peer_index.emplace(cp.peer_id, m_replay_peers.size()).first;
+			m_replay_peers.emplace_back();
+		}
+		m_replay_peers[it->second].push_back(cp);
+	}
+
+	actionstream << "LoadGenerator: replaying " << packets.size()
+			<< " packets from " << m_replay_peers.size() << " peers" << std::endl;
+	return !m_replay_peers.empty();
+}
+
+void LoadGenerator::startBot()
+{
+	u32 index = m_bots.size();
+	std::string name = m_params.name_prefix + itos(index);
+
+	std::unique_ptr<LoadBot> bot(new LoadBot(name, m_params.bot, index + 1));
+	if (!m_replay_peers.empty())
+		bot->setReplay(m_replay_peers[index % m_replay_peers.size()]);
+	bot->connect(m_params.address);
+	m_bots.push_back(std::move(bot));
+}
+
+bool LoadGenerator::run()
+{
+	if (!m_params.replay_file.empty() && !loadReplay()) {
+		errorstream << "LoadGenerator: no packets to replay in \""
+				<< m_params.replay_file << "\"" << std::endl;
+		return false;
+	}
+
+	actionstream << "LoadGenerator: starting " << m_params.bot_count
+			<< " bots against " << m_params.address.serializeString()
+			<< ":" << m_params.address.getPort() << std::endl;
+
+	float start_timer = 0.0f;
+	float report_timer = 0.0f;
+	float run_time = 0.0f;
+	u64 last_ms = porting::getTimeMs();
+	bool *kill = porting::signal_handler_killstatus();
+
+	while (!*kill) {
+		u64 now_ms = porting::getTimeMs();
+		float dtime = (now_ms - last_ms) / 1000.0f;
+		last_ms = now_ms;
+
+		// Ramp up gradually, the server handles logins sequentially
+		start_timer += dtime * m_params.connect_rate;
+		while (start_timer >= 1.0f && m_bots.size() < m_params.bot_count) {
+			start_timer -= 1.0f;
+			startBot();
+		}
+
+		bool all_replayed = !m_replay_peers.empty();
+		for (auto &bot : m_bots) {
+			bot->step(dtime);
+			if (bot->getState() != LOADBOT_DISCONNECTED && !bot->isReplayDone())
+				all_replayed = false;
+		}
+
+		report_timer += dtime;
+		if (report_timer >= m_params.report_interval) {
+			if (!m_bots.empty())
+				m_bots[0]->requestServerStatus();
+			report(report_timer, false);
+			report_timer = 0.0f;
+		}
+
+		if (m_bots.size() == m_params.bot_count) {
+			run_time += dtime;
+			if (m_params.duration > 0.0f && run_time >= m_params.duration)
+				break;
+			if (all_replayed)
+				break;
+		}
+
+		sleep_ms(5);
+	}
+
+	report(report_timer, true);
+	return true;
+}
+
+void LoadGenerator::report(float dtime, bool final)
+{
+	LoadBotStats stats;
+	u32 active = 0;
+	u32 joined = 0;
+	float join_time_sum = 0.0f;
+	float max_lag = -1.0f;
+
+	for (auto &bot : m_bots) {
+		stats.add(bot->takeStats());
+		if (bot->getState() == LOADBOT_ACTIVE)
+			active++;
+		if (bot->getJoinTime() > 0.0f) {
+			joined++;
+			join_time_sum += bot->getJoinTime();
+		}
+		max_lag = MYMAX(max_lag, bot->getServerMaxLag());
+	}
+
+	m_total_stats.add(stats);
+	m_total_time += dtime;
+
+	if (!final) {
+		float rate = dtime > 0.0f ? 1.0f / dtime : 0.0f;
+		rawstream << std::fixed << std::setprecision(1)
+			<< "bots=" << active << "/" << m_bots.size()
+			<< " KiB/s=" << stats.bytes_received / 1024.0f * rate
+			<< " packets/s=" << stats.packets_received * rate
+			<< " blocks/s=" << stats.blocks_received * rate
+			<< " block_latency_ms(avg/max)="
+			<< (stats.block_latency_samples ?
+				stats.block_latency_sum / stats.block_latency_samples * 1000 : 0.0f)
+			<< "/" << stats.block_latency_max * 1000
+			<< " server_max_lag=" << std::setprecision(3) << max_lag
+			<< std::endl;
+		return;
+	}
+
+	const LoadBotStats &t = m_total_stats;
+	float rate = m_total_time > 0.0f ? 1.0f / m_total_time : 0.0f;
+	rawstream << std::fixed << std::setprecision(1)
+		<< "Summary after " << m_total_time << "s:" << std::endl
+		<< "  bots joined:        " << joined << "/" << m_bots.size() << std::endl
+		<< "  avg join time:      " << std::setprecision(3)
+		<< (joined ? join_time_sum / joined : 0.0f) << "s" << std::endl
+		<< std::setprecision(1)
+		<< "  received:           " << t.bytes_received / 1024.0f * rate
+		<< " KiB/s, " << t.packets_received * rate << " packets/s" << std::endl
+		<< "  blocks:             " << t.blocks_received * rate << "/s" << std::endl
+		<< "  block latency:      avg "
+		<< (t.block_latency_samples ?
+			t.block_latency_sum / t.block_latency_samples * 1000 : 0.0f)
+		<< "ms, max " << t.block_latency_max * 1000 << "ms" << std::endl
+		<< "  server max_lag:     " << std::setprecision(3) << max_lag
+		<< "s" << std::endl;
+
+	for (auto &bot : m_bots) {
+		if (!bot->getDenyReason().empty()) {
+			rawstream << "  " << bot->getName() << " disconnected: "
+				<< bot->getDenyReason() << std::endl;
+		}
+	}
+}
+
+int run_loadgen(const Settings &cmd_args)
+{
+	LoadGeneratorParams params;
+
+	std::string address = "127.0.0.1";
+	if (cmd_args.exists("address"))
+		address = cmd_args.get("address");
+	u16 port = 30000;
+	if (cmd_args.exists("port"))
+		port = cmd_args.getU16("port");
+
+	sockets_init();
+	try {
+		params.address.Resolve(address.c_str());
+	} catch (ResolveError &e) {
+		errorstream << "Couldn't resolve address \"" << address << "\": "
+				<< e.what() << std::endl;
+		return 1;
+	}
+	params.address.setPort(port);
+
+	if (cmd_args.exists("bots"))
+		params.bot_count = cmd_args.getU16("bots");
+	if (cmd_args.exists("name"))
+		params.name_prefix = cmd_args.get("name");
+	if (cmd_args.exists("password"))
+		params.bot.password = cmd_args.get("password");
+	if (cmd_args.exists("duration"))
+		params.duration = cmd_args.getFloat("duration");
+	if (cmd_args.exists("connect-rate"))
+		params.connect_rate = MYMAX(0.1f, cmd_args.getFloat("connect-rate"));
+	if (cmd_args.exists("report-interval"))
+		params.report_interval = MYMAX(1.0f, cmd_args.getFloat("report-interval"));
+	if (cmd_args.exists("interact-interval"))
+		params.bot.interact_interval = cmd_args.getFloat("interact-interval");
+	if (cmd_args.exists("replay"))
+		params.replay_file = cmd_args.get("replay");
+
+	if (cmd_args.exists("movement")) {
+		const std::string movement = cmd_args.get("movement");
+		if (movement == "idle") {
+			params.bot.movement = LOADBOT_MOVE_IDLE;
+		} else if (movement == "walk") {
+			params.bot.movement = LOADBOT_MOVE_WALK;
+		} else if (movement == "circle") {
+			params.bot.movement = LOADBOT_MOVE_CIRCLE;
+		} else if (movement == "line") {
+			params.bot.movement = LOADBOT_MOVE_LINE;
+		} else {
+			errorstream << "Unknown movement \"" << movement
+					<< "\", expected idle, walk, circle or line" << std::endl;
+			return 1;
+		}
+	}
+
+	LoadGenerator loadgen(params);
+	return loadgen.run() ? 0 : 1;
+}
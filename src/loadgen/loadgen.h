@@ -0,0 +1,73 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "bot.h"
+#include "network/address.h"
+
+class Settings;
+
+struct LoadGeneratorParams
+{
+	Address address;
+	u32 bot_count = 10;
+	std::string name_prefix = "loadbot";
+	// Run time in seconds after the last bot was started, 0 = until killed
+	float duration = 60.0f;
+	// Bots started per second
+	float connect_rate = 10.0f;
+	// Seconds between status lines
+	float report_interval = 5.0f;
+	LoadBotParams bot;
+	// Packet capture to replay, empty = generate movement
+	std::string replay_file;
+};
+
+/*
+	Drives many LoadBots from a single thread and prints periodic
+	statistics: received data rate, block delivery latency and the
+	server's own step time (max_lag, queried with /status).
+*/
+class LoadGenerator
+{
+public:
+	LoadGenerator(const LoadGeneratorParams &params);
+	~LoadGenerator();
+
+	bool run();
+
+private:
+	bool loadReplay();
+	void startBot();
+	void report(float dtime, bool final);
+
+	LoadGeneratorParams m_params;
+	std::vector<std::unique_ptr<LoadBot>> m_bots;
+	// Captured packets grouped by their original peer
+	std::vector<std::vector<CapturedPacket>> m_replay_peers;
+
+	LoadBotStats m_total_stats;
+	float m_total_time = 0.0f;
+};
+
+int run_loadgen(const Settings &cmd_args);
@@ -37,12 +37,19 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "player.h"
 #include "porting.h"
 #include "network/socket.h"
+#include "nodedef.h"
+#include "serialization.h"
+#include "mapgen/mapgen_benchmark.h"
+#ifdef LOADGEN
+#include "loadgen/loadgen.h"
+#endif
 #if USE_CURSES
 	#include "terminal_chat_console.h"
 #endif
 #ifndef SERVER
 #include "gui/guiMainMenu.h"
 #include "client/clientlauncher.h"
+#include "client/meshgen_benchmark.h"
 #include "gui/guiEngine.h"
 #include "gui/mainmenumanager.h"
 #endif
@@ -101,6 +108,8 @@ static bool determine_subgame(GameParams *game_params);
 
 static bool run_dedicated_server(const GameParams &game_params, const Settings &cmd_args);
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args);
+static bool dump_node_definitions(const GameParams &game_params,
+		const Address &bind_addr, const Settings &cmd_args);
 
 /**********************************************************************/
 
@@ -183,6 +192,13 @@ int main(int argc, char *argv[])
 	if (cmd_args.getFlag("run-unittests")) {
 		return run_tests();
 	}
+	if (cmd_args.getFlag("run-benchmarks")) {
+		return run_benchmarks();
+	}
+#endif
+
+#ifdef LOADGEN
+	return run_loadgen(cmd_args);
 #endif
 
 	GameParams game_params;
@@ -208,6 +224,9 @@ int main(int argc, char *argv[])
 		return run_dedicated_server(game_params, cmd_args) ? 0 : 1;
 
 #ifndef SERVER
+	if (cmd_args.getFlag("meshgen-benchmark"))
+		return run_meshgen_benchmark(game_params, cmd_args) ? 0 : 1;
+
 	ClientLauncher launcher;
 	retval = launcher.run(game_params, cmd_args) ? 0 : 1;
 #else
@@ -255,6 +274,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Set network port (UDP)"))));
 	allowed_options->insert(std::make_pair("run-unittests", ValueSpec(VALUETYPE_FLAG,
 			_("Run the unit tests and exit"))));
+	allowed_options->insert(std::make_pair("run-benchmarks", ValueSpec(VALUETYPE_FLAG,
+			_("Run the benchmarks of the unit tests and exit"))));
 	allowed_options->insert(std::make_pair("map-dir", ValueSpec(VALUETYPE_STRING,
 			_("Same as --world (deprecated)"))));
 	allowed_options->insert(std::make_pair("world", ValueSpec(VALUETYPE_STRING,
@@ -293,11 +314,25 @@ static void set_allowed_options(OptionList *allowed_options)
 		_("Migrate from current auth backend to another (Only works when using minetestserver or with --server)"))));
 	allowed_options->insert(std::make_pair("terminal", ValueSpec(VALUETYPE_FLAG,
 			_("Feature an interactive terminal (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("dump-nodedefs", ValueSpec(VALUETYPE_STRING,
+			_("Write the node definitions of the world to a file and exit (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("mapgen-benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Generate chunks with the mapgen of the world, print stage timings and a hash of the result, and exit (Only works when using minetestserver or with --server)"))));
+	allowed_options->insert(std::make_pair("mapgen-chunks", ValueSpec(VALUETYPE_STRING,
+			_("Number of chunks generated by --mapgen-benchmark (default: 16)"))));
+	allowed_options->insert(std::make_pair("mapgen-seed", ValueSpec(VALUETYPE_STRING,
+			_("Map seed used by --mapgen-benchmark (default: 1)"))));
 #ifndef SERVER
 	allowed_options->insert(std::make_pair("videomodes", ValueSpec(VALUETYPE_FLAG,
 			_("Show available video modes"))));
 	allowed_options->insert(std::make_pair("speedtests", ValueSpec(VALUETYPE_FLAG,
 			_("Run speed tests"))));
+	allowed_options->insert(std::make_pair("meshgen-benchmark", ValueSpec(VALUETYPE_FLAG,
+			_("Build meshes for the blocks of a world without a window and print statistics"))));
+	allowed_options->insert(std::make_pair("nodedefs", ValueSpec(VALUETYPE_STRING,
+			_("Node definitions written by --dump-nodedefs, for --meshgen-benchmark"))));
+	allowed_options->insert(std::make_pair("meshgen-radius", ValueSpec(VALUETYPE_STRING,
+			_("Radius in blocks around the origin used by --meshgen-benchmark (default: 4)"))));
 	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
 			_("Address to connect to. ('' = local game)"))));
 	allowed_options->insert(std::make_pair("random-input", ValueSpec(VALUETYPE_FLAG,
@@ -315,6 +350,28 @@ static void set_allowed_options(OptionList *allowed_options)
 	allowed_options->insert(std::make_pair("console", ValueSpec(VALUETYPE_FLAG,
 		_("Starts with the console (Windows only)"))));
 #endif
+#ifdef LOADGEN
+	allowed_options->insert(std::make_pair("address", ValueSpec(VALUETYPE_STRING,
+			_("Address of the server to load (default: 127.0.0.1)"))));
+	allowed_options->insert(std::make_pair("bots", ValueSpec(VALUETYPE_STRING,
+			_("Number of bots to connect (default: 10)"))));
+	allowed_options->insert(std::make_pair("name", ValueSpec(VALUETYPE_STRING,
+			_("Bot name prefix, the bot number is appended (default: loadbot)"))));
+	allowed_options->insert(std::make_pair("password", ValueSpec(VALUETYPE_STRING,
+			_("Set password for all bots"))));
+	allowed_options->insert(std::make_pair("duration", ValueSpec(VALUETYPE_STRING,
+			_("Seconds to run after all bots are started, 0 = until killed (default: 60)"))));
+	allowed_options->insert(std::make_pair("connect-rate", ValueSpec(VALUETYPE_STRING,
+			_("Bots started per second (default: 10)"))));
+	allowed_options->insert(std::make_pair("movement", ValueSpec(VALUETYPE_STRING,
+			_("Bot movement: 'idle', 'walk', 'circle' or 'line' (default: walk)"))));
+	allowed_options->insert(std::make_pair("interact-interval", ValueSpec(VALUETYPE_STRING,
+			_("Seconds between dig/place actions of each bot, 0 = never (default: 0)"))));
+	allowed_options->insert(std::make_pair("replay", ValueSpec(VALUETYPE_STRING,
+			_("Replay a packet capture recorded with packet_capture_file"))));
+	allowed_options->insert(std::make_pair("report-interval", ValueSpec(VALUETYPE_STRING,
+			_("Seconds between statistics lines (default: 5)"))));
+#endif
 
 }
 
@@ -844,6 +901,12 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	if (cmd_args.exists("migrate-auth"))
 		return ServerEnvironment::migrateAuthDatabase(game_params, cmd_args);
 
+	if (cmd_args.exists("dump-nodedefs"))
+		return dump_node_definitions(game_params, bind_addr, cmd_args);
+
+	if (cmd_args.getFlag("mapgen-benchmark"))
+		return run_mapgen_benchmark(game_params, bind_addr, cmd_args);
+
 	if (cmd_args.exists("terminal")) {
 #if USE_CURSES
 		bool name_ok = true;
@@ -928,6 +991,40 @@ static bool run_dedicated_server(const GameParams &game_params, const Settings &
 	return true;
 }
 
+static bool dump_node_definitions(const GameParams &game_params,
+		const Address &bind_addr, const Settings &cmd_args)
+{
+	std::string path = cmd_args.get("dump-nodedefs");
+	std::ostringstream os_compressed(std::ios::binary);
+
+	try {
+		// Loading the mods is enough, the server is never started
+		Server server(game_params.world_path, game_params.game_spec, false,
+			bind_addr, true);
+		server.init();
+
+		// Same format as TOCLIENT_NODEDEF
+		std::ostringstream os(std::ios::binary);
+		server.getNodeDefManager()->serialize(os, LATEST_PROTOCOL_VERSION);
+		compressZlib(os.str(), os_compressed);
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		return false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		return false;
+	}
+
+	if (!fs::safeWriteToFile(path, os_compressed.str())) {
+		errorstream << "Failed to write node definitions to "
+			<< path << std::endl;
+		return false;
+	}
+
+	actionstream << "Wrote node definitions to " << path << std::endl;
+	return true;
+}
+
 static bool migrate_map_database(const GameParams &game_params, const Settings &cmd_args)
 {
 	std::string migrate_to = cmd_args.get("migrate");
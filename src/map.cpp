@@ -1075,12 +1075,28 @@ bool Map::isOccluded(v3s16 p0, v3s16 p1, float step, float stepfac,
 	uf.normalize();
 	v3f p0f = v3f(p0.X, p0.Y, p0.Z) * BS;
 	u32 count = 0;
+	// Consecutive samples mostly fall into the same block
+	v3s16 blockpos(S16_MAX, S16_MAX, S16_MAX);
+	MapBlock *block = nullptr;
 	for(float s=start_off; s<d0+end_off; s+=step){
 		v3f pf = p0f + uf * s;
 		v3s16 p = floatToInt(pf, BS);
-		MapNode n = getNodeNoEx(p);
-		const ContentFeatures &f = m_nodedef->get(n);
-		if(f.drawtype == NDT_NORMAL){
+		v3s16 bp = getNodeBlockPos(p);
+		if (bp != blockpos) {
+			blockpos = bp;
+			block = getBlockNoCreateNoEx(bp);
+		}
+		bool opaque = false;
+		if (block && block->isFullyOpaque()) {
+			opaque = true;
+		} else if (block) {
+			bool is_valid_position;
+			MapNode n = block->getNodeNoCheck(p - bp * MAP_BLOCKSIZE,
+				&is_valid_position);
+			opaque = is_valid_position &&
+				m_nodedef->get(n).drawtype == NDT_NORMAL;
+		}
+		if (opaque) {
 			// not transparent, see ContentFeature::updateTextures
 			count++;
 			if(count >= needed_count)
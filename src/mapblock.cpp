@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <sstream>
 #include "map.h"
+#include "collision.h"
 #include "light.h"
 #include "nodedef.h"
 #include "nodemetadata.h"
@@ -85,6 +86,7 @@ MapBlock::~MapBlock()
 	}
 #endif
 
+	delete collision_cache;
 	delete[] data;
 }
 
@@ -212,10 +214,35 @@ void MapBlock::expireDayNightDiff()
 	if (!data) {
 		m_day_night_differs = false;
 		m_day_night_differs_expired = false;
+		m_fully_opaque = false;
+		m_fully_opaque_expired = false;
 		return;
 	}
 
 	m_day_night_differs_expired = true;
+	m_fully_opaque_expired = true;
+}
+
+void MapBlock::actuallyUpdateFullyOpaque()
+{
+	m_fully_opaque_expired = false;
+	m_fully_opaque = false;
+
+	if (!data)
+		return;
+
+	const NodeDefManager *nodemgr = m_gamedef->ndef();
+	content_t last_content = CONTENT_IGNORE;
+	for (u32 i = 0; i < nodecount; i++) {
+		content_t c = data[i].getContent();
+		if (i != 0 && c == last_content)
+			continue;
+		if (nodemgr->get(c).drawtype != NDT_NORMAL)
+			return;
+		last_content = c;
+	}
+
+	m_fully_opaque = true;
 }
 
 s16 MapBlock::getGroundLevel(v2s16 p2d)
@@ -457,6 +484,9 @@ void MapBlock::deSerialize(std::istream &is, u8 version, bool disk)
 	TRACESTREAM(<<"MapBlock::deSerialize "<<PP(getPos())<<std::endl);
 
 	m_day_night_differs_expired = false;
+	m_fully_opaque_expired = true;
+	collision_cache_expired = true;
+	content_types_expired = true;
 
 	if(version <= 21)
 	{
@@ -37,6 +37,7 @@ class NodeMetadataList;
 class IGameDef;
 class MapBlockMesh;
 class VoxelManipulator;
+struct BlockCollisionCache;
 
 #define BLOCK_TIMESTAMP_UNDEFINED 0xffffffff
 
@@ -114,8 +115,12 @@ class MapBlock
 		} else if (mod == m_modified) {
 			m_modified_reason |= reason;
 		}
-		if (mod == MOD_STATE_WRITE_NEEDED)
+		if (mod == MOD_STATE_WRITE_NEEDED) {
 			contents_cached = false;
+			collision_cache_expired = true;
+			content_types_expired = true;
+			m_fully_opaque_expired = true;
+		}
 	}
 
 	inline u32 getModified()
@@ -372,6 +377,17 @@ class MapBlock
 		return m_day_night_differs;
 	}
 
+	// Whether every node of the block is an opaque cube (NDT_NORMAL).
+	// Used as a shortcut by occlusion tests, expires whenever the nodes
+	// of the block are changed.
+	inline bool isFullyOpaque()
+	{
+		if (m_fully_opaque_expired)
+			actuallyUpdateFullyOpaque();
+		return m_fully_opaque;
+	}
+	void actuallyUpdateFullyOpaque();
+
 	////
 	//// Miscellaneous stuff
 	////
@@ -539,6 +555,21 @@ class MapBlock
 	// True if we never want to cache content types for this block
 	bool do_not_cache_contents = false;
 
+	//// Collision optimizations ////
+	// Built by getBlockCollisionCache() when needed
+	BlockCollisionCache *collision_cache = nullptr;
+	// True if the nodes changed since collision_cache was built
+	bool collision_cache_expired = true;
+
+	//// Node search optimizations ////
+	// Built by getBlockContentTypes() when needed. Not shared with the
+	// ABM cache above: that one is marked as cached at the end of an ABM
+	// pass even if the ABMs changed nodes of the block during the pass,
+	// which is fine for ABMs but would make searches miss nodes.
+	std::vector<content_t> content_types;
+	// True if the nodes changed since content_types was built
+	bool content_types_expired = true;
+
 private:
 	/*
 		Private member variables
@@ -597,6 +628,9 @@ class MapBlock
 	bool m_day_night_differs = false;
 	bool m_day_night_differs_expired = true;
 
+	bool m_fully_opaque = false;
+	bool m_fully_opaque_expired = true;
+
 	bool m_generated = false;
 
 	/*
@@ -125,6 +125,9 @@ void DungeonGen::generate(MMVManip *vm, u32 bseed, v3s16 nmin, v3s16 nmax)
 	if (dp.c_alt_wall == CONTENT_IGNORE)
 		return;
 
+	// Point noise of each wall node. A batched version would have to round
+	// exactly like noise3d_gradient() does in -ffast-math builds, or the
+	// alt walls of existing worlds would change.
 	for (s16 z = nmin.Z; z <= nmax.Z; z++)
 	for (s16 y = nmin.Y; y <= nmax.Y; y++) {
 		u32 i = vm->m_area.index(nmin.X, y, z);
@@ -102,6 +102,19 @@ class GenerateNotifier {
 	std::list<GenNotifyEvent> m_notify_events;
 };
 
+// Parts of makeChunk() that are timed separately, see Mapgen::beginStage()
+enum MapgenStage {
+	MGSTAGE_TERRAIN,
+	MGSTAGE_BIOMES,
+	MGSTAGE_CAVES,
+	MGSTAGE_ORES,
+	MGSTAGE_DUNGEONS,
+	MGSTAGE_DECORATIONS,
+	MGSTAGE_LIQUIDS,
+	MGSTAGE_LIGHTING,
+	MGSTAGE_COUNT
+};
+
 enum MapgenType {
 	MAPGEN_V5,
 	MAPGEN_V6,
@@ -170,6 +183,9 @@ class Mapgen {
 	BiomeGen *biomegen = nullptr;
 	GenerateNotifier gennotify;
 
+	// Microseconds spent in each stage by the last makeChunk() call
+	u64 stage_times[MGSTAGE_COUNT] = {};
+
 	Mapgen() = default;
 	Mapgen(int mapgenid, MapgenParams *params, EmergeManager *emerge);
 	virtual ~Mapgen() = default;
@@ -189,12 +205,19 @@ class Mapgen {
 	void updateLiquid(UniqueQueue<v3s16> *trans_liquid, v3s16 nmin, v3s16 nmax);
 
 	void setLighting(u8 light, v3s16 nmin, v3s16 nmax);
-	void lightSpread(VoxelArea &a, v3s16 p, u8 light);
 	void calcLighting(v3s16 nmin, v3s16 nmax, v3s16 full_nmin, v3s16 full_nmax,
 		bool propagate_shadow = true);
 	void propagateSunlight(v3s16 nmin, v3s16 nmax, bool propagate_shadow);
 	void spreadLight(v3s16 nmin, v3s16 nmax);
 
+	// Stage timing for makeChunk(). resetStages() clears stage_times,
+	// beginStage() charges the time since the previous call to the stage
+	// that was running and endStages() stops the clock.
+	void resetStages();
+	void beginStage(MapgenStage stage);
+	void endStages() { beginStage(MGSTAGE_COUNT); }
+	static const char *getStageName(MapgenStage stage);
+
 	virtual void makeChunk(BlockMakeData *data) {}
 	virtual int getGroundLevelAtPoint(v2s16 p) { return 0; }
 
@@ -218,6 +241,9 @@ class Mapgen {
 	// that checks whether there are floodable nodes without liquid beneath
 	// the node at index vi.
 	inline bool isLiquidHorizontallyFlowable(u32 vi, v3s16 em);
+
+	MapgenStage m_stage = MGSTAGE_COUNT;
+	u64 m_stage_start = 0;
 };
 
 /*
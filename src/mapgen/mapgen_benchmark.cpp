@@ -0,0 +1,167 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "mapgen_benchmark.h"
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include "mapgen.h"
+#include "content/subgames.h"
+#include "emerge.h"
+#include "gameparams.h"
+#include "log.h"
+#include "map.h"
+#include "porting.h"
+#include "server.h"
+#include "settings.h"
+#include "threading/task_pool.h"
+#include "util/numeric.h"
+
+// Chunk positions in a fixed order, in chunks. Half of them are at the
+// surface and half just below it.
+static std::vector<v3s16> get_chunk_positions(u32 count)
+{
+	std::vector<v3s16> positions;
+	s16 side = std::ceil(std::sqrt((float)((count + 1) / 2)));
+	for (u32 i = 0; i < count; i++) {
+		u32 j = i / 2;
+		positions.emplace_back(j % side - side / 2, -(s16)(i % 2),
+			j / side - side / 2);
+	}
+	return positions;
+}
+
+static MapgenParams *make_params(const MapgenParams *world_params, u64 seed)
+{
+	// Copy the parameters of the world, with another seed
+	Settings settings;
+	world_params->MapgenParams::writeParams(&settings);
+	world_params->writeParams(&settings);
+	settings.setU64("seed", seed);
+
+	MapgenParams *params = Mapgen::createMapgenParams(world_params->mgtype);
+	params->mgtype = world_params->mgtype;
+	params->MapgenParams::readParams(&settings);
+	params->readParams(&settings);
+	return params;
+}
+
+static u64 generate_chunk(Mapgen *mapgen, Map *map, const MapgenParams *params,
+		v3s16 chunkpos, const NodeDefManager *ndef)
+{
+	// Same as ServerMap::initBlockMake() on an empty map
+	BlockMakeData data;
+	data.seed = params->seed;
+	data.blockpos_min = EmergeManager::getContainingChunk(
+		chunkpos * params->chunksize, params->chunksize);
+	data.blockpos_max = data.blockpos_min +
+		v3s16(1, 1, 1) * (params->chunksize - 1);
+	data.blockpos_requested = data.blockpos_min;
+	data.nodedef = ndef;
+
+	VoxelArea area((data.blockpos_min - 1) * MAP_BLOCKSIZE,
+		(data.blockpos_max + 2) * MAP_BLOCKSIZE - v3s16(1, 1, 1));
+	data.vmanip = new MMVManip(map);
+	data.vmanip->addArea(area);
+	for (s32 i = 0; i < area.getVolume(); i++)
+		data.vmanip->m_data[i] = MapNode(CONTENT_IGNORE);
+
+	// v6 trees and schematic probabilities use the global generator
+	mysrand(Mapgen::getBlockSeed2(data.blockpos_min, params->seed));
+	mapgen->makeChunk(&data);
+
+	return murmur_hash_64_ua(data.vmanip->m_data,
+		area.getVolume() * sizeof(MapNode), 0);
+}
+
+bool run_mapgen_benchmark(const GameParams &game_params,
+		const Address &bind_addr, const Settings &cmd_args)
+{
+	u32 num_chunks = 16;
+	if (cmd_args.exists("mapgen-chunks"))
+		num_chunks = MYMAX(cmd_args.getU32("mapgen-chunks"), 1U);
+	u64 seed = 1;
+	if (cmd_args.exists("mapgen-seed"))
+		seed = cmd_args.getU64("mapgen-seed");
+
+	try {
+		// Loading the mods is enough, the server is never started
+		Server server(game_params.world_path, game_params.game_spec, false,
+			bind_addr, true);
+		server.init();
+
+		EmergeManager *emerge = server.getEmergeManager();
+		MapgenParams *params = make_params(emerge->mgparams, seed);
+		Mapgen *mapgen = Mapgen::createMapgen(params->mgtype, 0, params, emerge);
+		if (!mapgen) {
+			errorstream << "Cannot create mapgen "
+				<< Mapgen::getMapgenName(params->mgtype) << std::endl;
+			delete params;
+			return false;
+		}
+
+		// Same helper threads as the emerge threads would use
+		u16 num_task_threads = g_settings->getU16("num_mapgen_task_threads");
+		std::unique_ptr<TaskPool> task_pool;
+		if (num_task_threads > 0)
+			task_pool.reset(new TaskPool("MapgenTask", num_task_threads));
+		TaskPool::setCurrent(task_pool.get());
+
+		u64 stage_times[MGSTAGE_COUNT] = {};
+		std::vector<u64> hashes;
+		u64 t0 = porting::getTimeUs();
+		for (const v3s16 &chunkpos : get_chunk_positions(num_chunks)) {
+			hashes.push_back(generate_chunk(mapgen, &server.getMap(),
+				params, chunkpos, server.getNodeDefManager()));
+			for (int i = 0; i != MGSTAGE_COUNT; i++)
+				stage_times[i] += mapgen->stage_times[i];
+		}
+		u64 time_us = porting::getTimeUs() - t0;
+		TaskPool::setCurrent(nullptr);
+
+		u64 hash = murmur_hash_64_ua(&hashes[0],
+			hashes.size() * sizeof(u64), 0);
+		dstream << "mapgen: mapgen=" << Mapgen::getMapgenName(params->mgtype)
+			<< " seed=" << seed
+			<< " chunks=" << num_chunks
+			<< " task_threads=" << num_task_threads
+			<< " time_ms=" << time_us / 1000
+			<< " chunks_per_s=" << num_chunks * 1000000.0 / MYMAX(time_us, 1)
+			<< std::endl;
+		for (int i = 0; i != MGSTAGE_COUNT; i++) {
+			dstream << "mapgen: stage=" << Mapgen::getStageName((MapgenStage)i)
+				<< " time_ms=" << stage_times[i] / 1000
+				<< " percent=" << stage_times[i] * 100.0 / MYMAX(time_us, 1)
+				<< std::endl;
+		}
+		dstream << "mapgen: hash=" << std::hex << std::setfill('0')
+			<< std::setw(16) << hash << std::dec << std::endl;
+
+		delete mapgen;
+		delete params;
+	} catch (const ModError &e) {
+		errorstream << "ModError: " << e.what() << std::endl;
+		return false;
+	} catch (const ServerError &e) {
+		errorstream << "ServerError: " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
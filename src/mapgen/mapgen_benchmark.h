@@ -0,0 +1,39 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+struct GameParams;
+class Address;
+class Settings;
+
+/*
+	Map generation benchmark (--mapgen-benchmark).
+
+	Loads the mods of a world and runs the mapgen of the world on a
+	fixed set of chunks around the origin, with the seed given by
+	--mapgen-seed instead of the seed of the world. Nothing is written
+	to the map database and the Lua on_generated callbacks are not run.
+
+	Prints the time spent in each stage of makeChunk() and a hash of
+	the generated nodes, so that changes to the mapgens can be checked
+	for speed and for not changing the terrain.
+*/
+bool run_mapgen_benchmark(const GameParams &game_params,
+		const Address &bind_addr, const Settings &cmd_args);
@@ -240,18 +240,25 @@ void MapgenCarpathian::makeChunk(BlockMakeData *data)
 	// Create a block-specific seed
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	resetStages();
+	beginStage(MGSTAGE_TERRAIN);
+
 	// Generate terrain
 	s16 stone_surface_max_y = generateTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	beginStage(MGSTAGE_BIOMES);
+
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	beginStage(MGSTAGE_CAVES);
+
 	// Generate tunnels, caverns and large randomwalk caves
 	if (flags & MG_CAVES) {
 		// Generate tunnels first as caverns confuse them
@@ -273,31 +280,45 @@ void MapgenCarpathian::makeChunk(BlockMakeData *data)
 			generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	beginStage(MGSTAGE_ORES);
+
 	// Generate the registered ores
 	m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_DUNGEONS);
+
 	// Generate dungeons
 	if ((flags & MG_DUNGEONS) && full_node_min.Y >= dungeon_ymin &&
 			full_node_max.Y <= dungeon_ymax)
 		generateDungeons(stone_surface_max_y);
 
+	beginStage(MGSTAGE_DECORATIONS);
+
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_BIOMES);
+
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
+	beginStage(MGSTAGE_LIQUIDS);
+
 	// Update liquids
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	beginStage(MGSTAGE_LIGHTING);
+
 	// Calculate lighting
 	if (flags & MG_LIGHT) {
 		calcLighting(node_min - v3s16(0, 1, 0), node_max + v3s16(0, 1, 0),
 				full_node_min, full_node_max);
 	}
 
+	endStages();
+
 	this->generating = false;
 }
 
@@ -188,18 +188,25 @@ void MapgenFlat::makeChunk(BlockMakeData *data)
 
 	blockseed = getBlockSeed2(full_node_min, seed);
 
+	resetStages();
+	beginStage(MGSTAGE_TERRAIN);
+
 	// Generate base terrain, mountains, and ridges with initial heightmaps
 	s16 stone_surface_max_y = generateTerrain();
 
 	// Create heightmap
 	updateHeightmap(node_min, node_max);
 
+	beginStage(MGSTAGE_BIOMES);
+
 	// Init biome generator, place biome-specific nodes, and build biomemap
 	if (flags & MG_BIOMES) {
 		biomegen->calcBiomeNoise(node_min);
 		generateBiomes();
 	}
 
+	beginStage(MGSTAGE_CAVES);
+
 	if (flags & MG_CAVES) {
 		// Generate tunnels
 		generateCavesNoiseIntersection(stone_surface_max_y);
@@ -207,25 +214,37 @@ void MapgenFlat::makeChunk(BlockMakeData *data)
 		generateCavesRandomWalk(stone_surface_max_y, large_cave_depth);
 	}
 
+	beginStage(MGSTAGE_ORES);
+
 	// Generate the registered ores
 	m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_DUNGEONS);
+
 	if ((flags & MG_DUNGEONS) && full_node_min.Y >= dungeon_ymin &&
 			full_node_max.Y <= dungeon_ymax)
 		generateDungeons(stone_surface_max_y);
 
+	beginStage(MGSTAGE_DECORATIONS);
+
 	// Generate the registered decorations
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_BIOMES);
+
 	// Sprinkle some dust on top after everything else was generated
 	if (flags & MG_BIOMES)
 		dustTopNodes();
 
 	//printf("makeChunk: %dms\n", t.stop());
 
+	beginStage(MGSTAGE_LIQUIDS);
+
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	beginStage(MGSTAGE_LIGHTING);
+
 	if (flags & MG_LIGHT)
 		calcLighting(node_min - v3s16(0, 1, 0), node_max + v3s16(0, 1, 0),
 			full_node_min, full_node_max);
@@ -233,6 +252,8 @@ void MapgenFlat::makeChunk(BlockMakeData *data)
 	//setLighting(node_min - v3s16(1, 0, 1) * MAP_BLOCKSIZE,
 	//			node_max + v3s16(1, 0, 1) * MAP_BLOCKSIZE, 0xFF);
 
+	endStages();
+
 	this->generating = false;
 }
 
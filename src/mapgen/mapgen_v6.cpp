@@ -521,6 +521,9 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Create a block-specific seed
 	blockseed = get_blockseed(data->seed, full_node_min);
 
+	resetStages();
+	beginStage(MGSTAGE_TERRAIN);
+
 	// Make some noise
 	calculateNoise();
 
@@ -542,10 +545,14 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Loop this part, it will make stuff look older and newer nicely
 	const u32 age_loops = 2;
 	for (u32 i_age = 0; i_age < age_loops; i_age++) { // Aging loop
+		beginStage(MGSTAGE_CAVES);
+
 		// Make caves (this code is relatively horrible)
 		if (flags & MG_CAVES)
 			generateCaves(stone_surface_max_y);
 
+		beginStage(MGSTAGE_TERRAIN);
+
 		// Add mud to the central chunk
 		addMud();
 
@@ -558,6 +565,8 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	// Update heightmap after mudflow
 	updateHeightmap(node_min, node_max);
 
+	beginStage(MGSTAGE_DUNGEONS);
+
 	// Add dungeons
 	if ((flags & MG_DUNGEONS) && stone_surface_max_y >= node_min.Y &&
 			full_node_min.Y >= dungeon_ymin && full_node_max.Y <= dungeon_ymax) {
@@ -605,12 +614,18 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 		dgen.generate(vm, blockseed, full_node_min, full_node_max);
 	}
 
+	beginStage(MGSTAGE_LIQUIDS);
+
 	// Add top and bottom side of water to transforming_liquid queue
 	updateLiquid(&data->transforming_liquid, full_node_min, full_node_max);
 
+	beginStage(MGSTAGE_BIOMES);
+
 	// Add surface nodes
 	growGrass();
 
+	beginStage(MGSTAGE_DECORATIONS);
+
 	// Generate some trees, and add grass, if a jungle
 	if (spflags & MGV6_TREES)
 		placeTreesAndJungleGrass();
@@ -619,15 +634,21 @@ void MapgenV6::makeChunk(BlockMakeData *data)
 	if (flags & MG_DECORATIONS)
 		m_emerge->decomgr->placeAllDecos(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_ORES);
+
 	// Generate the registered ores
 	m_emerge->oremgr->placeAllOres(this, blockseed, node_min, node_max);
 
+	beginStage(MGSTAGE_LIGHTING);
+
 	// Calculate lighting
 	if (flags & MG_LIGHT)
 		calcLighting(node_min - v3s16(1, 1, 1) * MAP_BLOCKSIZE,
 			node_max + v3s16(1, 0, 1) * MAP_BLOCKSIZE,
 			full_node_min, full_node_max);
 
+	endStages();
+
 	this->generating = false;
 }
 
@@ -27,6 +27,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include "porting.h"
 #include "settings.h"
+#include <algorithm>
+#include <cfloat>
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -91,6 +93,18 @@ void BiomeManager::clear()
 }
 
 
+BiomeIndex *BiomeManager::createIndex() const
+{
+	std::vector<Biome *> biomes;
+	for (size_t i = 1; i < getNumObjects(); i++) {
+		Biome *b = (Biome *)getRaw(i);
+		if (b)
+			biomes.push_back(b);
+	}
+	return new BiomeIndex(biomes);
+}
+
+
 // For BiomeGen type 'BiomeGenOriginal'
 float BiomeManager::getHeatAtPosOriginal(v3s16 pos, NoiseParams &np_heat,
 	NoiseParams &np_heat_blend, u64 seed)
@@ -174,12 +188,218 @@ void BiomeParamsOriginal::writeParams(Settings *settings) const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+BiomeIndex::BiomeIndex(const std::vector<Biome *> &biomes)
+{
+	// Biomes are candidates within their Y limits and in the blend area
+	// above. A negative vertical_blend cuts off the top of the biome.
+	for (const Biome *b : biomes) {
+		m_band_starts.push_back(b->min_pos.Y);
+		m_band_starts.push_back(b->max_pos.Y + 1);
+		m_band_starts.push_back(b->max_pos.Y + b->vertical_blend + 1);
+	}
+	std::sort(m_band_starts.begin(), m_band_starts.end());
+	m_band_starts.erase(std::unique(m_band_starts.begin(), m_band_starts.end()),
+		m_band_starts.end());
+
+	// Band 0 is below all biomes
+	m_bands.resize(m_band_starts.size() + 1);
+	std::vector<Biome *> within, blend;
+	for (size_t i = 1; i < m_bands.size(); i++) {
+		s32 y = m_band_starts[i - 1];
+		within.clear();
+		blend.clear();
+		for (Biome *b : biomes) {
+			if (y < b->min_pos.Y || y > b->max_pos.Y + b->vertical_blend)
+				continue;
+			if (y <= b->max_pos.Y)
+				within.push_back(b);
+			else
+				blend.push_back(b);
+		}
+		m_bands[i].within.build(within);
+		m_bands[i].blend.build(blend);
+	}
+}
+
+
+Biome *BiomeIndex::get(float heat, float humidity, v3s16 pos) const
+{
+	size_t band = std::upper_bound(m_band_starts.begin(), m_band_starts.end(),
+		(s32)pos.Y) - m_band_starts.begin();
+
+	Biome *biome_closest = nullptr;
+	Biome *biome_closest_blend = nullptr;
+	float dist_min = FLT_MAX;
+	float dist_min_blend = FLT_MAX;
+
+	m_bands[band].within.findNearest(heat, humidity, pos,
+		&biome_closest, &dist_min);
+	m_bands[band].blend.findNearest(heat, humidity, pos,
+		&biome_closest_blend, &dist_min_blend);
+
+	// Carefully tune pseudorandom seed variation to avoid single node dither
+	// and create larger scale blending patterns similar to horizontal biome
+	// blend.
+	mysrand(pos.Y + (heat + humidity) * 0.9f);
+
+	if (biome_closest_blend && dist_min_blend <= dist_min &&
+			myrand_range(0, biome_closest_blend->vertical_blend) >=
+			pos.Y - biome_closest_blend->max_pos.Y)
+		return biome_closest_blend;
+
+	return biome_closest;
+}
+
+
+void BiomeIndex::Grid::build(const std::vector<Biome *> &points)
+{
+	if (points.empty())
+		return;
+
+	size = std::ceil(std::sqrt((double)points.size()));
+
+	float max_heat = -FLT_MAX;
+	float max_humidity = -FLT_MAX;
+	min_heat = FLT_MAX;
+	min_humidity = FLT_MAX;
+	for (const Biome *b : points) {
+		min_heat = MYMIN(min_heat, b->heat_point);
+		max_heat = MYMAX(max_heat, b->heat_point);
+		min_humidity = MYMIN(min_humidity, b->humidity_point);
+		max_humidity = MYMAX(max_humidity, b->humidity_point);
+	}
+	cell_heat = (max_heat - min_heat) / size;
+	cell_humidity = (max_humidity - min_humidity) / size;
+	if (!(cell_heat > 0.0))
+		cell_heat = 1.0;
+	if (!(cell_humidity > 0.0))
+		cell_humidity = 1.0;
+
+	// Counting sort by cell, keeps the order of the index within a cell
+	std::vector<s32> point_cells(points.size());
+	cells.assign(size * size + 1, 0);
+	for (size_t i = 0; i < points.size(); i++) {
+		point_cells[i] =
+			getCell(points[i]->humidity_point, min_humidity, cell_humidity) * size +
+			getCell(points[i]->heat_point, min_heat, cell_heat);
+		cells[point_cells[i] + 1]++;
+	}
+	for (s32 i = 0; i < size * size; i++)
+		cells[i + 1] += cells[i];
+
+	biomes.resize(points.size());
+	std::vector<u32> next(cells.begin(), cells.end() - 1);
+	for (size_t i = 0; i < points.size(); i++)
+		biomes[next[point_cells[i]]++] = points[i];
+}
+
+
+s32 BiomeIndex::Grid::getCell(float value, double min, double cell_size) const
+{
+	double c = ((double)value - min) / cell_size;
+	if (!(c >= 0.0)) // Also catches NaN
+		return 0;
+	if (c >= size)
+		return size - 1;
+	return (s32)c;
+}
+
+
+double BiomeIndex::Grid::getBound(double distance) const
+{
+	// Lower bound of the squared distance of points at least 'distance'
+	// away, as computed in float by findNearest(), with a margin for its
+	// rounding errors
+	if (!(distance > 0.0))
+		return 0.0;
+	return distance * distance * (1.0 - 1e-5) - 1e-12;
+}
+
+
+void BiomeIndex::Grid::searchCell(s32 x, s32 y, float heat, float humidity,
+	v3s16 pos, Biome **nearest, float *dist_min) const
+{
+	double dx = MYMAX(MYMAX(min_heat + x * cell_heat - heat,
+		heat - (min_heat + (x + 1) * cell_heat)), 0.0);
+	double dy = MYMAX(MYMAX(min_humidity + y * cell_humidity - humidity,
+		humidity - (min_humidity + (y + 1) * cell_humidity)), 0.0);
+	if (getBound(std::sqrt(dx * dx + dy * dy)) > *dist_min)
+		return;
+
+	s32 c = y * size + x;
+	for (u32 i = cells[c]; i < cells[c + 1]; i++) {
+		Biome *b = biomes[i];
+		if (pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
+				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
+			continue;
+
+		float d_heat = heat - b->heat_point;
+		float d_humidity = humidity - b->humidity_point;
+		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
+
+		// Same as the first closest biome in the order of the index
+		if (dist < *dist_min || (dist == *dist_min && *nearest &&
+				b->index < (*nearest)->index)) {
+			*dist_min = dist;
+			*nearest = b;
+		}
+	}
+}
+
+
+void BiomeIndex::Grid::findNearest(float heat, float humidity, v3s16 pos,
+	Biome **nearest, float *dist_min) const
+{
+	if (biomes.empty())
+		return;
+
+	s32 qx = getCell(heat, min_heat, cell_heat);
+	s32 qy = getCell(humidity, min_humidity, cell_humidity);
+
+	for (s32 r = 0; ; r++) {
+		s32 x0 = qx - r, x1 = qx + r;
+		s32 y0 = qy - r, y1 = qy + r;
+
+		// Cells on the ring around the cell of the query
+		for (s32 y = MYMAX(y0, 0); y <= MYMIN(y1, size - 1); y++) {
+			if (y == y0 || y == y1) {
+				for (s32 x = MYMAX(x0, 0); x <= MYMIN(x1, size - 1); x++)
+					searchCell(x, y, heat, humidity, pos, nearest, dist_min);
+				continue;
+			}
+			if (x0 >= 0)
+				searchCell(x0, y, heat, humidity, pos, nearest, dist_min);
+			if (x1 < size)
+				searchCell(x1, y, heat, humidity, pos, nearest, dist_min);
+		}
+
+		if (x0 <= 0 && y0 <= 0 && x1 >= size - 1 && y1 >= size - 1)
+			break;
+
+		// Cells further out are beyond the outer edges of the ring
+		double distance = DBL_MAX;
+		if (x0 > 0)
+			distance = MYMIN(distance, heat - (min_heat + x0 * cell_heat));
+		if (x1 < size - 1)
+			distance = MYMIN(distance, min_heat + (x1 + 1) * cell_heat - heat);
+		if (y0 > 0)
+			distance = MYMIN(distance, humidity - (min_humidity + y0 * cell_humidity));
+		if (y1 < size - 1)
+			distance = MYMIN(distance,
+				min_humidity + (y1 + 1) * cell_humidity - humidity);
+		if (getBound(distance) > *dist_min)
+			break;
+	}
+}
+
+
 BiomeGenOriginal::BiomeGenOriginal(BiomeManager *biomemgr,
 	BiomeParamsOriginal *params, v3s16 chunksize)
 {
 	m_bmgr   = biomemgr;
 	m_params = params;
 	m_csize  = chunksize;
+	m_index  = biomemgr->createIndex();
 
 	noise_heat           = new Noise(&params->np_heat,
 									params->seed, m_csize.X, m_csize.Z);
@@ -208,6 +428,8 @@ BiomeGenOriginal::~BiomeGenOriginal()
 	delete noise_humidity;
 	delete noise_heat_blend;
 	delete noise_humidity_blend;
+
+	delete m_index;
 }
 
 // Only usable in a mapgen thread
@@ -276,45 +498,8 @@ Biome *BiomeGenOriginal::getBiomeAtIndex(size_t index, v3s16 pos) const
 
 Biome *BiomeGenOriginal::calcBiomeFromNoise(float heat, float humidity, v3s16 pos) const
 {
-	Biome *biome_closest = nullptr;
-	Biome *biome_closest_blend = nullptr;
-	float dist_min = FLT_MAX;
-	float dist_min_blend = FLT_MAX;
-
-	for (size_t i = 1; i < m_bmgr->getNumObjects(); i++) {
-		Biome *b = (Biome *)m_bmgr->getRaw(i);
-		if (!b ||
-				pos.Y < b->min_pos.Y || pos.Y > b->max_pos.Y + b->vertical_blend ||
-				pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
-				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
-			continue;
-
-		float d_heat = heat - b->heat_point;
-		float d_humidity = humidity - b->humidity_point;
-		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
-
-		if (pos.Y <= b->max_pos.Y) { // Within y limits of biome b
-			if (dist < dist_min) {
-				dist_min = dist;
-				biome_closest = b;
-			}
-		} else if (dist < dist_min_blend) { // Blend area above biome b
-			dist_min_blend = dist;
-			biome_closest_blend = b;
-		}
-	}
-
-	// Carefully tune pseudorandom seed variation to avoid single node dither
-	// and create larger scale blending patterns similar to horizontal biome
-	// blend.
-	mysrand(pos.Y + (heat + humidity) * 0.9f);
-
-	if (biome_closest_blend && dist_min_blend <= dist_min &&
-			myrand_range(0, biome_closest_blend->vertical_blend) >=
-			pos.Y - biome_closest_blend->max_pos.Y)
-		return biome_closest_blend;
-
-	return (biome_closest) ? biome_closest : (Biome *)m_bmgr->getRaw(BIOME_NONE);	
+	Biome *biome = m_index->get(heat, humidity, pos);
+	return biome ? biome : (Biome *)m_bmgr->getRaw(BIOME_NONE);
 }
 
 
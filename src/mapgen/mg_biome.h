@@ -72,6 +72,62 @@ class Biome : public ObjDef, public NodeResolver {
 };
 
 
+////
+//// BiomeIndex
+////
+
+/*
+	Finds the biome for a heat, humidity and position with the same result
+	as comparing the distances to all biomes, including the dithering in
+	vertical blend areas.
+
+	The Y axis is split into bands in which the same biomes are candidates,
+	either within their Y limits or in their blend area above. The heat and
+	humidity points of the candidates of a band are put into a grid of about
+	one point per cell, which is searched in rings around the cell of the
+	query until no closer point can follow.
+*/
+class BiomeIndex {
+public:
+	// biomes must be ordered by their index
+	BiomeIndex(const std::vector<Biome *> &biomes);
+
+	// Returns nullptr if no biome contains pos
+	Biome *get(float heat, float humidity, v3s16 pos) const;
+
+private:
+	struct Grid {
+		void build(const std::vector<Biome *> &points);
+		// Keeps *nearest if it is closer or equally close with a lower index
+		void findNearest(float heat, float humidity, v3s16 pos,
+			Biome **nearest, float *dist_min) const;
+		void searchCell(s32 x, s32 y, float heat, float humidity, v3s16 pos,
+			Biome **nearest, float *dist_min) const;
+
+		s32 getCell(float value, double min, double cell_size) const;
+		double getBound(double distance) const;
+
+		double min_heat = 0.0;
+		double min_humidity = 0.0;
+		double cell_heat = 1.0;
+		double cell_humidity = 1.0;
+		s32 size = 0;
+		// Biomes of cell i are biomes[cells[i]] to biomes[cells[i + 1] - 1]
+		std::vector<u32> cells;
+		std::vector<Biome *> biomes;
+	};
+
+	struct Band {
+		Grid within;
+		Grid blend;
+	};
+
+	// Band i covers the Y values from band_starts[i - 1] to band_starts[i] - 1
+	std::vector<s32> m_band_starts;
+	std::vector<Band> m_bands;
+};
+
+
 ////
 //// BiomeGen
 ////
@@ -174,6 +230,7 @@ class BiomeGenOriginal : public BiomeGen {
 
 private:
 	BiomeParamsOriginal *m_params;
+	BiomeIndex *m_index;
 
 	Noise *noise_heat;
 	Noise *noise_humidity;
@@ -224,6 +281,9 @@ class BiomeManager : public ObjDefManager {
 
 	virtual void clear();
 
+	// Call after all biomes are registered
+	BiomeIndex *createIndex() const;
+
 	// For BiomeGen type 'BiomeGenOriginal'
 	float getHeatAtPosOriginal(v3s16 pos, NoiseParams &np_heat,
 		NoiseParams &np_heat_blend, u64 seed);
@@ -54,13 +54,14 @@ size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 	v3s16 nmin, v3s16 nmax)
 {
 	size_t nplaced = 0;
+	DecoSurfaceCache surfaces(mg, nmin, nmax);
 
 	for (size_t i = 0; i != m_objects.size(); i++) {
 		Decoration *deco = (Decoration *)m_objects[i];
 		if (!deco)
 			continue;
 
-		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax);
+		nplaced += deco->placeDeco(mg, blockseed, nmin, nmax, &surfaces);
 		blockseed++;
 	}
 
@@ -71,6 +72,93 @@ size_t DecorationManager::placeAllDecos(Mapgen *mg, u32 blockseed,
 ///////////////////////////////////////////////////////////////////////////////
 
 
+DecoSurfaceCache::DecoSurfaceCache(Mapgen *mg, v3s16 nmin, v3s16 nmax) :
+	m_mg(mg),
+	m_nmin(nmin),
+	m_nmax(nmax),
+	m_xsize(nmax.X - nmin.X + 1)
+{
+	u32 size = m_xsize * (nmax.Z - nmin.Z + 1);
+	m_scanned.resize(size, 0);
+	m_ground_level.resize(size);
+	m_liquid_surface.resize(size);
+}
+
+
+s16 DecoSurfaceCache::getGroundLevel(s16 x, s16 z)
+{
+	if (!contains(x, z))
+		return m_mg->findGroundLevel(v2s16(x, z), m_nmin.Y, m_nmax.Y);
+
+	u32 i = index(x, z);
+	if (!(m_scanned[i] & SCANNED_GROUND)) {
+		m_ground_level[i] = m_mg->findGroundLevel(v2s16(x, z),
+			m_nmin.Y, m_nmax.Y);
+		m_scanned[i] |= SCANNED_GROUND;
+	}
+	return m_ground_level[i];
+}
+
+
+s16 DecoSurfaceCache::getLiquidSurface(s16 x, s16 z)
+{
+	if (!contains(x, z))
+		return m_mg->findLiquidSurface(v2s16(x, z), m_nmin.Y, m_nmax.Y);
+
+	u32 i = index(x, z);
+	if (!(m_scanned[i] & SCANNED_LIQUID)) {
+		m_liquid_surface[i] = m_mg->findLiquidSurface(v2s16(x, z),
+			m_nmin.Y, m_nmax.Y);
+		m_scanned[i] |= SCANNED_LIQUID;
+	}
+	return m_liquid_surface[i];
+}
+
+
+const DecoSurfaceCache::Surfaces &DecoSurfaceCache::getSurfaces(s16 x, s16 z)
+{
+	if (!contains(x, z)) {
+		m_uncached.floors.clear();
+		m_uncached.ceilings.clear();
+		m_mg->getSurfaces(v2s16(x, z), m_nmin.Y, m_nmax.Y,
+			m_uncached.floors, m_uncached.ceilings);
+		return m_uncached;
+	}
+
+	if (m_surfaces.empty())
+		m_surfaces.resize(m_scanned.size());
+
+	u32 i = index(x, z);
+	Surfaces &surf = m_surfaces[i];
+	if (!(m_scanned[i] & SCANNED_SURFACES)) {
+		surf.floors.clear();
+		surf.ceilings.clear();
+		m_mg->getSurfaces(v2s16(x, z), m_nmin.Y, m_nmax.Y,
+			surf.floors, surf.ceilings);
+		m_scanned[i] |= SCANNED_SURFACES;
+	}
+	return surf;
+}
+
+
+void DecoSurfaceCache::invalidate(s16 x, s16 z, s16 radius)
+{
+	s16 x0 = MYMAX(x - radius, m_nmin.X);
+	s16 x1 = MYMIN(x + radius, m_nmax.X);
+	s16 z0 = MYMAX(z - radius, m_nmin.Z);
+	s16 z1 = MYMIN(z + radius, m_nmax.Z);
+
+	for (s16 zi = z0; zi <= z1; zi++) {
+		u32 i = index(x0, zi);
+		for (s16 xi = x0; xi <= x1; xi++, i++)
+			m_scanned[i] = 0;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+
 void Decoration::resolveNodeNames()
 {
 	getIdsFromNrBacklog(&c_place_on);
@@ -127,7 +215,8 @@ bool Decoration::canPlaceDecoration(MMVManip *vm, v3s16 p)
 }
 
 
-size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
+size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+	DecoSurfaceCache *surfaces)
 {
 	PcgRandom ps(blockseed + 53);
 	int carea_size = nmax.X - nmin.X + 1;
@@ -205,48 +294,49 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 						continue;
 				}
 
-				// Get all floors and ceilings in node column
-				u16 size = (nmax.Y - nmin.Y + 1) / 2;
-				std::vector<s16> floors;
-				std::vector<s16> ceilings;
-				floors.reserve(size);
-				ceilings.reserve(size);
-
-				mg->getSurfaces(v2s16(x, z), nmin.Y, nmax.Y, floors, ceilings);
+				// Get all floors and ceilings in node column. Placing a
+				// decoration only marks the column for a new scan, the
+				// surfaces found before stay valid while they are used.
+				const DecoSurfaceCache::Surfaces &surf =
+					surfaces->getSurfaces(x, z);
 
 				if (flags & DECO_ALL_FLOORS) {
 					// Floor decorations
-					for (const s16 y : floors) {
+					for (const s16 y : surf.floors) {
 						if (y < y_min || y > y_max)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, false))
+						if (generate(mg->vm, &ps, pos, false)) {
+							surfaces->invalidate(x, z, getReach());
 							mg->gennotify.addEvent(
 									GENNOTIFY_DECORATION, pos, index);
+						}
 					}
 				}
 
 				if (flags & DECO_ALL_CEILINGS) {
 					// Ceiling decorations
-					for (const s16 y : ceilings) {
+					for (const s16 y : surf.ceilings) {
 						if (y < y_min || y > y_max)
 							continue;
 
 						v3s16 pos(x, y, z);
-						if (generate(mg->vm, &ps, pos, true))
+						if (generate(mg->vm, &ps, pos, true)) {
+							surfaces->invalidate(x, z, getReach());
 							mg->gennotify.addEvent(
 									GENNOTIFY_DECORATION, pos, index);
+						}
 					}
 				}
 			} else { // Heightmap decorations
 				s16 y = -MAX_MAP_GENERATION_LIMIT;
 				if (flags & DECO_LIQUID_SURFACE)
-					y = mg->findLiquidSurface(v2s16(x, z), nmin.Y, nmax.Y);
+					y = surfaces->getLiquidSurface(x, z);
 				else if (mg->heightmap)
 					y = mg->heightmap[mapindex];
 				else
-					y = mg->findGroundLevel(v2s16(x, z), nmin.Y, nmax.Y);
+					y = surfaces->getGroundLevel(x, z);
 
 				if (y < y_min || y > y_max || y < nmin.Y || y > nmax.Y)
 					continue;
@@ -259,8 +349,10 @@ size_t Decoration::placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax)
 				}
 
 				v3s16 pos(x, y, z);
-				if (generate(mg->vm, &ps, pos, false))
+				if (generate(mg->vm, &ps, pos, false)) {
+					surfaces->invalidate(x, z, getReach());
 					mg->gennotify.addEvent(GENNOTIFY_DECORATION, pos, index);
+				}
 			}
 		}
 	}
@@ -402,3 +494,14 @@ size_t DecoSchematic::generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceilin
 
 	return 1;
 }
+
+
+s16 DecoSchematic::getReach() const
+{
+	// Rotation and centering keep the schematic within its largest
+	// horizontal size of the placement position
+	if (schematic == NULL)
+		return 0;
+
+	return MYMAX(schematic->size.X, schematic->size.Z) - 1;
+}
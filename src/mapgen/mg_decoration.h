@@ -48,6 +48,64 @@ enum DecorationType {
 extern FlagDesc flagdesc_deco[];
 
 
+/*
+	Ground levels, liquid surfaces and floors and ceilings of the node
+	columns of a mapchunk, shared by all decorations placed in it.
+
+	A column is scanned when a decoration first needs it and again after a
+	decoration was placed over it, so the results are the same as when
+	every decoration scans the voxel manipulator itself.
+*/
+class DecoSurfaceCache {
+public:
+	struct Surfaces {
+		std::vector<s16> floors;
+		std::vector<s16> ceilings;
+	};
+
+	DecoSurfaceCache(Mapgen *mg, v3s16 nmin, v3s16 nmax);
+
+	s16 getGroundLevel(s16 x, s16 z);
+	s16 getLiquidSurface(s16 x, s16 z);
+	// The result stays unchanged until the column is scanned again
+	const Surfaces &getSurfaces(s16 x, s16 z);
+
+	// Marks the columns within radius of (x, z) as changed
+	void invalidate(s16 x, s16 z, s16 radius);
+
+private:
+	enum {
+		SCANNED_GROUND   = 0x01,
+		SCANNED_LIQUID   = 0x02,
+		SCANNED_SURFACES = 0x04,
+	};
+
+	// Decorations placed by Lua on a voxel manipulator that is not square
+	// can ask for columns outside of the area, these are not cached.
+	bool contains(s16 x, s16 z) const
+	{
+		return x >= m_nmin.X && x <= m_nmax.X &&
+			z >= m_nmin.Z && z <= m_nmax.Z;
+	}
+
+	u32 index(s16 x, s16 z) const
+	{
+		return (z - m_nmin.Z) * m_xsize + (x - m_nmin.X);
+	}
+
+	Mapgen *m_mg;
+	v3s16 m_nmin;
+	v3s16 m_nmax;
+	s16 m_xsize;
+	std::vector<u8> m_scanned;
+	std::vector<s16> m_ground_level;
+	std::vector<s16> m_liquid_surface;
+	// Only allocated when a decoration needs all surfaces
+	std::vector<Surfaces> m_surfaces;
+	Surfaces m_uncached;
+};
+
+
 class Decoration : public ObjDef, public NodeResolver {
 public:
 	Decoration() = default;
@@ -56,9 +114,12 @@ class Decoration : public ObjDef, public NodeResolver {
 	virtual void resolveNodeNames();
 
 	bool canPlaceDecoration(MMVManip *vm, v3s16 p);
-	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax);
+	size_t placeDeco(Mapgen *mg, u32 blockseed, v3s16 nmin, v3s16 nmax,
+		DecoSurfaceCache *surfaces);
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling) = 0;
+	// Horizontal distance from p at which generate() may change nodes
+	virtual s16 getReach() const { return 0; }
 
 	u32 flags = 0;
 	int mapseed = 0;
@@ -94,6 +155,7 @@ class DecoSchematic : public Decoration {
 	DecoSchematic() = default;
 
 	virtual size_t generate(MMVManip *vm, PcgRandom *pr, v3s16 p, bool ceiling);
+	virtual s16 getReach() const;
 
 	Rotation rotation;
 	Schematic *schematic = nullptr;
@@ -128,6 +128,8 @@ void OreScatter::generate(MMVManip *vm, int mapseed, u32 blockseed,
 		int y0 = pr.range(nmin.Y, nmax.Y - csize + 1);
 		int z0 = pr.range(nmin.Z, nmax.Z - csize + 1);
 
+		// Whether a cluster is skipped decides how many random numbers it
+		// uses, so the position of the next cluster depends on this noise
 		if ((flags & OREFLAG_USE_NOISE) &&
 			(NoisePerlin3D(&np, x0, y0, z0, mapseed) < nthresh))
 			continue;
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <cstring>
 #include <fstream>
 #include <typeinfo>
 #include "mg_schematic.h"
@@ -88,86 +89,177 @@ void Schematic::resolveNodeNames()
 		content_t c_new = c_nodes[c_original];
 		schemdata[i].setContent(c_new);
 	}
+
+	compileRotations();
 }
 
 
-void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+void Schematic::compileRotations()
 {
-	sanity_check(m_ndef != NULL);
-
 	int xstride = 1;
 	int ystride = size.X;
 	int zstride = size.X * size.Y;
 
-	s16 sx = size.X;
-	s16 sy = size.Y;
-	s16 sz = size.Z;
-
-	int i_start, i_step_x, i_step_z;
-	switch (rot) {
-		case ROTATE_90:
-			i_start  = sx - 1;
-			i_step_x = zstride;
-			i_step_z = -xstride;
-			SWAP(s16, sx, sz);
-			break;
-		case ROTATE_180:
-			i_start  = zstride * (sz - 1) + sx - 1;
-			i_step_x = -xstride;
-			i_step_z = -zstride;
-			break;
-		case ROTATE_270:
-			i_start  = zstride * (sz - 1);
-			i_step_x = -zstride;
-			i_step_z = xstride;
-			SWAP(s16, sx, sz);
-			break;
-		default:
-			i_start  = 0;
-			i_step_x = xstride;
-			i_step_z = zstride;
+	for (int rot = ROTATE_0; rot <= ROTATE_270; rot++) {
+		RotatedSchematic &rs = m_rotated[rot];
+		s16 sx = size.X;
+		s16 sy = size.Y;
+		s16 sz = size.Z;
+
+		// Same walk through schemdata as the rotated blit used to do
+		int i_start, i_step_x, i_step_z;
+		switch (rot) {
+			case ROTATE_90:
+				i_start  = sx - 1;
+				i_step_x = zstride;
+				i_step_z = -xstride;
+				SWAP(s16, sx, sz);
+				break;
+			case ROTATE_180:
+				i_start  = zstride * (sz - 1) + sx - 1;
+				i_step_x = -xstride;
+				i_step_z = -zstride;
+				break;
+			case ROTATE_270:
+				i_start  = zstride * (sz - 1);
+				i_step_x = -zstride;
+				i_step_z = xstride;
+				SWAP(s16, sx, sz);
+				break;
+			default:
+				i_start  = 0;
+				i_step_x = xstride;
+				i_step_z = zstride;
+		}
+
+		rs.size = v3s16(sx, sy, sz);
+		rs.nodes.clear();
+		rs.runs.clear();
+		rs.prob_nodes.clear();
+		rs.slice_runs.clear();
+		rs.slice_prob_nodes.clear();
+
+		for (s16 y = 0; y != sy; y++) {
+			rs.slice_runs.push_back(rs.runs.size());
+			rs.slice_prob_nodes.push_back(rs.prob_nodes.size());
+
+			for (s16 z = 0; z != sz; z++) {
+				bool in_run = false;
+				u32 i = z * i_step_z + y * ystride + i_start;
+				for (s16 x = 0; x != sx; x++, i += i_step_x) {
+					u8 placement_prob = schemdata[i].param1 & MTSCHEM_PROB_MASK;
+					bool force_place_node = schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+
+					if (schemdata[i].getContent() == CONTENT_IGNORE ||
+							placement_prob == MTSCHEM_PROB_NEVER) {
+						in_run = false;
+						continue;
+					}
+
+					MapNode n = schemdata[i];
+					n.param1 = 0;
+					if (rot)
+						n.rotateAlongYAxis(m_ndef, (Rotation)rot);
+
+					if (placement_prob != MTSCHEM_PROB_ALWAYS) {
+						rs.prob_nodes.push_back({x, z, placement_prob,
+							force_place_node, n});
+						in_run = false;
+						continue;
+					}
+
+					if (!in_run || rs.runs.back().force_place != force_place_node) {
+						rs.runs.push_back({x, z, 0, force_place_node,
+							(u32)rs.nodes.size()});
+						in_run = true;
+					}
+					rs.nodes.push_back(n);
+					rs.runs.back().length++;
+				}
+			}
+		}
+
+		rs.slice_runs.push_back(rs.runs.size());
+		rs.slice_prob_nodes.push_back(rs.prob_nodes.size());
 	}
 
+	m_rotated_valid = true;
+}
+
+
+void Schematic::blitToVManip(MMVManip *vm, v3s16 p, Rotation rot, bool force_place)
+{
+	sanity_check(m_ndef != NULL);
+
+	if (!m_rotated_valid)
+		compileRotations();
+
+	const RotatedSchematic &rs = m_rotated[rot <= ROTATE_270 ? rot : ROTATE_0];
+	const VoxelArea &area = vm->m_area;
+
+	// Part of each row that is inside the voxel manipulator
+	s16 x_min = MYMAX(area.MinEdge.X - p.X, 0);
+	s16 x_max = MYMIN(area.MaxEdge.X - p.X, rs.size.X - 1);
+
 	s16 y_map = p.Y;
-	for (s16 y = 0; y != sy; y++) {
+	for (s16 y = 0; y != rs.size.Y; y++) {
 		if ((slice_probs[y] != MTSCHEM_PROB_ALWAYS) &&
 			(slice_probs[y] <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
 			continue;
 
-		for (s16 z = 0; z != sz; z++) {
-			u32 i = z * i_step_z + y * ystride + i_start;
-			for (s16 x = 0; x != sx; x++, i += i_step_x) {
-				v3s16 pos(p.X + x, y_map, p.Z + z);
-				if (!vm->m_area.contains(pos))
-					continue;
-
-				if (schemdata[i].getContent() == CONTENT_IGNORE)
-					continue;
+		if (y_map < area.MinEdge.Y || y_map > area.MaxEdge.Y) {
+			y_map++;
+			continue;
+		}
 
-				u8 placement_prob     = schemdata[i].param1 & MTSCHEM_PROB_MASK;
-				bool force_place_node = schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+		// Runs never consume random numbers, so they can be placed before
+		// the probability nodes of the same slice
+		for (u32 r = rs.slice_runs[y]; r != rs.slice_runs[y + 1]; r++) {
+			const RotatedSchematic::Run &run = rs.runs[r];
+			s16 z_map = p.Z + run.z;
+			if (z_map < area.MinEdge.Z || z_map > area.MaxEdge.Z)
+				continue;
+
+			s16 x0 = MYMAX(run.x, x_min);
+			s16 x1 = MYMIN(run.x + run.length - 1, x_max);
+			if (x0 > x1)
+				continue;
+
+			const MapNode *src = &rs.nodes[run.first + x0 - run.x];
+			MapNode *dst = &vm->m_data[area.index(p.X + x0, y_map, z_map)];
+			u32 count = x1 - x0 + 1;
+
+			if (force_place || run.force_place) {
+				memcpy(dst, src, count * sizeof(MapNode));
+				continue;
+			}
 
-				if (placement_prob == MTSCHEM_PROB_NEVER)
-					continue;
+			for (u32 i = 0; i != count; i++) {
+				content_t c = dst[i].getContent();
+				if (c == CONTENT_AIR || c == CONTENT_IGNORE)
+					dst[i] = src[i];
+			}
+		}
 
-				u32 vi = vm->m_area.index(pos);
-				if (!force_place && !force_place_node) {
-					content_t c = vm->m_data[vi].getContent();
-					if (c != CONTENT_AIR && c != CONTENT_IGNORE)
-						continue;
-				}
+		for (u32 j = rs.slice_prob_nodes[y]; j != rs.slice_prob_nodes[y + 1]; j++) {
+			const RotatedSchematic::ProbNode &pn = rs.prob_nodes[j];
+			v3s16 pos(p.X + pn.x, y_map, p.Z + pn.z);
+			if (!area.contains(pos))
+				continue;
 
-				if ((placement_prob != MTSCHEM_PROB_ALWAYS) &&
-					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+			u32 vi = area.index(pos);
+			if (!force_place && !pn.force_place) {
+				content_t c = vm->m_data[vi].getContent();
+				if (c != CONTENT_AIR && c != CONTENT_IGNORE)
 					continue;
+			}
 
-				vm->m_data[vi] = schemdata[i];
-				vm->m_data[vi].param1 = 0;
+			if (pn.prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS))
+				continue;
 
-				if (rot)
-					vm->m_data[vi].rotateAlongYAxis(m_ndef, rot);
-			}
+			vm->m_data[vi] = pn.n;
 		}
+
 		y_map++;
 	}
 }
@@ -303,6 +395,7 @@ bool Schematic::deserializeFromMts(std::istream *is,
 
 	delete []schemdata;
 	schemdata = new MapNode[nodecount];
+	m_rotated_valid = false;
 
 	MapNode::deSerializeBulk(ss, SER_FMT_VER_HIGHEST_READ, schemdata,
 		nodecount, 2, 2, true);
@@ -514,6 +607,7 @@ bool Schematic::getSchematicFromMap(Map *map, v3s16 p1, v3s16 p2)
 		slice_probs[y] = MTSCHEM_PROB_ALWAYS;
 
 	schemdata = new MapNode[size.X * size.Y * size.Z];
+	m_rotated_valid = false;
 
 	u32 i = 0;
 	for (s16 z = p1.Z; z <= p2.Z; z++)
@@ -534,6 +628,8 @@ void Schematic::applyProbabilities(v3s16 p0,
 	std::vector<std::pair<v3s16, u8> > *plist,
 	std::vector<std::pair<s16, u8> > *splist)
 {
+	m_rotated_valid = false;
+
 	for (size_t i = 0; i != plist->size(); i++) {
 		v3s16 p = (*plist)[i].first - p0;
 		int index = p.Z * (size.Y * size.X) + p.Y * size.X + p.X;
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <map>
+#include <vector>
 #include "mg_decoration.h"
 #include "util/string.h"
 
@@ -121,6 +122,46 @@ class Schematic : public ObjDef, public NodeResolver {
 	v3s16 size;
 	MapNode *schemdata = nullptr;
 	u8 *slice_probs = nullptr;
+
+private:
+	/*
+		The schematic in one rotation, prepared for blitToVManip().
+		Nodes that are always placed are stored as runs along X that
+		are copied as a whole, with param1 cleared and param2 already
+		rotated. Nodes with a placement probability are kept in a
+		separate list. Both are sorted by Y slice.
+	*/
+	struct RotatedSchematic {
+		struct Run {
+			s16 x;
+			s16 z;
+			u16 length;
+			bool force_place;
+			u32 first;   // Index in nodes
+		};
+
+		struct ProbNode {
+			s16 x;
+			s16 z;
+			u8 prob;
+			bool force_place;
+			MapNode n;
+		};
+
+		v3s16 size;
+		std::vector<MapNode> nodes;
+		std::vector<Run> runs;
+		std::vector<ProbNode> prob_nodes;
+		// First run and probability node of each slice, size.Y + 1 entries
+		std::vector<u32> slice_runs;
+		std::vector<u32> slice_prob_nodes;
+	};
+
+	// Builds m_rotated from schemdata, needs resolved content ids
+	void compileRotations();
+
+	RotatedSchematic m_rotated[4];
+	bool m_rotated_valid = false;
 };
 
 class SchematicManager : public ObjDefManager {
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "util/base64.h"
 #include "chatmessage.h"
+#include "client/blockcache.h"
 #include "client/clientmedia.h"
 #include "log.h"
 #include "map.h"
@@ -37,6 +38,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/connection.h"
 #include "script/scripting_client.h"
 #include "util/serialize.h"
+#include "util/sha1.h"
 #include "util/srp.h"
 #include "tileanimation.h"
 #include "gettext.h"
@@ -133,6 +135,8 @@ void Client::handleCommand_AuthAccept(NetworkPacket* pkt)
 	infostream << "Client: received recommended send interval "
 					<< m_recommended_send_interval<<std::endl;
 
+	initBlockCache();
+
 	// Reply to server
 	std::string lang = gettext("LANG_CODE");
 	if (lang == "LANG_CODE")
@@ -282,6 +286,33 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	*pkt >> p;
 
 	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
+
+	if (m_block_cache)
+		m_block_cache->store(p, datastring);
+
+	deSerializeBlock(p, datastring);
+}
+
+void Client::handleCommand_BlockDataCached(NetworkPacket* pkt)
+{
+	v3s16 p;
+	*pkt >> p;
+
+	std::string datastring;
+	if (!m_block_cache || !m_block_cache->load(p, &datastring)) {
+		// Cache entry is gone, have the server send the full block
+		infostream << "Client: cached block " << PP(p)
+				<< " missing, requesting it again" << std::endl;
+		std::vector<v3s16> blocks = { p };
+		sendDeletedBlocks(blocks);
+		return;
+	}
+
+	deSerializeBlock(p, datastring);
+}
+
+void Client::deSerializeBlock(v3s16 p, const std::string &datastring)
+{
 	std::istringstream istr(datastring, std::ios_base::binary);
 
 	MapSector *sector;
@@ -626,8 +657,10 @@ void Client::handleCommand_AnnounceMedia(NetworkPacket* pkt)
 
 	// Mesh update thread must be stopped while
 	// updating content definitions
-	sanity_check(!m_mesh_update_thread.isRunning());
+	sanity_check(!m_mesh_update_manager.isRunning());
 
+	// Sorted, so that the media hash does not depend on the order
+	std::map<std::string, std::string> media;
 	for (u16 i = 0; i < num_files; i++) {
 		std::string name, sha1_base64;
 
@@ -635,7 +668,17 @@ void Client::handleCommand_AnnounceMedia(NetworkPacket* pkt)
 
 		std::string sha1_raw = base64_decode(sha1_base64);
 		m_media_downloader->addFile(name, sha1_raw);
+		media[name] = sha1_raw;
+	}
+
+	SHA1 media_sha1;
+	for (const auto &it : media) {
+		media_sha1.addBytes(it.first.c_str(), it.first.size() + 1);
+		media_sha1.addBytes(it.second.c_str(), it.second.size());
 	}
+	unsigned char *digest = media_sha1.getDigest();
+	m_media_hash.assign((char *)digest, 20);
+	free(digest);
 
 	try {
 		std::string str;
@@ -697,7 +740,7 @@ void Client::handleCommand_Media(NetworkPacket* pkt)
 
 	// Mesh update thread must be stopped while
 	// updating content definitions
-	sanity_check(!m_mesh_update_thread.isRunning());
+	sanity_check(!m_mesh_update_manager.isRunning());
 
 	for (u32 i=0; i < num_files; i++) {
 		std::string name;
@@ -718,7 +761,7 @@ void Client::handleCommand_NodeDef(NetworkPacket* pkt)
 
 	// Mesh update thread must be stopped while
 	// updating content definitions
-	sanity_check(!m_mesh_update_thread.isRunning());
+	sanity_check(!m_mesh_update_manager.isRunning());
 
 	// Decompress node definitions
 	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
@@ -738,7 +781,7 @@ void Client::handleCommand_ItemDef(NetworkPacket* pkt)
 
 	// Mesh update thread must be stopped while
 	// updating content definitions
-	sanity_check(!m_mesh_update_thread.isRunning());
+	sanity_check(!m_mesh_update_manager.isRunning());
 
 	// Decompress item definitions
 	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
@@ -194,9 +194,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 		New network float format
 		ContentFeatures version 13
 		Add full Euler rotations instead of just yaw
+	PROTOCOL VERSION 38:
+		Add TOSERVER_CACHED_BLOCKS and TOCLIENT_BLOCKDATA_CACHED
 */
 
-#define LATEST_PROTOCOL_VERSION 37
+#define LATEST_PROTOCOL_VERSION 38
 #define LATEST_PROTOCOL_VERSION_STRING TOSTRING(LATEST_PROTOCOL_VERSION)
 
 // Server's supported network protocol range
@@ -209,6 +211,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define CLIENT_PROTOCOL_VERSION_MIN 37
 #define CLIENT_PROTOCOL_VERSION_MAX LATEST_PROTOCOL_VERSION
 
+// Seed of the block hashes in TOSERVER_CACHED_BLOCKS
+#define BLOCK_CACHE_HASH_SEED 0x6d62636b
+// Maximum number of blocks a client may announce with TOSERVER_CACHED_BLOCKS
+#define BLOCK_CACHE_MAX_ANNOUNCED 16384
+
 // Constant that differentiates the protocol from random data and other protocols
 #define PROTOCOL_ID 0x4f457403
 
@@ -670,7 +677,15 @@ enum ToClientCommand
 		u8[len] formspec
 	*/
 
-	TOCLIENT_NUM_MSG_TYPES = 0x62,
+	TOCLIENT_BLOCKDATA_CACHED = 0x62,
+	/*
+		Sent instead of TOCLIENT_BLOCKDATA when the client announced the
+		same block content with TOSERVER_CACHED_BLOCKS.
+
+		v3s16 position
+	*/
+
+	TOCLIENT_NUM_MSG_TYPES = 0x63,
 };
 
 enum ToServerCommand
@@ -885,7 +900,20 @@ enum ToServerCommand
 		std::string bytes_M
 	*/
 
-	TOSERVER_NUM_MSG_TYPES = 0x53,
+	TOSERVER_CACHED_BLOCKS = 0x53,
+	/*
+		Blocks the client has in its block cache. The hash is
+		murmur_hash_64_ua over the TOCLIENT_BLOCKDATA payload following
+		the position, with seed BLOCK_CACHE_HASH_SEED.
+
+		u16 count
+		for each block {
+			v3s16 position
+			u64 hash
+		}
+	*/
+
+	TOSERVER_NUM_MSG_TYPES = 0x54,
 };
 
 enum AuthMechanism
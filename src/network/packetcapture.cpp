@@ -0,0 +1,170 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "packetcapture.h"
+#include <algorithm>
+#include "networkpacket.h"
+#include "log.h"
+#include "porting.h"
+#include "threading/mutex_auto_lock.h"
+#include "util/serialize.h"
+
+void CapturedPacket::toNetworkPacket(NetworkPacket *pkt, session_t new_peer_id) const
+{
+	std::vector<u8> raw(2 + data.size());
+	writeU16(&raw[0], command);
+	if (!data.empty())
+		memcpy(&raw[2], data.c_str(), data.size());
+	pkt->putRawPacket(&raw[0], raw.size(), new_peer_id);
+}
+
+/*
+	PacketCaptureWriter
+*/
+
+PacketCaptureWriter::PacketCaptureWriter(const std::string &path) :
+	m_os(path.c_str(), std::ios::binary | std::ios::trunc),
+	m_start_ms(porting::getTimeMs())
+{
+	if (!m_os.good()) {
+		errorstream << "PacketCaptureWriter: cannot open \"" << path
+				<< "\" for writing" << std::endl;
+		return;
+	}
+
+	writeU32(m_os, PACKET_CAPTURE_MAGIC);
+	writeU8(m_os, PACKET_CAPTURE_VERSION);
+}
+
+PacketCaptureWriter::~PacketCaptureWriter()
+{
+	m_os.flush();
+}
+
+/*
+	Commands of the login sequence, which carry the password verifier and
+	SRP values of the player. They must never end up in a capture file; the
+	load generator sends its own when replaying.
+*/
+static bool is_login_command(u16 command)
+{
+	switch (command) {
+	case TOSERVER_INIT:
+	case TOSERVER_INIT_LEGACY:
+	case TOSERVER_INIT2:
+	case TOSERVER_PASSWORD_LEGACY:
+	case TOSERVER_FIRST_SRP:
+	case TOSERVER_SRP_BYTES_A:
+	case TOSERVER_SRP_BYTES_M:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void PacketCaptureWriter::record(NetworkPacket *pkt)
+{
+	if (is_login_command(pkt->getCommand()))
+		return;
+
+	CapturedPacket cp;
+	cp.time_ms = porting::getTimeMs() - m_start_ms;
+	cp.peer_id = pkt->getPeerId();
+	cp.command = pkt->getCommand();
+	if (pkt->getSize() > 0)
+		cp.data.assign(pkt->getString(0), pkt->getSize());
+	record(cp);
+}
+
+void PacketCaptureWriter::record(const CapturedPacket &cp)
+{
+	if (is_login_command(cp.command))
+		return;
+
+	MutexAutoLock lock(m_mutex);
+	if (!m_os.good())
+		return;
+
+	writeU32(m_os, cp.time_ms);
+	writeU16(m_os, cp.peer_id);
+	writeU16(m_os, cp.command);
+	writeU32(m_os, cp.data.size());
+	m_os.write(cp.data.c_str(), cp.data.size());
+}
+
+/*
+	PacketCaptureReader
+*/
+
+PacketCaptureReader::PacketCaptureReader(const std::string &path) :
+	m_is(path.c_str(), std::ios::binary)
+{
+	if (!m_is.good()) {
+		errorstream << "PacketCaptureReader: cannot open \"" << path
+				<< "\"" << std::endl;
+		return;
+	}
+
+	u32 magic = readU32(m_is);
+	u8 version = readU8(m_is);
+	if (magic != PACKET_CAPTURE_MAGIC || version != PACKET_CAPTURE_VERSION) {
+		errorstream << "PacketCaptureReader: \"" << path
+				<< "\" is not a supported packet capture" << std::endl;
+		return;
+	}
+
+	m_is_open = true;
+}
+
+bool PacketCaptureReader::next(CapturedPacket *cp)
+{
+	if (!m_is_open)
+		return false;
+
+	cp->time_ms = readU32(m_is);
+	cp->peer_id = readU16(m_is);
+	cp->command = readU16(m_is);
+	u32 size = readU32(m_is);
+	if (!m_is.good())
+		return false;
+
+	cp->data.resize(size);
+	if (size > 0)
+		m_is.read(&cp->data[0], size);
+
+	return m_is.gcount() == (std::streamsize)size || size == 0;
+}
+
+bool PacketCaptureReader::readAll(const std::string &path,
+		std::vector<CapturedPacket> *packets)
+{
+	PacketCaptureReader reader(path);
+	if (!reader.isOpen())
+		return false;
+
+	CapturedPacket cp;
+	while (reader.next(&cp))
+		packets->push_back(cp);
+
+	std::stable_sort(packets->begin(), packets->end(),
+		[] (const CapturedPacket &a, const CapturedPacket &b) {
+			return a.time_ms < b.time_ms;
+		});
+	return true;
+}
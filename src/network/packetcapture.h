@@ -0,0 +1,96 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "networkprotocol.h"
+
+class NetworkPacket;
+
+/*
+	Packet capture files store a stream of inbound (TOSERVER) packets
+	so that it can be replayed against a server later on, e.g. by the
+	load generator. Login and authentication packets are not recorded.
+
+	Format:
+	[0] u32 magic "MTPC"
+	[4] u8 version
+	for each packet {
+		u32 time since capture start in milliseconds
+		u16 peer id
+		u16 command
+		u32 payload length
+		payload
+	}
+*/
+
+#define PACKET_CAPTURE_MAGIC 0x4d545043 // "MTPC"
+#define PACKET_CAPTURE_VERSION 1
+
+struct CapturedPacket
+{
+	u32 time_ms = 0;
+	session_t peer_id = 0;
+	u16 command = 0;
+	std::string data;
+
+	// Creates a packet suitable for sending or handing to a packet handler
+	void toNetworkPacket(NetworkPacket *pkt, session_t new_peer_id) const;
+};
+
+class PacketCaptureWriter
+{
+public:
+	PacketCaptureWriter(const std::string &path);
+	~PacketCaptureWriter();
+
+	bool isOpen() const { return m_os.good(); }
+
+	void record(NetworkPacket *pkt);
+	void record(const CapturedPacket &cp);
+
+private:
+	std::ofstream m_os;
+	u64 m_start_ms;
+	std::mutex m_mutex;
+};
+
+class PacketCaptureReader
+{
+public:
+	PacketCaptureReader(const std::string &path);
+
+	bool isOpen() const { return m_is_open; }
+
+	// Returns false at the end of the file or on a truncated record
+	bool next(CapturedPacket *cp);
+
+	// Reads the whole file, packets are ordered by capture time
+	static bool readAll(const std::string &path,
+			std::vector<CapturedPacket> *packets);
+
+private:
+	std::ifstream m_is;
+	bool m_is_open = false;
+};
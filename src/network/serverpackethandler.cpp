@@ -34,6 +34,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/connection.h"
 #include "network/networkprotocol.h"
 #include "network/serveropcodes.h"
+#include "server/authworker.h"
 #include "util/auth.h"
 #include "util/base64.h"
 #include "util/pointedthing.h"
@@ -555,6 +556,37 @@ void Server::handleCommand_DeletedBlocks(NetworkPacket* pkt)
 	}
 }
 
+void Server::handleCommand_CachedBlocks(NetworkPacket* pkt)
+{
+	/*
+		[0] u16 command
+		[2] u16 count
+		[4] v3s16 pos_0
+		[4+6] u64 hash_0
+		...
+	*/
+
+	u16 count;
+	*pkt >> count;
+
+	RemoteClient *client = getClient(pkt->getPeerId(), CS_InitDone);
+
+	if (pkt->getSize() < 2 + (u32)count * (6 + 8)) {
+		throw con::InvalidIncomingDataException
+				("CACHED_BLOCKS length is too short");
+	}
+
+	for (u16 i = 0; i < count; i++) {
+		v3s16 p;
+		u64 hash;
+		*pkt >> p >> hash;
+		client->SetBlockCached(p, hash);
+	}
+
+	verbosestream << "Server: " << getPlayerName(pkt->getPeerId())
+			<< " has " << count << " cached blocks" << std::endl;
+}
+
 void Server::handleCommand_InventoryAction(NetworkPacket* pkt)
 {
 	RemotePlayer *player = m_env->getPlayer(pkt->getPeerId());
@@ -1663,14 +1695,18 @@ void Server::handleCommand_SrpBytesA(NetworkPacket* pkt)
 
 	client->chosen_mech = chosen;
 
-	std::string salt;
-	std::string verifier;
+	SrpJob job;
+	job.type = SRP_JOB_START;
+	job.peer_id = pkt->getPeerId();
+	job.want_sudo = wantSudo;
+	job.name = client->getName();
+	job.bytes_A = bytes_A;
 
 	if (based_on == 0) {
-
-		generate_srp_verifier_and_salt(client->getName(), client->enc_pwd,
-			&verifier, &salt);
-	} else if (!decode_srp_verifier_and_salt(client->enc_pwd, &verifier, &salt)) {
+		job.legacy_password = true;
+		job.password = client->enc_pwd;
+	} else if (!decode_srp_verifier_and_salt(client->enc_pwd,
+			&job.srp_verifier, &job.salt)) {
 		// Non-base64 errors should have been catched in the init handler
 		actionstream << "Server: User " << client->getName()
 			<< " tried to log in, but srp verifier field"
@@ -1679,33 +1715,9 @@ void Server::handleCommand_SrpBytesA(NetworkPacket* pkt)
 		return;
 	}
 
-	char *bytes_B = 0;
-	size_t len_B = 0;
-
-	client->auth_data = srp_verifier_new(SRP_SHA256, SRP_NG_2048,
-		client->getName().c_str(),
-		(const unsigned char *) salt.c_str(), salt.size(),
-		(const unsigned char *) verifier.c_str(), verifier.size(),
-		(const unsigned char *) bytes_A.c_str(), bytes_A.size(),
-		NULL, 0,
-		(unsigned char **) &bytes_B, &len_B, NULL, NULL);
-
-	if (!bytes_B) {
-		actionstream << "Server: User " << client->getName()
-			<< " tried to log in, SRP-6a safety check violated in _A handler."
-			<< std::endl;
-		if (wantSudo) {
-			DenySudoAccess(pkt->getPeerId());
-			return;
-		}
-
-		DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_UNEXPECTED_DATA);
-		return;
-	}
-
-	NetworkPacket resp_pkt(TOCLIENT_SRP_BYTES_S_B, 0, pkt->getPeerId());
-	resp_pkt << salt << std::string(bytes_B, len_B);
-	Send(&resp_pkt);
+	// The answer is sent by handleAuthResult once the job is done
+	client->auth_job_pending = true;
+	m_auth_workers->queueJob(job);
 }
 
 void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
@@ -1725,8 +1737,9 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 		return;
 	}
 
-	if (client->chosen_mech != AUTH_MECHANISM_SRP &&
-			client->chosen_mech != AUTH_MECHANISM_LEGACY_PASSWORD) {
+	if ((client->chosen_mech != AUTH_MECHANISM_SRP &&
+			client->chosen_mech != AUTH_MECHANISM_LEGACY_PASSWORD) ||
+			client->auth_job_pending) {
 		actionstream << "Server: got SRP _M packet, while auth"
 			<< "is going on with mech " << client->chosen_mech
 			<< " from " << getPeerAddress(pkt->getPeerId()).serializeString()
@@ -1752,28 +1765,71 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 		return;
 	}
 
-	unsigned char *bytes_HAMK = 0;
+	SrpJob job;
+	job.type = SRP_JOB_VERIFY;
+	job.peer_id = pkt->getPeerId();
+	job.want_sudo = wantSudo;
+	job.name = client->getName();
+	job.bytes_M = bytes_M;
+	// The job owns the verifier until handleAuthResult gives it back
+	job.verifier = (SRPVerifier *) client->auth_data;
+	client->auth_data = nullptr;
+
+	client->auth_job_pending = true;
+	m_auth_workers->queueJob(job);
+}
 
-	srp_verifier_verify_session((SRPVerifier *) client->auth_data,
-		(unsigned char *)bytes_M.c_str(), &bytes_HAMK);
+void Server::handleAuthResult(const SrpJob &job)
+{
+	RemoteClient *client = getClientNoEx(job.peer_id, CS_Invalid);
+	if (!client || !client->auth_job_pending ||
+			(client->chosen_mech != AUTH_MECHANISM_SRP &&
+			client->chosen_mech != AUTH_MECHANISM_LEGACY_PASSWORD)) {
+		// Client left or was denied while the job was running
+		srp_verifier_delete(job.verifier);
+		return;
+	}
 
-	if (!bytes_HAMK) {
-		if (wantSudo) {
+	client->auth_job_pending = false;
+	client->auth_data = job.verifier;
+
+	if (job.type == SRP_JOB_START) {
+		if (!job.success) {
 			actionstream << "Server: User " << client->getName()
-				<< " at " << getPeerAddress(pkt->getPeerId()).serializeString()
+				<< " tried to log in, SRP-6a safety check violated in _A handler."
+				<< std::endl;
+			if (job.want_sudo) {
+				DenySudoAccess(job.peer_id);
+				return;
+			}
+
+			DenyAccess(job.peer_id, SERVER_ACCESSDENIED_UNEXPECTED_DATA);
+			return;
+		}
+
+		NetworkPacket resp_pkt(TOCLIENT_SRP_BYTES_S_B, 0, job.peer_id);
+		resp_pkt << job.salt << job.bytes_B;
+		Send(&resp_pkt);
+		return;
+	}
+
+	if (!job.success) {
+		if (job.want_sudo) {
+			actionstream << "Server: User " << client->getName()
+				<< " at " << getPeerAddress(job.peer_id).serializeString()
 				<< " tried to change their password, but supplied wrong"
 				<< " (SRP) password for authentication." << std::endl;
-			DenySudoAccess(pkt->getPeerId());
+			DenySudoAccess(job.peer_id);
 			return;
 		}
 
-		std::string ip = getPeerAddress(pkt->getPeerId()).serializeString();
+		std::string ip = getPeerAddress(job.peer_id).serializeString();
 		actionstream << "Server: User " << client->getName()
 			<< " at " << ip
 			<< " supplied wrong password (auth mechanism: SRP)."
 			<< std::endl;
 		m_script->on_auth_failure(client->getName(), ip);
-		DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_WRONG_PASSWORD);
+		DenyAccess(job.peer_id, SERVER_ACCESSDENIED_WRONG_PASSWORD);
 		return;
 	}
 
@@ -1785,13 +1841,13 @@ void Server::handleCommand_SrpBytesM(NetworkPacket* pkt)
 		if (!m_script->getAuth(playername, &checkpwd, NULL)) {
 			actionstream << "Server: " << playername << " cannot be authenticated"
 				<< " (auth handler does not work?)" << std::endl;
-			DenyAccess(pkt->getPeerId(), SERVER_ACCESSDENIED_SERVER_FAIL);
+			DenyAccess(job.peer_id, SERVER_ACCESSDENIED_SERVER_FAIL);
 			return;
 		}
 		client->create_player_on_auth_success = false;
 	}
 
-	acceptAuth(pkt->getPeerId(), wantSudo);
+	acceptAuth(job.peer_id, job.want_sudo);
 }
 
 /*
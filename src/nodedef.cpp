@@ -862,7 +862,7 @@ void ContentFeatures::updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc
 			param_type_2 == CPT2_COLORED_WALLMOUNTED)
 		palette = tsrc->getPalette(palette_name);
 
-	if (drawtype == NDT_MESH && !mesh.empty()) {
+	if (drawtype == NDT_MESH && !mesh.empty() && client) {
 		// Meshnode drawtype
 		// Read the mesh and apply scale
 		mesh_ptr[0] = client->getMesh(mesh);
@@ -1345,8 +1345,17 @@ void NodeDefManager::updateTextures(IGameDef *gamedef,
 		"textures in node definitions" << std::endl;
 
 	Client *client = (Client *)gamedef;
-	ITextureSource *tsrc = client->tsrc();
-	IShaderSource *shdsrc = client->getShaderSource();
+	updateTextures(client->tsrc(), client->getShaderSource(), client,
+		progress_callback, progress_callback_args);
+#endif
+}
+
+#ifndef SERVER
+void NodeDefManager::updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc,
+	Client *client,
+	void (*progress_callback)(void *progress_args, u32 progress, u32 max_progress),
+	void *progress_callback_args)
+{
 	scene::IMeshManipulator *meshmanip =
 		RenderingEngine::get_scene_manager()->getMeshManipulator();
 	TextureSettings tsettings;
@@ -1354,13 +1363,35 @@ void NodeDefManager::updateTextures(IGameDef *gamedef,
 
 	u32 size = m_content_features.size();
 
+	// Compose the images of the tiles up front, on several threads.
+	// Names that are changed by ContentFeatures::updateTextures are
+	// still generated there.
+	std::vector<std::string> names;
+	auto add_tile = [&names] (const TileDef &tdef) {
+		if (!tdef.name.empty())
+			names.push_back(tdef.name + "^[applyfiltersformesh");
+	};
+	for (const ContentFeatures &f : m_content_features) {
+		// Used for the minimap color
+		if (tsettings.enable_minimap && !f.tiledef[0].name.empty())
+			names.push_back(f.tiledef[0].name);
+		for (const TileDef &tdef : f.tiledef)
+			add_tile(tdef);
+		for (const TileDef &tdef : f.tiledef_overlay)
+			add_tile(tdef);
+		for (const TileDef &tdef : f.tiledef_special)
+			add_tile(tdef);
+	}
+	tsrc->prepareTextures(names);
+
 	for (u32 i = 0; i < size; i++) {
 		ContentFeatures *f = &(m_content_features[i]);
 		f->updateTextures(tsrc, shdsrc, meshmanip, client, tsettings);
-		progress_callback(progress_callback_args, i, size);
+		if (progress_callback)
+			progress_callback(progress_callback_args, i, size);
 	}
-#endif
 }
+#endif
 
 void NodeDefManager::serialize(std::ostream &os, u16 protocol_version) const
 {
@@ -606,6 +606,18 @@ class NodeDefManager {
 		void (*progress_cbk)(void *progress_args, u32 progress, u32 max_progress),
 		void *progress_cbk_args);
 
+#ifndef SERVER
+	/*!
+	 * Same as above, with the texture and shader sources given directly.
+	 * @param client used to load meshes of mesh drawtype nodes, may be
+	 * NULL in which case those nodes get no mesh.
+	 */
+	void updateTextures(ITextureSource *tsrc, IShaderSource *shdsrc,
+		Client *client,
+		void (*progress_cbk)(void *progress_args, u32 progress, u32 max_progress),
+		void *progress_cbk_args);
+#endif
+
 	/*!
 	 * Writes the content of this manager to the given output stream.
 	 * @param protocol_version serialization version of ContentFeatures
@@ -0,0 +1,220 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "nodesearch.h"
+#include <algorithm>
+#include "constants.h"
+#include "face_position_cache.h"
+#include "map.h"
+#include "mapblock.h"
+
+// Blocks with more content types than this are never skipped
+#define MAX_BLOCK_CONTENT_TYPES 64
+
+NodeSearchFilter::NodeSearchFilter(const std::vector<content_t> &filter)
+{
+	for (size_t i = 0; i != filter.size(); i++) {
+		content_t c = filter[i];
+		if (c >= m_index.size())
+			m_index.resize(c + 1, -1);
+		if (m_index[c] == -1)
+			m_index[c] = i;
+	}
+}
+
+
+bool NodeSearchFilter::mayMatch(MapBlock *block) const
+{
+	if (!block || block->isDummy())
+		return find(CONTENT_IGNORE) != -1;
+
+	const std::vector<content_t> &types = getBlockContentTypes(block);
+	if (types.empty())
+		return true;
+	for (content_t c : types) {
+		if (find(c) != -1)
+			return true;
+	}
+	return false;
+}
+
+
+const std::vector<content_t> &getBlockContentTypes(MapBlock *block)
+{
+	static const std::vector<content_t> ignore_types(1, CONTENT_IGNORE);
+	if (block->isDummy())
+		return ignore_types;
+	if (!block->content_types_expired)
+		return block->content_types;
+
+	std::vector<content_t> &types = block->content_types;
+	block->content_types_expired = false;
+	types.clear();
+
+	// Most nodes are the same as the one before
+	const MapNode *data = block->getData();
+	content_t last = data[0].getContent();
+	types.push_back(last);
+	for (u32 i = 1; i != MapBlock::nodecount; i++) {
+		content_t c = data[i].getContent();
+		if (c == last)
+			continue;
+		last = c;
+		if (std::find(types.begin(), types.end(), c) != types.end())
+			continue;
+		if (types.size() == MAX_BLOCK_CONTENT_TYPES) {
+			types.clear();
+			break;
+		}
+		types.push_back(c);
+	}
+	return types;
+}
+
+
+// Nodes of blocks that are not loaded
+static const MapNode *get_ignore_nodes()
+{
+	static const std::vector<MapNode> nodes(MapBlock::nodecount,
+		MapNode(CONTENT_IGNORE));
+	return &nodes[0];
+}
+
+static inline const MapNode *get_block_nodes(MapBlock *block)
+{
+	return block && !block->isDummy() ? block->getData() : get_ignore_nodes();
+}
+
+// Calls func(block, nodes, base, rmin, rmax) for every block that overlaps
+// the area and may contain nodes of the filter. base is the position of
+// the block's first node, rmin and rmax are the corners of the part of the
+// area inside of the block, relative to base.
+template <typename F>
+static void for_each_block(Map *map, v3s16 minp, v3s16 maxp,
+	const NodeSearchFilter &filter, F func)
+{
+	v3s16 bpmin = getNodeBlockPos(minp);
+	v3s16 bpmax = getNodeBlockPos(maxp);
+	v3s16 bp;
+	for (bp.Z = bpmin.Z; bp.Z <= bpmax.Z; bp.Z++)
+	for (bp.Y = bpmin.Y; bp.Y <= bpmax.Y; bp.Y++)
+	for (bp.X = bpmin.X; bp.X <= bpmax.X; bp.X++) {
+		MapBlock *block = map->getBlockNoCreateNoEx(bp);
+		if (!filter.mayMatch(block))
+			continue;
+
+		v3s16 base = bp * MAP_BLOCKSIZE;
+		v3s16 rmin(
+			MYMAX(minp.X - base.X, 0),
+			MYMAX(minp.Y - base.Y, 0),
+			MYMAX(minp.Z - base.Z, 0));
+		v3s16 rmax(
+			MYMIN(maxp.X - base.X, MAP_BLOCKSIZE - 1),
+			MYMIN(maxp.Y - base.Y, MAP_BLOCKSIZE - 1),
+			MYMIN(maxp.Z - base.Z, MAP_BLOCKSIZE - 1));
+		func(block, get_block_nodes(block), base, rmin, rmax);
+	}
+}
+
+
+void findNodesInArea(Map *map, v3s16 minp, v3s16 maxp,
+	const NodeSearchFilter &filter, const NodeSearchCallback &found)
+{
+	for_each_block(map, minp, maxp, filter, [&] (MapBlock *block,
+			const MapNode *nodes, v3s16 base, v3s16 rmin, v3s16 rmax) {
+		for (s16 z = rmin.Z; z <= rmax.Z; z++)
+		for (s16 y = rmin.Y; y <= rmax.Y; y++) {
+			u32 i = (z * MAP_BLOCKSIZE + y) * MAP_BLOCKSIZE + rmin.X;
+			for (s16 x = rmin.X; x <= rmax.X; x++, i++) {
+				s32 index = filter.find(nodes[i].getContent());
+				if (index != -1)
+					found(base + v3s16(x, y, z), index);
+			}
+		}
+	});
+}
+
+
+void findNodesInAreaUnderAir(Map *map, v3s16 minp, v3s16 maxp,
+	const NodeSearchFilter &filter, const NodeSearchCallback &found)
+{
+	for_each_block(map, minp, maxp, filter, [&] (MapBlock *block,
+			const MapNode *nodes, v3s16 base, v3s16 rmin, v3s16 rmax) {
+		// The nodes above the top layer of the block are in the block above
+		const MapNode *nodes_above = nullptr;
+		if (rmax.Y == MAP_BLOCKSIZE - 1) {
+			v3s16 bp_above = getNodeBlockPos(base) + v3s16(0, 1, 0);
+			nodes_above = get_block_nodes(map->getBlockNoCreateNoEx(bp_above));
+		}
+
+		for (s16 z = rmin.Z; z <= rmax.Z; z++)
+		for (s16 y = rmin.Y; y <= rmax.Y; y++) {
+			u32 i = (z * MAP_BLOCKSIZE + y) * MAP_BLOCKSIZE + rmin.X;
+			u32 i_above = y == MAP_BLOCKSIZE - 1 ?
+				z * MAP_BLOCKSIZE * MAP_BLOCKSIZE + rmin.X : i + MAP_BLOCKSIZE;
+			const MapNode *above = y == MAP_BLOCKSIZE - 1 ? nodes_above : nodes;
+			for (s16 x = rmin.X; x <= rmax.X; x++, i++, i_above++) {
+				content_t c = nodes[i].getContent();
+				if (c == CONTENT_AIR || above[i_above].getContent() != CONTENT_AIR)
+					continue;
+				s32 index = filter.find(c);
+				if (index != -1)
+					found(base + v3s16(x, y, z), index);
+			}
+		}
+	});
+}
+
+
+bool findNodeNear(Map *map, v3s16 pos, s32 radius, s32 start_radius,
+	const NodeSearchFilter &filter, v3s16 *found)
+{
+	// Blocks that cannot match are skipped as the shells reach them, so
+	// that a node close to pos is found without listing the content types
+	// of far blocks. Consecutive positions are mostly in the same block.
+	bool have_block = false;
+	v3s16 last_bp;
+	const MapNode *nodes = nullptr;
+	bool may_match = false;
+
+	for (s32 d = start_radius; d <= radius; d++) {
+		const std::vector<v3s16> &list = FacePositionCache::getFacePositions(d);
+		for (const v3s16 &i : list) {
+			v3s16 p = pos + i;
+			v3s16 bp, rel;
+			getNodeBlockPosWithOffset(p, bp, rel);
+			if (!have_block || bp != last_bp) {
+				MapBlock *block = map->getBlockNoCreateNoEx(bp);
+				may_match = filter.mayMatch(block);
+				nodes = get_block_nodes(block);
+				last_bp = bp;
+				have_block = true;
+			}
+			if (!may_match)
+				continue;
+
+			u32 index = (rel.Z * MAP_BLOCKSIZE + rel.Y) * MAP_BLOCKSIZE + rel.X;
+			if (filter.find(nodes[index].getContent()) != -1) {
+				*found = p;
+				return true;
+			}
+		}
+	}
+	return false;
+}
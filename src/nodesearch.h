@@ -0,0 +1,85 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "irr_v3d.h"
+#include "mapnode.h"
+
+class Map;
+class MapBlock;
+
+/*
+	Searching the map for nodes of some content types, as done by
+	find_nodes_in_area() and friends.
+
+	The area is walked block by block and the nodes of each block in memory
+	order. Blocks that contain none of the wanted content types are
+	skipped, based on a list of the content types of each block that is
+	kept until the block is modified.
+*/
+
+// Content types that are searched for, given as a list that may contain
+// the same content type more than once (e.g. "default:dirt" and
+// "group:soil"). A content type matches the first entry of the list.
+class NodeSearchFilter
+{
+public:
+	NodeSearchFilter(const std::vector<content_t> &filter);
+
+	// Index of the first entry of the list that is c, or -1
+	inline s32 find(content_t c) const
+	{
+		return c < m_index.size() ? m_index[c] : -1;
+	}
+
+	// True if there may be nodes of the filter in the block.
+	// block may be NULL for blocks that are not loaded.
+	bool mayMatch(MapBlock *block) const;
+
+private:
+	std::vector<s32> m_index;
+};
+
+// Returns the content types of the nodes of a block, building the
+// list if needed. Blocks with very many content types get an empty list;
+// they are never skipped.
+const std::vector<content_t> &getBlockContentTypes(MapBlock *block);
+
+typedef std::function<void(v3s16 p, s32 filter_index)> NodeSearchCallback;
+
+// Calls found() for every node of the filter in the area minp to maxp,
+// unloaded nodes count as CONTENT_IGNORE. The nodes are found block by
+// block, not in the order of their positions.
+void findNodesInArea(Map *map, v3s16 minp, v3s16 maxp,
+	const NodeSearchFilter &filter, const NodeSearchCallback &found);
+
+// Same as findNodesInArea(), but only for nodes other than air that have
+// air above them. The node above may be outside of the area.
+void findNodesInAreaUnderAir(Map *map, v3s16 minp, v3s16 maxp,
+	const NodeSearchFilter &filter, const NodeSearchCallback &found);
+
+// Finds a node of the filter on the faces of the cubes around pos, going
+// from start_radius to radius nodes away. The faces are searched in the
+// order of FacePositionCache::getFacePositions(). Returns false if there
+// is no such node.
+bool findNodeNear(Map *map, v3s16 pos, s32 radius, s32 start_radius,
+	const NodeSearchFilter &filter, v3s16 *found);
@@ -31,11 +31,8 @@
 #include "util/numeric.h"
 #include "util/string.h"
 #include "exceptions.h"
-
-#define NOISE_MAGIC_X    1619
-#define NOISE_MAGIC_Y    31337
-#define NOISE_MAGIC_Z    52591
-#define NOISE_MAGIC_SEED 1013
+#include "noise_kernels.h"
+#include "threading/task_pool.h"
 
 typedef float (*Interp2dFxn)(
 		float v00, float v10, float v01, float v11,
@@ -434,6 +431,7 @@ Noise::Noise(NoiseParams *np_, s32 seed, u32 sx, u32 sy, u32 sz)
 	this->sx   = sx;
 	this->sy   = sy;
 	this->sz   = sz;
+	kernels    = getNoiseKernels();
 
 	allocBuffers();
 }
@@ -445,6 +443,12 @@ Noise::~Noise()
 	delete[] persist_buf;
 	delete[] noise_buf;
 	delete[] result;
+	delete[] interp_xi;
+	delete[] interp_tx;
+	delete[] interp_yi;
+	delete[] interp_ty;
+	delete[] interp_zi;
+	delete[] interp_tz;
 }
 
 
@@ -463,12 +467,24 @@ void Noise::allocBuffers()
 	delete[] gradient_buf;
 	delete[] persist_buf;
 	delete[] result;
+	delete[] interp_xi;
+	delete[] interp_tx;
+	delete[] interp_yi;
+	delete[] interp_ty;
+	delete[] interp_zi;
+	delete[] interp_tz;
 
 	try {
 		size_t bufsize = sx * sy * sz;
 		this->persist_buf  = NULL;
 		this->gradient_buf = new float[bufsize];
 		this->result       = new float[bufsize];
+		this->interp_xi    = new u32[sx];
+		this->interp_tx    = new float[sx];
+		this->interp_yi    = new u32[sy];
+		this->interp_ty    = new float[sy];
+		this->interp_zi    = new u32[sz];
+		this->interp_tz    = new float[sz];
 	} catch (std::bad_alloc &e) {
 		throw InvalidNoiseParamsException();
 	}
@@ -528,7 +544,7 @@ void Noise::resizeNoiseBuf(bool is3d)
 
 	delete[] noise_buf;
 	try {
-		noise_buf = new float[nlx * nly * nlz];
+		noise_buf = new float[nlx * nly * nlz + NOISE_LATTICE_PADDING];
 	} catch (std::bad_alloc &e) {
 		throw InvalidNoiseParamsException();
 	}
@@ -545,67 +561,77 @@ void Noise::resizeNoiseBuf(bool is3d)
  * Another optimization that could save half as many noise calls is to carry over
  * values from the previous noise lattice as midpoints in the new lattice for the
  * next octave.
+ *
+ * The inner loops are in noise_kernels.cpp.  interp_xi and interp_tx hold the
+ * lattice column and the x weight of each point of a row, which are the same
+ * for every row.  The y and z arrays do the same for the rows and slabs, so
+ * that these can be interpolated in any order, e.g. by the threads of the
+ * TaskPool of the calling thread.
  */
+static void prepare_weights(u32 *lattice_i, float *weights, u32 count,
+	float orig_u, float step, bool eased)
+{
+	float u = orig_u;
+	u32 noisei = 0;
+
+	for (u32 i = 0; i != count; i++) {
+		lattice_i[i] = noisei;
+		weights[i] = eased ? easeCurve(u) : u;
+
+		u += step;
+		if (u >= 1.0) {
+			u -= 1.0;
+			noisei++;
+		}
+	}
+}
+
+// Smallest number of points that is worth handing to another thread
+#define NOISE_TASK_POINTS 16384
+
+static inline u32 task_grain(u32 points_per_item)
+{
+	return (NOISE_TASK_POINTS + points_per_item - 1) / points_per_item;
+}
+
+
 #define idx(x, y) ((y) * nlx + (x))
 void Noise::gradientMap2D(
 		float x, float y,
 		float step_x, float step_y,
 		s32 seed)
 {
-	float v00, v01, v10, v11, u, v, orig_u;
-	u32 index, i, j, noisex, noisey;
+	float u, v;
+	u32 j;
 	u32 nlx, nly;
 	s32 x0, y0;
 
 	bool eased = np.flags & (NOISE_FLAG_DEFAULTS | NOISE_FLAG_EASED);
-	Interp2dFxn interpolate = eased ?
-		biLinearInterpolation : biLinearInterpolationNoEase;
 
 	x0 = std::floor(x);
 	y0 = std::floor(y);
 	u = x - (float)x0;
 	v = y - (float)y0;
-	orig_u = u;
 
 	//calculate noise point lattice
 	nlx = (u32)(u + sx * step_x) + 2;
 	nly = (u32)(v + sy * step_y) + 2;
-	index = 0;
 	for (j = 0; j != nly; j++)
-		for (i = 0; i != nlx; i++)
-			noise_buf[index++] = noise2d(x0 + i, y0 + j, seed);
+		kernels->lattice(&noise_buf[idx(0, j)], x0,
+			noiseLatticeBase(y0 + j, seed), nlx);
 
 	//calculate interpolations
-	index  = 0;
-	noisey = 0;
-	for (j = 0; j != sy; j++) {
-		v00 = noise_buf[idx(0, noisey)];
-		v10 = noise_buf[idx(1, noisey)];
-		v01 = noise_buf[idx(0, noisey + 1)];
-		v11 = noise_buf[idx(1, noisey + 1)];
-
-		u = orig_u;
-		noisex = 0;
-		for (i = 0; i != sx; i++) {
-			gradient_buf[index++] = interpolate(v00, v10, v01, v11, u, v);
-
-			u += step_x;
-			if (u >= 1.0) {
-				u -= 1.0;
-				noisex++;
-				v00 = v10;
-				v01 = v11;
-				v10 = noise_buf[idx(noisex + 1, noisey)];
-				v11 = noise_buf[idx(noisex + 1, noisey + 1)];
+	prepare_weights(interp_xi, interp_tx, sx, u, step_x, eased);
+	prepare_weights(interp_yi, interp_ty, sy, v, step_y, eased);
+	TaskPool::parallelFor(TaskPool::getCurrent(), sy, task_grain(sx),
+		[&](u32 begin, u32 end) {
+			for (u32 j = begin; j != end; j++) {
+				kernels->interpolate2D(&gradient_buf[j * sx],
+					&noise_buf[idx(0, interp_yi[j])],
+					&noise_buf[idx(0, interp_yi[j] + 1)],
+					interp_xi, interp_tx, interp_ty[j], sx);
 			}
-		}
-
-		v += step_y;
-		if (v >= 1.0) {
-			v -= 1.0;
-			noisey++;
-		}
-	}
+		});
 }
 #undef idx
 
@@ -616,15 +642,12 @@ void Noise::gradientMap3D(
 		float step_x, float step_y, float step_z,
 		s32 seed)
 {
-	float v000, v010, v100, v110;
-	float v001, v011, v101, v111;
-	float u, v, w, orig_u, orig_v;
-	u32 index, i, j, k, noisex, noisey, noisez;
+	float u, v, w;
+	u32 j, k;
 	u32 nlx, nly, nlz;
 	s32 x0, y0, z0;
 
-	Interp3dFxn interpolate = (np.flags & NOISE_FLAG_EASED) ?
-		triLinearInterpolation : triLinearInterpolationNoEase;
+	bool eased = np.flags & NOISE_FLAG_EASED;
 
 	x0 = std::floor(x);
 	y0 = std::floor(y);
@@ -632,72 +655,37 @@ void Noise::gradientMap3D(
 	u = x - (float)x0;
 	v = y - (float)y0;
 	w = z - (float)z0;
-	orig_u = u;
-	orig_v = v;
 
 	//calculate noise point lattice
 	nlx = (u32)(u + sx * step_x) + 2;
 	nly = (u32)(v + sy * step_y) + 2;
 	nlz = (u32)(w + sz * step_z) + 2;
-	index = 0;
 	for (k = 0; k != nlz; k++)
 		for (j = 0; j != nly; j++)
-			for (i = 0; i != nlx; i++)
-				noise_buf[index++] = noise3d(x0 + i, y0 + j, z0 + k, seed);
+			kernels->lattice(&noise_buf[idx(0, j, k)], x0,
+				noiseLatticeBase(y0 + j, z0 + k, seed), nlx);
 
 	//calculate interpolations
-	index  = 0;
-	noisey = 0;
-	noisez = 0;
-	for (k = 0; k != sz; k++) {
-		v = orig_v;
-		noisey = 0;
-		for (j = 0; j != sy; j++) {
-			v000 = noise_buf[idx(0, noisey,     noisez)];
-			v100 = noise_buf[idx(1, noisey,     noisez)];
-			v010 = noise_buf[idx(0, noisey + 1, noisez)];
-			v110 = noise_buf[idx(1, noisey + 1, noisez)];
-			v001 = noise_buf[idx(0, noisey,     noisez + 1)];
-			v101 = noise_buf[idx(1, noisey,     noisez + 1)];
-			v011 = noise_buf[idx(0, noisey + 1, noisez + 1)];
-			v111 = noise_buf[idx(1, noisey + 1, noisez + 1)];
-
-			u = orig_u;
-			noisex = 0;
-			for (i = 0; i != sx; i++) {
-				gradient_buf[index++] = interpolate(
-					v000, v100, v010, v110,
-					v001, v101, v011, v111,
-					u, v, w);
-
-				u += step_x;
-				if (u >= 1.0) {
-					u -= 1.0;
-					noisex++;
-					v000 = v100;
-					v010 = v110;
-					v100 = noise_buf[idx(noisex + 1, noisey,     noisez)];
-					v110 = noise_buf[idx(noisex + 1, noisey + 1, noisez)];
-					v001 = v101;
-					v011 = v111;
-					v101 = noise_buf[idx(noisex + 1, noisey,     noisez + 1)];
-					v111 = noise_buf[idx(noisex + 1, noisey + 1, noisez + 1)];
+	prepare_weights(interp_xi, interp_tx, sx, u, step_x, eased);
+	prepare_weights(interp_yi, interp_ty, sy, v, step_y, eased);
+	prepare_weights(interp_zi, interp_tz, sz, w, step_z, eased);
+	TaskPool::parallelFor(TaskPool::getCurrent(), sz, task_grain(sx * sy),
+		[&](u32 begin, u32 end) {
+			for (u32 k = begin; k != end; k++) {
+				u32 noisez = interp_zi[k];
+				u32 index = k * sy * sx;
+				for (u32 j = 0; j != sy; j++) {
+					u32 noisey = interp_yi[j];
+					kernels->interpolate3D(&gradient_buf[index],
+						&noise_buf[idx(0, noisey,     noisez)],
+						&noise_buf[idx(0, noisey + 1, noisez)],
+						&noise_buf[idx(0, noisey,     noisez + 1)],
+						&noise_buf[idx(0, noisey + 1, noisez + 1)],
+						interp_xi, interp_tx, interp_ty[j], interp_tz[k], sx);
+					index += sx;
 				}
 			}
-
-			v += step_y;
-			if (v >= 1.0) {
-				v -= 1.0;
-				noisey++;
-			}
-		}
-
-		w += step_z;
-		if (w >= 1.0) {
-			w -= 1.0;
-			noisez++;
-		}
-	}
+		});
 }
 #undef idx
 
@@ -780,27 +768,15 @@ float *Noise::perlinMap3D(float x, float y, float z, float *persistence_map)
 void Noise::updateResults(float g, float *gmap,
 	const float *persistence_map, size_t bufsize)
 {
-	// This looks very ugly, but it is 50-70% faster than having
-	// conditional statements inside the loop
-	if (np.flags & NOISE_FLAG_ABSVALUE) {
-		if (persistence_map) {
-			for (size_t i = 0; i != bufsize; i++) {
-				result[i] += gmap[i] * std::fabs(gradient_buf[i]);
-				gmap[i] *= persistence_map[i];
-			}
-		} else {
-			for (size_t i = 0; i != bufsize; i++)
-				result[i] += g * std::fabs(gradient_buf[i]);
-		}
-	} else {
-		if (persistence_map) {
-			for (size_t i = 0; i != bufsize; i++) {
-				result[i] += gmap[i] * gradient_buf[i];
-				gmap[i] *= persistence_map[i];
-			}
-		} else {
-			for (size_t i = 0; i != bufsize; i++)
-				result[i] += g * gradient_buf[i];
-		}
-	}
+	bool absvalue = np.flags & NOISE_FLAG_ABSVALUE;
+	TaskPool::parallelFor(TaskPool::getCurrent(), bufsize, NOISE_TASK_POINTS,
+		[&](u32 begin, u32 end) {
+			if (persistence_map)
+				kernels->accumulatePersist(result + begin, gmap + begin,
+					gradient_buf + begin, persistence_map + begin,
+					end - begin, absvalue);
+			else
+				kernels->accumulate(result + begin, gradient_buf + begin, g,
+					end - begin, absvalue);
+		});
 }
@@ -127,6 +127,8 @@ struct NoiseParams {
 	}
 };
 
+struct NoiseKernels;
+
 class Noise {
 public:
 	NoiseParams np;
@@ -138,6 +140,14 @@ class Noise {
 	float *gradient_buf = nullptr;
 	float *persist_buf = nullptr;
 	float *result = nullptr;
+	u32 *interp_xi = nullptr;
+	float *interp_tx = nullptr;
+	u32 *interp_yi = nullptr;
+	float *interp_ty = nullptr;
+	u32 *interp_zi = nullptr;
+	float *interp_tz = nullptr;
+	// Inner loops, the fastest ones for this CPU by default
+	const NoiseKernels *kernels;
 
 	Noise(NoiseParams *np, s32 seed, u32 sx, u32 sy, u32 sz=1);
 	~Noise();
@@ -0,0 +1,446 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "noise_kernels.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define NOISE_KERNELS_X86
+	#include <immintrin.h>
+#endif
+
+/*
+	Plain C++ kernels, also used for the leftover elements of a row by
+	the vector kernels
+*/
+
+// Same as noise2d() and noise3d()
+static inline float lattice_value(u32 n)
+{
+	n = (n >> 13) ^ n;
+	n = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+	return 1.f - (float)(int)n / 0x40000000;
+}
+
+static inline float lerp(float v0, float v1, float t)
+{
+	return v0 + (v1 - v0) * t;
+}
+
+static void lattice_scalar(float *out, s32 x, u32 base, u32 count)
+{
+	for (u32 i = 0; i != count; i++)
+		out[i] = lattice_value((NOISE_MAGIC_X * (u32)(x + i) + base) & 0x7fffffff);
+}
+
+static void interpolate2d_scalar(float *out, const float *row0, const float *row1,
+	const u32 *xi, const float *tx, float ty, u32 count)
+{
+	for (u32 i = 0; i != count; i++) {
+		u32 x = xi[i];
+		float u = lerp(row0[x], row0[x + 1], tx[i]);
+		float v = lerp(row1[x], row1[x + 1], tx[i]);
+		out[i] = lerp(u, v, ty);
+	}
+}
+
+static void interpolate3d_scalar(float *out,
+	const float *row00, const float *row10,
+	const float *row01, const float *row11,
+	const u32 *xi, const float *tx, float ty, float tz, u32 count)
+{
+	for (u32 i = 0; i != count; i++) {
+		u32 x = xi[i];
+		float t = tx[i];
+		float u = lerp(lerp(row00[x], row00[x + 1], t),
+			lerp(row10[x], row10[x + 1], t), ty);
+		float v = lerp(lerp(row01[x], row01[x + 1], t),
+			lerp(row11[x], row11[x + 1], t), ty);
+		out[i] = lerp(u, v, tz);
+	}
+}
+
+static void accumulate_scalar(float *result, const float *values, float g,
+	u32 count, bool absvalue)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * std::fabs(values[i]);
+	} else {
+		for (u32 i = 0; i != count; i++)
+			result[i] += g * values[i];
+	}
+}
+
+static void accumulate_persist_scalar(float *result, float *gmap,
+	const float *values, const float *persistence, u32 count, bool absvalue)
+{
+	if (absvalue) {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * std::fabs(values[i]);
+			gmap[i] *= persistence[i];
+		}
+	} else {
+		for (u32 i = 0; i != count; i++) {
+			result[i] += gmap[i] * values[i];
+			gmap[i] *= persistence[i];
+		}
+	}
+}
+
+static const NoiseKernels kernels_scalar = {
+	"scalar",
+	lattice_scalar,
+	interpolate2d_scalar,
+	interpolate3d_scalar,
+	accumulate_scalar,
+	accumulate_persist_scalar,
+};
+
+#ifdef NOISE_KERNELS_X86
+
+/*
+	SSE4.1 kernels, 4 points at a time. SSE4.1 is needed for the 32 bit
+	integer multiplication of the hash.
+
+	FMA is deliberately not enabled for these functions: a fused
+	multiply-add rounds differently than the plain C++ version.
+*/
+
+#define LERP_SSE(v0, v1, t) _mm_add_ps((v0), _mm_mul_ps(_mm_sub_ps((v1), (v0)), (t)))
+
+// Consecutive points of a row are at most one lattice column apart, so the
+// corners of 4 points are among 5 consecutive lattice values. They are
+// loaded with two unaligned loads and picked with a byte shuffle, which is
+// much faster than loading them one by one.
+__attribute__((target("sse4.1")))
+static inline __m128i shuffle_sse(const u32 *xi)
+{
+	__m128i offsets = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)xi),
+		_mm_set1_epi32(xi[0]));
+	return _mm_add_epi32(_mm_mullo_epi32(offsets, _mm_set1_epi32(0x04040404)),
+		_mm_set1_epi32(0x03020100));
+}
+
+__attribute__((target("sse4.1")))
+static inline void corners_sse(const float *row, u32 x0, __m128i shuffle,
+	__m128 *v0, __m128 *v1)
+{
+	*v0 = _mm_castsi128_ps(_mm_shuffle_epi8(
+		_mm_loadu_si128((const __m128i *)(row + x0)), shuffle));
+	*v1 = _mm_castsi128_ps(_mm_shuffle_epi8(
+		_mm_loadu_si128((const __m128i *)(row + x0 + 1)), shuffle));
+}
+
+__attribute__((target("sse4.1")))
+static void lattice_sse41(float *out, s32 x, u32 base, u32 count)
+{
+	const __m128i mask = _mm_set1_epi32(0x7fffffff);
+	const __m128i magic = _mm_set1_epi32(NOISE_MAGIC_X);
+	const __m128i vbase = _mm_set1_epi32(base);
+	const __m128i c1 = _mm_set1_epi32(60493);
+	const __m128i c2 = _mm_set1_epi32(19990303);
+	const __m128i c3 = _mm_set1_epi32(1376312589);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 divisor = _mm_set1_ps((float)0x40000000);
+	__m128i vx = _mm_add_epi32(_mm_set1_epi32(x), _mm_setr_epi32(0, 1, 2, 3));
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i n = _mm_add_epi32(_mm_mullo_epi32(vx, magic), vbase);
+		n = _mm_and_si128(n, mask);
+		n = _mm_xor_si128(_mm_srli_epi32(n, 13), n);
+		__m128i t = _mm_add_epi32(_mm_mullo_epi32(_mm_mullo_epi32(n, n), c1), c2);
+		n = _mm_and_si128(_mm_add_epi32(_mm_mullo_epi32(n, t), c3), mask);
+		__m128 f = _mm_div_ps(_mm_cvtepi32_ps(n), divisor);
+		_mm_storeu_ps(out + i, _mm_sub_ps(one, f));
+		vx = _mm_add_epi32(vx, _mm_set1_epi32(4));
+	}
+	lattice_scalar(out + i, x + i, base, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void interpolate2d_sse41(float *out, const float *row0, const float *row1,
+	const u32 *xi, const float *tx, float ty, u32 count)
+{
+	const __m128 vty = _mm_set1_ps(ty);
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i shuffle = shuffle_sse(xi + i);
+		__m128 t = _mm_loadu_ps(tx + i);
+		__m128 v00, v10, v01, v11;
+		corners_sse(row0, xi[i], shuffle, &v00, &v10);
+		corners_sse(row1, xi[i], shuffle, &v01, &v11);
+		__m128 u = LERP_SSE(v00, v10, t);
+		__m128 v = LERP_SSE(v01, v11, t);
+		_mm_storeu_ps(out + i, LERP_SSE(u, v, vty));
+	}
+	interpolate2d_scalar(out + i, row0, row1, xi + i, tx + i, ty, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void interpolate3d_sse41(float *out,
+	const float *row00, const float *row10,
+	const float *row01, const float *row11,
+	const u32 *xi, const float *tx, float ty, float tz, u32 count)
+{
+	const __m128 vty = _mm_set1_ps(ty);
+	const __m128 vtz = _mm_set1_ps(tz);
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i shuffle = shuffle_sse(xi + i);
+		__m128 t = _mm_loadu_ps(tx + i);
+		__m128 v000, v100, v010, v110, v001, v101, v011, v111;
+		corners_sse(row00, xi[i], shuffle, &v000, &v100);
+		corners_sse(row10, xi[i], shuffle, &v010, &v110);
+		corners_sse(row01, xi[i], shuffle, &v001, &v101);
+		corners_sse(row11, xi[i], shuffle, &v011, &v111);
+		__m128 u = LERP_SSE(LERP_SSE(v000, v100, t), LERP_SSE(v010, v110, t), vty);
+		__m128 v = LERP_SSE(LERP_SSE(v001, v101, t), LERP_SSE(v011, v111, t), vty);
+		_mm_storeu_ps(out + i, LERP_SSE(u, v, vtz));
+	}
+	interpolate3d_scalar(out + i, row00, row10, row01, row11,
+		xi + i, tx + i, ty, tz, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static void accumulate_sse41(float *result, const float *values, float g,
+	u32 count, bool absvalue)
+{
+	const __m128 vg = _mm_set1_ps(g);
+	// Clearing the sign bit is the same as std::fabs()
+	const __m128 mask = absvalue ?
+		_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)) :
+		_mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 v = _mm_and_ps(_mm_loadu_ps(values + i), mask);
+		__m128 r = _mm_add_ps(_mm_loadu_ps(result + i), _mm_mul_ps(vg, v));
+		_mm_storeu_ps(result + i, r);
+	}
+	accumulate_scalar(result + i, values + i, g, count - i, absvalue);
+}
+
+__attribute__((target("sse4.1")))
+static void accumulate_persist_sse41(float *result, float *gmap,
+	const float *values, const float *persistence, u32 count, bool absvalue)
+{
+	const __m128 mask = absvalue ?
+		_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)) :
+		_mm_castsi128_ps(_mm_set1_epi32(-1));
+
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 g = _mm_loadu_ps(gmap + i);
+		__m128 v = _mm_and_ps(_mm_loadu_ps(values + i), mask);
+		__m128 r = _mm_add_ps(_mm_loadu_ps(result + i), _mm_mul_ps(g, v));
+		_mm_storeu_ps(result + i, r);
+		_mm_storeu_ps(gmap + i, _mm_mul_ps(g, _mm_loadu_ps(persistence + i)));
+	}
+	accumulate_persist_scalar(result + i, gmap + i, values + i,
+		persistence + i, count - i, absvalue);
+}
+
+static const NoiseKernels kernels_sse41 = {
+	"sse4.1",
+	lattice_sse41,
+	interpolate2d_sse41,
+	interpolate3d_sse41,
+	accumulate_sse41,
+	accumulate_persist_sse41,
+};
+
+/*
+	AVX2 kernels, 8 points at a time. Also without FMA, see above.
+
+	The corners are picked from 9 consecutive lattice values with a
+	permutation like in the SSE4.1 kernels, which is also much faster than
+	hardware gathers.
+
+	The upper halves of the registers are cleared before calling the plain
+	C++ code for the leftover points, GCC does not do this for tail calls
+	and the SSE code after it gets very slow on some CPUs.
+*/
+
+#define LERP_AVX(v0, v1, t) \
+	_mm256_add_ps((v0), _mm256_mul_ps(_mm256_sub_ps((v1), (v0)), (t)))
+
+__attribute__((target("avx2")))
+static inline void corners_avx(const float *row, u32 x0, __m256i offsets,
+	__m256 *v0, __m256 *v1)
+{
+	*v0 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(row + x0), offsets);
+	*v1 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(row + x0 + 1), offsets);
+}
+
+__attribute__((target("avx2")))
+static void lattice_avx2(float *out, s32 x, u32 base, u32 count)
+{
+	const __m256i mask = _mm256_set1_epi32(0x7fffffff);
+	const __m256i magic = _mm256_set1_epi32(NOISE_MAGIC_X);
+	const __m256i vbase = _mm256_set1_epi32(base);
+	const __m256i c1 = _mm256_set1_epi32(60493);
+	const __m256i c2 = _mm256_set1_epi32(19990303);
+	const __m256i c3 = _mm256_set1_epi32(1376312589);
+	const __m256 one = _mm256_set1_ps(1.f);
+	const __m256 divisor = _mm256_set1_ps((float)0x40000000);
+	__m256i vx = _mm256_add_epi32(_mm256_set1_epi32(x),
+		_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i n = _mm256_add_epi32(_mm256_mullo_epi32(vx, magic), vbase);
+		n = _mm256_and_si256(n, mask);
+		n = _mm256_xor_si256(_mm256_srli_epi32(n, 13), n);
+		__m256i t = _mm256_add_epi32(
+			_mm256_mullo_epi32(_mm256_mullo_epi32(n, n), c1), c2);
+		n = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(n, t), c3), mask);
+		__m256 f = _mm256_div_ps(_mm256_cvtepi32_ps(n), divisor);
+		_mm256_storeu_ps(out + i, _mm256_sub_ps(one, f));
+		vx = _mm256_add_epi32(vx, _mm256_set1_epi32(8));
+	}
+	_mm256_zeroupper();
+	lattice_scalar(out + i, x + i, base, count - i);
+}
+
+__attribute__((target("avx2")))
+static void interpolate2d_avx2(float *out, const float *row0, const float *row1,
+	const u32 *xi, const float *tx, float ty, u32 count)
+{
+	const __m256 vty = _mm256_set1_ps(ty);
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		u32 x0 = xi[i];
+		__m256i offsets = _mm256_sub_epi32(
+			_mm256_loadu_si256((const __m256i *)(xi + i)), _mm256_set1_epi32(x0));
+		__m256 t = _mm256_loadu_ps(tx + i);
+		__m256 v00, v10, v01, v11;
+		corners_avx(row0, x0, offsets, &v00, &v10);
+		corners_avx(row1, x0, offsets, &v01, &v11);
+		__m256 u = LERP_AVX(v00, v10, t);
+		__m256 v = LERP_AVX(v01, v11, t);
+		_mm256_storeu_ps(out + i, LERP_AVX(u, v, vty));
+	}
+	_mm256_zeroupper();
+	interpolate2d_scalar(out + i, row0, row1, xi + i, tx + i, ty, count - i);
+}
+
+__attribute__((target("avx2")))
+static void interpolate3d_avx2(float *out,
+	const float *row00, const float *row10,
+	const float *row01, const float *row11,
+	const u32 *xi, const float *tx, float ty, float tz, u32 count)
+{
+	const __m256 vty = _mm256_set1_ps(ty);
+	const __m256 vtz = _mm256_set1_ps(tz);
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		u32 x0 = xi[i];
+		__m256i offsets = _mm256_sub_epi32(
+			_mm256_loadu_si256((const __m256i *)(xi + i)), _mm256_set1_epi32(x0));
+		__m256 t = _mm256_loadu_ps(tx + i);
+		__m256 v000, v100, v010, v110, v001, v101, v011, v111;
+		corners_avx(row00, x0, offsets, &v000, &v100);
+		corners_avx(row10, x0, offsets, &v010, &v110);
+		corners_avx(row01, x0, offsets, &v001, &v101);
+		corners_avx(row11, x0, offsets, &v011, &v111);
+		__m256 u = LERP_AVX(LERP_AVX(v000, v100, t), LERP_AVX(v010, v110, t), vty);
+		__m256 v = LERP_AVX(LERP_AVX(v001, v101, t), LERP_AVX(v011, v111, t), vty);
+		_mm256_storeu_ps(out + i, LERP_AVX(u, v, vtz));
+	}
+	_mm256_zeroupper();
+	interpolate3d_scalar(out + i, row00, row10, row01, row11,
+		xi + i, tx + i, ty, tz, count - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulate_avx2(float *result, const float *values, float g,
+	u32 count, bool absvalue)
+{
+	const __m256 vg = _mm256_set1_ps(g);
+	const __m256 mask = absvalue ?
+		_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)) :
+		_mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 v = _mm256_and_ps(_mm256_loadu_ps(values + i), mask);
+		__m256 r = _mm256_add_ps(_mm256_loadu_ps(result + i), _mm256_mul_ps(vg, v));
+		_mm256_storeu_ps(result + i, r);
+	}
+	_mm256_zeroupper();
+	accumulate_scalar(result + i, values + i, g, count - i, absvalue);
+}
+
+__attribute__((target("avx2")))
+static void accumulate_persist_avx2(float *result, float *gmap,
+	const float *values, const float *persistence, u32 count, bool absvalue)
+{
+	const __m256 mask = absvalue ?
+		_mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)) :
+		_mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 g = _mm256_loadu_ps(gmap + i);
+		__m256 v = _mm256_and_ps(_mm256_loadu_ps(values + i), mask);
+		__m256 r = _mm256_add_ps(_mm256_loadu_ps(result + i), _mm256_mul_ps(g, v));
+		_mm256_storeu_ps(result + i, r);
+		_mm256_storeu_ps(gmap + i, _mm256_mul_ps(g, _mm256_loadu_ps(persistence + i)));
+	}
+	_mm256_zeroupper();
+	accumulate_persist_scalar(result + i, gmap + i, values + i,
+		persistence + i, count - i, absvalue);
+}
+
+static const NoiseKernels kernels_avx2 = {
+	"avx2",
+	lattice_avx2,
+	interpolate2d_avx2,
+	interpolate3d_avx2,
+	accumulate_avx2,
+	accumulate_persist_avx2,
+};
+
+#endif // NOISE_KERNELS_X86
+
+std::vector<const NoiseKernels *> getSupportedNoiseKernels()
+{
+	std::vector<const NoiseKernels *> kernels;
+	kernels.push_back(&kernels_scalar);
+#ifdef NOISE_KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.1"))
+		kernels.push_back(&kernels_sse41);
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back(&kernels_avx2);
+#endif
+	return kernels;
+}
+
+const NoiseKernels *getNoiseKernels()
+{
+	static const NoiseKernels *kernels = getSupportedNoiseKernels().back();
+	return kernels;
+}
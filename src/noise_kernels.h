@@ -0,0 +1,85 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <vector>
+
+#define NOISE_MAGIC_X    1619
+#define NOISE_MAGIC_Y    31337
+#define NOISE_MAGIC_Z    52591
+#define NOISE_MAGIC_SEED 1013
+
+// Number of values that the lattice buffer must be larger than needed
+#define NOISE_LATTICE_PADDING 8
+
+/*
+	Inner loops of Noise::gradientMap2D/3D and the octave accumulation.
+
+	There is a plain C++ version and, on x86, SSE4.1 and AVX2 versions
+	that are picked at runtime depending on the CPU. All of them do the
+	same floating point operations in the same order on each element, so
+	their results are bit-identical and worlds generate the same way on
+	every machine.
+*/
+struct NoiseKernels
+{
+	const char *name;
+
+	// out[i] = noise value of the lattice point at x + i. base is the hash
+	// of the other coordinates and the seed, see noiseLatticeBase().
+	void (*lattice)(float *out, s32 x, u32 base, u32 count);
+
+	// Interpolates count points of one row between two or four lattice
+	// rows. Point i lies between lattice columns xi[i] and xi[i] + 1 with
+	// the (already eased) weight tx[i]. xi[i + 1] is either xi[i] or
+	// xi[i] + 1. Up to NOISE_LATTICE_PADDING values after the last lattice
+	// column that is used may be read.
+	void (*interpolate2D)(float *out, const float *row0, const float *row1,
+		const u32 *xi, const float *tx, float ty, u32 count);
+	void (*interpolate3D)(float *out,
+		const float *row00, const float *row10,
+		const float *row01, const float *row11,
+		const u32 *xi, const float *tx, float ty, float tz, u32 count);
+
+	// result[i] += g * values[i]
+	void (*accumulate)(float *result, const float *values, float g,
+		u32 count, bool absvalue);
+	// result[i] += gmap[i] * values[i]; gmap[i] *= persistence[i]
+	void (*accumulatePersist)(float *result, float *gmap, const float *values,
+		const float *persistence, u32 count, bool absvalue);
+};
+
+inline u32 noiseLatticeBase(s32 y, s32 z, s32 seed)
+{
+	return NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_Z * (u32)z +
+		NOISE_MAGIC_SEED * (u32)seed;
+}
+
+inline u32 noiseLatticeBase(s32 y, s32 seed)
+{
+	return NOISE_MAGIC_Y * (u32)y + NOISE_MAGIC_SEED * (u32)seed;
+}
+
+// Fastest kernels supported by this CPU
+const NoiseKernels *getNoiseKernels();
+
+// All kernels supported by this CPU, the plain C++ ones first
+std::vector<const NoiseKernels *> getSupportedNoiseKernels();
@@ -37,7 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapgen/treegen.h"
 #include "emerge.h"
 #include "pathfinder.h"
-#include "face_position_cache.h"
+#include "nodesearch.h"
 #include "remoteplayer.h"
 #ifndef SERVER
 #include "client/client.h"
@@ -776,22 +776,18 @@ int ModApiEnvMod::l_find_node_near(lua_State *L)
 	}
 #endif
 
-	for (int d = start_radius; d <= radius; d++) {
-		std::vector<v3s16> list = FacePositionCache::getFacePositions(d);
-		for (const v3s16 &i : list) {
-			v3s16 p = pos + i;
-			content_t c = env->getMap().getNodeNoEx(p).getContent();
-			if (CONTAINS(filter, c)) {
-				push_v3s16(L, p);
-				return 1;
-			}
-		}
+	v3s16 found;
+	if (findNodeNear(&env->getMap(), pos, radius, start_radius,
+			NodeSearchFilter(filter), &found)) {
+		push_v3s16(L, found);
+		return 1;
 	}
 	return 0;
 }
 
-// find_nodes_in_area(minp, maxp, nodenames) -> list of positions
+// find_nodes_in_area(minp, maxp, nodenames, [grouped]) -> list of positions
 // nodenames: eg. {"ignore", "group:tree"} or "default:dirt"
+// grouped: return a table of position lists indexed by node name instead
 int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 {
 	GET_ENV_PTR;
@@ -823,26 +819,42 @@ int ModApiEnvMod::l_find_nodes_in_area(lua_State *L)
 		ndef->getIds(readParam<std::string>(L, 3), filter);
 	}
 
+	if (lua_toboolean(L, 4)) {
+		std::vector<std::vector<v3s16>> grouped(filter.size());
+		findNodesInArea(&env->getMap(), minp, maxp, NodeSearchFilter(filter),
+			[&grouped] (v3s16 p, s32 filter_index) {
+				grouped[filter_index].push_back(p);
+			});
+
+		lua_newtable(L);
+		for (u32 i = 0; i < filter.size(); i++) {
+			// Content types that are in the filter more than once were
+			// only found for their first entry
+			if (std::find(filter.begin(), filter.begin() + i, filter[i]) !=
+					filter.begin() + i)
+				continue;
+			const std::vector<v3s16> &list = grouped[i];
+			lua_createtable(L, list.size(), 0);
+			for (u32 j = 0; j < list.size(); j++) {
+				push_v3s16(L, list[j]);
+				lua_rawseti(L, -2, j + 1);
+			}
+			lua_setfield(L, -2, ndef->get(filter[i]).name.c_str());
+		}
+		return 1;
+	}
+
 	std::vector<u32> individual_count;
 	individual_count.resize(filter.size());
 
 	lua_newtable(L);
 	u64 i = 0;
-	for (s16 x = minp.X; x <= maxp.X; x++)
-	for (s16 y = minp.Y; y <= maxp.Y; y++)
-	for (s16 z = minp.Z; z <= maxp.Z; z++) {
-		v3s16 p(x, y, z);
-		content_t c = env->getMap().getNodeNoEx(p).getContent();
-
-		std::vector<content_t>::iterator it = std::find(filter.begin(), filter.end(), c);
-		if (it != filter.end()) {
+	findNodesInArea(&env->getMap(), minp, maxp, NodeSearchFilter(filter),
+		[&] (v3s16 p, s32 filter_index) {
 			push_v3s16(L, p);
 			lua_rawseti(L, -2, ++i);
-
-			u32 filt_index = it - filter.begin();
-			individual_count[filt_index]++;
-		}
-	}
+			individual_count[filter_index]++;
+		});
 	lua_newtable(L);
 	for (u32 i = 0; i < filter.size(); i++) {
 		lua_pushnumber(L, individual_count[i]);
@@ -894,22 +906,11 @@ int ModApiEnvMod::l_find_nodes_in_area_under_air(lua_State *L)
 
 	lua_newtable(L);
 	u64 i = 0;
-	for (s16 x = minp.X; x <= maxp.X; x++)
-	for (s16 z = minp.Z; z <= maxp.Z; z++) {
-		s16 y = minp.Y;
-		v3s16 p(x, y, z);
-		content_t c = env->getMap().getNodeNoEx(p).getContent();
-		for (; y <= maxp.Y; y++) {
-			v3s16 psurf(x, y + 1, z);
-			content_t csurf = env->getMap().getNodeNoEx(psurf).getContent();
-			if (c != CONTENT_AIR && csurf == CONTENT_AIR &&
-					CONTAINS(filter, c)) {
-				push_v3s16(L, v3s16(x, y, z));
-				lua_rawseti(L, -2, ++i);
-			}
-			c = csurf;
-		}
-	}
+	findNodesInAreaUnderAir(&env->getMap(), minp, maxp,
+		NodeSearchFilter(filter), [&] (v3s16 p, s32 filter_index) {
+			push_v3s16(L, p);
+			lua_rawseti(L, -2, ++i);
+		});
 	return 1;
 }
 
@@ -344,6 +344,27 @@ int LuaVoxelManip::l_set_param2_data(lua_State *L)
 	return 0;
 }
 
+int LuaVoxelManip::l_get_buffer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	checkobject(L, 1);
+	std::string field = lua_isstring(L, 2) ? readParam<std::string>(L, 2) : "data";
+
+	if (field == "data")
+		return LuaVoxelManipBuffer::create_object(L, 1,
+			LuaVoxelManipBuffer::FIELD_CONTENT);
+	if (field == "light")
+		return LuaVoxelManipBuffer::create_object(L, 1,
+			LuaVoxelManipBuffer::FIELD_LIGHT);
+	if (field == "param2")
+		return LuaVoxelManipBuffer::create_object(L, 1,
+			LuaVoxelManipBuffer::FIELD_PARAM2);
+
+	throw LuaError("VoxelManip:get_buffer called with unknown field \"" +
+		field + "\"");
+}
+
 int LuaVoxelManip::l_update_map(lua_State *L)
 {
 	return 0;
@@ -473,7 +494,286 @@ const luaL_Reg LuaVoxelManip::methods[] = {
 	luamethod(LuaVoxelManip, set_light_data),
 	luamethod(LuaVoxelManip, get_param2_data),
 	luamethod(LuaVoxelManip, set_param2_data),
+	luamethod(LuaVoxelManip, get_buffer),
 	luamethod(LuaVoxelManip, was_modified),
 	luamethod(LuaVoxelManip, get_emerged_area),
 	{0,0}
 };
+
+/*
+  VoxelManipBuffer
+ */
+
+// The layout of the nodes is part of the API, see get_pointer()
+static_assert(sizeof(MapNode) == 4, "MapNode layout changed");
+
+// garbage collector
+int LuaVoxelManipBuffer::gc_object(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+	luaL_unref(L, LUA_REGISTRYINDEX, o->m_vm_ref);
+	delete o;
+
+	return 0;
+}
+
+// buffer[i] and methods
+int LuaVoxelManipBuffer::mt_index(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+
+	if (lua_type(L, 2) == LUA_TNUMBER) {
+		o->push(L, lua_tointeger(L, 2));
+		return 1;
+	}
+
+	// Look up the method in the method table
+	lua_pushvalue(L, 2);
+	lua_rawget(L, lua_upvalueindex(1));
+	return 1;
+}
+
+// buffer[i] = value
+int LuaVoxelManipBuffer::mt_newindex(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+
+	if (lua_type(L, 2) != LUA_TNUMBER)
+		return luaL_error(L, "VoxelManipBuffer: only indices can be set");
+
+	o->set(L, lua_tointeger(L, 2), 3);
+	return 0;
+}
+
+// #buffer
+int LuaVoxelManipBuffer::mt_len(lua_State *L)
+{
+	LuaVoxelManipBuffer *o = *(LuaVoxelManipBuffer **)(lua_touserdata(L, 1));
+
+	lua_pushinteger(L, o->m_vm->vm->m_area.getVolume());
+	return 1;
+}
+
+int LuaVoxelManipBuffer::l_get(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	o->push(L, luaL_checkinteger(L, 2));
+	return 1;
+}
+
+int LuaVoxelManipBuffer::l_set(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	o->set(L, luaL_checkinteger(L, 2), 3);
+	return 0;
+}
+
+// get_range(i, n, [t])
+int LuaVoxelManipBuffer::l_get_range(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	lua_Integer first = luaL_checkinteger(L, 2);
+	lua_Integer count = luaL_checkinteger(L, 3);
+	lua_Integer volume = o->m_vm->vm->m_area.getVolume();
+	if (first < 1 || count < 0 || count > volume - first + 1)
+		return luaL_error(L, "VoxelManipBuffer: range %d + %d out of range",
+			(int)first, (int)count);
+
+	if (lua_istable(L, 4))
+		lua_pushvalue(L, 4);
+	else
+		lua_createtable(L, count, 0);
+
+	for (lua_Integer i = 0; i != count; i++) {
+		o->push(L, first + i);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
+// set_range(i, t, [n])
+int LuaVoxelManipBuffer::l_set_range(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	lua_Integer first = luaL_checkinteger(L, 2);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	lua_Integer count = lua_isnoneornil(L, 4) ?
+		(lua_Integer)lua_objlen(L, 3) : luaL_checkinteger(L, 4);
+	lua_Integer volume = o->m_vm->vm->m_area.getVolume();
+	if (first < 1 || count < 0 || count > volume - first + 1)
+		return luaL_error(L, "VoxelManipBuffer: range %d + %d out of range",
+			(int)first, (int)count);
+
+	for (lua_Integer i = 0; i != count; i++) {
+		lua_rawgeti(L, 3, i + 1);
+		if (!lua_isnumber(L, -1))
+			return luaL_error(L, "VoxelManipBuffer: value %d is not a number",
+				(int)(i + 1));
+		o->setValue(first + i - 1, lua_tointeger(L, -1));
+		lua_pop(L, 1);
+	}
+	return 0;
+}
+
+int LuaVoxelManipBuffer::l_size(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	lua_pushinteger(L, o->m_vm->vm->m_area.getVolume());
+	return 1;
+}
+
+int LuaVoxelManipBuffer::l_get_pointer(lua_State *L)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	LuaVoxelManipBuffer *o = checkobject(L, 1);
+	MMVManip *vm = o->m_vm->vm;
+	if (!vm->m_data)
+		return 0;
+
+	lua_pushlightuserdata(L, vm->m_data);
+	return 1;
+}
+
+void LuaVoxelManipBuffer::push(lua_State *L, lua_Integer i) const
+{
+	MMVManip *vm = m_vm->vm;
+	if (i < 1 || i > vm->m_area.getVolume()) {
+		lua_pushnil(L);
+		return;
+	}
+
+	const MapNode &n = vm->m_data[i - 1];
+	switch (m_field) {
+	case FIELD_CONTENT:
+		lua_pushinteger(L, n.getContent());
+		break;
+	case FIELD_LIGHT:
+		lua_pushinteger(L, n.param1);
+		break;
+	case FIELD_PARAM2:
+		lua_pushinteger(L, n.param2);
+		break;
+	}
+}
+
+void LuaVoxelManipBuffer::set(lua_State *L, lua_Integer i,
+	int value_index) const
+{
+	MMVManip *vm = m_vm->vm;
+	if (i < 1 || i > vm->m_area.getVolume()) {
+		luaL_error(L, "VoxelManipBuffer: index %d out of range", (int)i);
+		return;
+	}
+
+	setValue(i - 1, luaL_checkinteger(L, value_index));
+}
+
+void LuaVoxelManipBuffer::setValue(u32 i, lua_Integer value) const
+{
+	MapNode &n = m_vm->vm->m_data[i];
+	switch (m_field) {
+	case FIELD_CONTENT:
+		n.setContent(value);
+		break;
+	case FIELD_LIGHT:
+		n.param1 = value;
+		break;
+	case FIELD_PARAM2:
+		n.param2 = value;
+		break;
+	}
+}
+
+LuaVoxelManipBuffer::LuaVoxelManipBuffer(LuaVoxelManip *vm, Field field,
+	int vm_ref) :
+	m_vm(vm),
+	m_field(field),
+	m_vm_ref(vm_ref)
+{
+}
+
+// Creates a LuaVoxelManipBuffer and leaves it on top of stack
+int LuaVoxelManipBuffer::create_object(lua_State *L, int vm_index, Field field)
+{
+	LuaVoxelManip *vm = LuaVoxelManip::checkobject(L, vm_index);
+	lua_pushvalue(L, vm_index);
+	int vm_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	LuaVoxelManipBuffer *o = new LuaVoxelManipBuffer(vm, field, vm_ref);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, className);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+LuaVoxelManipBuffer *LuaVoxelManipBuffer::checkobject(lua_State *L, int narg)
+{
+	NO_MAP_LOCK_REQUIRED;
+
+	luaL_checktype(L, narg, LUA_TUSERDATA);
+
+	void *ud = luaL_checkudata(L, narg, className);
+	if (!ud)
+		luaL_typerror(L, narg, className);
+
+	return *(LuaVoxelManipBuffer **)ud;  // unbox pointer
+}
+
+void LuaVoxelManipBuffer::Register(lua_State *L)
+{
+	lua_newtable(L);
+	int methodtable = lua_gettop(L);
+	luaL_newmetatable(L, className);
+	int metatable = lua_gettop(L);
+
+	lua_pushliteral(L, "__metatable");
+	lua_pushvalue(L, methodtable);
+	lua_settable(L, metatable);  // hide metatable from Lua getmetatable()
+
+	// Indices are values, other keys are methods
+	lua_pushliteral(L, "__index");
+	lua_pushvalue(L, methodtable);
+	lua_pushcclosure(L, mt_index, 1);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__newindex");
+	lua_pushcfunction(L, mt_newindex);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__len");
+	lua_pushcfunction(L, mt_len);
+	lua_settable(L, metatable);
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, gc_object);
+	lua_settable(L, metatable);
+
+	lua_pop(L, 1);  // drop metatable
+
+	luaL_openlib(L, 0, methods, 0);  // fill methodtable
+	lua_pop(L, 1);  // drop methodtable
+
+	// Only created by VoxelManip:get_buffer()
+}
+
+const char LuaVoxelManipBuffer::className[] = "VoxelManipBuffer";
+const luaL_Reg LuaVoxelManipBuffer::methods[] = {
+	luamethod(LuaVoxelManipBuffer, get),
+	luamethod(LuaVoxelManipBuffer, set),
+	luamethod(LuaVoxelManipBuffer, get_range),
+	luamethod(LuaVoxelManipBuffer, set_range),
+	luamethod(LuaVoxelManipBuffer, size),
+	luamethod(LuaVoxelManipBuffer, get_pointer),
+	{0,0}
+};
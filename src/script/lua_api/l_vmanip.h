@@ -60,6 +60,8 @@ class LuaVoxelManip : public ModApiBase
 	static int l_get_param2_data(lua_State *L);
 	static int l_set_param2_data(lua_State *L);
 
+	static int l_get_buffer(lua_State *L);
+
 	static int l_was_modified(lua_State *L);
 	static int l_get_emerged_area(lua_State *L);
 
@@ -79,3 +81,58 @@ class LuaVoxelManip : public ModApiBase
 
 	static void Register(lua_State *L);
 };
+
+/*
+  VoxelManipBuffer
+
+  A view of the content ids, light or param2 values of the nodes of a
+  VoxelManip, used in place of the flat arrays of get_data() and friends.
+ */
+class LuaVoxelManipBuffer : public ModApiBase
+{
+public:
+	enum Field {
+		FIELD_CONTENT,
+		FIELD_LIGHT,
+		FIELD_PARAM2,
+	};
+
+private:
+	LuaVoxelManip *m_vm;
+	Field m_field;
+	// Registry reference to the VoxelManip, keeps it alive
+	int m_vm_ref;
+
+	static const char className[];
+	static const luaL_Reg methods[];
+
+	static int gc_object(lua_State *L);
+	static int mt_index(lua_State *L);
+	static int mt_newindex(lua_State *L);
+	static int mt_len(lua_State *L);
+
+	static int l_get(lua_State *L);
+	static int l_set(lua_State *L);
+	static int l_get_range(lua_State *L);
+	static int l_set_range(lua_State *L);
+	static int l_size(lua_State *L);
+	static int l_get_pointer(lua_State *L);
+
+	// Pushes the value at the Lua index i, or nil if it is out of range
+	void push(lua_State *L, lua_Integer i) const;
+	// Sets the value at the Lua index i, throws if it is out of range
+	void set(lua_State *L, lua_Integer i, int value_index) const;
+	// Sets the value of the node at the C index i, which must be in range
+	void setValue(u32 i, lua_Integer value) const;
+
+public:
+	LuaVoxelManipBuffer(LuaVoxelManip *vm, Field field, int vm_ref);
+
+	// Creates a buffer of the VoxelManip at vm_index and leaves it on top of
+	// stack
+	static int create_object(lua_State *L, int vm_index, Field field);
+
+	static LuaVoxelManipBuffer *checkobject(lua_State *L, int narg);
+
+	static void Register(lua_State *L);
+};
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <algorithm>
 #include "network/connection.h"
 #include "network/networkprotocol.h"
+#include "network/packetcapture.h"
 #include "network/serveropcodes.h"
 #include "ban.h"
 #include "environment.h"
@@ -58,6 +59,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/thread.h"
 #include "defaultsettings.h"
 #include "server/mods.h"
+#include "server/authworker.h"
 #include "util/base64.h"
 #include "util/sha1.h"
 #include "util/hex.h"
@@ -99,6 +101,8 @@ void *ServerThread::run()
 		try {
 			m_server->AsyncRunStep();
 
+			m_server->ProcessAuthResults();
+
 			m_server->Receive();
 
 		} catch (con::NoIncomingDataException &e) {
@@ -331,6 +335,22 @@ void Server::init()
 	std::string ban_path = m_path_world + DIR_DELIM "ipban.txt";
 	m_banmanager = new BanManager(ban_path);
 
+	// Create auth worker pool, 0 threads runs the SRP steps synchronously
+	m_auth_workers = std::unique_ptr<AuthWorkerPool>(
+			new AuthWorkerPool(g_settings->getU16("auth_worker_threads")));
+
+	// Start inbound packet capture if requested
+	std::string capture_path = g_settings->get("packet_capture_file");
+	if (!capture_path.empty()) {
+		m_packet_capture = std::unique_ptr<PacketCaptureWriter>(
+				new PacketCaptureWriter(capture_path));
+		if (m_packet_capture->isOpen())
+			actionstream << "Server: capturing inbound packets to "
+					<< capture_path << std::endl;
+		else
+			m_packet_capture.reset();
+	}
+
 	m_modmgr = std::unique_ptr<ServerModManager>(new ServerModManager(m_path_world));
 	std::vector<ModSpec> unsatisfied_mods = m_modmgr->getUnsatisfiedMods();
 	// complain about mods with unsatisfied dependencies
@@ -419,7 +439,8 @@ void Server::start()
 	m_con->SetTimeoutMs(30);
 	m_con->Serve(m_bind_addr);
 
-	// Start thread
+	// Start threads
+	m_auth_workers->start();
 	m_thread->start();
 
 	// ASCII art for the win!
@@ -445,6 +466,7 @@ void Server::stop()
 	//m_emergethread.setRun(false);
 	m_thread->wait();
 	//m_emergethread.stop();
+	m_auth_workers->stop();
 
 	infostream<<"Server: Threads stopped"<<std::endl;
 }
@@ -470,6 +492,23 @@ void Server::step(float dtime)
 	}
 }
 
+/*
+	Time between position updates of an object sent to a player: zero up to
+	lod_distance, then growing linearly to max_interval at lod_range.
+*/
+static float get_position_update_interval(PlayerSAO *playersao,
+		ServerActiveObject *obj, float lod_distance, float lod_range,
+		float max_interval)
+{
+	float d = playersao->getBasePosition().getDistanceFrom(obj->getBasePosition());
+	if (d <= lod_distance)
+		return 0.0f;
+	if (lod_range <= lod_distance)
+		return max_interval;
+
+	return MYMIN(1.0f, (d - lod_distance) / (lod_range - lod_distance)) * max_interval;
+}
+
 void Server::AsyncRunStep(bool initial_step)
 {
 	g_profiler->add("Server::AsyncRunStep (num)", 1);
@@ -696,6 +735,7 @@ void Server::AsyncRunStep(bool initial_step)
 
 				// Remove from known objects
 				client->m_known_objects.erase(id);
+				client->m_object_position_lod.erase(id);
 
 				if(obj && obj->m_known_by_count > 0)
 					obj->m_known_by_count--;
@@ -789,6 +829,14 @@ void Server::AsyncRunStep(bool initial_step)
 			message_list->push_back(aom);
 		}
 
+		// Position updates of objects further away than this are rate limited
+		static thread_local const float lod_distance =
+			g_settings->getS16("object_update_lod_distance") * BS;
+		static thread_local const float lod_max_interval =
+			g_settings->getFloat("object_update_lod_max_interval");
+		static thread_local const float lod_range =
+			g_settings->getS16("active_object_send_range_blocks") * MAP_BLOCKSIZE * BS;
+
 		m_clients.lock();
 		const RemoteClientMap &clients = m_clients.getClientList();
 		// Route data to every client
@@ -796,6 +844,35 @@ void Server::AsyncRunStep(bool initial_step)
 			RemoteClient *client = client_it.second;
 			std::string reliable_data;
 			std::string unreliable_data;
+
+			PlayerSAO *playersao = nullptr;
+			if (lod_distance > 0) {
+				RemotePlayer *player = m_env->getPlayer(client->peer_id);
+				if (player)
+					playersao = player->getPlayerSAO();
+			}
+
+			// Send held back position updates that are due now
+			for (auto it = client->m_object_position_lod.begin();
+					it != client->m_object_position_lod.end();) {
+				ServerActiveObject *obj = m_env->getActiveObject(it->first);
+				if (!obj || !playersao) {
+					it = client->m_object_position_lod.erase(it);
+					continue;
+				}
+
+				RemoteClient::ObjectPositionLod &lod = it->second;
+				lod.timer += dtime;
+				float interval = get_position_update_interval(playersao, obj,
+						lod_distance, lod_range, lod_max_interval);
+				if (!lod.pending.empty() && lod.timer >= interval) {
+					unreliable_data += lod.pending;
+					lod.pending.clear();
+					lod.timer = 0.0f;
+				}
+				++it;
+			}
+
 			// Go through all objects in message buffer
 			for (const auto &buffered_message : buffered_messages) {
 				// If object is not known by client, skip it
@@ -803,18 +880,59 @@ void Server::AsyncRunStep(bool initial_step)
 				if (client->m_known_objects.find(id) == client->m_known_objects.end())
 					continue;
 
+				float lod_interval = 0.0f;
+				if (playersao) {
+					ServerActiveObject *obj = m_env->getActiveObject(id);
+					if (obj && obj != playersao)
+						lod_interval = get_position_update_interval(playersao, obj,
+								lod_distance, lod_range, lod_max_interval);
+				}
+
 				// Get message list of object
 				std::vector<ActiveObjectMessage>* list = buffered_message.second;
 				// Go through every message
 				for (const ActiveObjectMessage &aom : *list) {
+					bool is_position = !aom.reliable &&
+							aom.datastring.size() >= 55 &&
+							aom.datastring[0] == GENERIC_CMD_UPDATE_POSITION;
+
 					// Compose the full new data with header
 					std::string new_data;
 					// Add object id
 					char buf[2];
 					writeU16((u8*)&buf[0], aom.id);
 					new_data.append(buf, 2);
-					// Add data
-					new_data += serializeString(aom.datastring);
+
+					if (is_position && lod_interval > 0.0f) {
+						// Let the client interpolate over the longer interval
+						std::string datastring = aom.datastring;
+						float update_interval = readF32((u8 *)&datastring[51]);
+						writeF32((u8 *)&datastring[51],
+								MYMAX(update_interval, lod_interval));
+						new_data += serializeString(datastring);
+
+						auto it = client->m_object_position_lod.find(id);
+						if (it == client->m_object_position_lod.end()) {
+							// First update of this object, send right away
+							client->m_object_position_lod[id];
+						} else if (it->second.timer < lod_interval) {
+							// Keep only the newest one, it's absolute
+							it->second.pending = new_data;
+							continue;
+						} else {
+							it->second.pending.clear();
+							it->second.timer = 0.0f;
+						}
+					} else {
+						new_data += serializeString(aom.datastring);
+						if (is_position) {
+							// Object came close, drop held back updates
+							auto it = client->m_object_position_lod.find(id);
+							if (it != client->m_object_position_lod.end())
+								it->second.pending.clear();
+						}
+					}
+
 					// Add data to buffer
 					if (aom.reliable)
 						reliable_data += new_data;
@@ -1018,6 +1136,23 @@ void Server::Receive()
 	}
 }
 
+void Server::ProcessAuthResults()
+{
+	SrpJob job;
+	while (m_auth_workers->popResult(&job)) {
+		// Same locking as ProcessData, the result may accept the player
+		MutexAutoLock envlock(m_env_mutex);
+		try {
+			handleAuthResult(job);
+		} catch (const ClientStateError &e) {
+			errorstream << "ProcessAuthResults: peer=" << job.peer_id
+					<< e.what() << std::endl;
+		} catch (const con::PeerNotFoundException &e) {
+			// Do nothing
+		}
+	}
+}
+
 PlayerSAO* Server::StageTwoClientInit(session_t peer_id)
 {
 	std::string playername;
@@ -1148,6 +1283,9 @@ void Server::ProcessData(NetworkPacket *pkt)
 			return;
 		}
 
+		if (m_packet_capture)
+			m_packet_capture->record(pkt);
+
 		if (toServerCommandTable[command].state == TOSERVER_STATE_NOT_CONNECTED) {
 			handleCommand(pkt);
 			return;
@@ -2241,6 +2379,15 @@ void Server::SendBlockNoLock(session_t peer_id, MapBlock *block, u8 ver,
 	block->serializeNetworkSpecific(os);
 	std::string s = os.str();
 
+	// The client still has this exact block in its block cache
+	RemoteClient *client = m_clients.lockedGetClientNoEx(peer_id, CS_Active);
+	if (client && client->TakeBlockCached(block->getPos(), s)) {
+		NetworkPacket pkt(TOCLIENT_BLOCKDATA_CACHED, 6, peer_id);
+		pkt << block->getPos();
+		Send(&pkt);
+		return;
+	}
+
 	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 2 + 2 + 2 + 2 + s.size(), peer_id);
 
 	pkt << block->getPos();
@@ -63,6 +63,9 @@ struct SimpleSoundSpec;
 struct CloudParams;
 class ServerThread;
 class ServerModManager;
+class PacketCaptureWriter;
+class AuthWorkerPool;
+struct SrpJob;
 
 enum ClientDeletionReason {
 	CDR_LEAVE,
@@ -137,6 +140,8 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	// This is run by ServerThread and does the actual processing
 	void AsyncRunStep(bool initial_step=false);
 	void Receive();
+	// Applies the SRP steps finished by the auth workers, run by ServerThread
+	void ProcessAuthResults();
 	PlayerSAO* StageTwoClientInit(session_t peer_id);
 
 	/*
@@ -157,6 +162,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_GotBlocks(NetworkPacket* pkt);
 	void handleCommand_PlayerPos(NetworkPacket* pkt);
 	void handleCommand_DeletedBlocks(NetworkPacket* pkt);
+	void handleCommand_CachedBlocks(NetworkPacket* pkt);
 	void handleCommand_InventoryAction(NetworkPacket* pkt);
 	void handleCommand_ChatMessage(NetworkPacket* pkt);
 	void handleCommand_Damage(NetworkPacket* pkt);
@@ -170,6 +176,7 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 	void handleCommand_FirstSrp(NetworkPacket* pkt);
 	void handleCommand_SrpBytesA(NetworkPacket* pkt);
 	void handleCommand_SrpBytesM(NetworkPacket* pkt);
+	void handleAuthResult(const SrpJob &job);
 
 	void ProcessData(NetworkPacket *pkt);
 
@@ -661,6 +668,12 @@ class Server : public con::PeerHandler, public MapEventReceiver,
 
 	// ModChannel manager
 	std::unique_ptr<ModChannelMgr> m_modchannel_mgr;
+
+	// Inbound packet capture for replaying, see packet_capture_file
+	std::unique_ptr<PacketCaptureWriter> m_packet_capture;
+
+	// Computes SRP authentication steps off the server thread
+	std::unique_ptr<AuthWorkerPool> m_auth_workers;
 };
 
 /*
@@ -0,0 +1,145 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "authworker.h"
+#include "exceptions.h"
+#include "log.h"
+#include "porting.h"
+#include "threading/thread.h"
+#include "util/auth.h"
+#include "util/string.h"
+#include "util/srp.h"
+
+class AuthWorkerThread : public Thread
+{
+public:
+	AuthWorkerThread(AuthWorkerPool *pool, int index) :
+		Thread("Auth" + itos(index)),
+		m_pool(pool)
+	{
+	}
+
+	void *run()
+	{
+		while (!stopRequested()) {
+			SrpJob job;
+			try {
+				job = m_pool->m_jobs.pop_front(100);
+			} catch (ItemNotFoundException &e) {
+				continue;
+			}
+
+			AuthWorkerPool::runJob(&job);
+			m_pool->m_results.push_back(job);
+		}
+		return nullptr;
+	}
+
+private:
+	AuthWorkerPool *m_pool;
+};
+
+AuthWorkerPool::AuthWorkerPool(u16 thread_count)
+{
+	for (u16 i = 0; i < thread_count; i++)
+		m_threads.emplace_back(new AuthWorkerThread(this, i));
+}
+
+AuthWorkerPool::~AuthWorkerPool()
+{
+	stop();
+
+	// Nobody is going to pick these up anymore
+	while (!m_jobs.empty())
+		srp_verifier_delete(m_jobs.pop_frontNoEx().verifier);
+	while (!m_results.empty())
+		srp_verifier_delete(m_results.pop_frontNoEx().verifier);
+}
+
+void AuthWorkerPool::start()
+{
+	for (auto &thread : m_threads)
+		thread->start();
+}
+
+void AuthWorkerPool::stop()
+{
+	for (auto &thread : m_threads)
+		thread->stop();
+	for (auto &thread : m_threads)
+		thread->wait();
+}
+
+void AuthWorkerPool::queueJob(const SrpJob &job)
+{
+	if (m_threads.empty()) {
+		SrpJob sync_job = job;
+		runJob(&sync_job);
+		m_results.push_back(sync_job);
+		return;
+	}
+
+	m_jobs.push_back(job);
+}
+
+bool AuthWorkerPool::popResult(SrpJob *job)
+{
+	// Only the server thread consumes results, so this can't block
+	if (m_results.empty())
+		return false;
+
+	*job = m_results.pop_frontNoEx();
+	return true;
+}
+
+void AuthWorkerPool::runJob(SrpJob *job)
+{
+	job->success = false;
+
+	switch (job->type) {
+	case SRP_JOB_START: {
+		if (job->legacy_password)
+			generate_srp_verifier_and_salt(job->name, job->password,
+				&job->srp_verifier, &job->salt);
+
+		char *bytes_B = 0;
+		size_t len_B = 0;
+		job->verifier = srp_verifier_new(SRP_SHA256, SRP_NG_2048,
+			job->name.c_str(),
+			(const unsigned char *) job->salt.c_str(), job->salt.size(),
+			(const unsigned char *) job->srp_verifier.c_str(), job->srp_verifier.size(),
+			(const unsigned char *) job->bytes_A.c_str(), job->bytes_A.size(),
+			NULL, 0,
+			(unsigned char **) &bytes_B, &len_B, NULL, NULL);
+
+		if (bytes_B) {
+			job->bytes_B.assign(bytes_B, len_B);
+			job->success = true;
+		}
+		break;
+	}
+	case SRP_JOB_VERIFY: {
+		unsigned char *bytes_HAMK = 0;
+		srp_verifier_verify_session(job->verifier,
+			(const unsigned char *) job->bytes_M.c_str(), &bytes_HAMK);
+		job->success = bytes_HAMK != nullptr;
+		break;
+	}
+	}
+}
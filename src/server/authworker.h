@@ -0,0 +1,102 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "constants.h"
+#include "network/networkprotocol.h"
+#include "util/container.h"
+
+struct SRPVerifier;
+class AuthWorkerThread;
+
+enum SrpJobType
+{
+	// TOSERVER_SRP_BYTES_A: create the verifier and compute B
+	SRP_JOB_START,
+	// TOSERVER_SRP_BYTES_M: check the client's proof M
+	SRP_JOB_VERIFY,
+};
+
+/*
+	A unit of SRP work, sent to a worker and returned to the server thread
+	with the result filled in.
+
+	The job owns 'verifier' while it is queued; the server thread takes
+	ownership back when it picks up the result.
+*/
+struct SrpJob
+{
+	SrpJobType type = SRP_JOB_START;
+	session_t peer_id = PEER_ID_INEXISTENT;
+	bool want_sudo = false;
+	std::string name;
+
+	// SRP_JOB_START input. With legacy_password set, 'password' is the
+	// legacy hash and salt and verifier are generated from it.
+	bool legacy_password = false;
+	std::string password;
+	std::string salt;
+	std::string srp_verifier;
+	std::string bytes_A;
+
+	// SRP_JOB_VERIFY input
+	std::string bytes_M;
+
+	// Created by SRP_JOB_START, consumed by SRP_JOB_VERIFY
+	SRPVerifier *verifier = nullptr;
+
+	// Output
+	bool success = false;
+	std::string bytes_B;
+};
+
+/*
+	Runs the expensive SRP big number math (srp_verifier_new and
+	srp_verifier_verify_session) outside of the server thread, so that a
+	burst of logins doesn't stall the game loop.
+
+	With zero threads the jobs are run synchronously in queueJob().
+*/
+class AuthWorkerPool
+{
+public:
+	AuthWorkerPool(u16 thread_count);
+	~AuthWorkerPool();
+
+	void start();
+	void stop();
+
+	void queueJob(const SrpJob &job);
+	// Called by the server thread; returns false if no result is ready
+	bool popResult(SrpJob *job);
+
+	static void runJob(SrpJob *job);
+
+private:
+	friend class AuthWorkerThread;
+
+	std::vector<std::unique_ptr<AuthWorkerThread>> m_threads;
+	MutexedQueue<SrpJob> m_jobs;
+	MutexedQueue<SrpJob> m_results;
+};
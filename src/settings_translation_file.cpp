@@ -357,6 +357,8 @@ fake_function() {
 	gettext("Enables caching of facedir rotated meshes.");
 	gettext("Mapblock mesh generation delay");
 	gettext("Delay between mesh updates on the client in ms. Increasing this will slow\ndown the rate of mesh updates, thus reducing jitter on slower clients.");
+	gettext("Mapblock mesh generation threads");
+	gettext("Number of threads building mapblock meshes on the client.\n0 uses the number of processors minus two, at least 1.");
 	gettext("Mapblock mesh generator's MapBlock cache size in MB");
 	gettext("Size of the MapBlock cache of the mesh generator. Increasing this will\nincrease the cache hit %, reducing the data being copied from the main\nthread, thus reducing jitter.");
 	gettext("Minimap");
@@ -433,6 +435,12 @@ fake_function() {
 	gettext("Port to connect to (UDP).\nNote that the port field in the main menu overrides this setting.");
 	gettext("Saving map received from server");
 	gettext("Save the map received by the client on disk.");
+	gettext("Cache map blocks received from servers");
+	gettext("Keep map blocks received from servers in the cache directory.\nOn the next visit the server only sends blocks that have changed.");
+	gettext("Block cache size limit");
+	gettext("Size limit of the block cache of each server, in MB.\nThe least recently used blocks are dropped when it is exceeded.");
+	gettext("Cache composed textures");
+	gettext("Keep textures composed from server media in the cache directory.\nMakes joining a server again faster. Only the textures of the five\nservers or media versions used last are kept.");
 	gettext("Connect to external media server");
 	gettext("Enable usage of remote media server (if provided by server).\nRemote servers offer a significantly faster way to download media (e.g. textures)\nwhen connecting to the server.");
 	gettext("Client modding");
@@ -520,6 +528,8 @@ fake_function() {
 	gettext("If this is set, players will always (re)spawn at the given position.");
 	gettext("Disallow empty passwords");
 	gettext("If enabled, new players cannot join with an empty password.");
+	gettext("Authentication threads");
+	gettext("Number of threads used for the SRP password checks of logging in players.\nValue 0 runs them on the server thread.");
 	gettext("Disable anticheat");
 	gettext("If enabled, disable cheat prevention in multiplayer.");
 	gettext("Rollback recording");
@@ -532,6 +542,10 @@ fake_function() {
 	gettext("Whether to ask clients to reconnect after a (Lua) crash.\nSet this to true if your server is set up to restart automatically.");
 	gettext("Active object send range");
 	gettext("From how far clients know about objects, stated in mapblocks (16 nodes).\n\nSetting this larger than active_block_range will also cause the server\nto maintain active objects up to this distance in the direction the\nplayer is looking. (This can avoid mobs suddenly disappearing from view)");
+	gettext("Object update LOD distance");
+	gettext("Objects further away from a player than this distance (in nodes) send their\nposition updates to that player at a reduced rate, slowing down linearly\nup to the active object send range. Clients extrapolate the movement in\nbetween. 0 sends all updates at full rate.");
+	gettext("Object update LOD max interval");
+	gettext("Longest time in seconds between position updates of distant objects.");
 	gettext("Active block range");
 	gettext("The radius of the volume of blocks around every player that is subject to the\nactive block stuff, stated in mapblocks (16 nodes).\nIn active blocks objects are loaded and ABMs run.\nThis is also the minimum range in which active objects (mobs) are maintained.\nThis should be configured together with active_object_range.");
 	gettext("Max block send distance");
@@ -586,6 +600,8 @@ fake_function() {
 	gettext("Length of time between NodeTimer execution cycles");
 	gettext("Ignore world errors");
 	gettext("If enabled, invalid world data won't cause the server to shut down.\nOnly enable this if you know what you are doing.");
+	gettext("Packet capture file");
+	gettext("If set, all packets received by the server are written to this file.\nThe capture can be replayed against a server with minetestloadgen.\nLeave empty to disable capturing.");
 	gettext("Liquid loop max");
 	gettext("Max liquids processed per step.");
 	gettext("Liquid queue purge time");
@@ -655,6 +671,10 @@ fake_function() {
 	gettext("Replaces the default main menu with a custom one.");
 	gettext("Engine profiling data print interval");
 	gettext("Print the engine's profiling data in regular intervals (in seconds).\n0 = disable. Useful for developers.");
+	gettext("Client frame trace");
+	gettext("Record how long the parts of each client frame take, for the last frames.\nThe recording is written to a Chrome trace file (frametrace-*.json) in the\nuser directory after a hitch and when leaving the game. Useful for developers.");
+	gettext("Client frame trace hitch threshold");
+	gettext("Frames taking longer than this many milliseconds write the frame trace.\nAt most one trace is written every 10 seconds. 0 = only when leaving the game.");
 	gettext("Mapgen");
 	gettext("Mapgen name");
 	gettext("Name of map generator to be used when creating a new world.\nCreating a world in the main menu will override this.\nCurrent stable mapgens:\nv5, v6, v7 (except floatlands), flat, singlenode.\n'stable' means the terrain shape in an existing world will not be changed\nin the future. Note that biomes are defined by games and may still change.");
@@ -0,0 +1,183 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "threading/task_pool.h"
+#include <algorithm>
+#include "threading/thread.h"
+#include "debug.h"
+#include "log.h"
+
+static thread_local TaskPool *current_pool = nullptr;
+
+class TaskPoolThread : public Thread
+{
+public:
+	TaskPoolThread(const std::string &name, TaskPool *pool) :
+		Thread(name),
+		m_pool(pool)
+	{}
+
+	void *run()
+	{
+		BEGIN_DEBUG_EXCEPTION_HANDLER
+
+		m_pool->runHelper();
+
+		END_DEBUG_EXCEPTION_HANDLER
+
+		return nullptr;
+	}
+
+private:
+	TaskPool *m_pool;
+};
+
+
+TaskPool::TaskPool(const std::string &name, u32 num_threads)
+{
+	for (u32 i = 0; i != num_threads; i++) {
+		std::unique_ptr<TaskPoolThread> thread(new TaskPoolThread(name, this));
+		if (!thread->start()) {
+			errorstream << "TaskPool: failed to start thread " << name
+				<< std::endl;
+			break;
+		}
+		m_threads.push_back(std::move(thread));
+	}
+}
+
+
+TaskPool::~TaskPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_loop_added.notify_all();
+
+	for (auto &thread : m_threads)
+		thread->wait();
+}
+
+
+void TaskPool::parallelFor(u32 count, u32 grain, const RangeFunc &func)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	Loop loop;
+	loop.func       = &func;
+	loop.count      = count;
+	loop.grain      = grain;
+	loop.num_ranges = (count - 1) / grain + 1;
+	loop.next_range = 0;
+	loop.helpers    = 0;
+
+	if (loop.num_ranges == 1 || m_threads.empty()) {
+		func(0, count);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_loops.push_back(&loop);
+	}
+	m_loop_added.notify_all();
+
+	runRanges(&loop);
+
+	// Every range has been started. Stop handing out the loop and wait
+	// for the helpers that are still working on it.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto it = std::find(m_loops.begin(), m_loops.end(), &loop);
+	if (it != m_loops.end())
+		m_loops.erase(it);
+	m_loop_done.wait(lock, [&loop] { return loop.helpers == 0; });
+	lock.unlock();
+
+	if (loop.error)
+		std::rethrow_exception(loop.error);
+}
+
+
+TaskPool *TaskPool::getCurrent()
+{
+	return current_pool;
+}
+
+
+void TaskPool::setCurrent(TaskPool *pool)
+{
+	current_pool = pool;
+}
+
+
+void TaskPool::runRanges(Loop *loop)
+{
+	for (;;) {
+		u32 range = loop->next_range++;
+		if (range >= loop->num_ranges)
+			return;
+
+		u32 begin = range * loop->grain;
+		u32 end = loop->count - begin > loop->grain ?
+			begin + loop->grain : loop->count;
+		try {
+			(*loop->func)(begin, end);
+		} catch (...) {
+			// Keep the first exception for the calling thread and
+			// start no more ranges
+			std::lock_guard<std::mutex> lock(loop->error_mutex);
+			if (!loop->error)
+				loop->error = std::current_exception();
+			loop->next_range = loop->num_ranges;
+			return;
+		}
+	}
+}
+
+
+void TaskPool::runHelper()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		m_loop_added.wait(lock, [this] {
+			return m_stopping || !m_loops.empty();
+		});
+		if (m_stopping)
+			return;
+
+		Loop *loop = m_loops.front();
+		loop->helpers++;
+
+		lock.unlock();
+		runRanges(loop);
+		lock.lock();
+
+		auto it = std::find(m_loops.begin(), m_loops.end(), loop);
+		if (it != m_loops.end())
+			m_loops.erase(it);
+
+		if (--loop->helpers == 0)
+			m_loop_done.notify_all();
+	}
+}
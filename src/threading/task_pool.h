@@ -0,0 +1,108 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+
+class TaskPoolThread;
+
+/*
+	A set of helper threads that split loops into ranges and work on them
+	together with the thread that runs the loop.
+
+	Several threads may run loops on the same pool at once: idle helpers
+	take ranges from whichever loop is waiting, while every calling thread
+	keeps working on its own loop, so a loop always finishes even when all
+	helpers are busy elsewhere.
+*/
+class TaskPool
+{
+public:
+	typedef std::function<void(u32 begin, u32 end)> RangeFunc;
+
+	TaskPool(const std::string &name, u32 num_threads);
+	~TaskPool();
+	DISABLE_CLASS_COPY(TaskPool);
+
+	u32 getNumThreads() const { return m_threads.size(); }
+
+	// Calls func for consecutive ranges of at most grain items that together
+	// cover [0, count), and returns once all of them are done. The ranges
+	// run in no particular order and on any thread, so func must only
+	// write to data that belongs to its range.
+	// If func throws, no more ranges are started and the first exception
+	// is rethrown here once the ranges that were started are done.
+	void parallelFor(u32 count, u32 grain, const RangeFunc &func);
+
+	// Same as above, but runs the whole loop on the calling thread if there
+	// is no pool
+	static void parallelFor(TaskPool *pool, u32 count, u32 grain,
+		const RangeFunc &func)
+	{
+		if (pool)
+			pool->parallelFor(count, grain, func);
+		else if (count)
+			func(0, count);
+	}
+
+	// Pool that code running on the calling thread may use, or NULL.
+	// Set by the threads that own a pool, e.g. the emerge threads.
+	static TaskPool *getCurrent();
+	static void setCurrent(TaskPool *pool);
+
+private:
+	friend class TaskPoolThread;
+
+	struct Loop {
+		const RangeFunc *func;
+		u32 count;
+		u32 grain;
+		u32 num_ranges;
+		std::atomic<u32> next_range;
+		// Helpers working on ranges of this loop, protected by m_mutex
+		u32 helpers;
+		// First exception thrown by func, protected by error_mutex
+		std::mutex error_mutex;
+		std::exception_ptr error;
+	};
+
+	// Runs ranges of the loop until there are none left
+	static void runRanges(Loop *loop);
+
+	void runHelper();
+
+	std::vector<std::unique_ptr<TaskPoolThread>> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_loop_added;
+	std::condition_variable m_loop_done;
+	std::deque<Loop *> m_loops;
+	bool m_stopping = false;
+};
@@ -294,6 +294,43 @@ bool run_tests()
 	return num_modules_failed;
 }
 
+////
+//// run_benchmarks
+////
+
+bool run_benchmarks()
+{
+	u64 t1 = porting::getTimeMs();
+	TestGameDef gamedef;
+
+	g_logger.setLevelSilenced(LL_ERROR, true);
+
+	u32 num_failed = 0;
+	u32 num_run    = 0;
+	for (TestBase *testmod : TestManager::getTestModules()) {
+		testmod->benchmarkModule(&gamedef);
+		num_failed += testmod->num_tests_failed;
+		num_run += testmod->num_tests_run;
+	}
+
+	u64 tdiff = porting::getTimeMs() - t1;
+
+	g_logger.setLevelSilenced(LL_ERROR, false);
+
+	rawstream
+		<< "++++++++++++++++++++++++++++++++++++++++"
+		<< "++++++++++++++++++++++++++++++++++++++++" << std::endl
+		<< "Benchmark Results: " << (num_failed == 0 ? "PASSED" : "FAILED")
+		<< std::endl
+		<< "    " << num_failed << " / " << num_run
+		<< " failed benchmarks." << std::endl
+		<< "    Benchmarking took " << tdiff << "ms total." << std::endl
+		<< "++++++++++++++++++++++++++++++++++++++++"
+		<< "++++++++++++++++++++++++++++++++++++++++" << std::endl;
+
+	return num_failed;
+}
+
 ////
 //// TestBase
 ////
@@ -318,6 +355,19 @@ bool TestBase::testModule(IGameDef *gamedef)
 	return num_tests_failed == 0;
 }
 
+bool TestBase::benchmarkModule(IGameDef *gamedef)
+{
+	// Most modules have no benchmarks, so there is no header for each
+	num_tests_failed = 0;
+	num_tests_run = 0;
+	runBenchmarks(gamedef);
+
+	if (!m_test_dir.empty())
+		fs::RecursiveDelete(m_test_dir);
+
+	return num_tests_failed == 0;
+}
+
 std::string TestBase::getTestTempDirectory()
 {
 	if (!m_test_dir.empty())
@@ -104,10 +104,15 @@ class IGameDef;
 class TestBase {
 public:
 	bool testModule(IGameDef *gamedef);
+	bool benchmarkModule(IGameDef *gamedef);
 	std::string getTestTempDirectory();
 	std::string getTestTempFile();
 
 	virtual void runTests(IGameDef *gamedef) = 0;
+	// Benchmarks are slow and their timings depend on the machine, so they
+	// are run by --run-benchmarks instead of with the tests. They write
+	// their results to rawstream.
+	virtual void runBenchmarks(IGameDef *gamedef) {}
 	virtual const char *getName() = 0;
 
 	u32 num_tests_failed;
@@ -140,3 +145,4 @@ extern content_t t_CONTENT_LAVA;
 extern content_t t_CONTENT_BRICK;
 
 bool run_tests();
+bool run_benchmarks();
@@ -0,0 +1,213 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <cfloat>
+#include "mapgen/mg_biome.h"
+#include "noise.h"
+#include "porting.h"
+#include "util/numeric.h"
+
+class TestBiome : public TestBase {
+public:
+	TestBiome() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestBiome"; }
+
+	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
+
+	void testIndexEmpty();
+	void testIndex();
+	void benchmarkIndex();
+};
+
+static TestBiome g_test_instance;
+
+void TestBiome::runTests(IGameDef *gamedef)
+{
+	TEST(testIndexEmpty);
+	TEST(testIndex);
+}
+
+void TestBiome::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkIndex);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Same as BiomeManager::getBiomeFromNoiseOriginal()
+static Biome *find_biome_linear(const std::vector<Biome *> &biomes,
+	float heat, float humidity, v3s16 pos)
+{
+	Biome *biome_closest = nullptr;
+	Biome *biome_closest_blend = nullptr;
+	float dist_min = FLT_MAX;
+	float dist_min_blend = FLT_MAX;
+
+	for (Biome *b : biomes) {
+		if (pos.Y < b->min_pos.Y || pos.Y > b->max_pos.Y + b->vertical_blend ||
+				pos.X < b->min_pos.X || pos.X > b->max_pos.X ||
+				pos.Z < b->min_pos.Z || pos.Z > b->max_pos.Z)
+			continue;
+
+		float d_heat = heat - b->heat_point;
+		float d_humidity = humidity - b->humidity_point;
+		float dist = (d_heat * d_heat) + (d_humidity * d_humidity);
+
+		if (pos.Y <= b->max_pos.Y) {
+			if (dist < dist_min) {
+				dist_min = dist;
+				biome_closest = b;
+			}
+		} else if (dist < dist_min_blend) {
+			dist_min_blend = dist;
+			biome_closest_blend = b;
+		}
+	}
+
+	mysrand(pos.Y + (heat + humidity) * 0.9f);
+	if (biome_closest_blend && dist_min_blend <= dist_min &&
+			myrand_range(0, biome_closest_blend->vertical_blend) >=
+			pos.Y - biome_closest_blend->max_pos.Y)
+		return biome_closest_blend;
+
+	return biome_closest;
+}
+
+static void create_biomes(std::vector<Biome *> *biomes, u32 count, PcgRandom &pr)
+{
+	for (u32 i = 0; i < count; i++) {
+		Biome *b = new Biome;
+		b->index = i + 1;
+
+		s16 y_min = pr.range(-200, 100);
+		b->min_pos = v3s16(-31000, y_min, -31000);
+		b->max_pos = v3s16(31000, y_min + pr.range(0, 200), 31000);
+		if (i % 5 == 0) {
+			b->min_pos.X = pr.range(-100, 0);
+			b->max_pos.X = pr.range(0, 100);
+			b->min_pos.Z = pr.range(-100, 0);
+			b->max_pos.Z = pr.range(0, 100);
+		}
+
+		// Equal points and equal distances must pick the lowest index
+		if (i % 7 == 6) {
+			b->heat_point = (*biomes)[i - 1]->heat_point;
+			b->humidity_point = (*biomes)[i - 1]->humidity_point;
+		} else if (i % 3 == 0) {
+			b->heat_point = pr.range(0, 10) * 10;
+			b->humidity_point = pr.range(0, 10) * 10;
+		} else {
+			b->heat_point = pr.range(-1000, 11000) / 100.0f;
+			b->humidity_point = pr.range(-1000, 11000) / 100.0f;
+		}
+
+		if (i % 11 == 0)
+			b->vertical_blend = -2;
+		else if (i % 2 == 0)
+			b->vertical_blend = pr.range(1, 8);
+		else
+			b->vertical_blend = 0;
+
+		biomes->push_back(b);
+	}
+}
+
+static void delete_biomes(std::vector<Biome *> *biomes)
+{
+	for (Biome *b : *biomes)
+		delete b;
+	biomes->clear();
+}
+
+void TestBiome::testIndexEmpty()
+{
+	std::vector<Biome *> biomes;
+	BiomeIndex index(biomes);
+	UASSERT(index.get(50, 50, v3s16(0, 0, 0)) == nullptr);
+
+	PcgRandom pr(1);
+	create_biomes(&biomes, 1, pr);
+	BiomeIndex index1(biomes);
+	v3s16 pos(0, biomes[0]->min_pos.Y, 0);
+	UASSERT(index1.get(-1000, 1000, pos) == biomes[0]);
+	pos.Y--;
+	UASSERT(index1.get(-1000, 1000, pos) == nullptr);
+	delete_biomes(&biomes);
+}
+
+void TestBiome::testIndex()
+{
+	for (u32 count : {2, 13, 150}) {
+		PcgRandom pr(count);
+		std::vector<Biome *> biomes;
+		create_biomes(&biomes, count, pr);
+		BiomeIndex index(biomes);
+
+		for (u32 i = 0; i < 100000; i++) {
+			float heat, humidity;
+			if (i % 4 == 0) {
+				// On the points and on the grid lines
+				heat = pr.range(0, 10) * 10;
+				humidity = pr.range(0, 10) * 10;
+			} else {
+				heat = pr.range(-5000, 15000) / 100.0f;
+				humidity = pr.range(-5000, 15000) / 100.0f;
+			}
+			v3s16 pos(pr.range(-150, 150), pr.range(-250, 350), pr.range(-150, 150));
+
+			Biome *expected = find_biome_linear(biomes, heat, humidity, pos);
+			UASSERT(index.get(heat, humidity, pos) == expected);
+		}
+
+		delete_biomes(&biomes);
+	}
+}
+
+void TestBiome::benchmarkIndex()
+{
+	const u32 num_queries = 200000;
+	PcgRandom pr(42);
+	std::vector<Biome *> biomes;
+	create_biomes(&biomes, 150, pr);
+	BiomeIndex index(biomes);
+
+	std::vector<v3f> queries;
+	for (u32 i = 0; i < num_queries; i++)
+		queries.emplace_back(pr.range(-5000, 15000) / 100.0f,
+			pr.range(-5000, 15000) / 100.0f, pr.range(-250, 350));
+
+	u32 found_linear = 0, found_index = 0;
+	u64 t0 = porting::getTimeUs();
+	for (const v3f &q : queries)
+		found_linear += find_biome_linear(biomes, q.X, q.Y, v3s16(0, q.Z, 0)) != nullptr;
+	u64 t1 = porting::getTimeUs();
+	for (const v3f &q : queries)
+		found_index += index.get(q.X, q.Y, v3s16(0, q.Z, 0)) != nullptr;
+	u64 t2 = porting::getTimeUs();
+	UASSERTEQ(u32, found_linear, found_index);
+
+	rawstream << "Biome lookup, " << biomes.size() << " biomes, "
+		<< num_queries << " queries: linear " << (t1 - t0) / 1000
+		<< "ms, index " << (t2 - t1) / 1000 << "ms" << std::endl;
+
+	delete_biomes(&biomes);
+}
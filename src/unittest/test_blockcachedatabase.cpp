@@ -0,0 +1,106 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "database/database-sqlite3.h"
+#include "filesys.h"
+
+class TestBlockCacheDatabase : public TestBase {
+public:
+	TestBlockCacheDatabase() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestBlockCacheDatabase"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testSaveLoad();
+	void testList();
+	void testDeleteLeastRecentlyUsed();
+};
+
+static TestBlockCacheDatabase g_test_instance;
+
+void TestBlockCacheDatabase::runTests(IGameDef *gamedef)
+{
+	TEST(testSaveLoad);
+	TEST(testList);
+	TEST(testDeleteLeastRecentlyUsed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestBlockCacheDatabase::testSaveLoad()
+{
+	BlockCacheDatabaseSQLite3 db(getTestTempDirectory() + DIR_DELIM "save_load");
+	std::string data;
+	UASSERT(!db.loadBlock(v3s16(1, 2, 3), &data));
+
+	UASSERTEQ(u64, db.saveBlock(v3s16(1, 2, 3), 42, "block", 100), 0);
+	UASSERT(db.loadBlock(v3s16(1, 2, 3), &data));
+	UASSERTEQ(std::string, data, "block");
+
+	// Replacing a block gives the size it had
+	UASSERTEQ(u64, db.saveBlock(v3s16(1, 2, 3), 43, "new block", 101), 5);
+	UASSERT(db.loadBlock(v3s16(1, 2, 3), &data));
+	UASSERTEQ(std::string, data, "new block");
+	UASSERTEQ(u64, db.getTotalSize(), 9);
+}
+
+void TestBlockCacheDatabase::testList()
+{
+	BlockCacheDatabaseSQLite3 db(getTestTempDirectory() + DIR_DELIM "list");
+	UASSERTEQ(u64, db.getTotalSize(), 0);
+	db.saveBlock(v3s16(-1, 0, 5), 1, "a", 100);
+	db.saveBlock(v3s16(7, -300, 2), 2, "bb", 100);
+	db.saveBlock(v3s16(0, 0, 0), 3, "ccc", 100);
+	UASSERTEQ(u64, db.getTotalSize(), 6);
+
+	std::vector<std::pair<v3s16, u64>> blocks;
+	db.listBlocks(blocks);
+	UASSERTEQ(size_t, blocks.size(), 3);
+	std::sort(blocks.begin(), blocks.end(),
+		[] (const std::pair<v3s16, u64> &a, const std::pair<v3s16, u64> &b) {
+			return a.second < b.second;
+		});
+	UASSERT(blocks[0].first == v3s16(-1, 0, 5));
+	UASSERT(blocks[1].first == v3s16(7, -300, 2));
+	UASSERT(blocks[2].first == v3s16(0, 0, 0));
+	UASSERTEQ(u64, blocks[1].second, 2);
+}
+
+void TestBlockCacheDatabase::testDeleteLeastRecentlyUsed()
+{
+	BlockCacheDatabaseSQLite3 db(getTestTempDirectory() + DIR_DELIM "lru");
+	for (s16 i = 0; i < 10; i++)
+		db.saveBlock(v3s16(i, 0, 0), i, std::string(i + 1, 'x'), 100 + i);
+	// Using a block keeps it
+	db.touchBlock(v3s16(0, 0, 0), 200);
+
+	UASSERTEQ(u64, db.deleteLeastRecentlyUsed(3), 2 + 3 + 4);
+	std::string data;
+	UASSERT(db.loadBlock(v3s16(0, 0, 0), &data));
+	for (s16 i = 1; i < 4; i++)
+		UASSERT(!db.loadBlock(v3s16(i, 0, 0), &data));
+	UASSERT(db.loadBlock(v3s16(4, 0, 0), &data));
+	UASSERTEQ(u64, db.getTotalSize(), 1 + 5 + 6 + 7 + 8 + 9 + 10);
+
+	UASSERTEQ(u64, db.deleteLeastRecentlyUsed(100), 1 + 5 + 6 + 7 + 8 + 9 + 10);
+	UASSERTEQ(u64, db.getTotalSize(), 0);
+}
@@ -20,6 +20,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include "collision.h"
+#include "environment.h"
+#include "gamedef.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+#include "porting.h"
 
 class TestCollision : public TestBase {
 public:
@@ -27,8 +33,12 @@ class TestCollision : public TestBase {
 	const char *getName() { return "TestCollision"; }
 
 	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
 
 	void testAxisAlignedCollision();
+	void testCollisionMoveSimple(IGameDef *gamedef);
+	void testBlockCollisionCache(IGameDef *gamedef);
+	void benchmarkCollisionMoveSimple(IGameDef *gamedef);
 };
 
 static TestCollision g_test_instance;
@@ -36,6 +46,60 @@ static TestCollision g_test_instance;
 void TestCollision::runTests(IGameDef *gamedef)
 {
 	TEST(testAxisAlignedCollision);
+	TEST(testCollisionMoveSimple, gamedef);
+	TEST(testBlockCollisionCache, gamedef);
+}
+
+void TestCollision::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkCollisionMoveSimple, gamedef);
+}
+
+/*
+	3x2x3 blocks around the origin, stone below y = 0 and air above
+*/
+class CollisionTestEnvironment : public Environment
+{
+public:
+	CollisionTestEnvironment(IGameDef *gamedef):
+		Environment(gamedef),
+		m_map(dstream, gamedef)
+	{
+		MapNode stone(t_CONTENT_STONE);
+		MapNode air(CONTENT_AIR);
+		for (s16 z = -1; z <= 1; z++)
+		for (s16 x = -1; x <= 1; x++) {
+			MapSector *sector = new MapSector(&m_map, v2s16(x, z), gamedef);
+			(*m_map.getSectorsPtr())[v2s16(x, z)] = sector;
+			for (s16 y = -1; y <= 0; y++) {
+				MapBlock *block = sector->createBlankBlock(y);
+				MapNode n = y < 0 ? stone : air;
+				for (u32 i = 0; i < MapBlock::nodecount; i++)
+					block->getData()[i] = n;
+			}
+		}
+	}
+
+	void step(f32 dtime) {}
+	Map &getMap() { return m_map; }
+	void getSelectedActiveObjects(const core::line3d<f32> &shootline_on_map,
+			std::vector<PointedThing> &objects) {}
+
+private:
+	Map m_map;
+};
+
+// Drops a player sized box from 'pos' until it touches the ground
+static collisionMoveResult drop(Environment *env, IGameDef *gamedef, v3f *pos)
+{
+	aabb3f box(-0.3f * BS, 0.0f, -0.3f * BS, 0.3f * BS, 1.7f * BS, 0.3f * BS);
+	v3f speed(0, 0, 0);
+	collisionMoveResult r;
+	for (int i = 0; i < 100 && !r.touching_ground; i++) {
+		r = collisionMoveSimple(env, gamedef, BS * 0.5f, box, 0.0f, 0.05f,
+			pos, &speed, v3f(0, -10 * BS, 0), nullptr, false);
+	}
+	return r;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,3 +242,75 @@ void TestCollision::testAxisAlignedCollision()
 		}
 	}
 }
+
+void TestCollision::testCollisionMoveSimple(IGameDef *gamedef)
+{
+	CollisionTestEnvironment env(gamedef);
+
+	v3f pos(0, 5 * BS, 0);
+	collisionMoveResult r = drop(&env, gamedef, &pos);
+	UASSERT(r.touching_ground);
+	UASSERT(fabs(pos.Y - -0.5f * BS) < 0.01f * BS);
+
+	// The cached boxes of the block are rebuilt when a node changes
+	MapNode stone(t_CONTENT_STONE);
+	env.getMap().setNode(v3s16(0, 0, 0), stone);
+	pos = v3f(0, 5 * BS, 0);
+	r = drop(&env, gamedef, &pos);
+	UASSERT(r.touching_ground);
+	UASSERT(fabs(pos.Y - 0.5f * BS) < 0.01f * BS);
+}
+
+void TestCollision::testBlockCollisionCache(IGameDef *gamedef)
+{
+	CollisionTestEnvironment env(gamedef);
+	const NodeDefManager *nodedef = gamedef->getNodeDefManager();
+
+	// All stone nodes share one shape
+	MapBlock *block = env.getMap().getBlockNoCreateNoEx(v3s16(0, -1, 0));
+	const BlockCollisionCache *cache = getBlockCollisionCache(block, nodedef);
+	UASSERTEQ(size_t, cache->shapes.size(), 2);
+	UASSERTEQ(size_t, cache->boxes.size(), 1);
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		UASSERTEQ(u16, cache->nodes[i], BlockCollisionCache::NODE_SHAPE);
+	aabb3f node_box(-BS / 2, -BS / 2, -BS / 2, BS / 2, BS / 2, BS / 2);
+	UASSERT(cache->boxes[0].box == node_box);
+
+	// Another param2 is another shape
+	MapNode stone(t_CONTENT_STONE, 0, 1);
+	MapNode air(CONTENT_AIR);
+	env.getMap().setNode(v3s16(1, -2, 3), stone);
+	env.getMap().setNode(v3s16(2, -2, 3), air);
+	cache = getBlockCollisionCache(block, nodedef);
+	UASSERTEQ(size_t, cache->shapes.size(), 3);
+	u32 i = (3 * MAP_BLOCKSIZE + 14) * MAP_BLOCKSIZE + 1;
+	UASSERTEQ(u16, cache->nodes[i], BlockCollisionCache::NODE_SHAPE + 1);
+	UASSERTEQ(u16, cache->nodes[i + 1], BlockCollisionCache::NODE_EMPTY);
+	UASSERTEQ(u16, cache->nodes[i - 1], BlockCollisionCache::NODE_SHAPE);
+}
+
+void TestCollision::benchmarkCollisionMoveSimple(IGameDef *gamedef)
+{
+	// Objects walking on the ground, like mobs do
+	CollisionTestEnvironment env(gamedef);
+	aabb3f box(-0.4f * BS, 0.0f, -0.4f * BS, 0.4f * BS, 0.8f * BS, 0.4f * BS);
+	const u32 num_moves = 20000;
+
+	u64 t0 = porting::getTimeUs();
+	u32 touching_ground = 0;
+	for (u32 i = 0; i < num_moves; i++) {
+		v3f pos(((s32)(i % 20) - 10) * BS, -0.5f * BS,
+			((s32)((i / 20) % 20) - 10) * BS);
+		v3f speed(2 * BS, 0, 1 * BS);
+		collisionMoveResult r = collisionMoveSimple(&env, gamedef, BS * 0.5f,
+			box, 0.6f * BS, 0.05f, &pos, &speed, v3f(0, -10 * BS, 0),
+			nullptr, false);
+		touching_ground += r.touching_ground;
+	}
+	u64 t1 = porting::getTimeUs();
+	UASSERTEQ(u32, touching_ground, num_moves);
+
+	rawstream << "collisionMoveSimple: " << num_moves << " moves in "
+		<< (t1 - t0) << "us, " << (t1 - t0) * 1000 / num_moves
+		<< "ns per move" << std::endl;
+}
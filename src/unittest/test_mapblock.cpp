@@ -0,0 +1,77 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+
+class TestMapBlock : public TestBase {
+public:
+	TestMapBlock() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestMapBlock"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testFullyOpaqueExpires(IGameDef *gamedef);
+};
+
+static TestMapBlock g_test_instance;
+
+void TestMapBlock::runTests(IGameDef *gamedef)
+{
+	TEST(testFullyOpaqueExpires, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static MapBlock *make_stone_block(MapSector *sector, s16 y)
+{
+	MapBlock *block = sector->createBlankBlock(y);
+	for (u32 i = 0; i < MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE; i++)
+		block->getData()[i] = MapNode(t_CONTENT_STONE);
+	return block;
+}
+
+
+void TestMapBlock::testFullyOpaqueExpires(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	MapSector *sector = new MapSector(&map, v2s16(0, 0), gamedef);
+	(*map.getSectorsPtr())[v2s16(0, 0)] = sector;
+
+	// Carved through a VoxelManip
+	MapBlock *block = make_stone_block(sector, 0);
+	UASSERT(block->isFullyOpaque());
+
+	MMVManip vm(&map);
+	vm.initialEmerge(v3s16(0, 0, 0), v3s16(0, 0, 0), false);
+	vm.setNodeNoRef(v3s16(3, 4, 5), MapNode(CONTENT_AIR));
+	vm.blitBackAll(nullptr);
+	UASSERT(!block->isFullyOpaque());
+
+	// Carved through the Map
+	block = make_stone_block(sector, 1);
+	UASSERT(block->isFullyOpaque());
+
+	MapNode n(CONTENT_AIR);
+	map.setNode(v3s16(3, MAP_BLOCKSIZE + 4, 5), n);
+	UASSERT(!block->isFullyOpaque());
+}
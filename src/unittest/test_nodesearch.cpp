@@ -0,0 +1,304 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <algorithm>
+#include "face_position_cache.h"
+#include "map.h"
+#include "mapblock.h"
+#include "mapsector.h"
+#include "nodesearch.h"
+#include "noise.h"
+#include "porting.h"
+
+class TestNodeSearch : public TestBase {
+public:
+	TestNodeSearch() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestNodeSearch"; }
+
+	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
+
+	void testFindNodesInArea(IGameDef *gamedef);
+	void testFindNodesInAreaUnderAir(IGameDef *gamedef);
+	void testFindNodeNear(IGameDef *gamedef);
+	void testContentTypesExpire(IGameDef *gamedef);
+	void benchmarkFindNodesInArea(IGameDef *gamedef);
+};
+
+static TestNodeSearch g_test_instance;
+
+void TestNodeSearch::runTests(IGameDef *gamedef)
+{
+	TEST(testFindNodesInArea, gamedef);
+	TEST(testFindNodesInAreaUnderAir, gamedef);
+	TEST(testFindNodeNear, gamedef);
+	TEST(testContentTypesExpire, gamedef);
+}
+
+void TestNodeSearch::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkFindNodesInArea, gamedef);
+}
+
+/*
+	4x4x4 blocks from -32 to 31 with a hilly grass covered stone ground,
+	a few torches, water in one block and bricks in another. The block at
+	(1, 1, 1) is not loaded.
+*/
+static void make_map(Map *map, IGameDef *gamedef)
+{
+	PseudoRandom pr(1234);
+	for (s16 z = -2; z <= 1; z++)
+	for (s16 x = -2; x <= 1; x++) {
+		MapSector *sector = new MapSector(map, v2s16(x, z), gamedef);
+		(*map->getSectorsPtr())[v2s16(x, z)] = sector;
+		for (s16 y = -2; y <= 1; y++) {
+			if (x == 1 && y == 1 && z == 1)
+				continue;
+			MapBlock *block = sector->createBlankBlock(y);
+			v3s16 base = block->getPosRelative();
+			for (s16 rz = 0; rz < MAP_BLOCKSIZE; rz++)
+			for (s16 ry = 0; ry < MAP_BLOCKSIZE; ry++)
+			for (s16 rx = 0; rx < MAP_BLOCKSIZE; rx++) {
+				v3s16 p = base + v3s16(rx, ry, rz);
+				s16 ground = (p.X + 2 * p.Z) / 8;
+				content_t c = CONTENT_AIR;
+				if (p.Y < ground)
+					c = t_CONTENT_STONE;
+				else if (p.Y == ground)
+					c = t_CONTENT_GRASS;
+				else if (x == -1 && y == 1 && z == -1)
+					c = t_CONTENT_WATER;
+				else if (x == 0 && y == 1 && z == 1)
+					c = t_CONTENT_BRICK;
+				if (pr.range(0, 300) == 0)
+					c = t_CONTENT_TORCH;
+				block->getData()[(rz * MAP_BLOCKSIZE + ry) * MAP_BLOCKSIZE + rx] =
+					MapNode(c);
+			}
+		}
+	}
+}
+
+typedef std::vector<std::pair<v3s16, s32>> Found;
+
+static bool compare_found(const std::pair<v3s16, s32> &a,
+	const std::pair<v3s16, s32> &b)
+{
+	if (a.first.Z != b.first.Z)
+		return a.first.Z < b.first.Z;
+	if (a.first.Y != b.first.Y)
+		return a.first.Y < b.first.Y;
+	if (a.first.X != b.first.X)
+		return a.first.X < b.first.X;
+	return a.second < b.second;
+}
+
+// Node by node search as done by find_nodes_in_area() before
+static Found find_nodes_reference(Map *map, v3s16 minp, v3s16 maxp,
+	const std::vector<content_t> &filter, bool under_air)
+{
+	Found found;
+	for (s16 z = minp.Z; z <= maxp.Z; z++)
+	for (s16 y = minp.Y; y <= maxp.Y; y++)
+	for (s16 x = minp.X; x <= maxp.X; x++) {
+		content_t c = map->getNodeNoEx(v3s16(x, y, z)).getContent();
+		if (under_air && (c == CONTENT_AIR || map->getNodeNoEx(
+				v3s16(x, y + 1, z)).getContent() != CONTENT_AIR))
+			continue;
+		auto it = std::find(filter.begin(), filter.end(), c);
+		if (it != filter.end())
+			found.emplace_back(v3s16(x, y, z), it - filter.begin());
+	}
+	return found;
+}
+
+static Found find_nodes(Map *map, v3s16 minp, v3s16 maxp,
+	const std::vector<content_t> &filter, bool under_air)
+{
+	Found found;
+	NodeSearchCallback callback = [&found] (v3s16 p, s32 filter_index) {
+		found.emplace_back(p, filter_index);
+	};
+	if (under_air)
+		findNodesInAreaUnderAir(map, minp, maxp, NodeSearchFilter(filter),
+			callback);
+	else
+		findNodesInArea(map, minp, maxp, NodeSearchFilter(filter), callback);
+	std::sort(found.begin(), found.end(), compare_found);
+	return found;
+}
+
+static const v3s16 test_areas[][2] = {
+	{ v3s16(-32, -32, -32), v3s16(31, 31, 31) },
+	{ v3s16(-5, -3, -7), v3s16(4, 6, 3) },
+	{ v3s16(-20, 0, 10), v3s16(-20, 40, 40) },
+	{ v3s16(0, 15, 0), v3s16(15, 15, 15) },
+	{ v3s16(10, 10, 10), v3s16(40, 40, 40) },
+	{ v3s16(3, 3, 3), v3s16(3, 3, 3) },
+};
+
+static std::vector<std::vector<content_t>> make_filters()
+{
+	std::vector<std::vector<content_t>> filters;
+	filters.push_back({ t_CONTENT_STONE });
+	filters.push_back({ t_CONTENT_TORCH, t_CONTENT_BRICK });
+	filters.push_back({ CONTENT_IGNORE, t_CONTENT_GRASS });
+	filters.push_back({ t_CONTENT_TORCH, t_CONTENT_WATER, t_CONTENT_TORCH });
+	filters.push_back({ t_CONTENT_LAVA });
+	filters.push_back({ CONTENT_AIR, t_CONTENT_GRASS });
+	return filters;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestNodeSearch::testFindNodesInArea(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	make_map(&map, gamedef);
+
+	for (const auto &filter : make_filters())
+	for (const auto &area : test_areas) {
+		Found expected = find_nodes_reference(&map, area[0], area[1],
+			filter, false);
+		UASSERT(find_nodes(&map, area[0], area[1], filter, false) == expected);
+	}
+}
+
+
+void TestNodeSearch::testFindNodesInAreaUnderAir(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	make_map(&map, gamedef);
+
+	for (const auto &filter : make_filters())
+	for (const auto &area : test_areas) {
+		Found expected = find_nodes_reference(&map, area[0], area[1],
+			filter, true);
+		UASSERT(find_nodes(&map, area[0], area[1], filter, true) == expected);
+	}
+}
+
+
+void TestNodeSearch::testFindNodeNear(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	make_map(&map, gamedef);
+
+	static const v3s16 positions[] = {
+		v3s16(0, 0, 0), v3s16(-30, 20, -30), v3s16(28, 28, 28),
+		v3s16(5, -30, 20), v3s16(-17, 1, 9),
+	};
+	for (const auto &filter : make_filters())
+	for (const v3s16 &pos : positions)
+	for (s32 radius : { 0, 1, 5, 20, 30 })
+	for (s32 start_radius = 0; start_radius <= 1; start_radius++) {
+		// Same search as find_node_near() did before
+		bool expected_ok = false;
+		v3s16 expected;
+		for (s32 d = start_radius; d <= radius && !expected_ok; d++) {
+			for (const v3s16 &i : FacePositionCache::getFacePositions(d)) {
+				content_t c = map.getNodeNoEx(pos + i).getContent();
+				if (std::find(filter.begin(), filter.end(), c) != filter.end()) {
+					expected = pos + i;
+					expected_ok = true;
+					break;
+				}
+			}
+		}
+
+		v3s16 found;
+		bool ok = findNodeNear(&map, pos, radius, start_radius,
+			NodeSearchFilter(filter), &found);
+		UASSERTEQ(bool, ok, expected_ok);
+		if (ok)
+			UASSERT(found == expected);
+	}
+}
+
+
+void TestNodeSearch::testContentTypesExpire(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	make_map(&map, gamedef);
+
+	// The block at (-2, -2, -2) is all stone
+	MapBlock *block = map.getBlockNoCreateNoEx(v3s16(-2, -2, -2));
+	for (u32 i = 0; i < MapBlock::nodecount; i++)
+		block->getData()[i] = MapNode(t_CONTENT_STONE);
+	block->raiseModified(MOD_STATE_WRITE_NEEDED);
+
+	std::vector<content_t> types = getBlockContentTypes(block);
+	UASSERTEQ(size_t, types.size(), 1);
+	UASSERTEQ(content_t, types[0], t_CONTENT_STONE);
+
+	NodeSearchFilter filter(std::vector<content_t>(1, t_CONTENT_BRICK));
+	UASSERT(!filter.mayMatch(block));
+	UASSERT(!filter.mayMatch(nullptr));
+
+	MapNode brick(t_CONTENT_BRICK);
+	map.setNode(v3s16(-20, -21, -22), brick);
+	UASSERT(filter.mayMatch(block));
+
+	Found found;
+	findNodesInArea(&map, v3s16(-32, -32, -32), v3s16(-17, -17, -17), filter,
+		[&found] (v3s16 p, s32 filter_index) {
+			found.emplace_back(p, filter_index);
+		});
+	UASSERTEQ(size_t, found.size(), 1);
+	UASSERT(found[0].first == v3s16(-20, -21, -22));
+}
+
+
+void TestNodeSearch::benchmarkFindNodesInArea(IGameDef *gamedef)
+{
+	Map map(dstream, gamedef);
+	make_map(&map, gamedef);
+
+	// Rare nodes, like mods looking for ores or torches, and common ones
+	std::vector<std::vector<content_t>> filters;
+	filters.push_back({ t_CONTENT_BRICK, t_CONTENT_LAVA });
+	filters.push_back({ t_CONTENT_STONE, t_CONTENT_GRASS });
+	v3s16 minp(-32, -32, -32);
+	v3s16 maxp(31, 31, 31);
+	const u32 num_searches = 10;
+
+	for (const auto &filter : filters) {
+		u64 t0 = porting::getTimeUs();
+		size_t count_reference = 0;
+		for (u32 i = 0; i < num_searches; i++)
+			count_reference += find_nodes_reference(&map, minp, maxp, filter,
+				false).size();
+		u64 t1 = porting::getTimeUs();
+		size_t count = 0;
+		for (u32 i = 0; i < num_searches; i++) {
+			findNodesInArea(&map, minp, maxp, NodeSearchFilter(filter),
+				[&count] (v3s16 p, s32 filter_index) { count++; });
+		}
+		u64 t2 = porting::getTimeUs();
+		UASSERTEQ(size_t, count, count_reference);
+
+		rawstream << "findNodesInArea: " << num_searches << " searches of "
+			<< "64^3 nodes finding " << count / num_searches << " nodes in "
+			<< (t2 - t1) << "us, node by node in " << (t1 - t0) << "us"
+			<< std::endl;
+	}
+}
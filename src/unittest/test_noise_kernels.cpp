@@ -0,0 +1,234 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include <cstring>
+#include "noise.h"
+#include "noise_kernels.h"
+#include "porting.h"
+#include "threading/task_pool.h"
+#include "util/numeric.h"
+
+class TestNoiseKernels : public TestBase {
+public:
+	TestNoiseKernels() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestNoiseKernels"; }
+
+	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
+
+	void testLattice();
+	void testPerlinMap2D();
+	void testPerlinMap3D();
+	void testPerlinMapTaskPool();
+	void benchmarkPerlinMap();
+
+	std::vector<const NoiseKernels *> m_kernels;
+};
+
+static TestNoiseKernels g_test_instance;
+
+void TestNoiseKernels::runTests(IGameDef *gamedef)
+{
+	m_kernels = getSupportedNoiseKernels();
+
+	TEST(testLattice);
+	TEST(testPerlinMap2D);
+	TEST(testPerlinMap3D);
+	TEST(testPerlinMapTaskPool);
+}
+
+void TestNoiseKernels::runBenchmarks(IGameDef *gamedef)
+{
+	m_kernels = getSupportedNoiseKernels();
+
+	TEST(benchmarkPerlinMap);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static const u32 test_flags[] = {
+	0,
+	NOISE_FLAG_DEFAULTS,
+	NOISE_FLAG_EASED,
+	NOISE_FLAG_ABSVALUE,
+	NOISE_FLAG_EASED | NOISE_FLAG_ABSVALUE,
+};
+
+// Odd sizes, so that the vector kernels also have leftover points
+static const v3s16 test_sizes[] = {
+	v3s16(40, 41, 40),
+	v3s16(13, 7, 5),
+	v3s16(33, 2, 17),
+};
+
+static void fill_persistence(float *persist, u32 count)
+{
+	for (u32 i = 0; i != count; i++)
+		persist[i] = 0.3f + (i % 7) * 0.1f;
+}
+
+void TestNoiseKernels::testLattice()
+{
+	float expected[37], actual[37];
+
+	for (const NoiseKernels *kernels : m_kernels) {
+		for (s32 x : {-1000003, -20, 0, 5, 123456789}) {
+			for (u32 i = 0; i != 37; i++)
+				expected[i] = noise3d(x + i, -7, 300, 1337);
+			kernels->lattice(actual, x, noiseLatticeBase(-7, 300, 1337), 37);
+			UASSERT(memcmp(expected, actual, sizeof(expected)) == 0);
+
+			for (u32 i = 0; i != 37; i++)
+				expected[i] = noise2d(x + i, 42, -5);
+			kernels->lattice(actual, x, noiseLatticeBase(42, -5), 37);
+			UASSERT(memcmp(expected, actual, sizeof(expected)) == 0);
+		}
+	}
+}
+
+void TestNoiseKernels::testPerlinMap2D()
+{
+	for (u32 flags : test_flags)
+	for (const v3s16 &size : test_sizes)
+	for (bool use_persistence : {false, true}) {
+		NoiseParams np(0.5, 3, v3f(61, 17, 3.3), 12, 4, 0.63, 2.5, flags);
+		u32 count = size.X * size.Y;
+		std::vector<float> persist(count);
+		fill_persistence(&persist[0], count);
+
+		Noise reference(&np, 42, size.X, size.Y);
+		reference.kernels = m_kernels[0];
+		reference.perlinMap2D(-1234.5f, 77.25f,
+			use_persistence ? &persist[0] : NULL);
+
+		for (const NoiseKernels *kernels : m_kernels) {
+			Noise noise(&np, 42, size.X, size.Y);
+			noise.kernels = kernels;
+			noise.perlinMap2D(-1234.5f, 77.25f,
+				use_persistence ? &persist[0] : NULL);
+			UASSERT(memcmp(reference.result, noise.result,
+				count * sizeof(float)) == 0);
+		}
+	}
+}
+
+void TestNoiseKernels::testPerlinMap3D()
+{
+	for (u32 flags : test_flags)
+	for (const v3s16 &size : test_sizes)
+	for (bool use_persistence : {false, true}) {
+		NoiseParams np(0.5, 3, v3f(250, 120, 250), 5934, 5, 0.63, 2.0, flags);
+		u32 count = size.X * size.Y * size.Z;
+		std::vector<float> persist(count);
+		fill_persistence(&persist[0], count);
+
+		Noise reference(&np, 42, size.X, size.Y, size.Z);
+		reference.kernels = m_kernels[0];
+		reference.perlinMap3D(-1234.5f, 77.25f, 8000.f,
+			use_persistence ? &persist[0] : NULL);
+
+		for (const NoiseKernels *kernels : m_kernels) {
+			Noise noise(&np, 42, size.X, size.Y, size.Z);
+			noise.kernels = kernels;
+			noise.perlinMap3D(-1234.5f, 77.25f, 8000.f,
+				use_persistence ? &persist[0] : NULL);
+			UASSERT(memcmp(reference.result, noise.result,
+				count * sizeof(float)) == 0);
+		}
+	}
+}
+
+void TestNoiseKernels::testPerlinMapTaskPool()
+{
+	// Large enough to be split into several ranges
+	static const v3s16 sizes[] = {
+		v3s16(40, 41, 40),
+		v3s16(200, 150, 3),
+	};
+	TaskPool pool("NoiseTest", 3);
+
+	for (const v3s16 &size : sizes)
+	for (bool use_persistence : {false, true}) {
+		NoiseParams np(0.5, 3, v3f(61, 17, 3.3), 12, 4, 0.63, 2.5,
+			NOISE_FLAG_EASED);
+		u32 count = size.X * size.Y * size.Z;
+		std::vector<float> persist(count);
+		fill_persistence(&persist[0], count);
+		float *persistence_map = use_persistence ? &persist[0] : NULL;
+
+		Noise serial_2d(&np, 42, size.X, size.Y);
+		Noise serial_3d(&np, 42, size.X, size.Y, size.Z);
+		serial_2d.perlinMap2D(-1234.5f, 77.25f, persistence_map);
+		serial_3d.perlinMap3D(-1234.5f, 77.25f, 8000.f, persistence_map);
+
+		Noise parallel_2d(&np, 42, size.X, size.Y);
+		Noise parallel_3d(&np, 42, size.X, size.Y, size.Z);
+		TaskPool::setCurrent(&pool);
+		parallel_2d.perlinMap2D(-1234.5f, 77.25f, persistence_map);
+		parallel_3d.perlinMap3D(-1234.5f, 77.25f, 8000.f, persistence_map);
+		TaskPool::setCurrent(nullptr);
+
+		UASSERT(memcmp(serial_2d.result, parallel_2d.result,
+			size.X * size.Y * sizeof(float)) == 0);
+		UASSERT(memcmp(serial_3d.result, parallel_3d.result,
+			count * sizeof(float)) == 0);
+	}
+}
+
+void TestNoiseKernels::benchmarkPerlinMap()
+{
+	// Sizes used by the mapgens for one 80x80x80 chunk
+	const u32 iterations = 10;
+	NoiseParams np_2d(0, 1, v3f(600, 600, 600), 5934, 5, 0.6, 2.0);
+	NoiseParams np_3d(0, 1, v3f(96, 96, 96), 5333, 5, 0.6, 2.0);
+	Noise reference_2d(&np_2d, 42, 80, 80);
+	Noise reference_3d(&np_3d, 42, 80, 82, 80);
+	reference_2d.kernels = m_kernels[0];
+	reference_3d.kernels = m_kernels[0];
+	reference_2d.perlinMap2D(1600, -800);
+	reference_3d.perlinMap3D(1600, -48, -800);
+
+	for (const NoiseKernels *kernels : m_kernels) {
+		Noise noise_2d(&np_2d, 42, 80, 80);
+		Noise noise_3d(&np_3d, 42, 80, 82, 80);
+		noise_2d.kernels = kernels;
+		noise_3d.kernels = kernels;
+
+		u64 t0 = porting::getTimeUs();
+		for (u32 i = 0; i != iterations; i++)
+			noise_2d.perlinMap2D(1600, -800);
+		u64 t1 = porting::getTimeUs();
+		for (u32 i = 0; i != iterations; i++)
+			noise_3d.perlinMap3D(1600, -48, -800);
+		u64 t2 = porting::getTimeUs();
+
+		UASSERT(memcmp(reference_2d.result, noise_2d.result,
+			80 * 80 * sizeof(float)) == 0);
+		UASSERT(memcmp(reference_3d.result, noise_3d.result,
+			80 * 82 * 80 * sizeof(float)) == 0);
+
+		rawstream << "perlinMap " << kernels->name << ": 2D "
+			<< 80.0 * 80 * iterations * 1000000 / MYMAX(t1 - t0, 1)
+			<< " points/s, 3D "
+			<< 80.0 * 82 * 80 * iterations * 1000000 / MYMAX(t2 - t1, 1)
+			<< " points/s" << std::endl;
+	}
+}
@@ -0,0 +1,126 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "network/networkpacket.h"
+#include "network/packetcapture.h"
+
+class TestPacketCapture : public TestBase {
+public:
+	TestPacketCapture() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestPacketCapture"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testRoundTrip();
+	void testInvalidFile();
+	void testLoginNotRecorded();
+};
+
+static TestPacketCapture g_test_instance;
+
+void TestPacketCapture::runTests(IGameDef *gamedef)
+{
+	TEST(testRoundTrip);
+	TEST(testInvalidFile);
+	TEST(testLoginNotRecorded);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestPacketCapture::testRoundTrip()
+{
+	std::string path = getTestTempFile();
+
+	{
+		PacketCaptureWriter writer(path);
+		UASSERT(writer.isOpen());
+
+		NetworkPacket pkt(TOSERVER_CHAT_MESSAGE, 0, 7);
+		pkt << std::wstring(L"hello");
+		writer.record(&pkt);
+
+		NetworkPacket empty(TOSERVER_RESPAWN, 0, 9);
+		writer.record(&empty);
+	}
+
+	std::vector<CapturedPacket> packets;
+	UASSERT(PacketCaptureReader::readAll(path, &packets));
+	UASSERTEQ(size_t, packets.size(), 2);
+
+	UASSERTEQ(u16, packets[0].command, TOSERVER_CHAT_MESSAGE);
+	UASSERTEQ(session_t, packets[0].peer_id, 7);
+	UASSERTEQ(u16, packets[1].command, TOSERVER_RESPAWN);
+	UASSERTEQ(session_t, packets[1].peer_id, 9);
+	UASSERT(packets[1].data.empty());
+
+	NetworkPacket replayed;
+	packets[0].toNetworkPacket(&replayed, 3);
+	UASSERTEQ(u16, replayed.getCommand(), TOSERVER_CHAT_MESSAGE);
+	UASSERTEQ(session_t, replayed.getPeerId(), 3);
+	std::wstring message;
+	replayed >> message;
+	UASSERT(message == L"hello");
+}
+
+void TestPacketCapture::testInvalidFile()
+{
+	std::string path = getTestTempFile();
+	{
+		std::ofstream os(path.c_str(), std::ios::binary);
+		os << "not a capture";
+	}
+
+	PacketCaptureReader reader(path);
+	UASSERT(!reader.isOpen());
+}
+
+void TestPacketCapture::testLoginNotRecorded()
+{
+	std::string path = getTestTempFile();
+
+	{
+		PacketCaptureWriter writer(path);
+		UASSERT(writer.isOpen());
+
+		static const u16 login_commands[] = {
+			TOSERVER_INIT, TOSERVER_INIT2, TOSERVER_FIRST_SRP,
+			TOSERVER_SRP_BYTES_A, TOSERVER_SRP_BYTES_M,
+		};
+		for (u16 command : login_commands) {
+			NetworkPacket pkt(command, 0, 5);
+			pkt << std::string("secret");
+			writer.record(&pkt);
+
+			CapturedPacket cp;
+			cp.command = command;
+			cp.data = "secret";
+			writer.record(cp);
+		}
+
+		NetworkPacket pkt(TOSERVER_RESPAWN, 0, 5);
+		writer.record(&pkt);
+	}
+
+	std::vector<CapturedPacket> packets;
+	UASSERT(PacketCaptureReader::readAll(path, &packets));
+	UASSERTEQ(size_t, packets.size(), 1);
+	UASSERTEQ(u16, packets[0].command, TOSERVER_RESPAWN);
+}
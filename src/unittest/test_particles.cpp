@@ -0,0 +1,158 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+#include "client/particles.h"
+#include "gamedef.h"
+#include "map.h"
+#include "porting.h"
+
+class TestParticles : public TestBase {
+public:
+	TestParticles() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestParticles"; }
+
+	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
+
+	void testStep();
+	void testVertices();
+	void benchmarkStep(IGameDef *gamedef);
+};
+
+static TestParticles g_test_instance;
+
+void TestParticles::runTests(IGameDef *gamedef)
+{
+	TEST(testStep);
+	TEST(testVertices);
+}
+
+void TestParticles::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkStep, gamedef);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TestParticles::testStep()
+{
+	ParticlePool pool(nullptr, false);
+
+	ParticleParameters p;
+	p.vel = v3f(1, 0, 0);
+	p.acc = v3f(0, -2, 0);
+	p.expirationtime = 1.5f;
+	pool.add(p);
+	p.expirationtime = 0.5f;
+	pool.add(p);
+	UASSERTEQ(size_t, pool.size(), 2);
+
+	// Velocity is updated before the position
+	pool.step(1.0f, nullptr, nullptr);
+	UASSERTEQ(size_t, pool.size(), 2);
+	pool.updateVertices(ParticleCamera());
+	const video::S3DVertex *v = pool.getVertices().data();
+	UASSERT(v[0].Pos.equals(v3f(1, -2, 0) * BS + v3f(-0.5f, -0.5f, 0)));
+
+	// The second particle has expired
+	pool.step(1.0f, nullptr, nullptr);
+	UASSERTEQ(size_t, pool.size(), 1);
+	pool.step(1.0f, nullptr, nullptr);
+	UASSERTEQ(size_t, pool.size(), 0);
+}
+
+void TestParticles::testVertices()
+{
+	ParticlePool pool(nullptr, false);
+
+	ParticleParameters p;
+	p.pos = v3f(10, 0, 0);
+	p.size = 2.0f;
+	p.color = video::SColor(255, 255, 128, 0);
+	pool.add(p);
+	p.vertical = true;
+	pool.add(p);
+
+	ParticleCamera camera;
+	camera.camera_offset = v3f(10 * BS, 0, 0);
+	pool.updateVertices(camera);
+	const std::vector<video::S3DVertex> &v = pool.getVertices();
+	UASSERTEQ(size_t, v.size(), 8);
+
+	// Facing the camera, which looks along +Z
+	UASSERT(v[0].Pos.equals(v3f(-1, -1, 0)));
+	UASSERT(v[2].Pos.equals(v3f(1, 1, 0)));
+	UASSERT(v[0].TCoords.equals(v2f(0, 1)));
+	UASSERT(v[2].TCoords.equals(v2f(1, 0)));
+
+	// Turned towards the player at the origin, along the Z axis
+	UASSERT(v[4].Pos.equals(v3f(0, -1, 1)));
+	UASSERT(v[6].Pos.equals(v3f(0, 1, -1)));
+
+	// No light yet
+	UASSERT(v[0].Color == video::SColor(255, 0, 0, 0));
+}
+
+void TestParticles::benchmarkStep(IGameDef *gamedef)
+{
+	// Particles falling through an empty map, like rain or snow
+	const u32 num_particles = 50000;
+	const u32 num_steps = 100;
+
+	ParticlePool pool(nullptr, false);
+	for (u32 i = 0; i < num_particles; i++) {
+		ParticleParameters p;
+		p.pos = v3f(i % 100, 50, (i / 100) % 100);
+		p.vel = v3f(0.1f, -5, 0);
+		p.acc = v3f(0, -1, 0);
+		p.expirationtime = 1000.0f;
+		p.vertical = i % 2;
+		pool.add(p);
+	}
+
+	Map map(dstream, gamedef);
+	ParticleCamera camera;
+	camera.player_pos = v3f(50, 0, 50);
+	camera.pitch = 20.0f;
+	camera.yaw = 45.0f;
+
+	u64 time_step = 0, time_light = 0, time_vertices = 0;
+	for (u32 i = 0; i < num_steps; i++) {
+		ParticleLightCache light_cache(&map, 1000, gamedef->ndef());
+		u64 t0 = porting::getTimeUs();
+		pool.step(0.05f, nullptr, nullptr);
+		u64 t1 = porting::getTimeUs();
+		pool.updateLight(&light_cache);
+		u64 t2 = porting::getTimeUs();
+		pool.updateVertices(camera);
+		u64 t3 = porting::getTimeUs();
+		time_step += t1 - t0;
+		time_light += t2 - t1;
+		time_vertices += t3 - t2;
+	}
+	UASSERTEQ(size_t, pool.size(), num_particles);
+	UASSERTEQ(size_t, pool.getVertices().size(), num_particles * 4);
+
+	rawstream << "Particle step, " << num_particles << " particles: step "
+		<< time_step / num_steps << "us, light "
+		<< time_light / num_steps << "us, vertices "
+		<< time_vertices / num_steps << "us" << std::endl;
+}
@@ -19,6 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <sstream>
+#include <thread>
+#include <json/json.h>
+#include "frametrace.h"
 #include "profiler.h"
 
 class TestProfiler : public TestBase
@@ -30,6 +34,8 @@ class TestProfiler : public TestBase
 	void runTests(IGameDef *gamedef);
 
 	void testProfilerAverage();
+	void testFrameTracer();
+	void testFrameTracerRingBuffer();
 };
 
 static TestProfiler g_test_instance;
@@ -37,6 +43,8 @@ static TestProfiler g_test_instance;
 void TestProfiler::runTests(IGameDef *gamedef)
 {
 	TEST(testProfilerAverage);
+	TEST(testFrameTracer);
+	TEST(testFrameTracerRingBuffer);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,3 +79,84 @@ void TestProfiler::testProfilerAverage()
 
 	UASSERT(p.getValue("Test2") == 123.57f);
 }
+
+static bool parse_json(const std::string &str, Json::Value *root)
+{
+	std::istringstream is(str);
+	Json::CharReaderBuilder builder;
+	std::string errs;
+	return Json::parseFromStream(builder, is, root, &errs);
+}
+
+void TestProfiler::testFrameTracer()
+{
+	FrameTracer tracer;
+
+	// Nothing is recorded before start()
+	{
+		FrameTraceScope scope(&tracer, "ignored");
+	}
+	UASSERTEQ(size_t, tracer.getEventCount(), 0);
+
+	tracer.start();
+	tracer.beginFrame();
+	{
+		FrameTraceScope scope(&tracer, "outer");
+		FrameTraceScope scope2(&tracer, "inner \"quoted\"");
+	}
+	// Other threads are not recorded
+	std::thread thread([&tracer] () {
+		FrameTraceScope scope(&tracer, "thread");
+	});
+	thread.join();
+	tracer.endFrame();
+	UASSERTEQ(size_t, tracer.getEventCount(), 3);
+
+	std::ostringstream os;
+	tracer.writeChromeTrace(os);
+	Json::Value root;
+	UASSERT(parse_json(os.str(), &root));
+
+	// Events are written when they end
+	const Json::Value &events = root["traceEvents"];
+	UASSERTEQ(u32, events.size(), 3);
+	UASSERT(events[0]["name"] == "inner \"quoted\"");
+	UASSERT(events[1]["name"] == "outer");
+	UASSERT(events[2]["name"] == "frame");
+	UASSERT(events[2]["ph"] == "X");
+	UASSERT(events[2]["ts"].asUInt64() <= events[1]["ts"].asUInt64());
+	UASSERT(events[1]["ts"].asUInt64() <= events[0]["ts"].asUInt64());
+	UASSERT(events[2]["dur"].asUInt64() >= events[1]["dur"].asUInt64());
+
+	tracer.stop();
+	{
+		FrameTraceScope scope(&tracer, "ignored");
+	}
+	UASSERTEQ(size_t, tracer.getEventCount(), 3);
+}
+
+void TestProfiler::testFrameTracerRingBuffer()
+{
+	static const char *names[] = {"0", "1", "2", "3", "4", "5"};
+	FrameTracer tracer(4);
+	tracer.start();
+	for (u64 i = 0; i < 6; i++)
+		tracer.addEvent(names[i], i * 10, i * 10 + 5);
+	UASSERTEQ(size_t, tracer.getEventCount(), 4);
+
+	// The oldest events were dropped
+	std::ostringstream os;
+	tracer.writeChromeTrace(os);
+	Json::Value root;
+	UASSERT(parse_json(os.str(), &root));
+	const Json::Value &events = root["traceEvents"];
+	UASSERTEQ(u32, events.size(), 4);
+	for (u32 i = 0; i < 4; i++) {
+		UASSERT(events[i]["name"] == names[i + 2]);
+		UASSERTEQ(u64, events[i]["ts"].asUInt64(), (i + 2) * 10);
+		UASSERTEQ(u64, events[i]["dur"].asUInt64(), 5);
+	}
+
+	tracer.clear();
+	UASSERTEQ(size_t, tracer.getEventCount(), 0);
+}
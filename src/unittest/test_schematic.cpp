@@ -21,7 +21,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapgen/mg_schematic.h"
 #include "gamedef.h"
+#include "map.h"
 #include "nodedef.h"
+#include "noise.h"
+#include "util/numeric.h"
 
 class TestSchematic : public TestBase {
 public:
@@ -33,6 +36,7 @@ class TestSchematic : public TestBase {
 	void testMtsSerializeDeserialize(const NodeDefManager *ndef);
 	void testLuaTableSerialize(const NodeDefManager *ndef);
 	void testFileSerializeDeserialize(const NodeDefManager *ndef);
+	void testBlitToVManip(const NodeDefManager *ndef);
 
 	static const content_t test_schem1_data[7 * 6 * 4];
 	static const content_t test_schem2_data[3 * 3 * 3];
@@ -52,6 +56,7 @@ void TestSchematic::runTests(IGameDef *gamedef)
 	TEST(testMtsSerializeDeserialize, ndef);
 	TEST(testLuaTableSerialize, ndef);
 	TEST(testFileSerializeDeserialize, ndef);
+	TEST(testBlitToVManip, ndef);
 
 	ndef->resetNodeResolveState();
 }
@@ -181,6 +186,178 @@ void TestSchematic::testFileSerializeDeserialize(const NodeDefManager *ndef)
 }
 
 
+// The node by node placement that blitToVManip() did before it placed
+// pre-rotated runs, the result and the use of myrand must be the same
+static void blit_reference(const Schematic &schem, MMVManip *vm, v3s16 p,
+	Rotation rot, bool force_place, const NodeDefManager *ndef)
+{
+	int xstride = 1;
+	int ystride = schem.size.X;
+	int zstride = schem.size.X * schem.size.Y;
+
+	s16 sx = schem.size.X;
+	s16 sy = schem.size.Y;
+	s16 sz = schem.size.Z;
+
+	int i_start, i_step_x, i_step_z;
+	switch (rot) {
+		case ROTATE_90:
+			i_start  = sx - 1;
+			i_step_x = zstride;
+			i_step_z = -xstride;
+			SWAP(s16, sx, sz);
+			break;
+		case ROTATE_180:
+			i_start  = zstride * (sz - 1) + sx - 1;
+			i_step_x = -xstride;
+			i_step_z = -zstride;
+			break;
+		case ROTATE_270:
+			i_start  = zstride * (sz - 1);
+			i_step_x = -zstride;
+			i_step_z = xstride;
+			SWAP(s16, sx, sz);
+			break;
+		default:
+			i_start  = 0;
+			i_step_x = xstride;
+			i_step_z = zstride;
+	}
+
+	s16 y_map = p.Y;
+	for (s16 y = 0; y != sy; y++) {
+		if ((schem.slice_probs[y] != MTSCHEM_PROB_ALWAYS) &&
+			(schem.slice_probs[y] <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+			continue;
+
+		for (s16 z = 0; z != sz; z++) {
+			u32 i = z * i_step_z + y * ystride + i_start;
+			for (s16 x = 0; x != sx; x++, i += i_step_x) {
+				v3s16 pos(p.X + x, y_map, p.Z + z);
+				if (!vm->m_area.contains(pos))
+					continue;
+
+				if (schem.schemdata[i].getContent() == CONTENT_IGNORE)
+					continue;
+
+				u8 placement_prob     = schem.schemdata[i].param1 & MTSCHEM_PROB_MASK;
+				bool force_place_node = schem.schemdata[i].param1 & MTSCHEM_FORCE_PLACE;
+
+				if (placement_prob == MTSCHEM_PROB_NEVER)
+					continue;
+
+				u32 vi = vm->m_area.index(pos);
+				if (!force_place && !force_place_node) {
+					content_t c = vm->m_data[vi].getContent();
+					if (c != CONTENT_AIR && c != CONTENT_IGNORE)
+						continue;
+				}
+
+				if ((placement_prob != MTSCHEM_PROB_ALWAYS) &&
+					(placement_prob <= myrand_range(1, MTSCHEM_PROB_ALWAYS)))
+					continue;
+
+				vm->m_data[vi] = schem.schemdata[i];
+				vm->m_data[vi].param1 = 0;
+
+				if (rot)
+					vm->m_data[vi].rotateAlongYAxis(ndef, rot);
+			}
+		}
+		y_map++;
+	}
+}
+
+
+void TestSchematic::testBlitToVManip(const NodeDefManager *ndef)
+{
+	static const v3s16 size(5, 4, 3);
+	static const u32 volume = size.X * size.Y * size.Z;
+	static const u8 param1s[] = {
+		MTSCHEM_PROB_ALWAYS,
+		MTSCHEM_PROB_ALWAYS,
+		MTSCHEM_PROB_ALWAYS,
+		MTSCHEM_PROB_ALWAYS | MTSCHEM_FORCE_PLACE,
+		MTSCHEM_PROB_NEVER,
+		64,
+		100 | MTSCHEM_FORCE_PLACE,
+	};
+	static const content_t dest_contents[] = {
+		CONTENT_AIR,
+		CONTENT_AIR,
+		CONTENT_IGNORE,
+		t_CONTENT_STONE,
+		t_CONTENT_WATER,
+	};
+	// Inside, clipped at the low and at the high edges, and outside
+	static const v3s16 positions[] = {
+		v3s16(2, 1, 2),
+		v3s16(-2, -1, -1),
+		v3s16(5, 4, 6),
+		v3s16(-3, 2, 5),
+		v3s16(0, 7, 0),
+	};
+	const VoxelArea area(v3s16(0, 0, 0), v3s16(7, 5, 7));
+
+	PseudoRandom pr(5678);
+
+	Schematic schem;
+	schem.flags       = 0;
+	schem.size        = size;
+	schem.schemdata   = new MapNode[volume];
+	schem.slice_probs = new u8[size.Y];
+	schem.slice_probs[0] = MTSCHEM_PROB_ALWAYS;
+	schem.slice_probs[1] = 64;
+	schem.slice_probs[2] = MTSCHEM_PROB_ALWAYS;
+	schem.slice_probs[3] = 100;
+
+	schem.m_nodenames.emplace_back("ignore");
+	schem.m_nodenames.emplace_back("air");
+	schem.m_nodenames.emplace_back("default:stone");
+	schem.m_nodenames.emplace_back("default:grass");
+	schem.m_nodenames.emplace_back("default:brick");
+	schem.m_nnlistsizes.push_back(schem.m_nodenames.size());
+
+	for (size_t i = 0; i != volume; i++) {
+		schem.schemdata[i] = MapNode(pr.range(0, 4),
+			param1s[pr.range(0, ARRLEN(param1s) - 1)], pr.range(0, 3));
+	}
+
+	ndef->pendNodeResolve(&schem);
+	UASSERT(schem.m_resolve_done);
+
+	MMVManip dest(nullptr);
+	dest.addArea(area);
+	for (u32 i = 0; i != area.getVolume(); i++) {
+		dest.m_data[i] = MapNode(
+			dest_contents[pr.range(0, ARRLEN(dest_contents) - 1)]);
+	}
+
+	MMVManip vm(nullptr), vm_ref(nullptr);
+	vm.addArea(area);
+	vm_ref.addArea(area);
+
+	for (int rot = ROTATE_0; rot <= ROTATE_270; rot++)
+	for (int force_place = 0; force_place != 2; force_place++)
+	for (const v3s16 &p : positions)
+	for (u32 seed = 0; seed != 4; seed++) {
+		for (u32 i = 0; i != area.getVolume(); i++)
+			vm.m_data[i] = vm_ref.m_data[i] = dest.m_data[i];
+
+		mysrand(seed);
+		schem.blitToVManip(&vm, p, (Rotation)rot, force_place);
+		u32 next = myrand();
+
+		mysrand(seed);
+		blit_reference(schem, &vm_ref, p, (Rotation)rot, force_place, ndef);
+		u32 next_ref = myrand();
+
+		for (u32 i = 0; i != area.getVolume(); i++)
+			UASSERT(vm.m_data[i] == vm_ref.m_data[i]);
+		UASSERTEQ(u32, next, next_ref);
+	}
+}
+
 // Should form a cross-shaped-thing...?
 const content_t TestSchematic::test_schem1_data[7 * 6 * 4] = {
 	3, 3, 1, 1, 1, 3, 3, // Y=0, Z=0
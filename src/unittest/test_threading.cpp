@@ -20,7 +20,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include <atomic>
+#include "exceptions.h"
 #include "threading/semaphore.h"
+#include "threading/task_pool.h"
 #include "threading/thread.h"
 
 
@@ -33,6 +35,8 @@ class TestThreading : public TestBase {
 	void testStartStopWait();
 	void testThreadKill();
 	void testAtomicSemaphoreThread();
+	void testTaskPool();
+	void testTaskPoolException();
 };
 
 static TestThreading g_test_instance;
@@ -42,6 +46,8 @@ void TestThreading::runTests(IGameDef *gamedef)
 	TEST(testStartStopWait);
 	TEST(testThreadKill);
 	TEST(testAtomicSemaphoreThread);
+	TEST(testTaskPool);
+	TEST(testTaskPoolException);
 }
 
 class SimpleTestThread : public Thread {
@@ -181,3 +187,99 @@ void TestThreading::testAtomicSemaphoreThread()
 	UASSERT(val == num_threads * 0x10000);
 }
 
+
+
+class TaskPoolTestThread : public Thread {
+public:
+	TaskPoolTestThread(TaskPool *pool, u32 count, u32 grain,
+			Semaphore &trigger) :
+		Thread("TaskPoolTest"),
+		visits(count),
+		m_pool(pool),
+		m_grain(grain),
+		m_trigger(trigger)
+	{
+	}
+
+	// How often each item was visited
+	std::vector<u32> visits;
+
+private:
+	void *run()
+	{
+		m_trigger.wait();
+		for (u32 i = 0; i < 20; i++) {
+			TaskPool::parallelFor(m_pool, visits.size(), m_grain,
+				[this] (u32 begin, u32 end) {
+					for (u32 j = begin; j != end; j++)
+						visits[j]++;
+				});
+		}
+		return nullptr;
+	}
+
+	TaskPool *m_pool;
+	u32 m_grain;
+	Semaphore &m_trigger;
+};
+
+
+void TestThreading::testTaskPool()
+{
+	for (u32 num_helpers : {0, 1, 3}) {
+		TaskPool pool("TaskPoolTest", num_helpers);
+		UASSERTEQ(u32, pool.getNumThreads(), num_helpers);
+
+		// Several loops at once, with all kinds of range sizes
+		Semaphore trigger;
+		std::vector<TaskPoolTestThread *> threads;
+		for (u32 grain : {0, 1, 7, 1000, 5000}) {
+			threads.push_back(new TaskPoolTestThread(&pool, 1000 + grain,
+				grain, trigger));
+		}
+		threads.push_back(new TaskPoolTestThread(nullptr, 333, 5, trigger));
+		threads.push_back(new TaskPoolTestThread(&pool, 0, 5, trigger));
+
+		for (TaskPoolTestThread *thread : threads)
+			UASSERT(thread->start());
+
+		trigger.post(threads.size());
+
+		for (TaskPoolTestThread *thread : threads) {
+			thread->wait();
+			for (u32 visits : thread->visits)
+				UASSERTEQ(u32, visits, 20);
+			delete thread;
+		}
+	}
+}
+
+
+void TestThreading::testTaskPoolException()
+{
+	for (u32 num_helpers : {0, 1, 3}) {
+		TaskPool pool("TaskPoolTest", num_helpers);
+
+		std::atomic<u32> visited(0);
+		bool caught = false;
+		try {
+			pool.parallelFor(1000, 10, [&visited] (u32 begin, u32 end) {
+				visited += end - begin;
+				if (begin <= 500 && 500 < end)
+					throw BaseException("range failed");
+			});
+		} catch (BaseException &e) {
+			caught = true;
+			UASSERTEQ(std::string, e.what(), "range failed");
+		}
+		UASSERT(caught);
+		UASSERT(visited <= 1000);
+
+		// The pool still works
+		visited = 0;
+		pool.parallelFor(1000, 10, [&visited] (u32 begin, u32 end) {
+			visited += end - begin;
+		});
+		UASSERTEQ(u32, visited, 1000);
+	}
+}
@@ -20,8 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "test.h"
 
 #include <cmath>
+#include <set>
+#include "util/blockbitset.h"
 #include "util/numeric.h"
 #include "util/string.h"
+#include "util/timetaker.h"
 
 class TestUtilities : public TestBase {
 public:
@@ -29,6 +32,7 @@ class TestUtilities : public TestBase {
 	const char *getName() { return "TestUtilities"; }
 
 	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
 
 	void testAngleWrapAround();
 	void testWrapDegrees_0_360_v3f();
@@ -54,6 +58,9 @@ class TestUtilities : public TestBase {
 	void testMyround();
 	void testStringJoin();
 	void testEulerConversion();
+	void testBlockBitSet();
+	void benchmarkBlockBitSet();
+	void testIsSphereInSight();
 };
 
 static TestUtilities g_test_instance;
@@ -84,6 +91,13 @@ void TestUtilities::runTests(IGameDef *gamedef)
 	TEST(testMyround);
 	TEST(testStringJoin);
 	TEST(testEulerConversion);
+	TEST(testBlockBitSet);
+	TEST(testIsSphereInSight);
+}
+
+void TestUtilities::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkBlockBitSet);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -508,3 +522,104 @@ void TestUtilities::testEulerConversion()
 	setPitchYawRoll(m2, v2);
 	UASSERT(within(m1, m2, tolL));
 }
+
+void TestUtilities::testBlockBitSet()
+{
+	BlockBitSet set;
+	UASSERT(set.empty());
+	UASSERT(!set.contains(v3s16(0, 0, 0)));
+
+	// Region borders and negative coordinates
+	const v3s16 positions[] = {
+		v3s16(0, 0, 0), v3s16(7, 7, 7), v3s16(8, 0, 0), v3s16(-1, 0, 0),
+		v3s16(-8, -8, -8), v3s16(-9, 3, 2), v3s16(2047, -2048, 100),
+	};
+	for (const v3s16 &p : positions)
+		UASSERT(set.insert(p));
+	UASSERT(!set.insert(v3s16(-1, 0, 0)));
+	UASSERTEQ(size_t, set.size(), 7);
+
+	for (const v3s16 &p : positions)
+		UASSERT(set.contains(p));
+	UASSERT(!set.contains(v3s16(1, 0, 0)));
+	UASSERT(!set.contains(v3s16(-2, 0, 0)));
+	UASSERT(!set.contains(v3s16(0, 0, -8)));
+
+	UASSERT(set.erase(v3s16(-8, -8, -8)));
+	UASSERT(!set.erase(v3s16(-8, -8, -8)));
+	UASSERT(!set.contains(v3s16(-8, -8, -8)));
+	UASSERTEQ(size_t, set.size(), 6);
+
+	set.clear();
+	UASSERT(set.empty());
+	UASSERT(!set.contains(v3s16(7, 7, 7)));
+}
+
+void TestUtilities::benchmarkBlockBitSet()
+{
+	// Compare lookup speed with std::set over a typical view range
+	BlockBitSet set;
+	std::set<v3s16> reference;
+	for (s16 z = -10; z <= 10; z++)
+	for (s16 y = -10; y <= 10; y++)
+	for (s16 x = -10; x <= 10; x += 2) {
+		set.insert(v3s16(x, y, z));
+		reference.insert(v3s16(x, y, z));
+	}
+
+	u32 found_set = 0, found_ref = 0;
+	u64 time_set, time_ref;
+	{
+		TimeTaker t("BlockBitSet", nullptr, PRECISION_MICRO);
+		for (int i = 0; i < 20; i++)
+		for (s16 z = -12; z <= 12; z++)
+		for (s16 y = -12; y <= 12; y++)
+		for (s16 x = -12; x <= 12; x++)
+			found_set += set.contains(v3s16(x, y, z));
+		time_set = t.stop(true);
+	}
+	{
+		TimeTaker t("std::set", nullptr, PRECISION_MICRO);
+		for (int i = 0; i < 20; i++)
+		for (s16 z = -12; z <= 12; z++)
+		for (s16 y = -12; y <= 12; y++)
+		for (s16 x = -12; x <= 12; x++)
+			found_ref += reference.count(v3s16(x, y, z));
+		time_ref = t.stop(true);
+	}
+	UASSERTEQ(u32, found_set, found_ref);
+	UASSERTEQ(size_t, set.size(), reference.size());
+	rawstream << "BlockBitSet lookups: " << time_set << "us, std::set: "
+			<< time_ref << "us" << std::endl;
+}
+
+void TestUtilities::testIsSphereInSight()
+{
+	v3f camera_pos(0, 0, 0);
+	v3f camera_dir(0, 0, 1);
+	f32 fov = 72.0f * core::DEGTORAD;
+	f32 range = 1000 * BS;
+
+	// A block straight ahead is seen, as is any sphere containing it
+	UASSERT(isBlockInSight(v3s16(0, 0, 5), camera_pos, camera_dir, fov, range));
+	UASSERT(isSphereInSight(v3f(0, 0, 88) * BS, 8 * BS, camera_pos, camera_dir,
+		fov, range));
+	UASSERT(isSphereInSight(v3f(60, 0, 100) * BS, 120 * BS, camera_pos,
+		camera_dir, fov, range));
+
+	// Behind the camera, out of range
+	UASSERT(!isSphereInSight(v3f(0, 0, -100) * BS, 8 * BS, camera_pos,
+		camera_dir, fov, range));
+	UASSERT(!isSphereInSight(v3f(0, 0, 2000) * BS, 8 * BS, camera_pos,
+		camera_dir, fov, range));
+
+	// Far off to the side, unless the sphere is large enough
+	UASSERT(!isSphereInSight(v3f(300, 0, 100) * BS, 8 * BS, camera_pos,
+		camera_dir, fov, range));
+	UASSERT(isSphereInSight(v3f(300, 0, 100) * BS, 300 * BS, camera_pos,
+		camera_dir, fov, range));
+
+	// The camera is inside the sphere
+	UASSERT(isSphereInSight(v3f(0, 0, -10) * BS, 20 * BS, camera_pos,
+		camera_dir, fov, range));
+}
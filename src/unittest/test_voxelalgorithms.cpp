@@ -19,7 +19,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "test.h"
 
+#include <cmath>
+#include <cstring>
 #include "gamedef.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "porting.h"
 #include "voxelalgorithms.h"
 #include "util/numeric.h"
 
@@ -29,8 +34,11 @@ class TestVoxelAlgorithms : public TestBase {
 	const char *getName() { return "TestVoxelAlgorithms"; }
 
 	void runTests(IGameDef *gamedef);
+	void runBenchmarks(IGameDef *gamedef);
 
 	void testVoxelLineIterator(const NodeDefManager *ndef);
+	void testSpreadLight(const NodeDefManager *ndef);
+	void benchmarkSpreadLight(const NodeDefManager *ndef);
 };
 
 static TestVoxelAlgorithms g_test_instance;
@@ -40,6 +48,12 @@ void TestVoxelAlgorithms::runTests(IGameDef *gamedef)
 	const NodeDefManager *ndef = gamedef->getNodeDefManager();
 
 	TEST(testVoxelLineIterator, ndef);
+	TEST(testSpreadLight, ndef);
+}
+
+void TestVoxelAlgorithms::runBenchmarks(IGameDef *gamedef)
+{
+	TEST(benchmarkSpreadLight, gamedef->getNodeDefManager());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -99,3 +113,209 @@ void TestVoxelAlgorithms::testVoxelLineIterator(const NodeDefManager *ndef)
 		UASSERTEQ(int, actual_nodecount, nodecount);
 	}
 }
+
+/*
+	Fills the voxel manipulator with terrain similar to a mapgen v7
+	chunk: hills, caves with torches and lava, a few water lakes, and
+	sunlight like after Mapgen::propagateSunlight().
+*/
+static void make_terrain(VoxelManipulator *vm, s32 seed)
+{
+	const VoxelArea &area = vm->m_area;
+	v3s16 em = area.getExtent();
+	NoiseParams np_terrain(4, 30, v3f(120, 120, 120), 82341, 5, 0.6, 2.0);
+	NoiseParams np_cave(0, 12, v3f(61, 61, 61), 52534, 3, 0.5, 2.0);
+	Noise noise_terrain(&np_terrain, seed, em.X, em.Z);
+	Noise noise_cave(&np_cave, seed, em.X, em.Y, em.Z);
+	noise_terrain.perlinMap2D(area.MinEdge.X, area.MinEdge.Z);
+	noise_cave.perlinMap3D(area.MinEdge.X, area.MinEdge.Y, area.MinEdge.Z);
+	PcgRandom pr(seed);
+
+	u32 index3d = 0;
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 y = area.MinEdge.Y; y <= area.MaxEdge.Y; y++) {
+		u32 i = area.index(area.MinEdge.X, y, z);
+		for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++, i++, index3d++) {
+			u32 index2d = (z - area.MinEdge.Z) * em.X + (x - area.MinEdge.X);
+			float height = noise_terrain.result[index2d];
+			content_t c = CONTENT_AIR;
+			if (y <= height) {
+				c = t_CONTENT_STONE;
+				if (std::fabs(noise_cave.result[index3d]) > 9) {
+					c = CONTENT_AIR;
+					u32 r = pr.range(0, 999);
+					if (r < 2)
+						c = t_CONTENT_TORCH;
+					else if (r < 3)
+						c = t_CONTENT_LAVA;
+				}
+			} else if (y <= 1) {
+				c = t_CONTENT_WATER;
+			}
+			vm->m_data[i] = MapNode(c);
+			vm->m_flags[i] &= ~VOXELFLAG_NO_DATA;
+		}
+	}
+
+	// Sunlight from the top, night light is dark
+	for (s16 z = area.MinEdge.Z; z <= area.MaxEdge.Z; z++)
+	for (s16 x = area.MinEdge.X; x <= area.MaxEdge.X; x++) {
+		u32 i = area.index(x, area.MaxEdge.Y, z);
+		for (s16 y = area.MaxEdge.Y; y >= area.MinEdge.Y; y--) {
+			if (vm->m_data[i].getContent() != CONTENT_AIR)
+				break;
+			vm->m_data[i].param1 = LIGHT_SUN;
+			VoxelArea::add_y(em, i, -1);
+		}
+	}
+}
+
+// Lights the area by relaxing every node until nothing changes
+static void spread_light_reference(VoxelManipulator *vm,
+	const NodeDefManager *ndef, const VoxelArea &a)
+{
+	static const v3s16 dirs[6] = {
+		v3s16(1, 0, 0), v3s16(-1, 0, 0), v3s16(0, 1, 0),
+		v3s16(0, -1, 0), v3s16(0, 0, 1), v3s16(0, 0, -1),
+	};
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		v3s16 p;
+		for (p.Z = a.MinEdge.Z; p.Z <= a.MaxEdge.Z; p.Z++)
+		for (p.Y = a.MinEdge.Y; p.Y <= a.MaxEdge.Y; p.Y++)
+		for (p.X = a.MinEdge.X; p.X <= a.MaxEdge.X; p.X++) {
+			MapNode &n = vm->m_data[vm->m_area.index(p)];
+			const ContentFeatures &f = ndef->get(n);
+			if (!f.light_propagates)
+				continue;
+			u8 day = MYMAX(n.param1 & 0x0F, f.light_source);
+			u8 night = MYMAX(n.param1 >> 4, f.light_source);
+			for (const v3s16 &dir : dirs) {
+				if (!a.contains(p + dir))
+					continue;
+				const MapNode &n2 = vm->m_data[vm->m_area.index(p + dir)];
+				if (!ndef->get(n2).light_propagates)
+					continue;
+				day = MYMAX(day, (n2.param1 & 0x0F) - 1);
+				night = MYMAX(night, (n2.param1 >> 4) - 1);
+			}
+			u8 light = day | (night << 4);
+			if (light != n.param1) {
+				n.param1 = light;
+				changed = true;
+			}
+		}
+	}
+}
+
+void TestVoxelAlgorithms::testSpreadLight(const NodeDefManager *ndef)
+{
+	VoxelArea area(v3s16(-20, -30, -20), v3s16(19, 9, 19));
+	VoxelArea light_area(v3s16(-19, -29, -19), v3s16(18, 8, 18));
+
+	for (s32 seed : {1, 2, 3}) {
+		VoxelManipulator expected, actual;
+		expected.addArea(area);
+		actual.addArea(area);
+		make_terrain(&expected, seed);
+
+		// Some night light coming in from outside of the area
+		for (s16 y = -29; y <= 8; y++) {
+			MapNode &n = expected.m_data[area.index(-20, y, 0)];
+			if (n.getContent() == CONTENT_AIR)
+				n.param1 |= 0xB0;
+		}
+		memcpy(actual.m_data, expected.m_data,
+			area.getVolume() * sizeof(MapNode));
+
+		spread_light_reference(&expected, ndef, light_area);
+		voxalgo::spread_light(&actual, ndef, light_area);
+
+		for (s32 i = 0; i < area.getVolume(); i++)
+			UASSERT(actual.m_data[i] == expected.m_data[i] &&
+				actual.m_data[i].param1 == expected.m_data[i].param1);
+	}
+}
+
+// Mapgen::spreadLight() before it used voxalgo::spread_light()
+static void spread_light_recursive(VoxelManipulator *vm,
+	const NodeDefManager *ndef, const VoxelArea &a, v3s16 p, u8 light)
+{
+	if (light <= 1 || !a.contains(p))
+		return;
+
+	MapNode &n = vm->m_data[vm->m_area.index(p)];
+	u8 light_day = light & 0x0F;
+	if (light_day > 0)
+		light_day -= 0x01;
+	u8 light_night = light & 0xF0;
+	if (light_night > 0)
+		light_night -= 0x10;
+	if ((light_day <= (n.param1 & 0x0F) &&
+		light_night <= (n.param1 & 0xF0)) ||
+		!ndef->get(n).light_propagates)
+		return;
+
+	light = MYMAX(light_day, n.param1 & 0x0F) |
+		MYMAX(light_night, n.param1 & 0xF0);
+	n.param1 = light;
+
+	spread_light_recursive(vm, ndef, a, p + v3s16(0, 0, 1), light);
+	spread_light_recursive(vm, ndef, a, p + v3s16(0, 1, 0), light);
+	spread_light_recursive(vm, ndef, a, p + v3s16(1, 0, 0), light);
+	spread_light_recursive(vm, ndef, a, p - v3s16(0, 0, 1), light);
+	spread_light_recursive(vm, ndef, a, p - v3s16(0, 1, 0), light);
+	spread_light_recursive(vm, ndef, a, p - v3s16(1, 0, 0), light);
+}
+
+static void spread_light_recursive(VoxelManipulator *vm,
+	const NodeDefManager *ndef, const VoxelArea &a)
+{
+	v3s16 p;
+	for (p.Z = a.MinEdge.Z; p.Z <= a.MaxEdge.Z; p.Z++)
+	for (p.Y = a.MinEdge.Y; p.Y <= a.MaxEdge.Y; p.Y++)
+	for (p.X = a.MinEdge.X; p.X <= a.MaxEdge.X; p.X++) {
+		MapNode &n = vm->m_data[vm->m_area.index(p)];
+		const ContentFeatures &f = ndef->get(n);
+		if (!f.light_propagates)
+			continue;
+		if (f.light_source)
+			n.param1 = f.light_source | (f.light_source << 4);
+		u8 light = n.param1;
+		if (light) {
+			for (const v3s16 &dir : {v3s16(0, 0, 1), v3s16(0, 1, 0),
+					v3s16(1, 0, 0), v3s16(0, 0, -1), v3s16(0, -1, 0),
+					v3s16(-1, 0, 0)})
+				spread_light_recursive(vm, ndef, a, p + dir, light);
+		}
+	}
+}
+
+void TestVoxelAlgorithms::benchmarkSpreadLight(const NodeDefManager *ndef)
+{
+	// One 80x80x80 chunk at the surface with the mapgen's border of one
+	// block, lit like Mapgen::calcLighting() does
+	VoxelArea area(v3s16(-48, -48, -48), v3s16(63, 63, 63));
+	VoxelArea light_area(v3s16(-33, -33, -33), v3s16(48, 48, 48));
+	VoxelManipulator vm_before, vm_after;
+	vm_before.addArea(area);
+	vm_after.addArea(area);
+	make_terrain(&vm_before, 42);
+	memcpy(vm_after.m_data, vm_before.m_data,
+		area.getVolume() * sizeof(MapNode));
+
+	u64 t0 = porting::getTimeUs();
+	spread_light_recursive(&vm_before, ndef, light_area);
+	u64 t1 = porting::getTimeUs();
+	voxalgo::spread_light(&vm_after, ndef, light_area);
+	u64 t2 = porting::getTimeUs();
+
+	u32 differing = 0;
+	for (s32 i = 0; i < area.getVolume(); i++)
+		differing += vm_before.m_data[i].param1 != vm_after.m_data[i].param1;
+
+	rawstream << "Chunk lighting: recursive " << (t1 - t0) / 1000
+		<< "ms, bucket queue " << (t2 - t1) / 1000 << "ms, "
+		<< differing << " nodes lit differently" << std::endl;
+}
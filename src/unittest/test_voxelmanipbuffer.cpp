@@ -0,0 +1,137 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "test.h"
+
+extern "C" {
+#include <lualib.h>
+}
+#include "lua_api/l_vmanip.h"
+#include "map.h"
+
+class TestVoxelManipBuffer : public TestBase {
+public:
+	TestVoxelManipBuffer() { TestManager::registerTestModule(this); }
+	const char *getName() { return "TestVoxelManipBuffer"; }
+
+	void runTests(IGameDef *gamedef);
+
+	void testIndex();
+	void testRange();
+};
+
+static TestVoxelManipBuffer g_test_instance;
+
+void TestVoxelManipBuffer::runTests(IGameDef *gamedef)
+{
+	TEST(testIndex);
+	TEST(testRange);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Runs the Lua code with the nodes 1 to 27 of a 3x3x3 VoxelManip as "vm",
+// each having its index as content, light and param2
+static bool run_with_vmanip(const char *code, MMVManip *vm)
+{
+	vm->addArea(VoxelArea(v3s16(0, 0, 0), v3s16(2, 2, 2)));
+	for (u32 i = 0; i < 27; i++)
+		vm->m_data[i] = MapNode(i + 1, i + 1, i + 1);
+
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+	LuaVoxelManip::Register(L);
+	LuaVoxelManipBuffer::Register(L);
+
+	// Like the Mapgen VoxelManip, the Lua object does not own vm
+	LuaVoxelManip *o = new LuaVoxelManip(vm, true);
+	*(void **)(lua_newuserdata(L, sizeof(void *))) = o;
+	luaL_getmetatable(L, "VoxelManip");
+	lua_setmetatable(L, -2);
+	lua_setglobal(L, "vm");
+
+	bool ok = luaL_loadstring(L, code) == 0 && lua_pcall(L, 0, 0, 0) == 0;
+	if (!ok)
+		errorstream << lua_tostring(L, -1) << std::endl;
+	lua_close(L);
+	return ok;
+}
+
+
+void TestVoxelManipBuffer::testIndex()
+{
+	MMVManip vm(nullptr);
+	UASSERT(run_with_vmanip(
+		"local data = vm:get_buffer()\n"
+		"assert(#data == 27 and data:size() == 27)\n"
+		"assert(data[1] == 1 and data[27] == 27 and data:get(14) == 14)\n"
+		"assert(data[0] == nil and data[28] == nil and data[-1] == nil)\n"
+		"data[2] = 100\n"
+		"data:set(27, 200)\n"
+		"assert(data[2] == 100 and data:get(27) == 200)\n"
+		"assert(not pcall(function() data[0] = 1 end))\n"
+		"assert(not pcall(function() data[28] = 1 end))\n"
+		"assert(not pcall(function() data.x = 1 end))\n"
+		"assert(not pcall(data.set, data, 3, 'stone'))\n"
+		"local light = vm:get_buffer('light')\n"
+		"local param2 = vm:get_buffer('param2')\n"
+		"assert(light[2] == 2 and param2[2] == 2)\n"
+		"light[3] = 15\n"
+		"param2[4] = 40\n"
+		"assert(data[3] == 3 and data[4] == 4)\n",
+		&vm));
+
+	UASSERTEQ(content_t, vm.m_data[1].getContent(), 100);
+	UASSERTEQ(content_t, vm.m_data[26].getContent(), 200);
+	UASSERTEQ(u8, vm.m_data[1].param1, 2);
+	UASSERTEQ(u8, vm.m_data[2].param1, 15);
+	UASSERTEQ(u8, vm.m_data[2].getContent(), 3);
+	UASSERTEQ(u8, vm.m_data[3].param2, 40);
+	UASSERTEQ(u8, vm.m_data[3].param1, 4);
+}
+
+
+void TestVoxelManipBuffer::testRange()
+{
+	MMVManip vm(nullptr);
+	UASSERT(run_with_vmanip(
+		"local data = vm:get_buffer()\n"
+		"local t = data:get_range(25, 3)\n"
+		"assert(#t == 3 and t[1] == 25 and t[3] == 27)\n"
+		"assert(#data:get_range(27, 0) == 0)\n"
+		"local reused = {}\n"
+		"assert(data:get_range(1, 2, reused) == reused and reused[2] == 2)\n"
+		"assert(not pcall(data.get_range, data, 26, 3))\n"
+		"assert(not pcall(data.get_range, data, 0, 1))\n"
+		"data:set_range(10, {100, 101, 102})\n"
+		"data:set_range(20, {200, 201, 202}, 2)\n"
+		"assert(not pcall(data.set_range, data, 26, {1, 2, 3}))\n"
+		"assert(not pcall(data.set_range, data, 1, {1, 'x'}))\n"
+		"vm:get_buffer('param2'):set_range(1, {50})\n",
+		&vm));
+
+	UASSERTEQ(content_t, vm.m_data[8].getContent(), 9);
+	UASSERTEQ(content_t, vm.m_data[9].getContent(), 100);
+	UASSERTEQ(content_t, vm.m_data[11].getContent(), 102);
+	UASSERTEQ(content_t, vm.m_data[12].getContent(), 13);
+	UASSERTEQ(content_t, vm.m_data[20].getContent(), 201);
+	UASSERTEQ(content_t, vm.m_data[21].getContent(), 22);
+	UASSERTEQ(u8, vm.m_data[0].param2, 50);
+	UASSERTEQ(content_t, vm.m_data[0].getContent(), 1);
+}
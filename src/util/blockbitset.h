@@ -0,0 +1,102 @@
+/*
+Minetest
+Copyright (C) 2018 celeron55, Perttu Ahola <celeron55@gmail.com>
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irr_v3d.h"
+#include <bitset>
+#include <unordered_map>
+
+/*
+	Set of block positions stored as one bit per position.
+
+	Positions are grouped into regions of 8x8x8 that share a bitset, so
+	lookups and insertions are one hash lookup plus a bit operation
+	instead of a tree walk, and nearby positions share cache lines.
+*/
+class BlockBitSet
+{
+public:
+	bool contains(v3s16 p) const
+	{
+		auto it = m_regions.find(regionKey(p));
+		return it != m_regions.end() && it->second.bits[bitIndex(p)];
+	}
+
+	// Returns false if p was already in the set
+	bool insert(v3s16 p)
+	{
+		Region &r = m_regions[regionKey(p)];
+		u32 i = bitIndex(p);
+		if (r.bits[i])
+			return false;
+		r.bits[i] = true;
+		r.count++;
+		m_size++;
+		return true;
+	}
+
+	// Returns false if p was not in the set
+	bool erase(v3s16 p)
+	{
+		auto it = m_regions.find(regionKey(p));
+		if (it == m_regions.end())
+			return false;
+		u32 i = bitIndex(p);
+		if (!it->second.bits[i])
+			return false;
+		it->second.bits[i] = false;
+		m_size--;
+		if (--it->second.count == 0)
+			m_regions.erase(it);
+		return true;
+	}
+
+	void clear()
+	{
+		m_regions.clear();
+		m_size = 0;
+	}
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+private:
+	struct Region
+	{
+		std::bitset<512> bits;
+		u16 count = 0;
+	};
+
+	static u64 regionKey(v3s16 p)
+	{
+		// Arithmetic shift keeps negative positions in their own regions
+		return ((u64)(u16)(p.X >> 3) << 32) |
+			((u64)(u16)(p.Y >> 3) << 16) |
+			(u64)(u16)(p.Z >> 3);
+	}
+
+	static u32 bitIndex(v3s16 p)
+	{
+		return ((p.Z & 7) << 6) | ((p.Y & 7) << 3) | (p.X & 7);
+	}
+
+	std::unordered_map<u64, Region> m_regions;
+	size_t m_size = 0;
+};
@@ -43,6 +43,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdint>
+#include <mutex>
 
 #include <config.h>
 
@@ -75,6 +76,8 @@ static int g_initialized = 0;
 #define RAND_BUFF_MAX 128
 static unsigned int g_rand_idx;
 static unsigned char g_rand_buff[RAND_BUFF_MAX];
+// Verifiers may be created from several threads, see AuthWorkerPool
+static std::mutex g_rand_mutex;
 
 void *(*srp_alloc)(size_t) = &malloc;
 void *(*srp_realloc)(void *, size_t) = &realloc;
@@ -553,18 +556,28 @@ static SRP_Result fill_buff()
 	return SRP_OK;
 }
 
+static SRP_Result fill_random_bytes(unsigned char *dest, size_t len)
+{
+	std::lock_guard<std::mutex> lock(g_rand_mutex);
+	if (RAND_BUFF_MAX - g_rand_idx < len)
+		if (fill_buff() != SRP_OK) return SRP_ERR;
+	memcpy(dest, &g_rand_buff[g_rand_idx], len);
+	g_rand_idx += len;
+	return SRP_OK;
+}
+
 static SRP_Result mpz_fill_random(mpz_t num)
 {
 	// was call: BN_rand(num, 256, -1, 0);
-	if (RAND_BUFF_MAX - g_rand_idx < 32)
-		if (fill_buff() != SRP_OK) return SRP_ERR;
-	mpz_from_bin((const unsigned char *)(&g_rand_buff[g_rand_idx]), 32, num);
-	g_rand_idx += 32;
+	unsigned char buf[32];
+	if (fill_random_bytes(buf, sizeof(buf)) != SRP_OK) return SRP_ERR;
+	mpz_from_bin(buf, sizeof(buf), num);
 	return SRP_OK;
 }
 
 static SRP_Result init_random()
 {
+	std::lock_guard<std::mutex> lock(g_rand_mutex);
 	if (g_initialized) return SRP_OK;
 	SRP_Result ret = fill_buff();
 	g_initialized = (ret == SRP_OK);
@@ -612,12 +625,10 @@ SRP_Result srp_create_salted_verification_key( SRP_HashAlgorithm alg,
 	if (*bytes_s == NULL) {
 		size_t size_to_fill = 16;
 		*len_s = size_to_fill;
-		if (RAND_BUFF_MAX - g_rand_idx < size_to_fill)
-			if (fill_buff() != SRP_OK) goto error_and_exit;
 		*bytes_s = (unsigned char *)srp_alloc(size_to_fill);
 		if (!*bytes_s) goto error_and_exit;
-		memcpy(*bytes_s, &g_rand_buff[g_rand_idx], size_to_fill);
-		g_rand_idx += size_to_fill;
+		if (fill_random_bytes(*bytes_s, size_to_fill) != SRP_OK)
+			goto error_and_exit;
 	}
 
 	if (!calculate_x(
@@ -75,14 +75,38 @@ struct ChangingLight {
 };
 
 /*!
- * A fast, priority queue-like container to contain ChangingLights.
- * The ChangingLights are ordered by the given light levels.
- * The brightest ChangingLight is returned first.
+ * A ChangingLight that spreads light.
+ * Both light banks are spread together, so it carries
+ * the light it spreads in each bank.
  */
+struct SpreadingLight : ChangingLight {
+	/*!
+	 * Light of the node in both banks, packed the same way
+	 * as in param1: day light in the lower four bits,
+	 * night light in the upper four bits.
+	 */
+	u8 light = 0;
+
+	SpreadingLight() = default;
+
+	SpreadingLight(const relative_v3 &rel_pos, const mapblock_v3 &block_pos,
+		MapBlock *b, direction source_dir, u8 packed_light) :
+		ChangingLight(rel_pos, block_pos, b, source_dir),
+		light(packed_light)
+	{}
+};
+
+/*!
+ * A fast, priority queue-like container (a bucket queue) to contain
+ * nodes whose light changes.
+ * The elements are ordered by the given light levels.
+ * The brightest element is returned first.
+ */
+template <typename T>
 struct LightQueue {
 	//! For each light level there is a vector.
-	std::vector<ChangingLight> lights[LIGHT_SUN + 1];
-	//! Light of the brightest ChangingLight in the queue.
+	std::vector<T> lights[LIGHT_SUN + 1];
+	//! Light of the brightest element in the queue.
 	u8 max_light;
 
 	/*!
@@ -98,15 +122,15 @@ struct LightQueue {
 	}
 
 	/*!
-	 * Returns the next brightest ChangingLight and
+	 * Returns the next brightest element and
 	 * removes it from the queue.
 	 * If there were no elements in the queue, the given parameters
 	 * remain unmodified.
-	 * \param light light level of the popped ChangingLight
-	 * \param data the ChangingLight that was popped
-	 * \returns true if there was a ChangingLight in the queue.
+	 * \param light light level of the popped element
+	 * \param data the element that was popped
+	 * \returns true if there was an element in the queue.
 	 */
-	bool next(u8 &light, ChangingLight &data)
+	bool next(u8 &light, T &data)
 	{
 		while (lights[max_light].empty()) {
 			if (max_light == 0) {
@@ -122,15 +146,17 @@ struct LightQueue {
 
 	/*!
 	 * Adds an element to the queue.
-	 * The parameters are the same as in ChangingLight's constructor.
-	 * \param light light level of the ChangingLight
+	 * The parameters after the light level are passed to
+	 * the element's constructor.
+	 * \param light light level of the element
 	 */
-	inline void push(u8 light, const relative_v3 &rel_pos,
-		const mapblock_v3 &block_pos, MapBlock *block,
-		direction source_dir)
+	template <typename... Args>
+	inline void push(u8 light, Args &&... args)
 	{
 		assert(light <= LIGHT_SUN);
-		lights[light].emplace_back(rel_pos, block_pos, block, source_dir);
+		if (light > max_light)
+			max_light = light;
+		lights[light].emplace_back(std::forward<Args>(args)...);
 	}
 };
 
@@ -140,18 +166,38 @@ struct LightQueue {
  * This prevents pushing nodes twice into this queue.
  * The light of the pushed ChangingLight must be the
  * light of the node before unlighting it.
+ * Each light bank has its own unlight queue.
  */
-typedef LightQueue UnlightQueue;
+typedef LightQueue<ChangingLight> UnlightQueue;
 /*!
  * This type of light queue is for spreading lights.
+ * It contains the lights of both banks, a node is queued
+ * with the light of its brighter bank.
  * While spreading lights, all the nodes in it must
- * have the same light as the light level the ChangingLights
- * were pushed into this queue with. This prevents unnecessary
- * re-pushing of the nodes into the queue.
+ * have at least as much light as the SpreadingLights
+ * were pushed into this queue with. Nodes that got more light
+ * since they were pushed are skipped in that bank.
  * If a node doesn't let light trough but emits light, it can be added
  * too.
  */
-typedef LightQueue ReLightQueue;
+typedef LightQueue<SpreadingLight> ReLightQueue;
+
+static const LightBank banks[] = { LIGHTBANK_DAY, LIGHTBANK_NIGHT };
+
+/*!
+ * Returns the given light of a bank packed the same way as
+ * in param1, see SpreadingLight::light.
+ */
+static inline u8 pack_light(LightBank bank, u8 light)
+{
+	return bank == LIGHTBANK_DAY ? light : light << 4;
+}
+
+//! Returns one bank's light from packed light.
+static inline u8 unpack_light(LightBank bank, u8 packed_light)
+{
+	return bank == LIGHTBANK_DAY ? packed_light & 0x0F : packed_light >> 4;
+}
 
 /*!
  * neighbor_dirs[i] points towards
@@ -333,79 +379,305 @@ void unspread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
 			light_sources.push(brightest_neighbor_light, current.rel_position,
 				current.block_position, current.block,
 				(source_dir == 6) ? 6 : 5 - source_dir
-				/* with opposite direction*/);
+				/* with opposite direction*/,
+				pack_light(bank, brightest_neighbor_light));
 		}
 	}
 }
 
+/*!
+ * Spreads the given packed light of one node to its neighbors.
+ * Neighbors that get brighter are queued in light_sources.
+ *
+ * This is the light spreading core of both map updates and the
+ * map generator, it only accesses nodes through the Grid.
+ * Grid must provide:
+ * - Grid::Light, the queue's element type. It has a packed light
+ *   member 'light' and a 'source_direction'.
+ * - MapNode getNode(const Light &)
+ * - bool step(const Light &from, direction dir, u8 packed_light,
+ *   Light &to): moves to the neighbor, returns false if it can't be lit.
+ * - void setNode(const Light &from, const Light &to, MapNode &)
+ */
+template <typename Grid>
+inline void spread_light_from(Grid &grid, const NodeDefManager *nodemgr,
+	LightQueue<typename Grid::Light> &light_sources,
+	const typename Grid::Light &current, u8 light)
+{
+	// The light the current node can provide to its neighbors.
+	u8 spreading_day = light & 0x0F;
+	if (spreading_day > 0)
+		spreading_day--;
+	u8 spreading_night = light & 0xF0;
+	if (spreading_night > 0)
+		spreading_night -= 0x10;
+	if (spreading_day == 0 && spreading_night == 0)
+		return;
+
+	typename Grid::Light neighbor;
+	for (direction i = 0; i < 6; i++) {
+		// This node can't light up its light source
+		if (current.source_direction + i == 5) {
+			continue;
+		}
+		if (!grid.step(current, i, light, neighbor))
+			continue;
+		MapNode n = grid.getNode(neighbor);
+		const ContentFeatures &f = nodemgr->get(n.getContent());
+		if (!f.light_propagates)
+			continue;
+		// Light up the neighbor, if it has less light than it should.
+		u8 neighbor_light = f.param_type == CPT_LIGHT ? n.param1 : 0;
+		u8 new_day = (neighbor_light & 0x0F) < spreading_day ?
+			spreading_day : 0;
+		u8 new_night = (neighbor_light & 0xF0) < spreading_night ?
+			spreading_night : 0;
+		if (new_day == 0 && new_night == 0)
+			continue;
+		if (f.param_type == CPT_LIGHT) {
+			n.param1 = (new_day ? new_day : neighbor_light & 0x0F) |
+				(new_night ? new_night : neighbor_light & 0xF0);
+		}
+		grid.setNode(current, neighbor, n);
+		neighbor.light = new_day | new_night;
+		light_sources.push(MYMAX(new_day, new_night >> 4), neighbor);
+	}
+}
+
 /*
- * Spreads light from the specified starting nodes.
+ * Spreads light from the specified starting nodes, in both light banks.
  *
- * Before calling this procedure, make sure that all ChangingLights
- * in light_sources have as much light on the map as they have in
- * light_sources (if the queue contains a node multiple times, the brightest
- * occurrence counts).
+ * Lights are processed brightest first, so most nodes are lit only once.
+ * A node can be queued again when its other bank gets more light,
+ * stale queue entries are skipped in that bank.
+ *
+ * Before calling this procedure, make sure that all queued nodes
+ * have at least as much light as they were queued with (if the queue
+ * contains a node multiple times, the brightest occurrence counts).
  *
- * \param bank the light bank in which the procedure operates
  * \param light_sources starting nodes
- * \param modified_blocks output, all modified map blocks are added to this
  */
-void spread_light(Map *map, const NodeDefManager *nodemgr, LightBank bank,
-	LightQueue &light_sources,
-	std::map<v3s16, MapBlock*> &modified_blocks)
+template <typename Grid>
+void spread_light(Grid &grid, const NodeDefManager *nodemgr,
+	LightQueue<typename Grid::Light> &light_sources)
 {
-	// The light the current node can provide to its neighbors.
-	u8 spreading_light;
-	// The ChangingLight for the current node.
-	ChangingLight current;
-	// Position of the current neighbor.
-	mapblock_v3 neighbor_block_pos;
-	relative_v3 neighbor_rel_pos;
-	// A dummy boolean.
-	bool is_valid_position;
-	while (light_sources.next(spreading_light, current)) {
-		spreading_light--;
-		for (direction i = 0; i < 6; i++) {
-			// This node can't light up its light source
-			if (current.source_direction + i == 5) {
-				continue;
-			}
-			// Get the neighbor's position and block
-			neighbor_rel_pos = current.rel_position;
-			neighbor_block_pos = current.block_position;
-			MapBlock *neighbor_block;
-			if (step_rel_block_pos(i, neighbor_rel_pos, neighbor_block_pos)) {
-				neighbor_block = map->getBlockNoCreateNoEx(neighbor_block_pos);
-				if (neighbor_block == NULL) {
-					current.block->setLightingComplete(bank, i, false);
-					continue;
+	// Light level of the current node's queue bucket.
+	u8 queued_light;
+	// The current node.
+	typename Grid::Light current;
+	while (light_sources.next(queued_light, current)) {
+		u8 light = current.light;
+		// Skip the banks in which the node got more light since it
+		// was queued, that light is spread by a later entry.
+		MapNode node = grid.getNode(current);
+		const ContentFeatures &f = nodemgr->get(node);
+		u8 node_light = f.param_type == CPT_LIGHT ? node.param1 : 0;
+		if ((node_light & 0x0F) > (light & 0x0F))
+			light &= 0xF0;
+		if ((node_light & 0xF0) > (light & 0xF0))
+			light &= 0x0F;
+
+		spread_light_from(grid, nodemgr, light_sources, current, light);
+	}
+}
+
+/*!
+ * Lets spread_light() work on the map.
+ * Neighbors in unloaded blocks are not lit, the lighting of
+ * the block is marked incomplete instead.
+ */
+struct MapLightGrid {
+	typedef SpreadingLight Light;
+
+	Map *map;
+	//! All modified map blocks are added to this
+	std::map<v3s16, MapBlock*> &modified_blocks;
+
+	MapLightGrid(Map *m, std::map<v3s16, MapBlock*> &modified) :
+		map(m),
+		modified_blocks(modified)
+	{}
+
+	inline MapNode getNode(const Light &l) const
+	{
+		bool is_valid_position;
+		return l.block->getNodeNoCheck(l.rel_position, &is_valid_position);
+	}
+
+	inline bool step(const Light &from, direction dir, u8 packed_light,
+		Light &to)
+	{
+		to.rel_position = from.rel_position;
+		to.block_position = from.block_position;
+		to.source_direction = dir;
+		if (step_rel_block_pos(dir, to.rel_position, to.block_position)) {
+			to.block = map->getBlockNoCreateNoEx(to.block_position);
+			if (to.block == NULL) {
+				for (LightBank bank : banks) {
+					if (unpack_light(bank, packed_light) > 0)
+						from.block->setLightingComplete(bank, dir, false);
 				}
-			} else {
-				neighbor_block = current.block;
+				return false;
 			}
-			// Get the neighbor itself
-			MapNode neighbor = neighbor_block->getNodeNoCheck(neighbor_rel_pos,
+		} else {
+			to.block = from.block;
+		}
+		return true;
+	}
+
+	inline void setNode(const Light &from, const Light &to, MapNode &n)
+	{
+		to.block->setNodeNoCheck(to.rel_position, n);
+		// The current node was modified earlier, so its block
+		// is in modified_blocks.
+		if (from.block != to.block) {
+			modified_blocks[to.block_position] = to.block;
+		}
+	}
+};
+
+/*!
+ * Sets the light of the nodes in the queue to the light they
+ * are queued with, as spread_light() requires it.
+ * If a node is in the queue multiple times, the brightest
+ * occurrence of each bank counts.
+ */
+void init_spreading_lights(const NodeDefManager *nodemgr,
+	ReLightQueue &light_sources)
+{
+	// A dummy boolean.
+	bool is_valid_position;
+	for (u8 i = 0; i <= LIGHT_SUN; i++) {
+		for (const SpreadingLight &l : light_sources.lights[i]) {
+			MapNode n = l.block->getNodeNoCheck(l.rel_position,
 				&is_valid_position);
-			const ContentFeatures &f = nodemgr->get(neighbor.getContent());
-			if (f.light_propagates) {
-				// Light up the neighbor, if it has less light than it should.
-				u8 neighbor_light = neighbor.getLightRaw(bank, f);
-				if (neighbor_light < spreading_light) {
-					neighbor.setLight(bank, spreading_light, f);
-					neighbor_block->setNodeNoCheck(neighbor_rel_pos, neighbor);
-					light_sources.push(spreading_light, neighbor_rel_pos,
-						neighbor_block_pos, neighbor_block, i);
-					// The current node was modified earlier, so its block
-					// is in modified_blocks.
-					if (current.block != neighbor_block) {
-						modified_blocks[neighbor_block_pos] = neighbor_block;
-					}
-				}
+			const ContentFeatures &f = nodemgr->get(n);
+			for (LightBank bank : banks) {
+				u8 light = unpack_light(bank, l.light);
+				if (light > n.getLightRaw(bank, f))
+					n.setLight(bank, light, f);
 			}
+			l.block->setNodeNoCheck(l.rel_position, n);
 		}
 	}
 }
 
+/*
+ * Spreads light from the specified starting nodes on the map.
+ *
+ * \param light_sources starting nodes, see init_spreading_lights()
+ * \param modified_blocks output, all modified map blocks are added to this
+ */
+void spread_light(Map *map, const NodeDefManager *nodemgr,
+	ReLightQueue &light_sources,
+	std::map<v3s16, MapBlock*> &modified_blocks)
+{
+	MapLightGrid grid(map, modified_blocks);
+	spread_light(grid, nodemgr, light_sources);
+}
+
+//! A node of a voxel manipulator whose light spreads.
+struct VoxelSpreadingLight {
+	//! Position of the node.
+	v3s16 position;
+	//! Light of the node, see SpreadingLight::light.
+	u8 light = 0;
+	//! Direction from the node that lit this node.
+	direction source_direction = 6;
+	//! Index of the node in the voxel manipulator.
+	u32 index = 0;
+
+	VoxelSpreadingLight() = default;
+
+	VoxelSpreadingLight(const v3s16 &pos, u32 i, direction source_dir,
+		u8 packed_light) :
+		position(pos),
+		light(packed_light),
+		source_direction(source_dir),
+		index(i)
+	{}
+};
+
+/*!
+ * Lets spread_light() work in an area of a voxel manipulator.
+ * Nodes outside of the area are not lit.
+ */
+struct VoxelLightGrid {
+	typedef VoxelSpreadingLight Light;
+
+	MapNode *data;
+	const VoxelArea &area;
+	//! Index offsets of the neighbors, compatible with type 'direction'.
+	s32 strides[6];
+
+	VoxelLightGrid(VoxelManipulator *vm, const VoxelArea &a) :
+		data(vm->m_data),
+		area(a)
+	{
+		for (direction i = 0; i < 6; i++)
+			strides[i] = vm->m_area.index(neighbor_dirs[i]) -
+				vm->m_area.index(0, 0, 0);
+	}
+
+	inline MapNode getNode(const Light &l) const
+	{
+		return data[l.index];
+	}
+
+	inline bool step(const Light &from, direction dir, u8 packed_light,
+		Light &to) const
+	{
+		to.position = from.position + neighbor_dirs[dir];
+		if (!area.contains(to.position))
+			return false;
+		to.index = from.index + strides[dir];
+		to.source_direction = dir;
+		return true;
+	}
+
+	inline void setNode(const Light &from, const Light &to, MapNode &n)
+	{
+		data[to.index] = n;
+	}
+};
+
+void spread_light(VoxelManipulator *vm, const NodeDefManager *ndef,
+	const VoxelArea &a)
+{
+	LightQueue<VoxelSpreadingLight> light_sources(256);
+	VoxelLightGrid grid(vm, a);
+
+	// Collect and initialize all lit nodes and light sources
+	v3s16 p;
+	for (p.Z = a.MinEdge.Z; p.Z <= a.MaxEdge.Z; p.Z++)
+	for (p.Y = a.MinEdge.Y; p.Y <= a.MaxEdge.Y; p.Y++) {
+		u32 i = vm->m_area.index(a.MinEdge.X, p.Y, p.Z);
+		for (p.X = a.MinEdge.X; p.X <= a.MaxEdge.X; p.X++, i++) {
+			MapNode &n = vm->m_data[i];
+			if (n.getContent() == CONTENT_IGNORE)
+				continue;
+
+			const ContentFeatures &f = ndef->get(n);
+			if (!f.light_propagates)
+				continue;
+
+			// Direct access to param1 is okay, nodes that let light
+			// through have light data.
+			u8 day = MYMAX(n.param1 & 0x0F, f.light_source);
+			u8 night = MYMAX(n.param1 >> 4, f.light_source);
+			n.param1 = day | (night << 4);
+			// Spread right away, so only the nodes that get
+			// brighter have to be queued.
+			if (n.param1) {
+				spread_light_from(grid, ndef, light_sources,
+					VoxelSpreadingLight(p, i, 6, n.param1), n.param1);
+			}
+		}
+	}
+
+	spread_light(grid, ndef, light_sources);
+}
+
 struct SunlightPropagationUnit{
 	v2s16 relative_pos;
 	bool is_sunlit;
@@ -464,8 +736,6 @@ bool is_sunlight_above(Map *map, v3s16 pos, const NodeDefManager *ndef)
 	return sunlight;
 }
 
-static const LightBank banks[] = { LIGHTBANK_DAY, LIGHTBANK_NIGHT };
-
 void update_lighting_nodes(Map *map,
 	std::vector<std::pair<v3s16, MapNode> > &oldnodes,
 	std::map<v3s16, MapBlock*> &modified_blocks)
@@ -474,10 +744,11 @@ void update_lighting_nodes(Map *map,
 	// For node getter functions
 	bool is_valid_position;
 
-	// Process each light bank separately
+	// Lights of both banks are spread together
+	ReLightQueue light_sources(256);
+	// Unlight each light bank separately
 	for (LightBank bank : banks) {
 		UnlightQueue disappearing_lights(256);
-		ReLightQueue light_sources(256);
 		// Nodes that are brighter than the brightest modified node was
 		// won't change, since they didn't get their light from a
 		// modified node.
@@ -546,7 +817,8 @@ void update_lighting_nodes(Map *map,
 			}
 
 			if (new_light > 0) {
-				light_sources.push(new_light, rel_pos, block_pos, block, 6);
+				light_sources.push(new_light, rel_pos, block_pos, block, 6,
+					pack_light(bank, new_light));
 			}
 
 			if (new_light < old_light) {
@@ -618,7 +890,7 @@ void update_lighting_nodes(Map *map,
 							block_pos2);
 						// Mark node for lighting.
 						light_sources.push(LIGHT_SUN, rel_pos2, block_pos2,
-							block2, 4);
+							block2, 4, pack_light(LIGHTBANK_DAY, LIGHT_SUN));
 					}
 				}
 			}
@@ -627,20 +899,11 @@ void update_lighting_nodes(Map *map,
 		// Remove lights
 		unspread_light(map, ndef, bank, disappearing_lights, light_sources,
 			modified_blocks);
-		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= LIGHT_SUN; i++) {
-			const std::vector<ChangingLight> &lights = light_sources.lights[i];
-			for (std::vector<ChangingLight>::const_iterator it = lights.begin();
-					it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position,
-					&is_valid_position);
-				n.setLight(bank, i, ndef);
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
-		// Spread lights.
-		spread_light(map, ndef, bank, light_sources, modified_blocks);
 	}
+	// Initialize light values for light spreading.
+	init_spreading_lights(ndef, light_sources);
+	// Spread lights.
+	spread_light(map, ndef, light_sources, modified_blocks);
 }
 
 /*!
@@ -693,11 +956,11 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 {
 	const NodeDefManager *ndef = map->getNodeDefManager();
 	bool is_valid_position;
+	// Since invalid light is not common, do not allocate
+	// memory if not needed.
+	ReLightQueue light_sources(0);
 	for (LightBank bank : banks) {
-		// Since invalid light is not common, do not allocate
-		// memory if not needed.
 		UnlightQueue disappearing_lights(0);
-		ReLightQueue light_sources(0);
 		// Get incorrect lights
 		for (direction d = 0; d < 6; d++) {
 			// For each direction
@@ -748,20 +1011,11 @@ void update_block_border_lighting(Map *map, MapBlock *block,
 		// Remove lights
 		unspread_light(map, ndef, bank, disappearing_lights, light_sources,
 			modified_blocks);
-		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= LIGHT_SUN; i++) {
-			const std::vector<ChangingLight> &lights = light_sources.lights[i];
-			for (std::vector<ChangingLight>::const_iterator it = lights.begin();
-					it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position,
-					&is_valid_position);
-				n.setLight(bank, i, ndef);
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
-		// Spread lights.
-		spread_light(map, ndef, bank, light_sources, modified_blocks);
 	}
+	// Initialize light values for light spreading.
+	init_spreading_lights(ndef, light_sources);
+	// Spread lights.
+	spread_light(map, ndef, light_sources, modified_blocks);
 }
 
 /*!
@@ -907,7 +1161,7 @@ bool propagate_block_sunlight(Map *map, const NodeDefManager *ndef,
 					block->setNodeNoCheck(current_pos, n);
 					modified = true;
 					relight->push(LIGHT_SUN, current_pos, data->target_block,
-						block, 4);
+						block, 4, pack_light(LIGHTBANK_DAY, LIGHT_SUN));
 				} else {
 					// Light already valid, propagation stopped.
 					break;
@@ -970,14 +1224,13 @@ const VoxelArea block_pad[] = {
  * coordinates
  * \param unlight the first queue is for day light, the second is for
  * night light. Contains all nodes on the borders that need to be unlit.
- * \param relight the first queue is for day light, the second is for
- * night light. Contains nodes that were not modified, but got sunlight
+ * \param relight contains nodes that were not modified, but got sunlight
  * because the changes.
  * \param modified_blocks the procedure adds all modified blocks to
  * this map
  */
 void finish_bulk_light_update(Map *map, mapblock_v3 minblock,
-	mapblock_v3 maxblock, UnlightQueue unlight[2], ReLightQueue relight[2],
+	mapblock_v3 maxblock, UnlightQueue unlight[2], ReLightQueue &relight,
 	std::map<v3s16, MapBlock*> *modified_blocks)
 {
 	const NodeDefManager *ndef = map->getNodeDefManager();
@@ -988,7 +1241,7 @@ void finish_bulk_light_update(Map *map, mapblock_v3 minblock,
 
 	for (size_t bank = 0; bank < 2; bank++) {
 		LightBank b = banks[bank];
-		unspread_light(map, ndef, b, unlight[bank], relight[bank],
+		unspread_light(map, ndef, b, unlight[bank], relight,
 			*modified_blocks);
 	}
 
@@ -1011,39 +1264,30 @@ void finish_bulk_light_update(Map *map, mapblock_v3 minblock,
 			MapNode node = block->getNodeNoCheck(relpos.X, relpos.Y, relpos.Z, &is_valid);
 			const ContentFeatures &f = ndef->get(node);
 
-			// For each light bank
-			for (size_t b = 0; b < 2; b++) {
-				LightBank bank = banks[b];
+			// Both light banks are queued together
+			u8 max_light = 0;
+			u8 packed_light = 0;
+			for (LightBank bank : banks) {
 				u8 light = f.param_type == CPT_LIGHT ?
 					node.getLightNoChecks(bank, &f):
 					f.light_source;
-				if (light > 1)
-					relight[b].push(light, relpos, blockpos, block, 6);
+				if (light > 1) {
+					max_light = MYMAX(max_light, light);
+					packed_light |= pack_light(bank, light);
+				}
 			} // end of banks
+			if (max_light > 0)
+				relight.push(max_light, relpos, blockpos, block, 6,
+					packed_light);
 		} // end of nodes
 	} // end of blocks
 
 	// --- STEP 3: do light spreading
 
-	// For each light bank:
-	for (size_t b = 0; b < 2; b++) {
-		LightBank bank = banks[b];
-		// Sunlight is already initialized.
-		u8 maxlight = (b == 0) ? LIGHT_MAX : LIGHT_SUN;
-		// Initialize light values for light spreading.
-		for (u8 i = 0; i <= maxlight; i++) {
-			const std::vector<ChangingLight> &lights = relight[b].lights[i];
-			for (std::vector<ChangingLight>::const_iterator it = lights.begin();
-					it < lights.end(); ++it) {
-				MapNode n = it->block->getNodeNoCheck(it->rel_position,
-					&is_valid);
-				n.setLight(bank, i, ndef);
-				it->block->setNodeNoCheck(it->rel_position, n);
-			}
-		}
-		// Spread lights.
-		spread_light(map, ndef, bank, relight[b], *modified_blocks);
-	}
+	// Initialize light values for light spreading.
+	init_spreading_lights(ndef, relight);
+	// Spread lights.
+	spread_light(map, ndef, relight, *modified_blocks);
 }
 
 void blit_back_with_light(ServerMap *map, MMVManip *vm,
@@ -1054,7 +1298,8 @@ void blit_back_with_light(ServerMap *map, MMVManip *vm,
 	mapblock_v3 maxblock = getNodeBlockPos(vm->m_area.MaxEdge);
 	// First queue is for day light, second is for night light.
 	UnlightQueue unlight[] = { UnlightQueue(256), UnlightQueue(256) };
-	ReLightQueue relight[] = { ReLightQueue(256), ReLightQueue(256) };
+	// Lights of both banks are spread together.
+	ReLightQueue relight(256);
 	// Will hold sunlight data.
 	bool lights[MAP_BLOCKSIZE][MAP_BLOCKSIZE];
 	SunlightPropagationData data;
@@ -1080,7 +1325,7 @@ void blit_back_with_light(ServerMap *map, MMVManip *vm,
 		// Propagate sunlight and shadow below the voxel manipulator.
 		while (!data.data.empty()) {
 			if (propagate_block_sunlight(map, ndef, &data, &unlight[0],
-					&relight[0]))
+					&relight))
 				(*modified_blocks)[data.target_block] =
 					map->getBlockNoCreateNoEx(data.target_block);
 			// Step downwards.
@@ -1197,7 +1442,8 @@ void repair_block_light(ServerMap *map, MapBlock *block,
 	const NodeDefManager *ndef = map->getNodeDefManager();
 	// First queue is for day light, second is for night light.
 	UnlightQueue unlight[] = { UnlightQueue(256), UnlightQueue(256) };
-	ReLightQueue relight[] = { ReLightQueue(256), ReLightQueue(256) };
+	// Lights of both banks are spread together.
+	ReLightQueue relight(256);
 	// Will hold sunlight data.
 	bool lights[MAP_BLOCKSIZE][MAP_BLOCKSIZE];
 	SunlightPropagationData data;
@@ -1222,7 +1468,7 @@ void repair_block_light(ServerMap *map, MapBlock *block,
 	// Propagate sunlight and shadow below the voxel manipulator.
 	while (!data.data.empty()) {
 		if (propagate_block_sunlight(map, ndef, &data, &unlight[0],
-				&relight[0]))
+				&relight))
 			(*modified_blocks)[data.target_block] =
 				map->getBlockNoCreateNoEx(data.target_block);
 		// Step downwards.
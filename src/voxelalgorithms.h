@@ -80,6 +80,17 @@ void blit_back_with_light(ServerMap *map, MMVManip *vm,
 void repair_block_light(ServerMap *map, MapBlock *block,
 	std::map<v3s16, MapBlock*> *modified_blocks);
 
+/*!
+ * Spreads light in both light banks inside the given area
+ * of a voxel manipulator, starting from all lit nodes and light
+ * sources in the area. Nodes outside of the area are not changed.
+ * Used by the map generator.
+ *
+ * \param a the area to light, must be inside the voxel manipulator
+ */
+void spread_light(VoxelManipulator *vm, const NodeDefManager *ndef,
+	const VoxelArea &a);
+
 /*!
  * This class iterates trough voxels that intersect with
  * a line. The collision detection does not see nodeboxes,